@@ -27,15 +27,22 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/lookup/vl_lookup.h"
 #include "utils/metadata/meta_data.h"
-#include "utils_cache.h" /* for uc_get_rate() */
+#include "utils/sketch/sketch.h"
+#include "utils_cache.h" /* for uc_get_rate_r() */
 #include "utils_subst.h"
 
 #define AGG_MATCHES_ALL(str) (strcmp("/.*/", str) == 0)
 #define AGG_FUNC_PLACEHOLDER "%{aggregation}"
 
+/* Number of accumulators per instance. Writer threads are spread over the
+ * shards, so that they don't contend on the same counters and lock. */
+#define AGG_SHARDS_NUM 8
+#define AGG_SKETCH_ACCURACY 0.01
+
 struct aggregation_s /* {{{ */
 {
   lookup_identifier_t ident;
@@ -54,24 +61,46 @@ struct aggregation_s /* {{{ */
   bool calc_min;
   bool calc_max;
   bool calc_stddev;
+
+  double *percentiles;
+  size_t percentiles_num;
 }; /* }}} */
 typedef struct aggregation_s aggregation_t;
 
+struct agg_shard_s /* {{{ */
+{
+  /* Updated with atomic adds and taken with atomic exchanges. */
+  derive_t num;
+  gauge_t sum;
+  gauge_t squares_sum;
+
+  /* Protects "min", "max" and "sketch", which cannot be updated atomically. */
+  pthread_mutex_t lock;
+  gauge_t min;
+  gauge_t max;
+
+  sketch_t *sketch;
+}; /* }}} */
+typedef struct agg_shard_s agg_shard_t;
+
 struct agg_instance_s;
 typedef struct agg_instance_s agg_instance_t;
 struct agg_instance_s /* {{{ */
 {
-  pthread_mutex_t lock;
   lookup_identifier_t ident;
 
   int ds_type;
+  /* Whether any of min, max or the percentiles is calculated, i.e. whether
+   * writers need to take the shard lock. */
+  bool locked;
 
-  derive_t num;
-  gauge_t sum;
-  gauge_t squares_sum;
+  /* Only written by agg_write(), merged and reset by agg_read(). */
+  agg_shard_t shards[AGG_SHARDS_NUM];
+  /* Only used by agg_read(). */
+  sketch_t *sketch;
 
-  gauge_t min;
-  gauge_t max;
+  double const *percentiles;
+  size_t percentiles_num;
 
   rate_to_value_state_t *state_num;
   rate_to_value_state_t *state_sum;
@@ -79,15 +108,41 @@ struct agg_instance_s /* {{{ */
   rate_to_value_state_t *state_min;
   rate_to_value_state_t *state_max;
   rate_to_value_state_t *state_stddev;
+  rate_to_value_state_t *state_percentile;
 
   agg_instance_t *next;
 }; /* }}} */
 
+/* The instances a series (value list identifier) feeds into. Resolving this
+ * with lookup_search() is expensive, so the result is kept until the series
+ * expires from the value cache. */
+struct agg_series_s /* {{{ */
+{
+  agg_instance_t **instances;
+  size_t instances_num;
+  char name[];
+}; /* }}} */
+typedef struct agg_series_s agg_series_t;
+
 static lookup_t *lookup;
 
 static pthread_mutex_t agg_instance_list_lock = PTHREAD_MUTEX_INITIALIZER;
 static agg_instance_t *agg_instance_list_head;
 
+/* Lock order: agg_series_lock, then agg_instance_list_lock. Known series are
+ * looked up under the read lock; adding or removing a series requires the
+ * write lock. */
+static pthread_rwlock_t agg_series_lock = PTHREAD_RWLOCK_INITIALIZER;
+static c_avl_tree_t *agg_series_tree;
+/* Collects the results of lookup_search(), protected by the write lock of
+ * agg_series_lock. */
+static agg_series_t *agg_series_current;
+
+static pthread_key_t agg_shard_key;
+static pthread_once_t agg_shard_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t agg_shard_next_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t agg_shard_next;
+
 static bool agg_is_regex(char const *str) /* {{{ */
 {
   if (str == NULL)
@@ -105,9 +160,48 @@ static bool agg_is_regex(char const *str) /* {{{ */
 
 static void agg_destroy(aggregation_t *agg) /* {{{ */
 {
+  if (agg == NULL)
+    return;
+
+  sfree(agg->percentiles);
   sfree(agg);
 } /* }}} void agg_destroy */
 
+static void agg_shard_key_create(void) /* {{{ */
+{
+  pthread_key_create(&agg_shard_key, /* destructor = */ NULL);
+} /* }}} void agg_shard_key_create */
+
+/* Returns the shard used by the calling thread. Threads are assigned to the
+ * shards round-robin when they write their first value. */
+static size_t agg_shard_index(void) /* {{{ */
+{
+  pthread_once(&agg_shard_key_once, agg_shard_key_create);
+
+  uintptr_t id = (uintptr_t)pthread_getspecific(agg_shard_key);
+  if (id == 0) {
+    pthread_mutex_lock(&agg_shard_next_lock);
+    id = (agg_shard_next % AGG_SHARDS_NUM) + 1;
+    agg_shard_next++;
+    pthread_mutex_unlock(&agg_shard_next_lock);
+
+    pthread_setspecific(agg_shard_key, (void *)id);
+  }
+
+  return (size_t)(id - 1);
+} /* }}} size_t agg_shard_index */
+
+static void agg_shard_reset(agg_shard_t *shard) /* {{{ */
+{
+  shard->num = 0;
+  shard->sum = 0.0;
+  shard->squares_sum = 0.0;
+  shard->min = NAN;
+  shard->max = NAN;
+  if (shard->sketch != NULL)
+    sketch_reset(shard->sketch);
+} /* }}} void agg_shard_reset */
+
 /* Frees all dynamically allocated memory within the instance. */
 static void agg_instance_destroy(agg_instance_t *inst) /* {{{ */
 {
@@ -133,11 +227,16 @@ static void agg_instance_destroy(agg_instance_t *inst) /* {{{ */
   sfree(inst->state_min);
   sfree(inst->state_max);
   sfree(inst->state_stddev);
+  sfree(inst->state_percentile);
+
+  for (size_t i = 0; i < AGG_SHARDS_NUM; i++) {
+    pthread_mutex_destroy(&inst->shards[i].lock);
+    sketch_destroy(inst->shards[i].sketch);
+  }
+  sketch_destroy(inst->sketch);
 
   memset(inst, 0, sizeof(*inst));
   inst->ds_type = -1;
-  inst->min = NAN;
-  inst->max = NAN;
 } /* }}} void agg_instance_destroy */
 
 static int agg_instance_create_name(agg_instance_t *inst, /* {{{ */
@@ -238,14 +337,37 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
     ERROR("aggregation plugin: calloc() failed.");
     return NULL;
   }
-  pthread_mutex_init(&inst->lock, /* attr = */ NULL);
 
   inst->ds_type = ds->ds[0].type;
 
   agg_instance_create_name(inst, vl, agg);
 
-  inst->min = NAN;
-  inst->max = NAN;
+  inst->percentiles = agg->percentiles;
+  inst->percentiles_num = agg->percentiles_num;
+  inst->locked = agg->calc_min || agg->calc_max || (agg->percentiles_num > 0);
+
+  for (size_t i = 0; i < AGG_SHARDS_NUM; i++) {
+    pthread_mutex_init(&inst->shards[i].lock, /* attr = */ NULL);
+    agg_shard_reset(&inst->shards[i]);
+  }
+
+  if (agg->percentiles_num > 0) {
+    inst->state_percentile =
+        calloc(agg->percentiles_num, sizeof(*inst->state_percentile));
+    inst->sketch = sketch_create(AGG_SKETCH_ACCURACY);
+    bool failed = (inst->state_percentile == NULL) || (inst->sketch == NULL);
+    for (size_t i = 0; !failed && (i < AGG_SHARDS_NUM); i++) {
+      inst->shards[i].sketch = sketch_create(AGG_SKETCH_ACCURACY);
+      failed = (inst->shards[i].sketch == NULL);
+    }
+
+    if (failed) {
+      agg_instance_destroy(inst);
+      free(inst);
+      ERROR("aggregation plugin: Allocating percentile state failed.");
+      return NULL;
+    }
+  }
 
 #define INIT_STATE(field)                                                      \
   do {                                                                         \
@@ -278,22 +400,23 @@ static agg_instance_t *agg_instance_create(data_set_t const *ds, /* {{{ */
   return inst;
 } /* }}} agg_instance_t *agg_instance_create */
 
-/* Update the num, sum, min, max, ... fields of the aggregation instance, if
- * the rate of the value list is available. Value lists with more than one data
- * source are not supported and will return an error. Returns zero on success
- * and non-zero otherwise. */
-static int agg_instance_update(agg_instance_t *inst, /* {{{ */
-                               data_set_t const *ds, value_list_t const *vl) {
-  if (ds->ds_num != 1) {
-    ERROR("aggregation plugin: The \"%s\" type (data set) has more than one "
-          "data source. This is currently not supported by this plugin. "
-          "Sorry.",
-          ds->type);
-    return EINVAL;
+/* Returns the rate of a value list with a single data source. Gauges are
+ * used as-is, applying the same range check as the value cache, so that the
+ * cache is only consulted for the other data source types. */
+static int agg_get_rate(data_set_t const *ds, value_list_t const *vl, /* {{{ */
+                        gauge_t *ret_rate) {
+  if (ds->ds[0].type == DS_TYPE_GAUGE) {
+    gauge_t rate = vl->values[0].gauge;
+
+    if ((rate < ds->ds[0].min) || (rate > ds->ds[0].max))
+      rate = NAN;
+
+    *ret_rate = rate;
+    return 0;
   }
 
-  gauge_t *rate = uc_get_rate(ds, vl);
-  if (rate == NULL) {
+  gauge_t rate[ds->ds_num];
+  if (uc_get_rate_r(ds, vl, rate) != 0) {
     char ident[6 * DATA_MAX_NAME_LEN];
     FORMAT_VL(ident, sizeof(ident), vl);
     ERROR("aggregation plugin: Unable to read the current rate of \"%s\".",
@@ -301,27 +424,57 @@ static int agg_instance_update(agg_instance_t *inst, /* {{{ */
     return ENOENT;
   }
 
-  if (isnan(rate[0])) {
-    sfree(rate);
-    return 0;
-  }
+  *ret_rate = rate[0];
+  return 0;
+} /* }}} int agg_get_rate */
 
-  pthread_mutex_lock(&inst->lock);
+static void agg_atomic_add(gauge_t *dst, gauge_t value) /* {{{ */
+{
+  gauge_t old;
+  gauge_t new;
+
+  __atomic_load(dst, &old, __ATOMIC_RELAXED);
+  do {
+    new = old + value;
+  } while (!__atomic_compare_exchange(dst, &old, &new, /* weak = */ true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+} /* }}} void agg_atomic_add */
 
-  inst->num++;
-  inst->sum += rate[0];
-  inst->squares_sum += (rate[0] * rate[0]);
+static gauge_t agg_atomic_take(gauge_t *src) /* {{{ */
+{
+  gauge_t zero = 0.0;
+  gauge_t ret;
 
-  if (isnan(inst->min) || (inst->min > rate[0]))
-    inst->min = rate[0];
-  if (isnan(inst->max) || (inst->max < rate[0]))
-    inst->max = rate[0];
+  __atomic_exchange(src, &zero, &ret, __ATOMIC_RELAXED);
+  return ret;
+} /* }}} gauge_t agg_atomic_take */
 
-  pthread_mutex_unlock(&inst->lock);
+/* Update the num, sum, min, max, ... fields of the calling thread's shard of
+ * the aggregation instance. Instances that only calculate num, sum, average
+ * and stddev are updated without taking the shard lock. */
+static void agg_instance_update(agg_instance_t *inst, /* {{{ */
+                                size_t shard_index, gauge_t rate) {
+  agg_shard_t *shard = inst->shards + shard_index;
 
-  sfree(rate);
-  return 0;
-} /* }}} int agg_instance_update */
+  __atomic_fetch_add(&shard->num, 1, __ATOMIC_RELAXED);
+  agg_atomic_add(&shard->sum, rate);
+  agg_atomic_add(&shard->squares_sum, rate * rate);
+
+  if (!inst->locked)
+    return;
+
+  pthread_mutex_lock(&shard->lock);
+
+  if (isnan(shard->min) || (shard->min > rate))
+    shard->min = rate;
+  if (isnan(shard->max) || (shard->max < rate))
+    shard->max = rate;
+
+  if (shard->sketch != NULL)
+    sketch_add(shard->sketch, rate);
+
+  pthread_mutex_unlock(&shard->lock);
+} /* }}} void agg_instance_update */
 
 static int agg_instance_read_func(agg_instance_t *inst, /* {{{ */
                                   char const *func, gauge_t rate,
@@ -383,6 +536,46 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
   sstrncpy(vl.type_instance, inst->ident.type_instance,
            sizeof(vl.type_instance));
 
+  /* Merge and reset the shards. Each lock is only held briefly, so writers
+   * are not blocked while the values are dispatched. The counters are taken
+   * one after the other, so a value written concurrently may be counted in
+   * "num" of this interval but in "sum" of the next one. */
+  agg_shard_t total = {
+      .min = NAN,
+      .max = NAN,
+      .sketch = inst->sketch,
+  };
+  if (total.sketch != NULL)
+    sketch_reset(total.sketch);
+
+  for (size_t i = 0; i < AGG_SHARDS_NUM; i++) {
+    agg_shard_t *shard = inst->shards + i;
+
+    total.num += __atomic_exchange_n(&shard->num, 0, __ATOMIC_RELAXED);
+    total.sum += agg_atomic_take(&shard->sum);
+    total.squares_sum += agg_atomic_take(&shard->squares_sum);
+
+    if (!inst->locked)
+      continue;
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (isnan(total.min) || (total.min > shard->min))
+      total.min = shard->min;
+    if (isnan(total.max) || (total.max < shard->max))
+      total.max = shard->max;
+    if ((total.sketch != NULL) &&
+        (sketch_merge(total.sketch, shard->sketch) != 0))
+      WARNING("aggregation plugin: sketch_merge failed.");
+
+    shard->min = NAN;
+    shard->max = NAN;
+    if (shard->sketch != NULL)
+      sketch_reset(shard->sketch);
+
+    pthread_mutex_unlock(&shard->lock);
+  }
+
 #define READ_FUNC(func, rate)                                                  \
   do {                                                                         \
     if (inst->state_##func != NULL) {                                          \
@@ -391,31 +584,28 @@ static int agg_instance_read(agg_instance_t *inst, cdtime_t t) /* {{{ */
     }                                                                          \
   } while (0)
 
-  pthread_mutex_lock(&inst->lock);
-
-  READ_FUNC(num, (gauge_t)inst->num);
+  READ_FUNC(num, (gauge_t)total.num);
 
   /* All other aggregations are only defined when there have been any values
    * at all. */
-  if (inst->num > 0) {
-    READ_FUNC(sum, inst->sum);
-    READ_FUNC(average, (inst->sum / ((gauge_t)inst->num)));
-    READ_FUNC(min, inst->min);
-    READ_FUNC(max, inst->max);
-    READ_FUNC(stddev, sqrt((((gauge_t)inst->num) * inst->squares_sum) -
-                           (inst->sum * inst->sum)) /
-                          ((gauge_t)inst->num));
+  if (total.num > 0) {
+    READ_FUNC(sum, total.sum);
+    READ_FUNC(average, (total.sum / ((gauge_t)total.num)));
+    READ_FUNC(min, total.min);
+    READ_FUNC(max, total.max);
+    READ_FUNC(stddev, sqrt((((gauge_t)total.num) * total.squares_sum) -
+                           (total.sum * total.sum)) /
+                          ((gauge_t)total.num));
+
+    for (size_t i = 0; i < inst->percentiles_num; i++) {
+      char func[DATA_MAX_NAME_LEN];
+      ssnprintf(func, sizeof(func), "percentile-%g", inst->percentiles[i]);
+      agg_instance_read_func(
+          inst, func, sketch_percentile(inst->sketch, inst->percentiles[i]),
+          inst->state_percentile + i, &vl, inst->ident.plugin_instance, t);
+    }
   }
 
-  /* Reset internal state. */
-  inst->num = 0;
-  inst->sum = 0.0;
-  inst->squares_sum = 0.0;
-  inst->min = NAN;
-  inst->max = NAN;
-
-  pthread_mutex_unlock(&inst->lock);
-
   meta_data_destroy(vl.meta);
   vl.meta = NULL;
 
@@ -430,12 +620,28 @@ static void *agg_lookup_class_callback(/* {{{ */
   return agg_instance_create(ds, vl, (aggregation_t *)user_class);
 } /* }}} void *agg_class_callback */
 
-/* lookup_obj_callback_t for utils_vl_lookup */
+/* lookup_obj_callback_t for utils_vl_lookup. Only records the instance in
+ * agg_series_current; the value is added by agg_write(). */
 static int agg_lookup_obj_callback(data_set_t const *ds, /* {{{ */
                                    value_list_t const *vl,
                                    __attribute__((unused)) void *user_class,
                                    void *user_obj) {
-  return agg_instance_update((agg_instance_t *)user_obj, ds, vl);
+  agg_series_t *series = agg_series_current;
+  if (series == NULL)
+    return EINVAL;
+
+  agg_instance_t **tmp =
+      realloc(series->instances,
+              (series->instances_num + 1) * sizeof(*series->instances));
+  if (tmp == NULL) {
+    ERROR("aggregation plugin: realloc failed.");
+    return ENOMEM;
+  }
+  series->instances = tmp;
+  series->instances[series->instances_num] = user_obj;
+  series->instances_num++;
+
+  return 0;
 } /* }}} int agg_lookup_obj_callback */
 
 /* lookup_free_class_callback_t for utils_vl_lookup */
@@ -465,6 +671,7 @@ static void agg_lookup_free_obj_callback(void *user_obj) /* {{{ */
  *     CalculateMinimum true
  *     CalculateMaximum true
  *     CalculateStddev true
+ *     CalculatePercentile 99
  *   </Aggregation>
  * </Plugin>
  */
@@ -499,6 +706,33 @@ static int agg_config_handle_group_by(oconfig_item_t const *ci, /* {{{ */
   return 0;
 } /* }}} int agg_config_handle_group_by */
 
+static int agg_config_add_percentile(oconfig_item_t *ci, /* {{{ */
+                                     aggregation_t *agg) {
+  double percent;
+  int status = cf_util_get_double(ci, &percent);
+  if (status != 0)
+    return status;
+
+  if ((percent <= 0.0) || (percent >= 100)) {
+    ERROR("aggregation plugin: The value for \"%s\" must be between 0 and "
+          "100, exclusively.",
+          ci->key);
+    return ERANGE;
+  }
+
+  double *tmp = realloc(agg->percentiles,
+                        sizeof(*agg->percentiles) * (agg->percentiles_num + 1));
+  if (tmp == NULL) {
+    ERROR("aggregation plugin: realloc failed.");
+    return ENOMEM;
+  }
+  agg->percentiles = tmp;
+  agg->percentiles[agg->percentiles_num] = percent;
+  agg->percentiles_num++;
+
+  return 0;
+} /* }}} int agg_config_add_percentile */
+
 static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
 {
   aggregation_t *agg = calloc(1, sizeof(*agg));
@@ -555,13 +789,15 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_boolean(child, &agg->calc_max);
     else if (strcasecmp("CalculateStddev", child->key) == 0)
       status = cf_util_get_boolean(child, &agg->calc_stddev);
+    else if (strcasecmp("CalculatePercentile", child->key) == 0)
+      status = agg_config_add_percentile(child, agg);
     else
       WARNING("aggregation plugin: The \"%s\" key is not allowed inside "
               "<Aggregation /> blocks and will be ignored.",
               child->key);
 
     if (status != 0) {
-      sfree(agg);
+      agg_destroy(agg);
       return status;
     }
   } /* for (int i = 0; i < ci->children_num; i++) */
@@ -620,7 +856,8 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!agg->calc_num && !agg->calc_sum && !agg->calc_average /* {{{ */
-      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev) {
+      && !agg->calc_min && !agg->calc_max && !agg->calc_stddev &&
+      (agg->percentiles_num == 0)) {
     ERROR("aggregation plugin: No aggregation function has been specified. "
           "Without this, I don't know what I should be calculating. "
           "(Host \"%s\", Plugin \"%s\", PluginInstance \"%s\", "
@@ -631,14 +868,14 @@ static int agg_config_aggregation(oconfig_item_t *ci) /* {{{ */
   } /* }}} */
 
   if (!is_valid) { /* {{{ */
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   } /* }}} */
 
   int status = lookup_add(lookup, &agg->ident, agg->group_by, agg);
   if (status != 0) {
     ERROR("aggregation plugin: lookup_add failed with status %i.", status);
-    sfree(agg);
+    agg_destroy(agg);
     return -1;
   }
 
@@ -715,6 +952,109 @@ static int agg_read(void) /* {{{ */
   return (success > 0) ? 0 : -1;
 } /* }}} int agg_read */
 
+static void agg_series_free(agg_series_t *series) /* {{{ */
+{
+  if (series == NULL)
+    return;
+
+  sfree(series->instances);
+  sfree(series);
+} /* }}} void agg_series_free */
+
+/* Copies the instances of "series" into "ret_instances". If the buffer is too
+ * small, "*ret_instances" is replaced with a newly allocated array which must
+ * be freed by the caller. The caller must hold agg_series_lock. */
+static ssize_t agg_series_copy(agg_series_t const *series, /* {{{ */
+                               agg_instance_t ***ret_instances,
+                               size_t instances_size) {
+  size_t num = series->instances_num;
+  if (num > instances_size) {
+    agg_instance_t **tmp = calloc(num, sizeof(*tmp));
+    if (tmp == NULL) {
+      ERROR("aggregation plugin: calloc failed.");
+      return -1;
+    }
+    *ret_instances = tmp;
+  }
+  if (num > 0)
+    memcpy(*ret_instances, series->instances, num * sizeof(**ret_instances));
+
+  return (ssize_t)num;
+} /* }}} ssize_t agg_series_copy */
+
+/* Resolves the instances of the series "name" with lookup_search() and adds
+ * it to agg_series_tree. The caller must hold the write lock of
+ * agg_series_lock. */
+static agg_series_t *agg_series_create(data_set_t const *ds, /* {{{ */
+                                       value_list_t const *vl,
+                                       char const *name) {
+  if (agg_series_tree == NULL) {
+    agg_series_tree =
+        c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (agg_series_tree == NULL) {
+      ERROR("aggregation plugin: c_avl_create failed.");
+      return NULL;
+    }
+  }
+
+  size_t name_len = strlen(name) + 1;
+  agg_series_t *series = calloc(1, sizeof(*series) + name_len);
+  if (series == NULL) {
+    ERROR("aggregation plugin: calloc failed.");
+    return NULL;
+  }
+  memcpy(series->name, name, name_len);
+
+  agg_series_current = series;
+  int status = lookup_search(lookup, ds, vl);
+  agg_series_current = NULL;
+
+  if ((status < 0) ||
+      (c_avl_insert(agg_series_tree, series->name, series) != 0)) {
+    ERROR("aggregation plugin: Looking up the aggregations of \"%s\" "
+          "failed.",
+          name);
+    agg_series_free(series);
+    return NULL;
+  }
+
+  return series;
+} /* }}} agg_series_t *agg_series_create */
+
+/* Copies the instances the series "name" feeds into "ret_instances", see
+ * agg_series_copy(). Series seen before are found under the read lock, so
+ * concurrent writers do not serialize; only the first value of a series takes
+ * the write lock to call lookup_search(). Returns the number of instances or
+ * less than zero on error. */
+static ssize_t agg_series_get(data_set_t const *ds, /* {{{ */
+                              value_list_t const *vl, char const *name,
+                              agg_instance_t ***ret_instances,
+                              size_t instances_size) {
+  agg_series_t *series = NULL;
+  ssize_t num;
+
+  pthread_rwlock_rdlock(&agg_series_lock);
+  if ((agg_series_tree != NULL) &&
+      (c_avl_get(agg_series_tree, name, (void *)&series) == 0)) {
+    num = agg_series_copy(series, ret_instances, instances_size);
+    pthread_rwlock_unlock(&agg_series_lock);
+    return num;
+  }
+  pthread_rwlock_unlock(&agg_series_lock);
+
+  pthread_rwlock_wrlock(&agg_series_lock);
+  /* Another thread may have added the series in the meantime. */
+  if ((agg_series_tree == NULL) ||
+      (c_avl_get(agg_series_tree, name, (void *)&series) != 0))
+    series = agg_series_create(ds, vl, name);
+  num = (series != NULL)
+            ? agg_series_copy(series, ret_instances, instances_size)
+            : -1;
+  pthread_rwlock_unlock(&agg_series_lock);
+
+  return num;
+} /* }}} ssize_t agg_series_get */
+
 static int agg_write(data_set_t const *ds, value_list_t const *vl, /* {{{ */
                      __attribute__((unused)) user_data_t *user_data) {
   bool created_by_aggregation = false;
@@ -725,21 +1065,67 @@ static int agg_write(data_set_t const *ds, value_list_t const *vl, /* {{{ */
   if (created_by_aggregation)
     return 0;
 
-  int status;
-
   if (lookup == NULL)
-    status = ENOENT;
-  else {
-    status = lookup_search(lookup, ds, vl);
-    if (status > 0)
-      status = 0;
+    return ENOENT;
+
+  char name[6 * DATA_MAX_NAME_LEN];
+  int status = FORMAT_VL(name, sizeof(name), vl);
+  if (status != 0)
+    return status;
+
+  agg_instance_t *buffer[16];
+  agg_instance_t **instances = buffer;
+  ssize_t num = agg_series_get(ds, vl, name, &instances,
+                               STATIC_ARRAY_SIZE(buffer));
+  if (num <= 0)
+    return (num == 0) ? 0 : -1;
+
+  if (ds->ds_num != 1) {
+    ERROR("aggregation plugin: The \"%s\" type (data set) has more than one "
+          "data source. This is currently not supported by this plugin. "
+          "Sorry.",
+          ds->type);
+    status = EINVAL;
+  } else {
+    gauge_t rate = NAN;
+
+    status = agg_get_rate(ds, vl, &rate);
+    if ((status == 0) && !isnan(rate)) {
+      size_t shard_index = agg_shard_index();
+      for (ssize_t i = 0; i < num; i++)
+        agg_instance_update(instances[i], shard_index, rate);
+    }
   }
 
+  if (instances != buffer)
+    sfree(instances);
+
   return status;
 } /* }}} int agg_write */
 
+/* Forgets the aggregations of series that expired from the value cache. */
+static int agg_missing(value_list_t const *vl, /* {{{ */
+                       __attribute__((unused)) user_data_t *user_data) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return 0;
+
+  char *key = NULL;
+  agg_series_t *series = NULL;
+
+  pthread_rwlock_wrlock(&agg_series_lock);
+  if ((agg_series_tree != NULL) &&
+      (c_avl_remove(agg_series_tree, name, (void *)&key, (void *)&series) ==
+       0))
+    agg_series_free(series);
+  pthread_rwlock_unlock(&agg_series_lock);
+
+  return 0;
+} /* }}} int agg_missing */
+
 void module_register(void) {
   plugin_register_complex_config("aggregation", agg_config);
   plugin_register_read("aggregation", agg_read);
   plugin_register_write("aggregation", agg_write, /* user_data = */ NULL);
+  plugin_register_missing("aggregation", agg_missing, /* user_data = */ NULL);
 }
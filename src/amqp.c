@@ -792,6 +792,7 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   camqp_config_t *conf = user_data->data;
   char routing_key[6 * DATA_MAX_NAME_LEN];
   char buffer[8192];
+  char const *payload = buffer;
   int status;
 
   if ((ds == NULL) || (vl == NULL) || (conf == NULL))
@@ -821,12 +822,17 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
       return status;
     }
   } else if (conf->format == CAMQP_FORMAT_JSON) {
-    size_t bfree = sizeof(buffer);
-    size_t bfill = 0;
+    json_buffer_t *json = json_buffer_thread();
+    if (json == NULL)
+      return ENOMEM;
 
-    format_json_initialize(buffer, &bfill, &bfree);
-    format_json_value_list(buffer, &bfill, &bfree, ds, vl, conf->store_rates);
-    format_json_finalize(buffer, &bfill, &bfree);
+    status = json_buffer_value_list(json, ds, vl, conf->store_rates);
+    if (status != 0) {
+      ERROR("amqp plugin: Formatting JSON failed with status %i.", status);
+      return status;
+    }
+    json_buffer_finalize(json);
+    payload = json->data;
   } else if (conf->format == CAMQP_FORMAT_GRAPHITE) {
     status =
         format_graphite(buffer, sizeof(buffer), ds, vl, conf->prefix,
@@ -841,7 +847,7 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   }
 
   pthread_mutex_lock(&conf->lock);
-  status = camqp_write_locked(conf, buffer, routing_key);
+  status = camqp_write_locked(conf, payload, routing_key);
   pthread_mutex_unlock(&conf->lock);
 
   return status;
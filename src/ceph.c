@@ -1454,7 +1454,7 @@ static int ceph_shutdown(void) {
 
 void module_register(void) {
   plugin_register_complex_config("ceph", ceph_config);
-  plugin_register_init("ceph", ceph_init);
+  plugin_register_parallel_init("ceph", ceph_init);
   plugin_register_read("ceph", ceph_read);
   plugin_register_shutdown("ceph", ceph_shutdown);
 }
@@ -0,0 +1,177 @@
+/**
+ * collectd - src/collectd-columnar.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/columnar/columnar.h"
+
+typedef struct {
+  const char *match;
+  int64_t start_ms;
+  int64_t end_ms;
+  bool summary;
+  uint64_t points;
+  uint64_t values;
+} dump_options_t;
+
+static void exit_usage(int status) /* {{{ */
+{
+  fprintf((status == EXIT_SUCCESS) ? stdout : stderr,
+          "Usage: collectd-columnar [options] <file> [<file> ...]\n"
+          "\n"
+          "Prints the values stored by the write_columnar plugin as PUTVAL\n"
+          "commands.\n"
+          "\n"
+          "Valid options:\n"
+          "  -m <string>    Only print identifiers containing <string>.\n"
+          "  -s <time>      Skip values before <time> (seconds since epoch).\n"
+          "  -e <time>      Skip values after <time> (seconds since epoch).\n"
+          "  -S             Print a summary per file instead of values.\n"
+          "  -h             Print this help and exit.\n"
+          "\n"
+          "collectd " PACKAGE_VERSION ", http://collectd.org/\n");
+  exit(status);
+} /* }}} void exit_usage */
+
+static int print_point(const columnar_entry_t *e, int64_t time_ms, /* {{{ */
+                       const columnar_value_t *values, void *user_data) {
+  dump_options_t *opts = user_data;
+
+  if ((time_ms < opts->start_ms) || (time_ms > opts->end_ms))
+    return 0;
+  if ((opts->match != NULL) && (strstr(e->name, opts->match) == NULL))
+    return 0;
+
+  opts->points++;
+  opts->values += e->ds_num;
+  if (opts->summary)
+    return 0;
+
+  printf("PUTVAL \"%s\" %" PRIi64 ".%03" PRIi64, e->name, time_ms / 1000,
+         time_ms % 1000);
+  for (size_t i = 0; i < e->ds_num; i++) {
+    switch (e->ds_types[i]) {
+    case COLUMNAR_DS_GAUGE:
+      if (isnan(values[i].gauge))
+        printf(":U");
+      else
+        printf(":%.15g", values[i].gauge);
+      break;
+    case COLUMNAR_DS_DERIVE:
+      printf(":%" PRIi64, values[i].derive);
+      break;
+    case COLUMNAR_DS_COUNTER:
+      printf(":%" PRIu64, values[i].counter);
+      break;
+    default:
+      printf(":%" PRIu64, values[i].absolute);
+      break;
+    }
+  }
+  printf("\n");
+
+  return 0;
+} /* }}} int print_point */
+
+static int dump_file(const char *file, dump_options_t *opts) /* {{{ */
+{
+  struct stat statbuf;
+  FILE *fh;
+  int status;
+
+  fh = fopen(file, "r");
+  if (fh == NULL) {
+    fprintf(stderr, "%s: %s\n", file, strerror(errno));
+    return -1;
+  }
+
+  opts->points = 0;
+  opts->values = 0;
+  status = columnar_file_read(fh, print_point, opts);
+  if (status != 0)
+    fprintf(stderr, "%s: %s\n", file,
+            (status == EILSEQ) ? "corrupt file" : strerror(status));
+
+  if (opts->summary && (fstat(fileno(fh), &statbuf) == 0))
+    printf("%s: %" PRIu64 " points, %" PRIu64 " values, %lld bytes, "
+           "%.2f bytes/value\n",
+           file, opts->points, opts->values, (long long)statbuf.st_size,
+           (opts->values > 0)
+               ? ((double)statbuf.st_size) / ((double)opts->values)
+               : 0.0);
+
+  fclose(fh);
+  return status;
+} /* }}} int dump_file */
+
+int main(int argc, char **argv) /* {{{ */
+{
+  dump_options_t opts = {
+      .start_ms = INT64_MIN,
+      .end_ms = INT64_MAX,
+  };
+  int errors = 0;
+
+  while (42) {
+    int c = getopt(argc, argv, "m:s:e:Sh");
+
+    if (c == -1)
+      break;
+
+    switch (c) {
+    case 'm':
+      opts.match = optarg;
+      break;
+    case 's':
+      opts.start_ms = (int64_t)(atof(optarg) * 1000.0);
+      break;
+    case 'e':
+      opts.end_ms = (int64_t)(atof(optarg) * 1000.0);
+      break;
+    case 'S':
+      opts.summary = true;
+      break;
+    case 'h':
+      exit_usage(EXIT_SUCCESS);
+      break;
+    default:
+      exit_usage(EXIT_FAILURE);
+    }
+  }
+
+  if (optind >= argc)
+    exit_usage(EXIT_FAILURE);
+
+  for (int i = optind; i < argc; i++)
+    if (dump_file(argv[i], &opts) != 0)
+      errors++;
+
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+} /* }}} int main */
@@ -33,13 +33,16 @@
 #endif
 
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -59,8 +62,11 @@ static int conf_num_values = DEF_NUM_VALUES;
 static double conf_interval = DEF_INTERVAL;
 static const char *conf_destination = NET_DEFAULT_V6_ADDR;
 static const char *conf_service = NET_DEFAULT_PORT;
+static const char *conf_socket;
 
 static lcc_network_t *net;
+/* Used instead of "net" when sending to the unixsock plugin. */
+static FILE *sock_fh;
 
 static c_heap_t *values_heap;
 
@@ -86,6 +92,8 @@ __attribute__((noreturn)) static void exit_usage(int exit_status) /* {{{ */
       "                   (Default: %s)\n"
       "    -D <port>      Destination port of the network packets.\n"
       "                   (Default: %s)\n"
+      "    -s <socket>    Send PUTVAL commands to the UNIX socket of the\n"
+      "                   unixsock plugin instead of network packets.\n"
       "    -h             Print usage information (this output).\n"
       "\n"
       "Copyright (C) 2010-2012  Florian Forster\n"
@@ -213,6 +221,76 @@ static void destroy_value_list(lcc_value_list_t *vl) /* {{{ */
   free(vl);
 } /* }}} void destroy_value_list */
 
+static int sock_connect(void) /* {{{ */
+{
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  char reply[256];
+
+  int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  strncpy(sa.sun_path, conf_socket, sizeof(sa.sun_path) - 1);
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    fprintf(stderr, "connect(%s) failed: %s\n", conf_socket, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  /* Disable the reply to each PUTVAL, so the commands can be streamed
+   * without waiting for the daemon. */
+  size_t reply_len = 0;
+  if (write(fd, "QUIET\n", 6) != 6) {
+    perror("write");
+    close(fd);
+    return -1;
+  }
+  while ((reply_len < sizeof(reply) - 1) &&
+         (memchr(reply, '\n', reply_len) == NULL)) {
+    ssize_t status = read(fd, reply + reply_len, sizeof(reply) - 1 - reply_len);
+    if (status <= 0)
+      break;
+    reply_len += (size_t)status;
+  }
+  reply[reply_len] = 0;
+  if (reply[0] != '0') {
+    fprintf(stderr, "Enabling quiet mode failed: %s\n", reply);
+    close(fd);
+    return -1;
+  }
+
+  sock_fh = fdopen(fd, "w");
+  if (sock_fh == NULL) {
+    perror("fdopen");
+    close(fd);
+    return -1;
+  }
+  setvbuf(sock_fh, NULL, _IOFBF, 65536);
+
+  return 0;
+} /* }}} int sock_connect */
+
+static int sock_values_send(lcc_value_list_t const *vl) /* {{{ */
+{
+  char ident[1024];
+
+  lcc_identifier_to_string(/* connection = */ NULL, ident, sizeof(ident),
+                           &vl->identifier);
+
+  int status;
+  if (vl->values_types[0] == LCC_TYPE_GAUGE)
+    status = fprintf(sock_fh, "PUTVAL %s interval=%.3f %.3f:%.15g\n", ident,
+                     vl->interval, vl->time, vl->values[0].gauge);
+  else
+    status = fprintf(sock_fh, "PUTVAL %s interval=%.3f %.3f:%" PRIu64 "\n",
+                     ident, vl->interval, vl->time,
+                     (uint64_t)vl->values[0].derive);
+
+  return (status < 0) ? -1 : 0;
+} /* }}} int sock_values_send */
+
 static int send_value(lcc_value_list_t *vl) /* {{{ */
 {
   int status;
@@ -223,9 +301,16 @@ static int send_value(lcc_value_list_t *vl) /* {{{ */
   else
     vl->values[0].derive += (derive_t)get_boundet_random(0, 100);
 
-  status = lcc_network_values_send(net, vl);
-  if (status != 0)
-    fprintf(stderr, "lcc_network_values_send failed with status %i.\n", status);
+  if (sock_fh != NULL) {
+    status = sock_values_send(vl);
+    if (status != 0)
+      fprintf(stderr, "Writing to %s failed.\n", conf_socket);
+  } else {
+    status = lcc_network_values_send(net, vl);
+    if (status != 0)
+      fprintf(stderr, "lcc_network_values_send failed with status %i.\n",
+              status);
+  }
 
   vl->time += vl->interval;
 
@@ -284,7 +369,7 @@ static int read_options(int argc, char **argv) /* {{{ */
 {
   int opt;
 
-  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:h")) != -1) {
+  while ((opt = getopt(argc, argv, "n:H:p:i:d:D:s:h")) != -1) {
     switch (opt) {
     case 'n':
       get_integer_opt(optarg, &conf_num_values);
@@ -310,6 +395,10 @@ static int read_options(int argc, char **argv) /* {{{ */
       conf_service = optarg;
       break;
 
+    case 's':
+      conf_socket = optarg;
+      break;
+
     case 'h':
       exit_usage(EXIT_SUCCESS);
 
@@ -340,8 +429,10 @@ int main(int argc, char **argv) /* {{{ */
     exit(EXIT_FAILURE);
   }
 
-  net = lcc_network_create();
-  if (net == NULL) {
+  if (conf_socket != NULL) {
+    if (sock_connect() != 0)
+      exit(EXIT_FAILURE);
+  } else if ((net = lcc_network_create()) == NULL) {
     fprintf(stderr, "lcc_network_create failed.\n");
     exit(EXIT_FAILURE);
   } else {
@@ -388,6 +479,9 @@ int main(int argc, char **argv) /* {{{ */
       /* Check if we need to sleep */
       double now = dtime();
 
+      if ((sock_fh != NULL) && (now < vl->time))
+        fflush(sock_fh);
+
       while (now < vl->time) {
         double diff = vl->time - now;
         struct timespec ts = {
@@ -421,6 +515,8 @@ int main(int argc, char **argv) /* {{{ */
   }
   c_heap_destroy(values_heap);
 
+  if (sock_fh != NULL)
+    fclose(sock_fh);
   lcc_network_destroy(net);
   exit(EXIT_SUCCESS);
 } /* }}} int main */
@@ -291,7 +291,16 @@ static int csv_write(const data_set_t *ds, const value_list_t *vl,
   return 0;
 } /* int csv_write */
 
+static int csv_reset(void) {
+  sfree(datadir);
+  store_rates = 0;
+  use_stdio = 0;
+
+  return 0;
+} /* int csv_reset */
+
 void module_register(void) {
   plugin_register_config("csv", csv_config, config_keys, config_keys_num);
   plugin_register_write("csv", csv_write, /* user_data = */ NULL);
+  plugin_register_reset("csv", csv_reset);
 } /* void module_register */
@@ -35,6 +35,7 @@ struct cmdline_config {
 };
 
 void stop_collectd(void);
+void reload_collectd(void);
 struct cmdline_config init_config(int argc, char **argv);
 int run_loop(bool test_readall);
 
@@ -60,6 +60,7 @@
 #endif
 
 static int loop;
+static int reload;
 
 static int init_hostname(void) {
   const char *str = global_option_get("Hostname");
@@ -274,6 +275,11 @@ static int do_loop(void) {
     update_kstat();
 #endif
 
+    if (reload != 0) {
+      reload = 0;
+      cf_reload();
+    }
+
     /* Issue all plugins */
     plugin_read_all();
 
@@ -289,7 +295,8 @@ static int do_loop(void) {
     struct timespec ts_wait = CDTIME_T_TO_TIMESPEC(wait_until - now);
     wait_until = wait_until + interval;
 
-    while ((loop == 0) && (nanosleep(&ts_wait, &ts_wait) != 0)) {
+    while ((loop == 0) && (reload == 0) &&
+           (nanosleep(&ts_wait, &ts_wait) != 0)) {
       if (errno != EINTR) {
         ERROR("nanosleep failed: %s", STRERRNO);
         return -1;
@@ -386,6 +393,8 @@ static int configure_collectd(struct cmdline_config *config) {
 
 void stop_collectd(void) { loop++; }
 
+void reload_collectd(void) { reload++; }
+
 struct cmdline_config init_config(int argc, char **argv) {
   struct cmdline_config config = {
       .daemonize = true,
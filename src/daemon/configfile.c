@@ -120,6 +120,10 @@ static int cf_global_options_num = STATIC_ARRAY_SIZE(cf_global_options);
 
 static int cf_default_typesdb = 1;
 
+/* The configuration the daemon is running with, kept for cf_reload(). */
+static char *cf_config_file;
+static oconfig_item_t *cf_config;
+
 /*
  * Functions to handle register/unregister, search, and other plugin related
  * stuff
@@ -1016,9 +1020,31 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *)) {
   return 0;
 } /* int cf_register_complex */
 
+/* Dispatches all items of "conf" and keeps it as the running configuration.
+ * Takes ownership of "conf". */
+static int cf_apply(oconfig_item_t *conf) /* {{{ */
+{
+  int ret = 0;
+
+  for (int i = 0; i < conf->children_num; i++) {
+    if (conf->children[i].children == NULL) {
+      if (dispatch_value(conf->children + i) != 0)
+        ret = -1;
+    } else {
+      if (dispatch_block(conf->children + i) != 0)
+        ret = -1;
+    }
+  }
+
+  oconfig_free(cf_config);
+  cf_config = conf;
+
+  return ret;
+} /* }}} int cf_apply */
+
 int cf_read(const char *filename) {
   oconfig_item_t *conf;
-  int ret = 0;
+  int ret;
 
   conf = cf_read_generic(filename, /* pattern = */ NULL, /* depth = */ 0);
   if (conf == NULL) {
@@ -1030,17 +1056,19 @@ int cf_read(const char *filename) {
     return -1;
   }
 
-  for (int i = 0; i < conf->children_num; i++) {
-    if (conf->children[i].children == NULL) {
-      if (dispatch_value(conf->children + i) != 0)
-        ret = -1;
-    } else {
-      if (dispatch_block(conf->children + i) != 0)
-        ret = -1;
-    }
-  }
+  ret = cf_apply(conf);
 
-  oconfig_free(conf);
+  /* The daemon changes into `BaseDir', so remember where the file was. */
+  sfree(cf_config_file);
+  char cwd[PATH_MAX];
+  if ((filename[0] != '/') && (getcwd(cwd, sizeof(cwd)) != NULL)) {
+    size_t len = strlen(cwd) + strlen(filename) + 2;
+    cf_config_file = malloc(len);
+    if (cf_config_file != NULL)
+      snprintf(cf_config_file, len, "%s/%s", cwd, filename);
+  } else {
+    cf_config_file = strdup(filename);
+  }
 
   /* Read the default types.db if no `TypesDB' option was given. */
   if (cf_default_typesdb) {
@@ -1052,6 +1080,320 @@ int cf_read(const char *filename) {
 
 } /* int cf_read */
 
+/* Returns the name of the plugin `ci' is a "LoadPlugin" or "Plugin" item
+ * for, NULL for all other items. */
+static const char *cf_item_plugin(const oconfig_item_t *ci) /* {{{ */
+{
+  if ((strcasecmp("LoadPlugin", ci->key) != 0) &&
+      (strcasecmp("Plugin", ci->key) != 0))
+    return NULL;
+  if ((ci->values_num < 1) || (ci->values[0].type != OCONFIG_TYPE_STRING))
+    return NULL;
+
+  if (strcmp("libvirt", ci->values[0].value.string) == 0)
+    return "virt";
+  return ci->values[0].value.string;
+} /* }}} const char *cf_item_plugin */
+
+static bool cf_ci_equal(const oconfig_item_t *a, /* {{{ */
+                        const oconfig_item_t *b) {
+  if ((strcasecmp(a->key, b->key) != 0) || (a->values_num != b->values_num) ||
+      (a->children_num != b->children_num))
+    return false;
+
+  for (int i = 0; i < a->values_num; i++) {
+    const oconfig_value_t *va = a->values + i;
+    const oconfig_value_t *vb = b->values + i;
+
+    if (va->type != vb->type)
+      return false;
+    if ((va->type == OCONFIG_TYPE_STRING) &&
+        (strcmp(va->value.string, vb->value.string) != 0))
+      return false;
+    if ((va->type == OCONFIG_TYPE_NUMBER) &&
+        (va->value.number != vb->value.number))
+      return false;
+    if ((va->type == OCONFIG_TYPE_BOOLEAN) &&
+        (va->value.boolean != vb->value.boolean))
+      return false;
+  }
+
+  for (int i = 0; i < a->children_num; i++)
+    if (!cf_ci_equal(a->children + i, b->children + i))
+      return false;
+
+  return true;
+} /* }}} bool cf_ci_equal */
+
+/* Items selected for comparison: those of one plugin if `plugin' is not NULL.
+ * Otherwise the "Chain" blocks if `chains' is true, or everything that isn't
+ * a chain or plugin item, i.e. the global options. */
+static bool cf_item_selected(const oconfig_item_t *ci, /* {{{ */
+                             const char *plugin, bool chains) {
+  const char *name = cf_item_plugin(ci);
+
+  if (plugin != NULL)
+    return (name != NULL) && (strcasecmp(plugin, name) == 0);
+  if (name != NULL)
+    return false;
+  return chains == (strcasecmp("Chain", ci->key) == 0);
+} /* }}} bool cf_item_selected */
+
+/* Compares the selected top level items of two configurations in order. */
+static bool cf_items_changed(const oconfig_item_t *old, /* {{{ */
+                             const oconfig_item_t *new, const char *plugin,
+                             bool chains) {
+  int i = 0;
+  int j = 0;
+
+  while (42) {
+    while ((i < old->children_num) &&
+           !cf_item_selected(old->children + i, plugin, chains))
+      i++;
+    while ((j < new->children_num) &&
+           !cf_item_selected(new->children + j, plugin, chains))
+      j++;
+
+    if ((i >= old->children_num) || (j >= new->children_num))
+      return (i < old->children_num) || (j < new->children_num);
+    if (!cf_ci_equal(old->children + i, new->children + j))
+      return true;
+    i++;
+    j++;
+  }
+} /* }}} bool cf_items_changed */
+
+/* Adds the plugins `conf' refers to to `names', skipping duplicates. */
+static int cf_collect_plugins(const oconfig_item_t *conf, /* {{{ */
+                              const char ***names, size_t *names_num) {
+  for (int i = 0; i < conf->children_num; i++) {
+    const char *name = cf_item_plugin(conf->children + i);
+    bool found = false;
+
+    if (name == NULL)
+      continue;
+    for (size_t j = 0; (j < *names_num) && !found; j++)
+      found = (strcasecmp(name, (*names)[j]) == 0);
+    if (found)
+      continue;
+
+    const char **tmp = realloc(*names, (*names_num + 1) * sizeof(**names));
+    if (tmp == NULL)
+      return ENOMEM;
+    *names = tmp;
+    (*names)[*names_num] = name;
+    (*names_num)++;
+  }
+
+  return 0;
+} /* }}} int cf_collect_plugins */
+
+static bool cf_name_in(const char *name, const char **names, /* {{{ */
+                       size_t names_num) {
+  for (size_t i = 0; i < names_num; i++)
+    if (strcasecmp(name, names[i]) == 0)
+      return true;
+  return false;
+} /* }}} bool cf_name_in */
+
+/* Appends a copy of `ci' to the children of `root', which must have room for
+ * it. */
+static int cf_append_clone(oconfig_item_t *root, /* {{{ */
+                           const oconfig_item_t *ci) {
+  oconfig_item_t *copy = oconfig_clone(ci);
+  if (copy == NULL)
+    return ENOMEM;
+
+  copy->parent = root;
+  root->children[root->children_num] = *copy;
+  root->children_num++;
+  sfree(copy);
+  return 0;
+} /* }}} int cf_append_clone */
+
+/* Builds the configuration collectd runs with after a reload: the items of
+ * `new' that have been applied, and the items of `old' for the global options,
+ * the plugins in `kept' and, unless `chains_applied' is true, the chains. */
+static oconfig_item_t *cf_config_merge(const oconfig_item_t *old, /* {{{ */
+                                       const oconfig_item_t *new,
+                                       const char **kept, size_t kept_num,
+                                       bool chains_applied) {
+  oconfig_item_t *root = calloc(1, sizeof(*root));
+  if (root == NULL)
+    return NULL;
+  root->children =
+      calloc(old->children_num + new->children_num, sizeof(*root->children));
+  if (root->children == NULL) {
+    sfree(root);
+    return NULL;
+  }
+
+  for (int pass = 0; pass < 2; pass++) {
+    const oconfig_item_t *conf = (pass == 0) ? new : old;
+
+    for (int i = 0; i < conf->children_num; i++) {
+      const oconfig_item_t *ci = conf->children + i;
+      const char *name = cf_item_plugin(ci);
+      bool from_old;
+
+      if (name != NULL)
+        from_old = cf_name_in(name, kept, kept_num);
+      else if (strcasecmp("Chain", ci->key) == 0)
+        from_old = !chains_applied;
+      else
+        from_old = true;
+
+      if ((from_old == (conf == old)) && (cf_append_clone(root, ci) != 0)) {
+        oconfig_free(root);
+        return NULL;
+      }
+    }
+  }
+
+  return root;
+} /* }}} oconfig_item_t *cf_config_merge */
+
+/* Applies the differences between the running configuration and "conf", see
+ * cf_reload(). Takes ownership of "conf". */
+static int cf_reapply(oconfig_item_t *conf) /* {{{ */
+{
+  const char **names = NULL;
+  size_t names_num = 0;
+  bool *changed = NULL;
+  const char **kept = NULL;
+  size_t kept_num = 0;
+  bool chains_applied = false;
+  int ret = 0;
+
+  if (cf_items_changed(cf_config, conf, /* plugin = */ NULL,
+                       /* chains = */ false))
+    WARNING("configfile: Global options (such as Interval or TypesDB) have "
+            "changed. They will only take effect after a restart.");
+
+  if ((cf_collect_plugins(cf_config, &names, &names_num) != 0) ||
+      (cf_collect_plugins(conf, &names, &names_num) != 0) ||
+      ((changed = calloc(names_num + 1, sizeof(*changed))) == NULL) ||
+      ((kept = calloc(names_num + 1, sizeof(*kept))) == NULL)) {
+    ERROR("configfile: cf_reload: Out of memory.");
+    sfree(changed);
+    sfree(names);
+    oconfig_free(conf);
+    return -1;
+  }
+
+  /* Stop everything that changed or was removed first, then configure and
+   * initialize the changed and new plugins in the order of the file. Only
+   * plugins with a reset callback can be stopped and configured again; the
+   * others keep running with their previous configuration. */
+  for (size_t i = 0; i < names_num; i++) {
+    if (!cf_items_changed(cf_config, conf, names[i], false))
+      continue;
+
+    if (!plugin_is_loaded(names[i])) {
+      changed[i] = true;
+    } else if (!plugin_is_reloadable(names[i])) {
+      WARNING("configfile: The configuration of plugin \"%s\" has changed. "
+              "The plugin can't be reconfigured while running, restart "
+              "collectd to apply the change.",
+              names[i]);
+      kept[kept_num++] = names[i];
+    } else if (plugin_deactivate(names[i]) == 0) {
+      changed[i] = true;
+    } else {
+      ERROR("configfile: Deactivating plugin \"%s\" failed, keeping its "
+            "previous configuration.",
+            names[i]);
+      kept[kept_num++] = names[i];
+      ret = -1;
+    }
+  }
+
+  for (int i = 0; i < conf->children_num; i++) {
+    oconfig_item_t *ci = conf->children + i;
+    const char *name = cf_item_plugin(ci);
+    size_t j;
+
+    if (name == NULL)
+      continue;
+    for (j = 0; j < names_num; j++)
+      if (strcasecmp(name, names[j]) == 0)
+        break;
+    if (!changed[j])
+      continue;
+
+    int status = (ci->children == NULL) ? dispatch_value(ci)
+                                        : dispatch_block(ci);
+    if (status != 0)
+      ret = -1;
+  }
+
+  for (size_t i = 0; i < names_num; i++) {
+    if (!changed[i] || !plugin_is_loaded(names[i]))
+      continue;
+    if (plugin_reinit(names[i]) != 0)
+      ret = -1;
+    INFO("configfile: Plugin \"%s\" has been reconfigured.", names[i]);
+  }
+
+  if (cf_items_changed(cf_config, conf, /* plugin = */ NULL,
+                       /* chains = */ true)) {
+    fc_chain_t *chains = NULL;
+
+    if (fc_chains_create(conf, &chains) == 0) {
+      plugin_replace_chains(chains);
+      chains_applied = true;
+      INFO("configfile: Filter chains have been replaced.");
+    } else {
+      ERROR("configfile: Keeping the current filter chains.");
+      ret = -1;
+    }
+  }
+
+  /* Remember what is running, so that the next reload compares against it
+   * and warns about pending changes again. `names' and `kept' point into the
+   * old and new configuration. */
+  oconfig_item_t *running =
+      cf_config_merge(cf_config, conf, kept, kept_num, chains_applied);
+  if (running == NULL) {
+    ERROR("configfile: cf_reload: Out of memory.");
+    running = conf;
+    conf = NULL;
+    ret = -1;
+  }
+  sfree(kept);
+  sfree(changed);
+  sfree(names);
+  oconfig_free(cf_config);
+  if (conf != NULL)
+    oconfig_free(conf);
+  cf_config = running;
+
+  return ret;
+} /* }}} int cf_reapply */
+
+int cf_reload(void) /* {{{ */
+{
+  if ((cf_config_file == NULL) || (cf_config == NULL)) {
+    ERROR("configfile: Unable to reload: no configuration has been read.");
+    return -1;
+  }
+
+  INFO("configfile: Reloading %s.", cf_config_file);
+  oconfig_item_t *conf =
+      cf_read_generic(cf_config_file, /* pattern = */ NULL, /* depth = */ 0);
+  if ((conf == NULL) || (conf->children_num == 0)) {
+    ERROR("configfile: Unable to read %s, keeping the current configuration.",
+          cf_config_file);
+    if (conf != NULL)
+      oconfig_free(conf);
+    return -1;
+  }
+
+  int ret = cf_reapply(conf);
+  INFO("configfile: Reloading %s done.", cf_config_file);
+  return ret;
+} /* }}} int cf_reload */
+
 /* Assures the config option is a string, duplicates it and returns the copy in
  * "ret_string". If necessary "*ret_string" is freed first. Returns zero upon
  * success. */
@@ -89,6 +89,23 @@ int cf_register_complex(const char *type, int (*callback)(oconfig_item_t *));
  */
 int cf_read(const char *filename);
 
+/*
+ * DESCRIPTION
+ *  `cf_reload' reads the config file passed to `cf_read' again and compares
+ *  it to the running configuration. Reloadable plugins (see
+ *  `plugin_register_reset') whose `LoadPlugin' or `Plugin' blocks have
+ *  changed are deactivated, configured and initialized again; removed ones
+ *  are deactivated. New plugins are loaded. Changed `Chain' blocks replace the
+ *  filter chains. The value cache and the read and write threads are kept.
+ *  Changes to global options and to the other plugins only cause a warning
+ *  and take effect after a restart.
+ *
+ * RETURN VALUE
+ *  Returns zero upon success and non-zero otherwise. If the file can't be
+ *  parsed, the running configuration is left alone.
+ */
+int cf_reload(void);
+
 int global_option_set(const char *option, const char *value, bool from_cli);
 const char *global_option_get(const char *option);
 long global_option_get_long(const char *option, long default_value);
@@ -0,0 +1,432 @@
+/**
+ * collectd - src/daemon/configfile_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "configfile.c"
+#include "testing.h"
+
+/* Appends an item to the children of "parent". The returned pointer is only
+ * valid until the next item is added to "parent". */
+static oconfig_item_t *ci_add(oconfig_item_t *parent, const char *key) {
+  oconfig_item_t *tmp = realloc(parent->children, (parent->children_num + 1) *
+                                                      sizeof(*tmp));
+  assert(tmp != NULL);
+  parent->children = tmp;
+
+  oconfig_item_t *ci = parent->children + parent->children_num;
+  parent->children_num++;
+  *ci = (oconfig_item_t){.key = strdup(key)};
+  return ci;
+}
+
+static void ci_add_value(oconfig_item_t *ci, oconfig_value_t value) {
+  oconfig_value_t *tmp =
+      realloc(ci->values, (ci->values_num + 1) * sizeof(*tmp));
+  assert(tmp != NULL);
+  ci->values = tmp;
+  ci->values[ci->values_num] = value;
+  ci->values_num++;
+}
+
+static oconfig_item_t *ci_add_string(oconfig_item_t *parent, const char *key,
+                                     const char *value) {
+  oconfig_item_t *ci = ci_add(parent, key);
+  ci_add_value(ci, (oconfig_value_t){.value.string = strdup(value),
+                                     .type = OCONFIG_TYPE_STRING});
+  return ci;
+}
+
+static oconfig_item_t *ci_add_number(oconfig_item_t *parent, const char *key,
+                                     double value) {
+  oconfig_item_t *ci = ci_add(parent, key);
+  ci_add_value(ci, (oconfig_value_t){.value.number = value,
+                                     .type = OCONFIG_TYPE_NUMBER});
+  return ci;
+}
+
+static void ci_set_string(oconfig_item_t *ci, const char *value) {
+  assert((ci->values_num == 1) && (ci->values[0].type == OCONFIG_TYPE_STRING));
+  free(ci->values[0].value.string);
+  ci->values[0].value.string = strdup(value);
+}
+
+/* Interval 10
+ * LoadPlugin "cpu"
+ * LoadPlugin "libvirt"
+ * <Plugin "cpu">
+ *   ReportByCpu "true"
+ *   ValuesPercentage "false"
+ * </Plugin>
+ * <Chain "PreCache">
+ *   Target "write"
+ * </Chain> */
+static oconfig_item_t *config_create(void) {
+  oconfig_item_t *root = calloc(1, sizeof(*root));
+  assert(root != NULL);
+  root->key = strdup("");
+
+  ci_add_number(root, "Interval", 10);
+  ci_add_string(root, "LoadPlugin", "cpu");
+  ci_add_string(root, "LoadPlugin", "libvirt");
+  oconfig_item_t *plugin = ci_add_string(root, "Plugin", "cpu");
+  ci_add_string(plugin, "ReportByCpu", "true");
+  ci_add_string(plugin, "ValuesPercentage", "false");
+  oconfig_item_t *chain = ci_add_string(root, "Chain", "PreCache");
+  ci_add_string(chain, "Target", "write");
+
+  return root;
+}
+
+enum { CI_INTERVAL, CI_LOAD_CPU, CI_LOAD_VIRT, CI_PLUGIN_CPU, CI_CHAIN };
+
+DEF_TEST(ci_equal) {
+  oconfig_item_t *a = config_create();
+  oconfig_item_t *b = config_create();
+
+  OK(cf_ci_equal(a, b));
+
+  /* Keys are case insensitive, values are not. */
+  free(b->children[CI_INTERVAL].key);
+  b->children[CI_INTERVAL].key = strdup("interval");
+  OK(cf_ci_equal(a, b));
+  ci_set_string(b->children + CI_LOAD_CPU, "CPU");
+  OK(!cf_ci_equal(a, b));
+  ci_set_string(b->children + CI_LOAD_CPU, "cpu");
+  OK(cf_ci_equal(a, b));
+
+  b->children[CI_INTERVAL].values[0].value.number = 20;
+  OK(!cf_ci_equal(a, b));
+  b->children[CI_INTERVAL].values[0].value.number = 10;
+
+  /* Nested options are compared, too. */
+  oconfig_item_t *plugin = b->children + CI_PLUGIN_CPU;
+  ci_set_string(plugin->children + 1, "true");
+  OK(!cf_ci_equal(a, b));
+  ci_set_string(plugin->children + 1, "false");
+  OK(cf_ci_equal(a, b));
+
+  ci_add_string(plugin, "ReportByState", "true");
+  OK(!cf_ci_equal(a, b));
+  OK(!cf_ci_equal(b, a));
+
+  /* A string is not equal to a number. */
+  oconfig_item_t *c = calloc(1, sizeof(*c));
+  c->key = strdup("");
+  ci_add_string(c, "Interval", "10");
+  oconfig_item_t *d = calloc(1, sizeof(*d));
+  d->key = strdup("");
+  ci_add_number(d, "Interval", 10);
+  OK(!cf_ci_equal(c, d));
+
+  oconfig_free(a);
+  oconfig_free(b);
+  oconfig_free(c);
+  oconfig_free(d);
+  return 0;
+}
+
+DEF_TEST(items_changed) {
+  oconfig_item_t *old = config_create();
+  oconfig_item_t *new = config_create();
+
+  OK(!cf_items_changed(old, new, /* plugin = */ NULL, /* chains = */ false));
+  OK(!cf_items_changed(old, new, /* plugin = */ NULL, /* chains = */ true));
+  OK(!cf_items_changed(old, new, "cpu", false));
+  OK(!cf_items_changed(old, new, "virt", false));
+
+  /* Only the order of the selected items matters. */
+  oconfig_item_t interval = new->children[CI_INTERVAL];
+  memmove(new->children, new->children + 1,
+          (new->children_num - 1) * sizeof(*new->children));
+  new->children[new->children_num - 1] = interval;
+  OK(!cf_items_changed(old, new, NULL, false));
+  OK(!cf_items_changed(old, new, NULL, true));
+  OK(!cf_items_changed(old, new, "cpu", false));
+  oconfig_free(new);
+
+  /* A changed plugin block only changes that plugin. */
+  new = config_create();
+  ci_set_string(new->children[CI_PLUGIN_CPU].children, "false");
+  OK(cf_items_changed(old, new, "cpu", false));
+  OK(cf_items_changed(old, new, "CPU", false));
+  OK(!cf_items_changed(old, new, "virt", false));
+  OK(!cf_items_changed(old, new, NULL, false));
+  OK(!cf_items_changed(old, new, NULL, true));
+  oconfig_free(new);
+
+  /* "libvirt" is the old name of the virt plugin. Removing it is a change,
+   * adding it back, too. */
+  new = config_create();
+  ci_set_string(new->children + CI_LOAD_VIRT, "memory");
+  OK(cf_items_changed(old, new, "virt", false));
+  OK(cf_items_changed(new, old, "virt", false));
+  OK(cf_items_changed(old, new, "memory", false));
+  OK(!cf_items_changed(old, new, "cpu", false));
+  oconfig_free(new);
+
+  new = config_create();
+  ci_set_string(new->children[CI_CHAIN].children, "stop");
+  OK(cf_items_changed(old, new, NULL, true));
+  OK(!cf_items_changed(old, new, NULL, false));
+  oconfig_free(new);
+
+  new = config_create();
+  ci_add_string(new, "Hostname", "example.com");
+  OK(cf_items_changed(old, new, NULL, false));
+  OK(!cf_items_changed(old, new, NULL, true));
+  OK(!cf_items_changed(old, new, "cpu", false));
+  oconfig_free(new);
+
+  oconfig_free(old);
+  return 0;
+}
+
+/* The running configuration keeps the previous items of global options,
+ * plugins that were not reconfigured and chains that were not replaced. */
+DEF_TEST(config_merge) {
+  oconfig_item_t *old = config_create();
+  oconfig_item_t *new = config_create();
+  const char *kept[] = {"cpu"};
+
+  new->children[CI_INTERVAL].values[0].value.number = 20;
+  ci_set_string(new->children[CI_PLUGIN_CPU].children, "false");
+  ci_set_string(new->children[CI_CHAIN].children, "stop");
+  ci_add_string(new, "LoadPlugin", "memory");
+
+  oconfig_item_t *running = cf_config_merge(old, new, kept, 1, false);
+  CHECK_NOT_NULL(running);
+  OK(!cf_items_changed(old, running, NULL, false));
+  OK(!cf_items_changed(old, running, NULL, true));
+  OK(!cf_items_changed(old, running, "cpu", false));
+  OK(!cf_items_changed(new, running, "virt", false));
+  OK(!cf_items_changed(new, running, "memory", false));
+  OK(cf_items_changed(old, running, "memory", false));
+  oconfig_free(running);
+
+  running = cf_config_merge(old, new, NULL, 0, true);
+  CHECK_NOT_NULL(running);
+  OK(!cf_items_changed(old, running, NULL, false));
+  OK(!cf_items_changed(new, running, NULL, true));
+  OK(!cf_items_changed(new, running, "cpu", false));
+  oconfig_free(running);
+
+  oconfig_free(old);
+  oconfig_free(new);
+  return 0;
+}
+
+/* Plugins with a reset callback that reload_plugins() reconfigures. */
+static struct {
+  const char *name;
+  bool loaded;
+} reload_plugins_list[] = {
+    {"csv"},      {"logfile"},        {"network"},    {"tail"},
+    {"unixsock"}, {"write_graphite"}, {"write_http"},
+};
+
+static char reload_dir[] = "/tmp/configfile_test.XXXXXX";
+
+static bool reload_loaded(const char *name) {
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(reload_plugins_list); i++)
+    if (strcmp(name, reload_plugins_list[i].name) == 0)
+      return reload_plugins_list[i].loaded;
+  return false;
+}
+
+static char *reload_path(const char *name, const char *suffix) {
+  static char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s-%s", reload_dir, name, suffix);
+  return path;
+}
+
+/* Configures every plugin that could be loaded with files named after
+ * "suffix", below "reload_dir". */
+static oconfig_item_t *reload_config_create(const char *suffix) {
+  oconfig_item_t *root = calloc(1, sizeof(*root));
+  assert(root != NULL);
+  root->key = strdup("");
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(reload_plugins_list); i++)
+    if (reload_plugins_list[i].loaded)
+      ci_add_string(root, "LoadPlugin", reload_plugins_list[i].name);
+
+  oconfig_item_t *plugin;
+  if (reload_loaded("csv")) {
+    plugin = ci_add_string(root, "Plugin", "csv");
+    ci_add_string(plugin, "DataDir", reload_path("csv", suffix));
+  }
+  if (reload_loaded("logfile")) {
+    plugin = ci_add_string(root, "Plugin", "logfile");
+    ci_add_string(plugin, "LogLevel", "info");
+    ci_add_string(plugin, "File", reload_path("log", suffix));
+  }
+  if (reload_loaded("network")) {
+    plugin = ci_add_string(root, "Plugin", "network");
+    oconfig_item_t *listen = ci_add_string(plugin, "Listen", "127.0.0.1");
+    ci_add_value(listen, (oconfig_value_t){.value.string = strdup("0"),
+                                           .type = OCONFIG_TYPE_STRING});
+    ci_add_string(plugin, "Server", "127.0.0.1");
+    ci_add_number(plugin, "MaxPacketSize",
+                  (strcmp("a", suffix) == 0) ? 1024 : 2048);
+  }
+  if (reload_loaded("tail")) {
+    plugin = ci_add_string(root, "Plugin", "tail");
+    oconfig_item_t *file =
+        ci_add_string(plugin, "File", reload_path("tail", suffix));
+    ci_add_string(file, "Instance", suffix);
+    oconfig_item_t *match = ci_add(file, "Match");
+    ci_add_string(match, "Regex", "^([0-9]+)$");
+    ci_add_string(match, "DSType", "GaugeLast");
+    ci_add_string(match, "Type", "gauge");
+  }
+  if (reload_loaded("unixsock")) {
+    plugin = ci_add_string(root, "Plugin", "unixsock");
+    ci_add_string(plugin, "SocketFile", reload_path("sock", suffix));
+    ci_add_string(plugin, "DeleteSocket", "true");
+  }
+  if (reload_loaded("write_graphite")) {
+    plugin = ci_add_string(root, "Plugin", "write_graphite");
+    oconfig_item_t *node = ci_add_string(plugin, "Node", suffix);
+    ci_add_string(node, "Host", "127.0.0.1");
+    ci_add_string(node, "Port", "2003");
+  }
+  if (reload_loaded("write_http")) {
+    plugin = ci_add_string(root, "Plugin", "write_http");
+    oconfig_item_t *node = ci_add_string(plugin, "Node", suffix);
+    ci_add_string(node, "URL", "http://127.0.0.1:1/");
+  }
+
+  return root;
+}
+
+static data_source_t reload_dsrc = {"value", DS_TYPE_GAUGE, 0.0, NAN};
+static data_set_t reload_ds = {"gauge", 1, &reload_dsrc};
+
+static int reload_write(void) {
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = &(value_t){.gauge = 42};
+  vl.values_len = 1;
+  sstrncpy(vl.host, "example.com", sizeof(vl.host));
+  sstrncpy(vl.plugin, "test", sizeof(vl.plugin));
+  sstrncpy(vl.type, "gauge", sizeof(vl.type));
+
+  return plugin_write(/* plugin = */ NULL, &reload_ds, &vl);
+}
+
+static bool reload_file_type(const char *path, mode_t type) {
+  struct stat statbuf;
+  if (stat(path, &statbuf) != 0)
+    return false;
+  return (statbuf.st_mode & S_IFMT) == type;
+}
+
+static bool reload_file_contains(const char *path, const char *str) {
+  char buf[4096] = "";
+  FILE *fh = fopen(path, "r");
+  if (fh == NULL)
+    return false;
+  size_t len = fread(buf, 1, sizeof(buf) - 1, fh);
+  fclose(fh);
+  buf[len] = '\0';
+  return strstr(buf, str) != NULL;
+}
+
+/* The daemon's handler for SIGTERM, which the plugins send to their threads
+ * on shutdown, only stops the main loop. */
+static void reload_sigterm(__attribute__((unused)) int signal) {}
+
+/* Reloading a changed configuration makes the plugins use the new one. The
+ * plugins that are not built are skipped. */
+DEF_TEST(reload_plugins) {
+  struct sigaction sa = {.sa_handler = reload_sigterm};
+  CHECK_ZERO(sigaction(SIGTERM, &sa, NULL));
+  CHECK_NOT_NULL(mkdtemp(reload_dir));
+
+  plugin_set_dir(TEST_PLUGIN_DIR);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(reload_plugins_list); i++) {
+    oconfig_item_t *load = calloc(1, sizeof(*load));
+    load->key = strdup("");
+    ci_add_string(load, "LoadPlugin", reload_plugins_list[i].name);
+    reload_plugins_list[i].loaded = (dispatch_value(load->children) == 0);
+    oconfig_free(load);
+    if (!reload_plugins_list[i].loaded)
+      printf("skipping the %s plugin, it has not been built\n",
+             reload_plugins_list[i].name);
+  }
+
+  EXPECT_EQ_INT(0, cf_apply(reload_config_create("a")));
+  EXPECT_EQ_INT(0, plugin_init_all());
+  EXPECT_EQ_INT(0, reload_write());
+
+  EXPECT_EQ_INT(0, cf_reapply(reload_config_create("b")));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(reload_plugins_list); i++) {
+    if (!reload_plugins_list[i].loaded)
+      continue;
+    OK(plugin_is_loaded(reload_plugins_list[i].name));
+    OK(plugin_is_reloadable(reload_plugins_list[i].name));
+  }
+
+  EXPECT_EQ_INT(0, reload_write());
+  INFO("configfile_test: reloaded");
+
+  if (reload_loaded("csv")) {
+    OK(reload_file_type(reload_path("csv", "a/example.com"), S_IFDIR));
+    OK(reload_file_type(reload_path("csv", "b/example.com"), S_IFDIR));
+  }
+  if (reload_loaded("logfile")) {
+    OK(!reload_file_contains(reload_path("log", "a"), "reloaded"));
+    OK(reload_file_contains(reload_path("log", "b"), "reloaded"));
+  }
+  if (reload_loaded("unixsock")) {
+    OK(!reload_file_type(reload_path("sock", "a"), S_IFSOCK));
+    /* The listen thread creates the socket. */
+    for (int i = 0; i < 100; i++) {
+      if (reload_file_type(reload_path("sock", "b"), S_IFSOCK))
+        break;
+      nanosleep(&(struct timespec){.tv_nsec = 10000000}, NULL);
+    }
+    OK(reload_file_type(reload_path("sock", "b"), S_IFSOCK));
+  }
+
+  /* Applying the running configuration again changes nothing. */
+  EXPECT_EQ_INT(0, cf_reapply(reload_config_create("b")));
+
+  EXPECT_EQ_INT(0, plugin_shutdown_all());
+  oconfig_free(cf_config);
+  cf_config = NULL;
+
+  char cmd[PATH_MAX];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", reload_dir);
+  EXPECT_EQ_INT(0, system(cmd));
+  return 0;
+}
+
+int main(void) {
+  plugin_init_ctx();
+
+  RUN_TEST(ci_equal);
+  RUN_TEST(items_changed);
+  RUN_TEST(config_merge);
+  RUN_TEST(reload_plugins);
+
+  END_TEST;
+}
@@ -452,8 +452,17 @@ static int fc_config_add_rule(fc_chain_t *chain, /* {{{ */
   return 0;
 } /* }}} int fc_config_add_rule */
 
-static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
-{
+static fc_chain_t *fc_chain_find(fc_chain_t *head, /* {{{ */
+                                  const char *chain_name) {
+  for (fc_chain_t *chain = head; chain != NULL; chain = chain->next)
+    if (strcasecmp(chain_name, chain->name) == 0)
+      return chain;
+
+  return NULL;
+} /* }}} fc_chain_t *fc_chain_find */
+
+static int fc_config_add_chain(fc_chain_t **chains_head, /* {{{ */
+                               const oconfig_item_t *ci) {
   fc_chain_t *chain = NULL;
   int status = 0;
   int new_chain = 1;
@@ -464,8 +473,9 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
-  if (chain_list_head != NULL) {
-    if ((chain = fc_chain_get_by_name(ci->values[0].value.string)) != NULL)
+  if (*chains_head != NULL) {
+    if ((chain = fc_chain_find(*chains_head, ci->values[0].value.string)) !=
+        NULL)
       new_chain = 0;
   }
 
@@ -501,19 +511,19 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
-  if (chain_list_head != NULL) {
+  if (*chains_head != NULL) {
     if (!new_chain)
       return 0;
 
     fc_chain_t *ptr;
 
-    ptr = chain_list_head;
+    ptr = *chains_head;
     while (ptr->next != NULL)
       ptr = ptr->next;
 
     ptr->next = chain;
   } else {
-    chain_list_head = chain;
+    *chains_head = chain;
   }
 
   return 0;
@@ -579,10 +589,8 @@ static int fc_bit_jump_invoke(const data_set_t *ds, /* {{{ */
 
   chain_name = *user_data;
 
-  for (chain = chain_list_head; chain != NULL; chain = chain->next)
-    if (strcasecmp(chain_name, chain->name) == 0)
-      break;
-
+  chain = fc_chain_find(__atomic_load_n(&chain_list_head, __ATOMIC_ACQUIRE),
+                        chain_name);
   if (chain == NULL) {
     ERROR("Filter subsystem: Built-in target `jump': There is no chain "
           "named `%s'.",
@@ -799,6 +807,16 @@ int fc_register_match(const char *name, match_proc_t proc) /* {{{ */
   sstrncpy(m->name, name, sizeof(m->name));
   memcpy(&m->proc, &proc, sizeof(m->proc));
 
+  /* A plugin registered again by a configuration reload replaces its match.
+   */
+  for (fc_match_t *ptr = match_list_head; ptr != NULL; ptr = ptr->next) {
+    if (strcasecmp(ptr->name, name) == 0) {
+      memcpy(&ptr->proc, &proc, sizeof(ptr->proc));
+      free(m);
+      return 0;
+    }
+  }
+
   if (match_list_head == NULL) {
     match_list_head = m;
   } else {
@@ -828,6 +846,14 @@ int fc_register_target(const char *name, target_proc_t proc) /* {{{ */
   sstrncpy(t->name, name, sizeof(t->name));
   memcpy(&t->proc, &proc, sizeof(t->proc));
 
+  for (fc_target_t *ptr = target_list_head; ptr != NULL; ptr = ptr->next) {
+    if (strcasecmp(ptr->name, name) == 0) {
+      memcpy(&ptr->proc, &proc, sizeof(ptr->proc));
+      free(t);
+      return 0;
+    }
+  }
+
   if (target_list_head == NULL) {
     target_list_head = t;
   } else {
@@ -848,11 +874,8 @@ fc_chain_t *fc_chain_get_by_name(const char *chain_name) /* {{{ */
   if (chain_name == NULL)
     return NULL;
 
-  for (fc_chain_t *chain = chain_list_head; chain != NULL; chain = chain->next)
-    if (strcasecmp(chain_name, chain->name) == 0)
-      return chain;
-
-  return NULL;
+  return fc_chain_find(__atomic_load_n(&chain_list_head, __ATOMIC_ACQUIRE),
+                       chain_name);
 } /* }}} int fc_chain_get_by_name */
 
 int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
@@ -991,9 +1014,41 @@ int fc_configure(const oconfig_item_t *ci) /* {{{ */
     return -EINVAL;
 
   if (strcasecmp("Chain", ci->key) == 0)
-    return fc_config_add_chain(ci);
+    return fc_config_add_chain(&chain_list_head, ci);
 
   WARNING("Filter subsystem: Unknown top level config option `%s'.", ci->key);
 
   return -1;
 } /* }}} int fc_configure */
+
+int fc_chains_create(const oconfig_item_t *root, /* {{{ */
+                     fc_chain_t **ret_chains) {
+  fc_chain_t *chains = NULL;
+
+  fc_init_once();
+
+  for (int i = 0; i < root->children_num; i++) {
+    const oconfig_item_t *ci = root->children + i;
+
+    if (strcasecmp("Chain", ci->key) != 0)
+      continue;
+
+    if (fc_config_add_chain(&chains, ci) != 0) {
+      fc_free_chains(chains);
+      return -1;
+    }
+  }
+
+  *ret_chains = chains;
+  return 0;
+} /* }}} int fc_chains_create */
+
+fc_chain_t *fc_chains_replace(fc_chain_t *chains) /* {{{ */
+{
+  return __atomic_exchange_n(&chain_list_head, chains, __ATOMIC_ACQ_REL);
+} /* }}} fc_chain_t *fc_chains_replace */
+
+void fc_chains_destroy(fc_chain_t *chains) /* {{{ */
+{
+  fc_free_chains(chains);
+} /* }}} void fc_chains_destroy */
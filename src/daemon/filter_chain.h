@@ -100,4 +100,14 @@ int fc_default_action(const data_set_t *ds, value_list_t *vl);
  */
 int fc_configure(const oconfig_item_t *ci);
 
+/*
+ * Configuration reload: `fc_chains_create' builds the chains of all <Chain>
+ * blocks in `root' without installing them. `fc_chains_replace' installs
+ * them and returns the previous chains. Chains being processed may still use
+ * the previous chains until the caller has made sure that they are done.
+ */
+int fc_chains_create(const oconfig_item_t *root, fc_chain_t **ret_chains);
+fc_chain_t *fc_chains_replace(fc_chain_t *chains);
+void fc_chains_destroy(fc_chain_t *chains);
+
 #endif /* FILTER_CHAIN_H */
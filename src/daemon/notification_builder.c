@@ -0,0 +1,238 @@
+/**
+ * collectd - src/daemon/notification_builder.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* The notification builder is kept out of plugin.c, so that the tests link
+ * the same implementation as the daemon. See plugin.h for the interface. */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+
+/* Memory of a notification builder. Meta data entries and strings are carved
+ * out of these blocks, which are kept when the builder is reset. */
+#define NOTIFICATION_BLOCK_SIZE 4096
+
+typedef struct notification_block_s {
+  struct notification_block_s *next;
+  size_t size;
+  size_t used;
+  char data[];
+} notification_block_t;
+
+struct notification_builder_s {
+  notification_t n;
+  notification_meta_t *tail;
+  notification_block_t *head;
+  notification_block_t *current;
+};
+
+static void *notification_builder_alloc(notification_builder_t *b, size_t size,
+                                        size_t align) /* {{{ */
+{
+  notification_block_t *blk = b->current;
+
+  while (blk != NULL) {
+    uintptr_t addr = (uintptr_t)(blk->data + blk->used);
+    size_t pad = (align - (addr % align)) % align;
+
+    if (blk->used + pad + size <= blk->size) {
+      void *ptr = blk->data + blk->used + pad;
+      blk->used += pad + size;
+      b->current = blk;
+      return ptr;
+    }
+
+    /* Blocks after `current' are left over from a previous notification. */
+    blk = blk->next;
+    if (blk != NULL)
+      blk->used = 0;
+  }
+
+  size_t block_size = NOTIFICATION_BLOCK_SIZE;
+  if (size + align > block_size)
+    block_size = size + align;
+
+  blk = malloc(sizeof(*blk) + block_size);
+  if (blk == NULL) {
+    ERROR("notification_builder_alloc: malloc failed.");
+    return NULL;
+  }
+  blk->size = block_size;
+  blk->used = 0;
+
+  /* Insert after `current', so that left over blocks stay reachable. */
+  if (b->current == NULL) {
+    blk->next = b->head;
+    b->head = blk;
+  } else {
+    blk->next = b->current->next;
+    b->current->next = blk;
+  }
+  b->current = blk;
+
+  return notification_builder_alloc(b, size, align);
+} /* }}} void *notification_builder_alloc */
+
+notification_builder_t *plugin_notification_builder_create(void) /* {{{ */
+{
+  notification_builder_t *b = calloc(1, sizeof(*b));
+  if (b == NULL) {
+    ERROR("plugin_notification_builder_create: calloc failed.");
+    return NULL;
+  }
+  return b;
+} /* }}} notification_builder_t *plugin_notification_builder_create */
+
+void plugin_notification_builder_destroy(notification_builder_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return;
+
+  while (b->head != NULL) {
+    notification_block_t *next = b->head->next;
+    free(b->head);
+    b->head = next;
+  }
+  free(b);
+} /* }}} void plugin_notification_builder_destroy */
+
+notification_t *
+plugin_notification_builder_reset(notification_builder_t *b) /* {{{ */
+{
+  memset(&b->n, 0, sizeof(b->n));
+  b->tail = NULL;
+
+  b->current = b->head;
+  if (b->current != NULL)
+    b->current->used = 0;
+
+  return &b->n;
+} /* }}} notification_t *plugin_notification_builder_reset */
+
+static notification_meta_t *
+notification_builder_meta(notification_builder_t *b, const char *name,
+                          enum notification_meta_type_e type) /* {{{ */
+{
+  notification_meta_t *meta;
+
+  if (name == NULL) {
+    ERROR("plugin_notification_builder_add: name == NULL!");
+    return NULL;
+  }
+
+  meta = notification_builder_alloc(b, sizeof(*meta),
+                                    __alignof__(notification_meta_t));
+  if (meta == NULL)
+    return NULL;
+
+  sstrncpy(meta->name, name, sizeof(meta->name));
+  meta->type = type;
+  meta->next = NULL;
+
+  /* Appending is O(1), unlike plugin_notification_meta_add(). */
+  if (b->tail == NULL)
+    b->n.meta = meta;
+  else
+    b->tail->next = meta;
+  b->tail = meta;
+
+  return meta;
+} /* }}} notification_meta_t *notification_builder_meta */
+
+int plugin_notification_builder_add_string(notification_builder_t *b,
+                                           const char *name,
+                                           const char *value) /* {{{ */
+{
+  if (value == NULL) {
+    ERROR("plugin_notification_builder_add_string: value == NULL!");
+    return -1;
+  }
+
+  size_t len = strlen(value) + 1;
+  char *str = notification_builder_alloc(b, len, 1);
+  if (str == NULL)
+    return -1;
+  memcpy(str, value, len);
+
+  notification_meta_t *meta =
+      notification_builder_meta(b, name, NM_TYPE_STRING);
+  if (meta == NULL)
+    return -1;
+  meta->nm_value.nm_string = str;
+
+  return 0;
+} /* }}} int plugin_notification_builder_add_string */
+
+int plugin_notification_builder_add_signed_int(notification_builder_t *b,
+                                               const char *name,
+                                               int64_t value) /* {{{ */
+{
+  notification_meta_t *meta =
+      notification_builder_meta(b, name, NM_TYPE_SIGNED_INT);
+  if (meta == NULL)
+    return -1;
+  meta->nm_value.nm_signed_int = value;
+  return 0;
+} /* }}} int plugin_notification_builder_add_signed_int */
+
+int plugin_notification_builder_add_unsigned_int(notification_builder_t *b,
+                                                 const char *name,
+                                                 uint64_t value) /* {{{ */
+{
+  notification_meta_t *meta =
+      notification_builder_meta(b, name, NM_TYPE_UNSIGNED_INT);
+  if (meta == NULL)
+    return -1;
+  meta->nm_value.nm_unsigned_int = value;
+  return 0;
+} /* }}} int plugin_notification_builder_add_unsigned_int */
+
+int plugin_notification_builder_add_double(notification_builder_t *b,
+                                           const char *name,
+                                           double value) /* {{{ */
+{
+  notification_meta_t *meta =
+      notification_builder_meta(b, name, NM_TYPE_DOUBLE);
+  if (meta == NULL)
+    return -1;
+  meta->nm_value.nm_double = value;
+  return 0;
+} /* }}} int plugin_notification_builder_add_double */
+
+int plugin_notification_builder_add_boolean(notification_builder_t *b,
+                                            const char *name,
+                                            bool value) /* {{{ */
+{
+  notification_meta_t *meta =
+      notification_builder_meta(b, name, NM_TYPE_BOOLEAN);
+  if (meta == NULL)
+    return -1;
+  meta->nm_value.nm_boolean = value;
+  return 0;
+} /* }}} int plugin_notification_builder_add_boolean */
+
+int plugin_notification_builder_dispatch(notification_builder_t *b) /* {{{ */
+{
+  return plugin_dispatch_notification(&b->n);
+} /* }}} int plugin_notification_builder_dispatch */
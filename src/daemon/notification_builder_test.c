@@ -0,0 +1,173 @@
+/**
+ * collectd - src/daemon/notification_builder_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "testing.h"
+#include "utils/common/common.h"
+
+#define META_NUM 1000
+
+static size_t meta_count(const notification_t *n) {
+  size_t num = 0;
+  for (const notification_meta_t *m = n->meta; m != NULL; m = m->next)
+    num++;
+  return num;
+}
+
+/* Adds more meta data than fits into one block, including a string larger
+ * than a block. */
+DEF_TEST(growth) {
+  notification_builder_t *b;
+  char name[DATA_MAX_NAME_LEN];
+  char value[64];
+
+  CHECK_NOT_NULL(b = plugin_notification_builder_create());
+  notification_t *n = plugin_notification_builder_reset(b);
+  CHECK_NOT_NULL(n);
+  OK(n->meta == NULL);
+
+  size_t failed_num = 0;
+  for (int i = 0; i < META_NUM; i++) {
+    snprintf(name, sizeof(name), "key%d", i);
+    snprintf(value, sizeof(value), "value%d", i);
+    if (plugin_notification_builder_add_string(b, name, value) != 0)
+      failed_num++;
+  }
+  EXPECT_EQ_INT(0, failed_num);
+
+  char large[3 * 4096];
+  memset(large, 'x', sizeof(large) - 1);
+  large[sizeof(large) - 1] = 0;
+  CHECK_ZERO(plugin_notification_builder_add_string(b, "large", large));
+  CHECK_ZERO(plugin_notification_builder_add_signed_int(b, "signed", -42));
+  CHECK_ZERO(plugin_notification_builder_add_unsigned_int(b, "unsigned", 42));
+  CHECK_ZERO(plugin_notification_builder_add_double(b, "double", 0.5));
+  CHECK_ZERO(plugin_notification_builder_add_boolean(b, "boolean", true));
+
+  /* Meta data is kept in the order it was added. */
+  EXPECT_EQ_INT(META_NUM + 5, meta_count(n));
+  size_t mismatch_num = 0;
+  notification_meta_t *m = n->meta;
+  for (int i = 0; i < META_NUM; i++, m = m->next) {
+    snprintf(name, sizeof(name), "key%d", i);
+    snprintf(value, sizeof(value), "value%d", i);
+    if ((m->type != NM_TYPE_STRING) || (strcmp(name, m->name) != 0) ||
+        (strcmp(value, m->nm_value.nm_string) != 0) ||
+        ((uintptr_t)m % __alignof__(notification_meta_t) != 0))
+      mismatch_num++;
+  }
+  EXPECT_EQ_INT(0, mismatch_num);
+
+  EXPECT_EQ_STR("large", m->name);
+  EXPECT_EQ_STR(large, m->nm_value.nm_string);
+  m = m->next;
+  EXPECT_EQ_INT(NM_TYPE_SIGNED_INT, m->type);
+  EXPECT_EQ_INT(-42, m->nm_value.nm_signed_int);
+  m = m->next;
+  EXPECT_EQ_INT(NM_TYPE_UNSIGNED_INT, m->type);
+  EXPECT_EQ_UINT64(42, m->nm_value.nm_unsigned_int);
+  m = m->next;
+  EXPECT_EQ_INT(NM_TYPE_DOUBLE, m->type);
+  EXPECT_EQ_DOUBLE(0.5, m->nm_value.nm_double);
+  m = m->next;
+  EXPECT_EQ_INT(NM_TYPE_BOOLEAN, m->type);
+  OK(m->nm_value.nm_boolean);
+  OK(m->next == NULL);
+
+  plugin_notification_builder_destroy(b);
+  return 0;
+}
+
+/* A reset clears the notification and reuses the memory of the previous
+ * one. */
+DEF_TEST(reset) {
+  notification_builder_t *b;
+
+  CHECK_NOT_NULL(b = plugin_notification_builder_create());
+  notification_t *n = plugin_notification_builder_reset(b);
+  n->severity = NOTIF_FAILURE;
+  sstrncpy(n->host, "example.com", sizeof(n->host));
+  sstrncpy(n->message, "first", sizeof(n->message));
+  CHECK_ZERO(plugin_notification_builder_add_string(b, "a", "one"));
+  CHECK_ZERO(plugin_notification_builder_add_string(b, "b", "two"));
+  const char *first = n->meta->nm_value.nm_string;
+
+  OK(plugin_notification_builder_reset(b) == n);
+  EXPECT_EQ_INT(0, n->severity);
+  EXPECT_EQ_STR("", n->host);
+  EXPECT_EQ_STR("", n->message);
+  OK(n->meta == NULL);
+
+  CHECK_ZERO(plugin_notification_builder_add_string(b, "c", "three"));
+  EXPECT_EQ_INT(1, meta_count(n));
+  EXPECT_EQ_STR("c", n->meta->name);
+  EXPECT_EQ_STR("three", n->meta->nm_value.nm_string);
+  OK(n->meta->nm_value.nm_string == first);
+
+  /* Blocks left over from a larger notification are used again, too. */
+  for (int i = 0; i < META_NUM; i++)
+    CHECK_ZERO(plugin_notification_builder_add_boolean(b, "flag", true));
+  plugin_notification_builder_reset(b);
+  for (int i = 0; i < META_NUM; i++)
+    CHECK_ZERO(plugin_notification_builder_add_boolean(b, "flag", false));
+  EXPECT_EQ_INT(META_NUM, meta_count(n));
+
+  plugin_notification_builder_destroy(b);
+  return 0;
+}
+
+/* The builder owns copies of names and strings; the caller's buffers may be
+ * reused right away. */
+DEF_TEST(meta_ownership) {
+  notification_builder_t *b;
+  char name[DATA_MAX_NAME_LEN] = "name";
+  char value[32] = "value";
+
+  CHECK_NOT_NULL(b = plugin_notification_builder_create());
+  notification_t *n = plugin_notification_builder_reset(b);
+  CHECK_ZERO(plugin_notification_builder_add_string(b, name, value));
+  sstrncpy(name, "changed", sizeof(name));
+  sstrncpy(value, "changed", sizeof(value));
+
+  EXPECT_EQ_STR("name", n->meta->name);
+  EXPECT_EQ_STR("value", n->meta->nm_value.nm_string);
+  OK(n->meta->nm_value.nm_string != value);
+
+  EXPECT_EQ_INT(-1, plugin_notification_builder_add_string(b, "null", NULL));
+  EXPECT_EQ_INT(-1, plugin_notification_builder_add_boolean(b, NULL, true));
+  EXPECT_EQ_INT(1, meta_count(n));
+
+  plugin_notification_builder_destroy(b);
+  plugin_notification_builder_destroy(NULL);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(growth);
+  RUN_TEST(reset);
+  RUN_TEST(meta_ownership);
+
+  END_TEST;
+}
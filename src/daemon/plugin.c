@@ -63,6 +63,7 @@ struct callback_func_s {
   void *cf_callback;
   user_data_t cf_udata;
   plugin_ctx_t cf_ctx;
+  bool cf_parallel; /* init callbacks only */
 };
 typedef struct callback_func_s callback_func_t;
 
@@ -82,6 +83,11 @@ struct read_func_s {
   cdtime_t rf_interval;
   cdtime_t rf_effective_interval;
   cdtime_t rf_next_read;
+  /* Set while a read thread is running the callback and, if it was removed
+   * in the meantime, whether plugin_deactivate() is waiting for it. Protected
+   * by `read_lock'. */
+  bool rf_busy;
+  bool rf_waited;
 };
 typedef struct read_func_s read_func_t;
 
@@ -107,16 +113,63 @@ struct flush_callback_s {
 };
 typedef struct flush_callback_s flush_callback_t;
 
+/* Value of `plugins_loaded'. A plugin that has been deactivated by a
+ * configuration reload stays in memory; loading it again only calls its
+ * "module_register" function. */
+struct plugin_module_s {
+  void (*register_func)(void);
+  bool active;
+};
+typedef struct plugin_module_s plugin_module_t;
+
+/* A callback registered or unregistered while the thread was using the
+ * callback lists, see callbacks_enter(). `cf' is NULL for unregistrations. */
+struct callback_change_s;
+typedef struct callback_change_s callback_change_t;
+struct callback_change_s {
+  llist_t **list;
+  char *name;
+  callback_func_t *cf;
+  callback_change_t *next;
+};
+
+/* Per-thread state, stored under `plugin_ctx_key'. */
+struct thread_state_s;
+typedef struct thread_state_s thread_state_t;
+struct thread_state_s {
+  plugin_ctx_t ctx;
+  /* Number of nested callbacks_enter() calls. */
+  int callbacks_depth;
+  /* Incremented when the outermost callbacks_enter() call starts and when it
+   * ends, i.e. odd while the thread may be using the callback lists. */
+  unsigned long epoch;
+  /* Odd epoch callbacks_synchronize() waits for the thread to leave, zero
+   * otherwise. Only used with `callbacks_write_lock' held. */
+  unsigned long sync_epoch;
+  callback_change_t *changes_head;
+  callback_change_t *changes_tail;
+  /* Entry in the list of all thread states, `thread_states'. */
+  thread_state_t *prev;
+  thread_state_t *next;
+};
+
 /*
  * Private variables
  */
 static c_avl_tree_t *plugins_loaded;
 
 static llist_t *list_init;
+/* Other threads call the write, flush, missing, cache event, notification
+ * and log callbacks and run the filter chains while a configuration reload
+ * may replace them. Readers take no lock, see callbacks_enter(). Writers hold
+ * `callbacks_write_lock', publish new entries only once they are complete and
+ * free removed ones after callbacks_synchronize(). */
+static pthread_mutex_t callbacks_write_lock = PTHREAD_MUTEX_INITIALIZER;
 static llist_t *list_write;
 static llist_t *list_flush;
 static llist_t *list_missing;
 static llist_t *list_shutdown;
+static llist_t *list_reset;
 static llist_t *list_log;
 static llist_t *list_notification;
 
@@ -138,6 +191,9 @@ static llist_t *read_list;
 static int read_loop = 1;
 static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t read_cond = PTHREAD_COND_INITIALIZER;
+/* Signaled when a read callback plugin_deactivate() waits for returns. */
+static pthread_cond_t read_done_cond = PTHREAD_COND_INITIALIZER;
+static size_t read_waited_num;
 static pthread_t *read_threads;
 static size_t read_threads_num;
 static cdtime_t max_read_interval = DEFAULT_MAX_READ_INTERVAL;
@@ -153,6 +209,10 @@ static size_t write_threads_num;
 
 static pthread_key_t plugin_ctx_key;
 static bool plugin_ctx_key_initialized;
+static pthread_mutex_t thread_states_lock = PTHREAD_MUTEX_INITIALIZER;
+static thread_state_t *thread_states;
+/* Number of callbacks_enter() calls without a thread state. */
+static unsigned long callbacks_untracked;
 
 static long write_limit_high;
 static long write_limit_low;
@@ -165,6 +225,8 @@ static bool record_statistics;
  * Static functions
  */
 static int plugin_dispatch_values_internal(value_list_t *vl);
+static thread_state_t *thread_state_get(void);
+static void callbacks_leave(thread_state_t *t);
 
 static const char *plugin_get_dir(void) {
   if (plugindir == NULL)
@@ -272,18 +334,112 @@ static void destroy_read_heap(void) /* {{{ */
   read_heap = NULL;
 } /* }}} void destroy_read_heap */
 
-static int register_callback(llist_t **list, /* {{{ */
-                             const char *name, callback_func_t *cf) {
+/* Returns the calling thread's state without logging, so that it can be used
+ * from plugin_log(). Returns NULL before plugin_init_ctx() was called. */
+static thread_state_t *callbacks_thread(void) /* {{{ */
+{
+  if (!plugin_ctx_key_initialized)
+    return NULL;
+  return thread_state_get();
+} /* }}} thread_state_t *callbacks_thread */
+
+/* Marks the calling thread as using the callback lists and filter chains
+ * until callbacks_leave() is called. This takes no lock: entries other
+ * threads remove are only freed once the thread has left, see
+ * callbacks_synchronize(). Callbacks log, dispatch values and sometimes
+ * (un)register callbacks themselves, so only the outermost call in each
+ * thread counts. The returned state must be passed to callbacks_leave(). */
+static thread_state_t *callbacks_enter(void) /* {{{ */
+{
+  thread_state_t *t = callbacks_thread();
 
-  if (*list == NULL) {
-    *list = llist_create();
-    if (*list == NULL) {
-      ERROR("plugin: register_callback: "
-            "llist_create failed.");
-      destroy_callback(cf);
-      return -1;
+  if (t == NULL)
+    __atomic_add_fetch(&callbacks_untracked, 1, __ATOMIC_RELAXED);
+  else if (t->callbacks_depth++ == 0)
+    __atomic_store_n(&t->epoch, t->epoch + 1, __ATOMIC_RELAXED);
+  else
+    return t;
+
+  /* Pairs with the fence in callbacks_synchronize(): either the writer sees
+   * the new epoch, or this thread sees the writer's changes. */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  return t;
+} /* }}} thread_state_t *callbacks_enter */
+
+/* Waits until no thread uses an entry that was removed from the callback
+ * lists or the filter chains before the call, so that it can be freed. The
+ * caller holds `callbacks_write_lock' and must not be between
+ * callbacks_enter() and callbacks_leave(). */
+static void callbacks_synchronize(void) /* {{{ */
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  pthread_mutex_lock(&thread_states_lock);
+  for (thread_state_t *t = thread_states; t != NULL; t = t->next) {
+    unsigned long epoch = __atomic_load_n(&t->epoch, __ATOMIC_ACQUIRE);
+    t->sync_epoch = (epoch % 2) ? epoch : 0;
+  }
+  pthread_mutex_unlock(&thread_states_lock);
+
+  while (42) {
+    bool busy = __atomic_load_n(&callbacks_untracked, __ATOMIC_ACQUIRE) > 0;
+
+    /* Threads that exit in the meantime are removed from the list, threads
+     * that start in the meantime can't see the removed entries. */
+    pthread_mutex_lock(&thread_states_lock);
+    for (thread_state_t *t = thread_states; t != NULL; t = t->next) {
+      if (t->sync_epoch == 0)
+        continue;
+      if (__atomic_load_n(&t->epoch, __ATOMIC_ACQUIRE) != t->sync_epoch)
+        t->sync_epoch = 0;
+      else
+        busy = true;
     }
+    pthread_mutex_unlock(&thread_states_lock);
+
+    if (!busy)
+      return;
+
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = 1000000};
+    nanosleep(&ts, NULL);
+  }
+} /* }}} void callbacks_synchronize */
+
+/* A thread can't wait for itself to leave the callback lists, so changes
+ * made from within a callback are queued and applied by callbacks_leave(). */
+static int callbacks_defer(thread_state_t *t, llist_t **list, /* {{{ */
+                           const char *name, callback_func_t *cf) {
+  callback_change_t *c = calloc(1, sizeof(*c));
+  if (c == NULL) {
+    ERROR("plugin: callbacks_defer: calloc failed.");
+    destroy_callback(cf);
+    return ENOMEM;
+  }
+
+  c->name = strdup(name);
+  if (c->name == NULL) {
+    ERROR("plugin: callbacks_defer: strdup failed.");
+    destroy_callback(cf);
+    sfree(c);
+    return ENOMEM;
   }
+  c->list = list;
+  c->cf = cf;
+
+  if (t->changes_tail == NULL)
+    t->changes_head = c;
+  else
+    t->changes_tail->next = c;
+  t->changes_tail = c;
+
+  return 0;
+} /* }}} int callbacks_defer */
+
+static int register_callback(llist_t **list, /* {{{ */
+                             const char *name, callback_func_t *cf) {
+  thread_state_t *t = callbacks_thread();
+  if ((t != NULL) && (t->callbacks_depth > 0))
+    return callbacks_defer(t, list, name, cf);
 
   char *key = strdup(name);
   if (key == NULL) {
@@ -292,10 +448,27 @@ static int register_callback(llist_t **list, /* {{{ */
     return -1;
   }
 
+  /* Nothing may be logged while `callbacks_write_lock' is held. */
+  pthread_mutex_lock(&callbacks_write_lock);
+
+  if (*list == NULL) {
+    llist_t *new_list = llist_create();
+    if (new_list == NULL) {
+      pthread_mutex_unlock(&callbacks_write_lock);
+      ERROR("plugin: register_callback: "
+            "llist_create failed.");
+      sfree(key);
+      destroy_callback(cf);
+      return -1;
+    }
+    __atomic_store_n(list, new_list, __ATOMIC_RELEASE);
+  }
+
   llentry_t *le = llist_search(*list, name);
   if (le == NULL) {
     le = llentry_create(key, cf);
     if (le == NULL) {
+      pthread_mutex_unlock(&callbacks_write_lock);
       ERROR("plugin: register_callback: "
             "llentry_create failed.");
       sfree(key);
@@ -303,10 +476,15 @@ static int register_callback(llist_t **list, /* {{{ */
       return -1;
     }
 
+    /* Readers follow the entry as soon as it is appended. */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
     llist_append(*list, le);
+    pthread_mutex_unlock(&callbacks_write_lock);
   } else {
     callback_func_t *old_cf = le->value;
-    le->value = cf;
+    __atomic_store_n(&le->value, cf, __ATOMIC_RELEASE);
+    callbacks_synchronize();
+    pthread_mutex_unlock(&callbacks_write_lock);
 
     P_WARNING("register_callback: "
               "a callback named `%s' already exists - "
@@ -328,19 +506,26 @@ static void log_list_callbacks(llist_t **list, /* {{{ */
   llentry_t *le;
   int n;
 
-  n = llist_size(*list);
+  thread_state_t *t = callbacks_enter();
+
+  llist_t *l = __atomic_load_n(list, __ATOMIC_ACQUIRE);
+  n = llist_size(l);
   if (n == 0) {
     INFO("%s: [none]", comment);
+    callbacks_leave(t);
     return;
   }
 
   char **keys = calloc(n, sizeof(*keys));
   if (keys == NULL) {
     ERROR("%s: failed to allocate memory for list of callbacks", comment);
+    callbacks_leave(t);
     return;
   }
 
-  for (le = llist_head(*list), i = 0, len = 0; le != NULL; le = le->next, i++) {
+  /* Entries appended in the meantime are not listed. */
+  for (le = llist_head(l), i = 0, len = 0; (le != NULL) && (i < n);
+       le = le->next, i++) {
     keys[i] = le->key;
     len += strlen(le->key) + 6;
   }
@@ -354,6 +539,7 @@ static void log_list_callbacks(llist_t **list, /* {{{ */
     sfree(str);
   }
   sfree(keys);
+  callbacks_leave(t);
 } /* }}} void log_list_callbacks */
 
 static int create_register_callback(llist_t **list, /* {{{ */
@@ -385,19 +571,31 @@ static int create_register_callback(llist_t **list, /* {{{ */
   return register_callback(list, name, cf);
 } /* }}} int create_register_callback */
 
-static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
+static int plugin_unregister(llist_t **list, const char *name) /* {{{ */
 {
   llentry_t *e;
 
-  if (list == NULL)
+  if (*list == NULL)
     return -1;
 
-  e = llist_search(list, name);
+  thread_state_t *t = callbacks_thread();
+  if ((t != NULL) && (t->callbacks_depth > 0)) {
+    if (llist_search(*list, name) == NULL)
+      return -1;
+    return callbacks_defer(t, list, name, /* cf = */ NULL);
+  }
+
+  pthread_mutex_lock(&callbacks_write_lock);
+  e = llist_search(*list, name);
+  if (e != NULL) {
+    llist_remove(*list, e);
+    callbacks_synchronize();
+  }
+  pthread_mutex_unlock(&callbacks_write_lock);
+
   if (e == NULL)
     return -1;
 
-  llist_remove(list, e);
-
   sfree(e->key);
   destroy_callback(e->value);
 
@@ -406,9 +604,37 @@ static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
   return 0;
 } /* }}} int plugin_unregister */
 
+static void callbacks_leave(thread_state_t *t) /* {{{ */
+{
+  if (t == NULL) {
+    __atomic_sub_fetch(&callbacks_untracked, 1, __ATOMIC_RELEASE);
+    return;
+  }
+  if (--t->callbacks_depth > 0)
+    return;
+
+  __atomic_store_n(&t->epoch, t->epoch + 1, __ATOMIC_RELEASE);
+
+  while (t->changes_head != NULL) {
+    callback_change_t *c = t->changes_head;
+    t->changes_head = c->next;
+
+    if (c->cf != NULL)
+      register_callback(c->list, c->name, c->cf);
+    else
+      plugin_unregister(c->list, c->name);
+
+    sfree(c->name);
+    sfree(c);
+  }
+  t->changes_tail = NULL;
+} /* }}} void callbacks_leave */
+
 /* plugin_load_file loads the shared object "file" and calls its
- * "module_register" function. Returns zero on success, non-zero otherwise. */
-static int plugin_load_file(char const *file, bool global) {
+ * "module_register" function, which is returned in "ret_register". Returns
+ * zero on success, non-zero otherwise. */
+static int plugin_load_file(char const *file, bool global,
+                            void (**ret_register)(void)) {
   int flags = RTLD_NOW;
   if (global)
     flags |= RTLD_GLOBAL;
@@ -444,6 +670,7 @@ static int plugin_load_file(char const *file, bool global) {
   }
 
   (*reg_handle)();
+  *ret_register = reg_handle;
   return 0;
 }
 
@@ -496,6 +723,8 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
 
     /* Must hold `read_lock' when accessing `rf->rf_type'. */
     rf_type = rf->rf_type;
+    if ((read_loop != 0) && (rf_type != RF_REMOVE))
+      rf->rf_busy = true;
     pthread_mutex_unlock(&read_lock);
 
     /* Check if we're supposed to stop.. This may have interrupted
@@ -542,6 +771,15 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
 
     plugin_set_ctx(old_ctx);
 
+    pthread_mutex_lock(&read_lock);
+    rf->rf_busy = false;
+    if (rf->rf_waited) {
+      rf->rf_waited = false;
+      read_waited_num--;
+      pthread_cond_broadcast(&read_done_cond);
+    }
+    pthread_mutex_unlock(&read_lock);
+
     /* If the function signals failure, we will increase the
      * intervals in which it will be called. */
     if (status != 0) {
@@ -914,26 +1152,45 @@ void plugin_set_dir(const char *dir) {
     ERROR("plugin_set_dir: strdup(\"%s\") failed", dir);
 }
 
-bool plugin_is_loaded(char const *name) {
+static plugin_module_t *plugin_get_module(char const *name) {
+  plugin_module_t *m = NULL;
+
   if (plugins_loaded == NULL)
     plugins_loaded =
         c_avl_create((int (*)(const void *, const void *))strcasecmp);
   assert(plugins_loaded != NULL);
 
-  int status = c_avl_get(plugins_loaded, name, /* ret_value = */ NULL);
-  return status == 0;
+  if (c_avl_get(plugins_loaded, name, (void *)&m) != 0)
+    return NULL;
+  return m;
+}
+
+bool plugin_is_loaded(char const *name) {
+  plugin_module_t *m = plugin_get_module(name);
+  return (m != NULL) && m->active;
 }
 
-static int plugin_mark_loaded(char const *name) {
+static int plugin_mark_loaded(char const *name, void (*register_func)(void)) {
   char *name_copy;
+  plugin_module_t *m;
   int status;
 
   name_copy = strdup(name);
-  if (name_copy == NULL)
+  m = calloc(1, sizeof(*m));
+  if ((name_copy == NULL) || (m == NULL)) {
+    sfree(name_copy);
+    sfree(m);
     return ENOMEM;
+  }
+  m->register_func = register_func;
+  m->active = true;
 
   status = c_avl_insert(plugins_loaded,
-                        /* key = */ name_copy, /* value = */ NULL);
+                        /* key = */ name_copy, /* value = */ m);
+  if (status != 0) {
+    sfree(name_copy);
+    sfree(m);
+  }
   return status;
 }
 
@@ -946,7 +1203,7 @@ static void plugin_free_loaded(void) {
 
   while (c_avl_pick(plugins_loaded, &key, &value) == 0) {
     sfree(key);
-    assert(value == NULL);
+    sfree(value);
   }
 
   c_avl_destroy(plugins_loaded);
@@ -973,9 +1230,18 @@ int plugin_load(char const *plugin_name, bool global) {
     return EINVAL;
 
   /* Check if plugin is already loaded and don't do anything in this
-   * case. */
-  if (plugin_is_loaded(plugin_name))
+   * case. A plugin deactivated by a configuration reload only registers its
+   * callbacks again. */
+  plugin_module_t *m = plugin_get_module(plugin_name);
+  if (m != NULL) {
+    if (!m->active) {
+      (*m->register_func)();
+      m->active = true;
+      INFO("plugin_load: plugin \"%s\" successfully registered again.",
+           plugin_name);
+    }
     return 0;
+  }
 
   dir = plugin_get_dir();
   ret = 1;
@@ -1028,10 +1294,11 @@ int plugin_load(char const *plugin_name, bool global) {
       continue;
     }
 
-    status = plugin_load_file(filename, global);
+    void (*register_func)(void) = NULL;
+    status = plugin_load_file(filename, global, &register_func);
     if (status == 0) {
       /* success */
-      plugin_mark_loaded(plugin_name);
+      plugin_mark_loaded(plugin_name, register_func);
       ret = 0;
       INFO("plugin_load: plugin \"%s\" successfully loaded.", plugin_name);
       break;
@@ -1070,6 +1337,24 @@ EXPORT int plugin_register_init(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_init, name, (void *)callback, NULL);
 } /* plugin_register_init */
 
+EXPORT int plugin_register_parallel_init(const char *name,
+                                         plugin_init_cb callback) {
+  if (name == NULL || callback == NULL)
+    return EINVAL;
+
+  callback_func_t *cf = calloc(1, sizeof(*cf));
+  if (cf == NULL) {
+    ERROR("plugin: plugin_register_parallel_init: calloc failed.");
+    return ENOMEM;
+  }
+
+  cf->cf_callback = (void *)callback;
+  cf->cf_ctx = plugin_get_ctx();
+  cf->cf_parallel = true;
+
+  return register_callback(&list_init, name, cf);
+} /* plugin_register_parallel_init */
+
 static int plugin_compare_read_func(const void *arg0, const void *arg1) {
   const read_func_t *rf0;
   const read_func_t *rf1;
@@ -1326,6 +1611,14 @@ EXPORT int plugin_register_cache_event(const char *name,
   if (name == NULL || callback == NULL)
     return EINVAL;
 
+  thread_state_t *t = callbacks_thread();
+  if ((t != NULL) && (t->callbacks_depth > 0)) {
+    P_ERROR("plugin_register_cache_event: Cache event callbacks can't be "
+            "registered from within another callback.");
+    free_userdata(ud);
+    return EBUSY;
+  }
+
   char *name_copy = strdup(name);
   if (name_copy == NULL) {
     P_ERROR("plugin_register_cache_event: strdup failed.");
@@ -1333,44 +1626,61 @@ EXPORT int plugin_register_cache_event(const char *name,
     return ENOMEM;
   }
 
-  if (list_cache_event_num >= 32) {
-    P_ERROR("plugin_register_cache_event: Too much cache event callbacks tried "
-            "to be registered.");
-    free_userdata(ud);
-    return ENOMEM;
+  user_data_t user_data;
+  if (ud == NULL) {
+    user_data = (user_data_t){
+        .data = NULL,
+        .free_func = NULL,
+    };
+  } else {
+    user_data = *ud;
   }
+  plugin_ctx_t ctx = plugin_get_ctx();
 
+  /* Nothing may be logged while `callbacks_write_lock' is held. */
+  pthread_mutex_lock(&callbacks_write_lock);
+
+  /* Slots of unregistered callbacks are reused, so that plugins re-registered
+   * by a configuration reload don't use up the callbacks mask. */
+  size_t slot = list_cache_event_num;
   for (size_t i = 0; i < list_cache_event_num; i++) {
     cache_event_func_t *cef = &list_cache_event[i];
-    if (!cef->callback)
+    if (!cef->callback) {
+      if (slot == list_cache_event_num)
+        slot = i;
       continue;
+    }
 
     if (strcmp(name, cef->name) == 0) {
+      pthread_mutex_unlock(&callbacks_write_lock);
       P_ERROR("plugin_register_cache_event: a callback named `%s' already "
               "registered!",
               name);
+      sfree(name_copy);
       free_userdata(ud);
       return -1;
     }
   }
 
-  user_data_t user_data;
-  if (ud == NULL) {
-    user_data = (user_data_t){
-        .data = NULL,
-        .free_func = NULL,
-    };
-  } else {
-    user_data = *ud;
+  if (slot >= STATIC_ARRAY_SIZE(list_cache_event)) {
+    pthread_mutex_unlock(&callbacks_write_lock);
+    P_ERROR("plugin_register_cache_event: Too much cache event callbacks tried "
+            "to be registered.");
+    sfree(name_copy);
+    free_userdata(ud);
+    return ENOMEM;
   }
 
-  list_cache_event[list_cache_event_num] =
-      (cache_event_func_t){.callback = callback,
-                           .name = name_copy,
-                           .user_data = user_data,
-                           .plugin_ctx = plugin_get_ctx()};
-  list_cache_event_num++;
+  /* Readers skip the slot until its callback is set. */
+  cache_event_func_t *cef = &list_cache_event[slot];
+  cef->name = name_copy;
+  cef->user_data = user_data;
+  cef->plugin_ctx = ctx;
+  __atomic_store_n(&cef->callback, callback, __ATOMIC_RELEASE);
+  if (slot == list_cache_event_num)
+    __atomic_store_n(&list_cache_event_num, slot + 1, __ATOMIC_RELEASE);
 
+  pthread_mutex_unlock(&callbacks_write_lock);
   return 0;
 } /* int plugin_register_cache_event */
 
@@ -1378,6 +1688,10 @@ EXPORT int plugin_register_shutdown(const char *name, int (*callback)(void)) {
   return create_register_callback(&list_shutdown, name, (void *)callback, NULL);
 } /* int plugin_register_shutdown */
 
+EXPORT int plugin_register_reset(const char *name, plugin_reset_cb callback) {
+  return create_register_callback(&list_reset, name, (void *)callback, NULL);
+} /* int plugin_register_reset */
+
 static void plugin_free_data_sets(void) {
   void *key;
   void *value;
@@ -1449,7 +1763,7 @@ EXPORT int plugin_unregister_complex_config(const char *name) {
 } /* int plugin_unregister_complex_config */
 
 EXPORT int plugin_unregister_init(const char *name) {
-  return plugin_unregister(list_init, name);
+  return plugin_unregister(&list_init, name);
 }
 
 EXPORT int plugin_unregister_read(const char *name) /* {{{ */
@@ -1552,7 +1866,7 @@ EXPORT int plugin_unregister_read_group(const char *group) /* {{{ */
 } /* }}} int plugin_unregister_read_group */
 
 EXPORT int plugin_unregister_write(const char *name) {
-  return plugin_unregister(list_write, name);
+  return plugin_unregister(&list_write, name);
 }
 
 EXPORT int plugin_unregister_flush(const char *name) {
@@ -1568,25 +1882,42 @@ EXPORT int plugin_unregister_flush(const char *name) {
     }
   }
 
-  return plugin_unregister(list_flush, name);
+  return plugin_unregister(&list_flush, name);
 }
 
 EXPORT int plugin_unregister_missing(const char *name) {
-  return plugin_unregister(list_missing, name);
+  return plugin_unregister(&list_missing, name);
 }
 
 EXPORT int plugin_unregister_cache_event(const char *name) {
+  thread_state_t *t = callbacks_thread();
+  if ((t != NULL) && (t->callbacks_depth > 0)) {
+    P_ERROR("plugin_unregister_cache_event: Cache event callbacks can't be "
+            "unregistered from within another callback.");
+    return EBUSY;
+  }
+
+  pthread_mutex_lock(&callbacks_write_lock);
   for (size_t i = 0; i < list_cache_event_num; i++) {
     cache_event_func_t *cef = &list_cache_event[i];
     if (!cef->callback)
       continue;
     if (strcmp(name, cef->name) == 0) {
       /* Mark callback as inactive, so mask in cache entries remains actual */
-      cef->callback = NULL;
-      sfree(cef->name);
-      free_userdata(&cef->user_data);
+      __atomic_store_n(&cef->callback, NULL, __ATOMIC_RELAXED);
+      callbacks_synchronize();
+
+      cache_event_func_t old = *cef;
+      cef->name = NULL;
+      pthread_mutex_unlock(&callbacks_write_lock);
+
+      sfree(old.name);
+      free_userdata(&old.user_data);
+      return 0;
     }
   }
+  pthread_mutex_unlock(&callbacks_write_lock);
+
   return 0;
 }
 
@@ -1602,7 +1933,11 @@ static void destroy_cache_event_callbacks() {
 }
 
 EXPORT int plugin_unregister_shutdown(const char *name) {
-  return plugin_unregister(list_shutdown, name);
+  return plugin_unregister(&list_shutdown, name);
+}
+
+EXPORT int plugin_unregister_reset(const char *name) {
+  return plugin_unregister(&list_reset, name);
 }
 
 EXPORT int plugin_unregister_data_set(const char *name) {
@@ -1621,17 +1956,154 @@ EXPORT int plugin_unregister_data_set(const char *name) {
 } /* int plugin_unregister_data_set */
 
 EXPORT int plugin_unregister_log(const char *name) {
-  return plugin_unregister(list_log, name);
+  return plugin_unregister(&list_log, name);
 }
 
 EXPORT int plugin_unregister_notification(const char *name) {
-  return plugin_unregister(list_notification, name);
+  return plugin_unregister(&list_notification, name);
 }
 
+/* Calls one init callback and unloads the plugin's read callbacks if it
+ * fails. */
+static int plugin_init_one(const char *name, callback_func_t *cf) /* {{{ */
+{
+  plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+  plugin_init_cb callback = cf->cf_callback;
+  cdtime_t start = cdtime();
+  int status = (*callback)();
+  cdtime_t elapsed = cdtime() - start;
+  plugin_set_ctx(old_ctx);
+
+  INFO("Initialization of plugin `%s' took %.3f seconds.", name,
+       CDTIME_T_TO_DOUBLE(elapsed));
+
+  if (status != 0) {
+    ERROR("Initialization of plugin `%s' "
+          "failed with status %i. "
+          "Plugin will be unloaded.",
+          name, status);
+    /* Plugins that register read callbacks from the init
+     * callback should take care of appropriate error
+     * handling themselves. */
+    /* FIXME: Unload _all_ functions */
+    plugin_unregister_read(name);
+  }
+
+  return status;
+} /* }}} int plugin_init_one */
+
+typedef struct {
+  const char *name;
+  callback_func_t *cf;
+  pthread_t thread;
+  bool running;
+  int status;
+} init_job_t;
+
+static void *plugin_init_thread(void *arg) /* {{{ */
+{
+  init_job_t *job = arg;
+
+  job->status = plugin_init_one(job->name, job->cf);
+  return NULL;
+} /* }}} void *plugin_init_thread */
+
+static bool plugin_init_selected(const char *plugin, /* {{{ */
+                                 const callback_func_t *cf) {
+  return (plugin == NULL) || ((cf->cf_ctx.name != NULL) &&
+                              (strcasecmp(plugin, cf->cf_ctx.name) == 0));
+} /* }}} bool plugin_init_selected */
+
+/* Calls the init callbacks of "plugin" or, if NULL, of all plugins.
+ * Callbacks registered with plugin_register_parallel_init() are started in
+ * threads of their own first, the remaining ones run one after the other in
+ * the order they were registered in. */
+static int plugin_init_callbacks(const char *plugin) /* {{{ */
+{
+  init_job_t *jobs = NULL;
+  size_t jobs_num = 0;
+  int ret = 0;
+
+  for (llentry_t *le = llist_head(list_init); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    if (cf->cf_parallel && plugin_init_selected(plugin, cf))
+      jobs_num++;
+  }
+
+  if (jobs_num > 0) {
+    jobs = calloc(jobs_num, sizeof(*jobs));
+    if (jobs == NULL) {
+      ERROR("plugin_init_callbacks: calloc failed, "
+            "initializing all plugins sequentially.");
+      jobs_num = 0;
+    }
+  }
+
+  size_t i = 0;
+  for (llentry_t *le = llist_head(list_init); (le != NULL) && (i < jobs_num);
+       le = le->next) {
+    callback_func_t *cf = le->value;
+    if (!cf->cf_parallel || !plugin_init_selected(plugin, cf))
+      continue;
+
+    init_job_t *job = jobs + i;
+    i++;
+
+    *job = (init_job_t){.name = le->key, .cf = cf};
+    int status =
+        plugin_thread_create(&job->thread, plugin_init_thread, job, "init");
+    if (status != 0) {
+      WARNING("plugin_init_callbacks: Starting a thread to initialize "
+              "plugin `%s' failed: %s",
+              le->key, STRERROR(status));
+      continue;
+    }
+    job->running = true;
+  }
+
+  for (llentry_t *le = llist_head(list_init); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    if (!plugin_init_selected(plugin, cf))
+      continue;
+
+    /* Parallel callbacks which could not be started in a thread are
+     * called here, too. */
+    bool started = false;
+    for (i = 0; i < jobs_num; i++)
+      if ((jobs[i].cf == cf) && jobs[i].running)
+        started = true;
+    if (started)
+      continue;
+
+    if (plugin_init_one(le->key, cf) != 0)
+      ret = -1;
+  }
+
+  for (i = 0; i < jobs_num; i++) {
+    if (!jobs[i].running)
+      continue;
+
+    pthread_join(jobs[i].thread, NULL);
+    if (jobs[i].status != 0)
+      ret = -1;
+  }
+  sfree(jobs);
+
+  return ret;
+} /* }}} int plugin_init_callbacks */
+
+static void plugin_start_read_threads(void) /* {{{ */
+{
+  if (read_heap == NULL)
+    return;
+
+  int num = atoi(global_option_get("ReadThreads"));
+  if (num != -1)
+    start_read_threads((num > 0) ? ((size_t)num) : 5);
+} /* }}} void plugin_start_read_threads */
+
 EXPORT int plugin_init_all(void) {
   char const *chain_name;
-  llentry_t *le;
-  int status;
   int ret = 0;
 
   /* Init the value cache */
@@ -1680,51 +2152,225 @@ EXPORT int plugin_init_all(void) {
   /* Calling all init callbacks before checking if read callbacks
    * are available allows the init callbacks to register the read
    * callback. */
-  le = llist_head(list_init);
+  cdtime_t start = cdtime();
+  ret = plugin_init_callbacks(/* plugin = */ NULL);
+  INFO("Initialization of all plugins took %.3f seconds.",
+       CDTIME_T_TO_DOUBLE(cdtime() - start));
+
+  start_write_threads((size_t)write_threads_num);
+
+  max_read_interval =
+      global_option_get_time("MaxReadInterval", DEFAULT_MAX_READ_INTERVAL);
+
+  plugin_start_read_threads();
+  return ret;
+} /* void plugin_init_all */
+
+static bool plugin_owns_callback(const char *plugin, /* {{{ */
+                                  const plugin_ctx_t *ctx) {
+  return (ctx->name != NULL) && (strcasecmp(plugin, ctx->name) == 0);
+} /* }}} bool plugin_owns_callback */
+
+/* Removes the entries of "list" registered by "plugin" and stores them in
+ * "entries". Other threads may still follow the removed entries' "next"
+ * pointers until callbacks_synchronize() returns. Returns the number of
+ * entries removed. */
+static size_t plugin_detach_callbacks(llist_t *list, /* {{{ */
+                                      const char *plugin,
+                                      llentry_t **entries) {
+  size_t num = 0;
+  llentry_t *le = llist_head(list);
   while (le != NULL) {
-    callback_func_t *cf;
-    plugin_init_cb callback;
-    plugin_ctx_t old_ctx;
+    llentry_t *next = le->next;
+    callback_func_t *cf = le->value;
 
-    cf = le->value;
-    old_ctx = plugin_set_ctx(cf->cf_ctx);
-    callback = cf->cf_callback;
-    status = (*callback)();
-    plugin_set_ctx(old_ctx);
+    if (plugin_owns_callback(plugin, &cf->cf_ctx)) {
+      llist_remove(list, le);
+      entries[num++] = le;
+    }
+    le = next;
+  }
+  return num;
+} /* }}} size_t plugin_detach_callbacks */
 
-    if (status != 0) {
-      ERROR("Initialization of plugin `%s' "
-            "failed with status %i. "
-            "Plugin will be unloaded.",
-            le->key, status);
-      /* Plugins that register read callbacks from the init
-       * callback should take care of appropriate error
-       * handling themselves. */
-      /* FIXME: Unload _all_ functions */
-      plugin_unregister_read(le->key);
-      ret = -1;
+EXPORT bool plugin_is_reloadable(const char *plugin) /* {{{ */
+{
+  for (llentry_t *le = llist_head(list_reset); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    if (plugin_owns_callback(plugin, &cf->cf_ctx))
+      return true;
+  }
+  return false;
+} /* }}} bool plugin_is_reloadable */
+
+EXPORT int plugin_deactivate(const char *plugin) /* {{{ */
+{
+  plugin_module_t *m = plugin_get_module(plugin);
+  if ((m == NULL) || !m->active)
+    return ENOENT;
+  if (!plugin_is_reloadable(plugin))
+    return ENOTSUP;
+
+  /* Remove the read callbacks and wait for running ones to return. */
+  pthread_mutex_lock(&read_lock);
+  llentry_t *le = llist_head(read_list);
+  while (le != NULL) {
+    llentry_t *next = le->next;
+    read_func_t *rf = le->value;
+
+    if (plugin_owns_callback(plugin, &rf->rf_ctx)) {
+      llist_remove(read_list, le);
+      llentry_destroy(le);
+      /* Freed by the read thread that picks it up next. */
+      rf->rf_type = RF_REMOVE;
+      if (rf->rf_busy) {
+        rf->rf_waited = true;
+        read_waited_num++;
+      }
     }
+    le = next;
+  }
+  while (read_waited_num > 0)
+    pthread_cond_wait(&read_done_cond, &read_lock);
+  pthread_mutex_unlock(&read_lock);
 
-    le = le->next;
+  llist_t *flush = llist_create();
+  llist_t *reset = llist_create();
+  llist_t *other = llist_create();
+  if ((flush == NULL) || (reset == NULL) || (other == NULL)) {
+    llist_destroy(flush);
+    llist_destroy(reset);
+    llist_destroy(other);
+    ERROR("plugin_deactivate: llist_create failed.");
+    return ENOMEM;
+  }
+  cache_event_func_t cache_events[STATIC_ARRAY_SIZE(list_cache_event)];
+  size_t cache_events_num = 0;
+
+  /* The plugin's entries are removed from the callback lists first and only
+   * moved to "flush", "reset" and "other" once no other thread can follow
+   * them anymore. */
+  pthread_mutex_lock(&callbacks_write_lock);
+  struct {
+    llist_t *list;
+    llist_t *dst;
+    size_t num;
+  } detach[] = {
+      {list_flush, flush},
+      {list_reset, reset},
+      {list_shutdown, other},
+      {list_missing, other},
+      {list_write, other},
+      {list_notification, other},
+      {list_log, other},
+      {list_init, other},
+  };
+  size_t entries_num = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(detach); i++)
+    entries_num += llist_size(detach[i].list);
+
+  llentry_t **entries = calloc(entries_num + 1, sizeof(*entries));
+  if (entries == NULL) {
+    pthread_mutex_unlock(&callbacks_write_lock);
+    llist_destroy(flush);
+    llist_destroy(reset);
+    llist_destroy(other);
+    ERROR("plugin_deactivate: calloc failed.");
+    return ENOMEM;
   }
 
-  start_write_threads((size_t)write_threads_num);
+  entries_num = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(detach); i++) {
+    detach[i].num =
+        plugin_detach_callbacks(detach[i].list, plugin, entries + entries_num);
+    entries_num += detach[i].num;
+  }
+  for (size_t i = 0; i < list_cache_event_num; i++) {
+    cache_event_func_t *cef = &list_cache_event[i];
+    if ((cef->callback == NULL) ||
+        !plugin_owns_callback(plugin, &cef->plugin_ctx))
+      continue;
+    __atomic_store_n(&cef->callback, NULL, __ATOMIC_RELAXED);
+    cache_events[cache_events_num++] = *cef;
+  }
+
+  /* Afterwards, no other thread is within one of the plugin's callbacks. */
+  callbacks_synchronize();
+  for (size_t i = 0; i < list_cache_event_num; i++)
+    if (list_cache_event[i].callback == NULL)
+      list_cache_event[i].name = NULL;
+  pthread_mutex_unlock(&callbacks_write_lock);
+
+  entries_num = 0;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(detach); i++)
+    for (size_t j = 0; j < detach[i].num; j++)
+      llist_append(detach[i].dst, entries[entries_num++]);
+  sfree(entries);
+
+  /* Let the plugin write out the state it kept, as plugin_shutdown_all()
+   * does. */
+  for (le = llist_head(flush); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+    plugin_flush_cb callback = cf->cf_callback;
 
-  max_read_interval =
-      global_option_get_time("MaxReadInterval", DEFAULT_MAX_READ_INTERVAL);
+    (*callback)(/* timeout = */ 0, /* identifier = */ NULL, &cf->cf_udata);
+    plugin_set_ctx(old_ctx);
+  }
 
-  /* Start read-threads */
-  if (read_heap != NULL) {
-    const char *rt;
-    int num;
+  /* The reset callback replaces the shutdown callback. */
+  for (le = llist_head(reset); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
+    plugin_reset_cb callback = cf->cf_callback;
 
-    rt = global_option_get("ReadThreads");
-    num = atoi(rt);
-    if (num != -1)
-      start_read_threads((num > 0) ? ((size_t)num) : 5);
+    if ((*callback)() != 0)
+      WARNING("plugin_deactivate: Resetting `%s' failed.", le->key);
+    plugin_set_ctx(old_ctx);
   }
-  return ret;
-} /* void plugin_init_all */
+
+  destroy_all_callbacks(&flush);
+  destroy_all_callbacks(&other);
+  destroy_all_callbacks(&reset);
+  for (size_t i = 0; i < cache_events_num; i++) {
+    sfree(cache_events[i].name);
+    free_userdata(&cache_events[i].user_data);
+  }
+
+  cf_unregister(plugin);
+  cf_unregister_complex(plugin);
+
+  m->active = false;
+  INFO("plugin_deactivate: plugin \"%s\" deactivated.", plugin);
+  return 0;
+} /* }}} int plugin_deactivate */
+
+EXPORT int plugin_reinit(const char *plugin) /* {{{ */
+{
+  int status = plugin_init_callbacks(plugin);
+
+  /* plugin_init_all() only started read threads if there was anything to
+   * read. */
+  plugin_start_read_threads();
+
+  return status;
+} /* }}} int plugin_reinit */
+
+EXPORT void plugin_replace_chains(fc_chain_t *chains) /* {{{ */
+{
+  pthread_mutex_lock(&callbacks_write_lock);
+  fc_chain_t *old = fc_chains_replace(chains);
+  __atomic_store_n(&pre_cache_chain,
+                   fc_chain_get_by_name(global_option_get("PreCacheChain")),
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&post_cache_chain,
+                   fc_chain_get_by_name(global_option_get("PostCacheChain")),
+                   __ATOMIC_RELEASE);
+  callbacks_synchronize();
+  pthread_mutex_unlock(&callbacks_write_lock);
+
+  fc_chains_destroy(old);
+} /* }}} void plugin_replace_chains */
 
 /* TODO: Rename this function. */
 EXPORT void plugin_read_all(void) {
@@ -1787,9 +2433,6 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
   if (vl == NULL)
     return EINVAL;
 
-  if (list_write == NULL)
-    return ENOENT;
-
   if (ds == NULL) {
     ds = plugin_get_ds(vl->type);
     if (ds == NULL) {
@@ -1798,11 +2441,18 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     }
   }
 
+  thread_state_t *t = callbacks_enter();
+  llist_t *list = __atomic_load_n(&list_write, __ATOMIC_ACQUIRE);
+  if (list == NULL) {
+    callbacks_leave(t);
+    return ENOENT;
+  }
+
   if (plugin == NULL) {
     int success = 0;
     int failure = 0;
 
-    le = llist_head(list_write);
+    le = llist_head(list);
     while (le != NULL) {
       callback_func_t *cf = le->value;
       plugin_write_cb callback;
@@ -1835,7 +2485,7 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     callback_func_t *cf;
     plugin_write_cb callback;
 
-    le = llist_head(list_write);
+    le = llist_head(list);
     while (le != NULL) {
       if (strcasecmp(plugin, le->key) == 0)
         break;
@@ -1843,8 +2493,10 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
       le = le->next;
     }
 
-    if (le == NULL)
+    if (le == NULL) {
+      callbacks_leave(t);
       return ENOENT;
+    }
 
     cf = le->value;
 
@@ -1856,17 +2508,14 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     status = (*callback)(ds, vl, &cf->cf_udata);
   }
 
+  callbacks_leave(t);
   return status;
 } /* }}} int plugin_write */
 
 EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
                         const char *identifier) {
-  llentry_t *le;
-
-  if (list_flush == NULL)
-    return 0;
-
-  le = llist_head(list_flush);
+  thread_state_t *t = callbacks_enter();
+  llentry_t *le = llist_head(__atomic_load_n(&list_flush, __ATOMIC_ACQUIRE));
   while (le != NULL) {
     callback_func_t *cf;
     plugin_flush_cb callback;
@@ -1887,6 +2536,7 @@ EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
 
     le = le->next;
   }
+  callbacks_leave(t);
   return 0;
 } /* int plugin_flush */
 
@@ -1950,6 +2600,7 @@ EXPORT int plugin_shutdown_all(void) {
 
   destroy_all_callbacks(&list_notification);
   destroy_all_callbacks(&list_shutdown);
+  destroy_all_callbacks(&list_reset);
   destroy_all_callbacks(&list_log);
 
   plugin_free_loaded();
@@ -1959,42 +2610,47 @@ EXPORT int plugin_shutdown_all(void) {
 
 EXPORT int plugin_dispatch_missing(const value_list_t *vl) /* {{{ */
 {
-  if (list_missing == NULL)
-    return 0;
+  thread_state_t *t = callbacks_enter();
+  int status = 0;
 
-  llentry_t *le = llist_head(list_missing);
+  llentry_t *le = llist_head(__atomic_load_n(&list_missing, __ATOMIC_ACQUIRE));
   while (le != NULL) {
     callback_func_t *cf = le->value;
     plugin_ctx_t old_ctx = plugin_set_ctx(cf->cf_ctx);
     plugin_missing_cb callback = cf->cf_callback;
 
-    int status = (*callback)(vl, &cf->cf_udata);
+    status = (*callback)(vl, &cf->cf_udata);
     plugin_set_ctx(old_ctx);
     if (status != 0) {
       if (status < 0) {
         ERROR("plugin_dispatch_missing: Callback function \"%s\" "
               "failed with status %i.",
               le->key, status);
-        return status;
       } else {
-        return 0;
+        status = 0;
       }
+      break;
     }
 
     le = le->next;
   }
-  return 0;
+  callbacks_leave(t);
+  return status;
 } /* int }}} plugin_dispatch_missing */
 
 void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
                                  unsigned long callbacks_mask, const char *name,
                                  const value_list_t *vl) {
+  thread_state_t *t = callbacks_enter();
+  size_t num = __atomic_load_n(&list_cache_event_num, __ATOMIC_ACQUIRE);
+
   switch (event_type) {
   case CE_VALUE_NEW:
     callbacks_mask = 0;
-    for (size_t i = 0; i < list_cache_event_num; i++) {
+    for (size_t i = 0; i < num; i++) {
       cache_event_func_t *cef = &list_cache_event[i];
-      plugin_cache_event_cb callback = cef->callback;
+      plugin_cache_event_cb callback =
+          __atomic_load_n(&cef->callback, __ATOMIC_ACQUIRE);
 
       if (!callback)
         continue;
@@ -2031,9 +2687,10 @@ void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
     break;
   case CE_VALUE_UPDATE:
   case CE_VALUE_EXPIRED:
-    for (size_t i = 0; i < list_cache_event_num; i++) {
+    for (size_t i = 0; i < num; i++) {
       cache_event_func_t *cef = &list_cache_event[i];
-      plugin_cache_event_cb callback = cef->callback;
+      plugin_cache_event_cb callback =
+          __atomic_load_n(&cef->callback, __ATOMIC_ACQUIRE);
 
       if (!callback)
         continue;
@@ -2059,7 +2716,7 @@ void plugin_dispatch_cache_event(enum cache_event_type_e event_type,
     }
     break;
   }
-  return;
+  callbacks_leave(t);
 }
 
 static int plugin_dispatch_values_internal(value_list_t *vl) {
@@ -2147,22 +2804,28 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   escape_slashes(vl->type, sizeof(vl->type));
   escape_slashes(vl->type_instance, sizeof(vl->type_instance));
 
-  if (pre_cache_chain != NULL) {
-    status = fc_process_chain(ds, vl, pre_cache_chain);
+  thread_state_t *t = callbacks_enter();
+
+  fc_chain_t *chain = __atomic_load_n(&pre_cache_chain, __ATOMIC_ACQUIRE);
+  if (chain != NULL) {
+    status = fc_process_chain(ds, vl, chain);
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "pre-cache chain failed with "
               "status %i (%#x).",
               status, status);
-    } else if (status == FC_TARGET_STOP)
+    } else if (status == FC_TARGET_STOP) {
+      callbacks_leave(t);
       return 0;
+    }
   }
 
   /* Update the value cache */
   uc_update(ds, vl);
 
-  if (post_cache_chain != NULL) {
-    status = fc_process_chain(ds, vl, post_cache_chain);
+  chain = __atomic_load_n(&post_cache_chain, __ATOMIC_ACQUIRE);
+  if (chain != NULL) {
+    status = fc_process_chain(ds, vl, chain);
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "post-cache chain failed with "
@@ -2172,6 +2835,8 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   } else
     fc_default_action(ds, vl);
 
+  callbacks_leave(t);
+
   if ((free_meta_data == true) && (vl->meta != NULL)) {
     meta_data_destroy(vl->meta);
     vl->meta = NULL;
@@ -2357,11 +3022,16 @@ EXPORT int plugin_dispatch_notification(const notification_t *notif) {
         notif->severity, notif->message, CDTIME_T_TO_DOUBLE(notif->time),
         notif->host);
 
+  thread_state_t *t = callbacks_enter();
+  llist_t *list = __atomic_load_n(&list_notification, __ATOMIC_ACQUIRE);
+
   /* Nobody cares for notifications */
-  if (list_notification == NULL)
+  if (list == NULL) {
+    callbacks_leave(t);
     return -1;
+  }
 
-  le = llist_head(list_notification);
+  le = llist_head(list);
   while (le != NULL) {
     callback_func_t *cf;
     plugin_notification_cb callback;
@@ -2382,6 +3052,7 @@ EXPORT int plugin_dispatch_notification(const notification_t *notif) {
     le = le->next;
   }
 
+  callbacks_leave(t);
   return 0;
 } /* int plugin_dispatch_notification */
 
@@ -2400,12 +3071,16 @@ EXPORT void plugin_log(int level, const char *format, ...) {
   msg[sizeof(msg) - 1] = '\0';
   va_end(ap);
 
-  if (list_log == NULL) {
+  thread_state_t *t = callbacks_enter();
+  llist_t *list = __atomic_load_n(&list_log, __ATOMIC_ACQUIRE);
+
+  if (list == NULL) {
+    callbacks_leave(t);
     fprintf(stderr, "%s\n", msg);
     return;
   }
 
-  le = llist_head(list_log);
+  le = llist_head(list);
   while (le != NULL) {
     callback_func_t *cf;
     plugin_log_cb callback;
@@ -2420,6 +3095,7 @@ EXPORT void plugin_log(int level, const char *format, ...) {
 
     le = le->next;
   }
+  callbacks_leave(t);
 } /* void plugin_log */
 
 void daemon_log(int level, const char *format, ...) {
@@ -2637,27 +3313,56 @@ int plugin_notification_meta_free(notification_meta_t *n) {
   return 0;
 } /* int plugin_notification_meta_free */
 
-static void plugin_ctx_destructor(void *ctx) {
-  sfree(ctx);
+static void plugin_ctx_destructor(void *arg) {
+  thread_state_t *t = arg;
+
+  pthread_mutex_lock(&thread_states_lock);
+  if (t->prev != NULL)
+    t->prev->next = t->next;
+  else
+    thread_states = t->next;
+  if (t->next != NULL)
+    t->next->prev = t->prev;
+  pthread_mutex_unlock(&thread_states_lock);
+
+  while (t->changes_head != NULL) {
+    callback_change_t *c = t->changes_head;
+    t->changes_head = c->next;
+    sfree(c->name);
+    destroy_callback(c->cf);
+    sfree(c);
+  }
+  sfree(t);
 } /* void plugin_ctx_destructor */
 
 static plugin_ctx_t ctx_init = {/* interval = */ 0};
 
-static plugin_ctx_t *plugin_ctx_create(void) {
-  plugin_ctx_t *ctx;
+static thread_state_t *thread_state_get(void) {
+  thread_state_t *t;
+
+  assert(plugin_ctx_key_initialized);
+  t = pthread_getspecific(plugin_ctx_key);
+  if (t != NULL)
+    return t;
 
-  ctx = malloc(sizeof(*ctx));
-  if (ctx == NULL) {
-    ERROR("Failed to allocate plugin context: %s", STRERRNO);
+  /* Must not log: plugin_log() uses this, too. */
+  t = calloc(1, sizeof(*t));
+  if (t == NULL)
     return NULL;
-  }
 
-  *ctx = ctx_init;
-  assert(plugin_ctx_key_initialized);
-  pthread_setspecific(plugin_ctx_key, ctx);
+  t->ctx = ctx_init;
+  pthread_setspecific(plugin_ctx_key, t);
+
+  /* Lets callbacks_synchronize() wait for the thread. */
+  pthread_mutex_lock(&thread_states_lock);
+  t->next = thread_states;
+  if (thread_states != NULL)
+    thread_states->prev = t;
+  thread_states = t;
+  pthread_mutex_unlock(&thread_states_lock);
   DEBUG("Created new plugin context.");
-  return ctx;
-} /* int plugin_ctx_create */
+  return t;
+} /* thread_state_t *thread_state_get */
 
 EXPORT void plugin_init_ctx(void) {
   pthread_key_create(&plugin_ctx_key, plugin_ctx_destructor);
@@ -2665,37 +3370,29 @@ EXPORT void plugin_init_ctx(void) {
 } /* void plugin_init_ctx */
 
 EXPORT plugin_ctx_t plugin_get_ctx(void) {
-  plugin_ctx_t *ctx;
+  thread_state_t *t = thread_state_get();
 
-  assert(plugin_ctx_key_initialized);
-  ctx = pthread_getspecific(plugin_ctx_key);
-
-  if (ctx == NULL) {
-    ctx = plugin_ctx_create();
-    /* this must no happen -- exit() instead? */
-    if (ctx == NULL)
-      return ctx_init;
+  /* this must no happen -- exit() instead? */
+  if (t == NULL) {
+    ERROR("Failed to allocate plugin context.");
+    return ctx_init;
   }
 
-  return *ctx;
+  return t->ctx;
 } /* plugin_ctx_t plugin_get_ctx */
 
 EXPORT plugin_ctx_t plugin_set_ctx(plugin_ctx_t ctx) {
-  plugin_ctx_t *c;
+  thread_state_t *t = thread_state_get();
   plugin_ctx_t old;
 
-  assert(plugin_ctx_key_initialized);
-  c = pthread_getspecific(plugin_ctx_key);
-
-  if (c == NULL) {
-    c = plugin_ctx_create();
-    /* this must no happen -- exit() instead? */
-    if (c == NULL)
-      return ctx_init;
+  /* this must no happen -- exit() instead? */
+  if (t == NULL) {
+    ERROR("Failed to allocate plugin context.");
+    return ctx_init;
   }
 
-  old = *c;
-  *c = ctx;
+  old = t->ctx;
+  t->ctx = ctx;
 
   return old;
 } /* void plugin_set_ctx */
@@ -208,6 +208,7 @@ typedef int (*plugin_missing_cb)(const value_list_t *, user_data_t *);
 typedef int (*plugin_cache_event_cb)(cache_event_t *, user_data_t *);
 typedef void (*plugin_log_cb)(int severity, const char *message, user_data_t *);
 typedef int (*plugin_shutdown_cb)(void);
+typedef int (*plugin_reset_cb)(void);
 typedef int (*plugin_notification_cb)(const notification_t *, user_data_t *);
 /*
  * NAME
@@ -254,6 +255,22 @@ void plugin_read_all(void);
 int plugin_read_all_once(void);
 int plugin_shutdown_all(void);
 
+/*
+ * Used by the configuration reload, which only reconfigures plugins that
+ * `plugin_is_reloadable', i.e. that registered a reset callback.
+ * `plugin_deactivate' waits for running callbacks of such a plugin to return,
+ * removes all of its callbacks and calls its flush and reset callbacks. The
+ * shared object stays loaded and `plugin_load' registers the plugin again.
+ * `plugin_reinit' then calls the plugin's init callbacks.
+ * `plugin_replace_chains' installs chains built with `fc_chains_create' and
+ * frees the previous ones.
+ */
+bool plugin_is_reloadable(const char *name);
+int plugin_deactivate(const char *name);
+int plugin_reinit(const char *name);
+struct fc_chain_s;
+void plugin_replace_chains(struct fc_chain_s *chains);
+
 /*
  * NAME
  *  plugin_write
@@ -297,6 +314,11 @@ int plugin_register_config(const char *name,
 int plugin_register_complex_config(const char *type,
                                    int (*callback)(oconfig_item_t *));
 int plugin_register_init(const char *name, plugin_init_cb callback);
+/* Like "plugin_register_init", but the callback is run in a thread of its own,
+ * concurrently with the init callbacks of other plugins. Only use this if the
+ * callback does not depend on other plugins having been initialized and does
+ * not call "plugin_register_init" or "plugin_register_data_set". */
+int plugin_register_parallel_init(const char *name, plugin_init_cb callback);
 int plugin_register_read(const char *name, int (*callback)(void));
 /* "user_data" will be freed automatically, unless
  * "plugin_register_complex_read" returns an error (non-zero). */
@@ -313,6 +335,12 @@ int plugin_register_cache_event(const char *name,
                                 plugin_cache_event_cb callback,
                                 user_data_t const *ud);
 int plugin_register_shutdown(const char *name, plugin_shutdown_cb callback);
+/* Plugins that register a reset callback are reconfigured by a configuration
+ * reload; changes to the configuration of other plugins only take effect
+ * after a restart. The reset callback is called instead of the shutdown
+ * callback and must free everything the plugin's config and init callbacks
+ * created, so that "module_register" and these callbacks can run again. */
+int plugin_register_reset(const char *name, plugin_reset_cb callback);
 int plugin_register_data_set(const data_set_t *ds);
 int plugin_register_log(const char *name, plugin_log_cb callback,
                         user_data_t const *user_data);
@@ -330,6 +358,7 @@ int plugin_unregister_flush(const char *name);
 int plugin_unregister_missing(const char *name);
 int plugin_unregister_cache_event(const char *name);
 int plugin_unregister_shutdown(const char *name);
+int plugin_unregister_reset(const char *name);
 int plugin_unregister_data_set(const char *name);
 int plugin_unregister_log(const char *name);
 int plugin_unregister_notification(const char *name);
@@ -449,6 +478,36 @@ int plugin_notification_meta_copy(notification_t *dst,
 
 int plugin_notification_meta_free(notification_meta_t *n);
 
+/*
+ * Notification builder: keeps one notification and the memory for its meta
+ * data, so that plugins dispatching many notifications do not allocate and
+ * free every meta data entry and string. `plugin_notification_builder_reset'
+ * clears the notification and returns it for filling in the fields; meta data
+ * must be added with the functions below and is valid until the next reset.
+ * Never pass the meta data to `plugin_notification_meta_free'. A builder must
+ * not be used by more than one thread at a time.
+ */
+struct notification_builder_s;
+typedef struct notification_builder_s notification_builder_t;
+
+notification_builder_t *plugin_notification_builder_create(void);
+void plugin_notification_builder_destroy(notification_builder_t *b);
+notification_t *plugin_notification_builder_reset(notification_builder_t *b);
+int plugin_notification_builder_add_string(notification_builder_t *b,
+                                           const char *name,
+                                           const char *value);
+int plugin_notification_builder_add_signed_int(notification_builder_t *b,
+                                               const char *name,
+                                               int64_t value);
+int plugin_notification_builder_add_unsigned_int(notification_builder_t *b,
+                                                 const char *name,
+                                                 uint64_t value);
+int plugin_notification_builder_add_double(notification_builder_t *b,
+                                           const char *name, double value);
+int plugin_notification_builder_add_boolean(notification_builder_t *b,
+                                            const char *name, bool value);
+int plugin_notification_builder_dispatch(notification_builder_t *b);
+
 /*
  * Plugin context management.
  */
@@ -43,6 +43,15 @@ int plugin_load(const char *name, bool global) { return ENOTSUP; }
 
 bool plugin_is_loaded(const char *name) { return false; }
 
+bool plugin_is_reloadable(const char *name) { return false; }
+
+int plugin_deactivate(const char *name) { return ENOTSUP; }
+
+int plugin_reinit(const char *name) { return ENOTSUP; }
+
+void plugin_replace_chains(struct fc_chain_s *chains) { /* nop */
+}
+
 int plugin_register_config(const char *name,
                            int (*callback)(const char *key, const char *val),
                            const char **keys, int keys_num) {
@@ -58,6 +67,10 @@ int plugin_register_init(const char *name, plugin_init_cb callback) {
   return ENOTSUP;
 }
 
+int plugin_register_parallel_init(const char *name, plugin_init_cb callback) {
+  return ENOTSUP;
+}
+
 int plugin_register_read(__attribute__((unused)) const char *name,
                          __attribute__((unused)) int (*callback)(void)) {
   return ENOTSUP;
@@ -92,6 +105,10 @@ int plugin_register_shutdown(const char *name, int (*callback)(void)) {
   return ENOTSUP;
 }
 
+int plugin_register_reset(const char *name, plugin_reset_cb callback) {
+  return ENOTSUP;
+}
+
 int plugin_register_data_set(const data_set_t *ds) { return ENOTSUP; }
 
 int plugin_register_notification(__attribute__((unused)) const char *name,
@@ -244,3 +261,7 @@ int plugin_thread_create(__attribute__((unused)) pthread_t *thread,
  * would be to hard-code the top-level config keys in daemon/collectd.c to avoid
  * having these references in daemon/configfile.c. */
 int fc_configure(const oconfig_item_t *ci) { return ENOTSUP; }
+
+int fc_chains_create(const oconfig_item_t *root, struct fc_chain_s **ret) {
+  return ENOTSUP;
+}
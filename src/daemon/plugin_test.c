@@ -0,0 +1,144 @@
+/**
+ * collectd - src/daemon/plugin_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "testing.h"
+#include "utils/common/common.h"
+
+static data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0.0, NAN};
+static data_set_t ds = {"gauge", 1, &dsrc};
+
+static int first_calls;
+static int second_calls;
+
+static int write_values(void) {
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = &(value_t){.gauge = 42};
+  vl.values_len = 1;
+  sstrncpy(vl.host, "example.com", sizeof(vl.host));
+  sstrncpy(vl.plugin, "test", sizeof(vl.plugin));
+  sstrncpy(vl.type, "gauge", sizeof(vl.type));
+
+  return plugin_write(/* plugin = */ NULL, &ds, &vl);
+}
+
+static int second_write(__attribute__((unused)) const data_set_t *ds,
+                        __attribute__((unused)) const value_list_t *vl,
+                        __attribute__((unused)) user_data_t *ud) {
+  second_calls++;
+  return 0;
+}
+
+/* Replaces itself with "second", like a plugin giving up on its output. */
+static int first_write(__attribute__((unused)) const data_set_t *ds,
+                       __attribute__((unused)) const value_list_t *vl,
+                       __attribute__((unused)) user_data_t *ud) {
+  first_calls++;
+  if (plugin_register_write("second", second_write, NULL) != 0)
+    return -1;
+  if (plugin_unregister_write("first") != 0)
+    return -1;
+  if (plugin_unregister_write("unknown") != -1)
+    return -1;
+  return 0;
+}
+
+/* Changes made from within a callback are applied once the outermost
+ * callback has returned. */
+DEF_TEST(deferred_changes) {
+  CHECK_ZERO(plugin_register_write("first", first_write, NULL));
+
+  EXPECT_EQ_INT(0, write_values());
+  EXPECT_EQ_INT(1, first_calls);
+  EXPECT_EQ_INT(0, second_calls);
+
+  EXPECT_EQ_INT(0, write_values());
+  EXPECT_EQ_INT(1, first_calls);
+  EXPECT_EQ_INT(1, second_calls);
+
+  CHECK_ZERO(plugin_unregister_write("second"));
+  EXPECT_EQ_INT(0, write_values());
+  EXPECT_EQ_INT(1, second_calls);
+  return 0;
+}
+
+static bool slow_entered;
+static bool slow_returned;
+static bool slow_freed;
+static bool used_after_free;
+
+static void slow_free(void *data) {
+  __atomic_store_n((bool *)data, true, __ATOMIC_SEQ_CST);
+}
+
+static int slow_write(__attribute__((unused)) const data_set_t *ds,
+                      __attribute__((unused)) const value_list_t *vl,
+                      __attribute__((unused)) user_data_t *ud) {
+  __atomic_store_n(&slow_entered, true, __ATOMIC_SEQ_CST);
+
+  struct timespec ts = {.tv_sec = 0, .tv_nsec = 100000000};
+  nanosleep(&ts, NULL);
+
+  if (__atomic_load_n(&slow_freed, __ATOMIC_SEQ_CST))
+    used_after_free = true;
+  __atomic_store_n(&slow_returned, true, __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+static void *write_thread(__attribute__((unused)) void *arg) {
+  write_values();
+  return NULL;
+}
+
+/* Unregistering a callback that another thread is running waits for it to
+ * return before its user data is freed. */
+DEF_TEST(unregister_waits) {
+  pthread_t thread;
+  user_data_t ud = {.data = &slow_freed, .free_func = slow_free};
+
+  CHECK_ZERO(plugin_register_write("slow", slow_write, &ud));
+  CHECK_ZERO(pthread_create(&thread, NULL, write_thread, NULL));
+  while (!__atomic_load_n(&slow_entered, __ATOMIC_SEQ_CST)) {
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = 1000000};
+    nanosleep(&ts, NULL);
+  }
+
+  CHECK_ZERO(plugin_unregister_write("slow"));
+  OK(__atomic_load_n(&slow_returned, __ATOMIC_SEQ_CST));
+  OK(slow_freed);
+  OK(!used_after_free);
+
+  pthread_join(thread, NULL);
+  return 0;
+}
+
+int main(void) {
+  plugin_init_ctx();
+
+  RUN_TEST(deferred_changes);
+  RUN_TEST(unregister_waits);
+
+  END_TEST;
+}
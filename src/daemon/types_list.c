@@ -93,41 +93,42 @@ static int parse_ds(data_source_t *dsrc, char *buf, size_t buf_len) {
   return 0;
 } /* int parse_ds */
 
-static void parse_line(char *buf) {
+/* Parses one line of a types database into "ds". Returns zero if a data set
+ * has been parsed, in which case "ds->ds" must be freed by the caller. */
+static int parse_line(char *buf, data_set_t *ds) {
   char *fields[64];
   size_t fields_num;
   fields_num = strsplit(buf, fields, 64);
   if (fields_num < 2)
-    return;
+    return -1;
 
   /* Ignore lines which begin with a hash sign. */
   if (fields[0][0] == '#')
-    return;
+    return -1;
 
-  data_set_t ds = {{0}};
+  *ds = (data_set_t){{0}};
 
-  sstrncpy(ds.type, fields[0], sizeof(ds.type));
+  sstrncpy(ds->type, fields[0], sizeof(ds->type));
 
-  ds.ds_num = fields_num - 1;
-  ds.ds = calloc(ds.ds_num, sizeof(*ds.ds));
-  if (ds.ds == NULL)
-    return;
+  ds->ds_num = fields_num - 1;
+  ds->ds = calloc(ds->ds_num, sizeof(*ds->ds));
+  if (ds->ds == NULL)
+    return -1;
 
-  for (size_t i = 0; i < ds.ds_num; i++)
-    if (parse_ds(ds.ds + i, fields[i + 1], strlen(fields[i + 1])) != 0) {
+  for (size_t i = 0; i < ds->ds_num; i++)
+    if (parse_ds(ds->ds + i, fields[i + 1], strlen(fields[i + 1])) != 0) {
       ERROR("types_list: parse_line: Cannot parse data source #%" PRIsz
             " of data set %s",
-            i, ds.type);
-      sfree(ds.ds);
-      return;
+            i, ds->type);
+      sfree(ds->ds);
+      return -1;
     }
 
-  plugin_register_data_set(&ds);
-
-  sfree(ds.ds);
-} /* void parse_line */
+  return 0;
+} /* int parse_line */
 
-static void parse_file(FILE *fh) {
+static void parse_file(FILE *fh, int (*callback)(const data_set_t *, void *),
+                       void *user_data) {
   char buf[4096];
   size_t buf_len;
 
@@ -154,10 +155,20 @@ static void parse_file(FILE *fh) {
     if (buf_len == 0)
       continue;
 
-    parse_line(buf);
+    data_set_t ds;
+    if (parse_line(buf, &ds) != 0)
+      continue;
+
+    callback(&ds, user_data);
+    sfree(ds.ds);
   } /* while (fgets) */
 } /* void parse_file */
 
+static int register_data_set(const data_set_t *ds,
+                             void __attribute__((unused)) * user_data) {
+  return plugin_register_data_set(ds);
+}
+
 int read_types_list(const char *file) {
   FILE *fh;
 
@@ -172,7 +183,7 @@ int read_types_list(const char *file) {
     return -1;
   }
 
-  parse_file(fh);
+  parse_file(fh, register_data_set, /* user_data = */ NULL);
 
   fclose(fh);
   fh = NULL;
@@ -0,0 +1,115 @@
+/**
+ * collectd - src/daemon/types_list_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "types_list.c" /* sic */
+
+#include "testing.h"
+
+#define TYPES_NUM 2000
+
+static char base_dir[] = "/tmp/types_list_test.XXXXXX";
+
+typedef struct {
+  data_set_t sets[TYPES_NUM];
+  size_t sets_num;
+} collected_t;
+
+static int collect(const data_set_t *ds, void *user_data) {
+  collected_t *c = user_data;
+
+  if (c->sets_num >= TYPES_NUM)
+    return ENOSPC;
+
+  data_set_t *dst = c->sets + c->sets_num;
+  *dst = *ds;
+  dst->ds = calloc(ds->ds_num, sizeof(*dst->ds));
+  if (dst->ds == NULL)
+    return ENOMEM;
+  memcpy(dst->ds, ds->ds, ds->ds_num * sizeof(*dst->ds));
+  c->sets_num++;
+  return 0;
+}
+
+static void collected_reset(collected_t *c) {
+  for (size_t i = 0; i < c->sets_num; i++)
+    sfree(c->sets[i].ds);
+  c->sets_num = 0;
+}
+
+static int write_types_db(const char *file) {
+  FILE *fh = fopen(file, "w");
+  if (fh == NULL)
+    return errno;
+
+  fprintf(fh, "# comment\n\n");
+  for (int i = 0; i < TYPES_NUM; i++)
+    fprintf(fh,
+            "type%04d\trx:DERIVE:0:U, tx:DERIVE:0:U, value:GAUGE:-10.5:%d\n",
+            i, i);
+  /* Invalid data sources are skipped. */
+  fprintf(fh, "invalid\tvalue:FOO:0:U\n");
+  return (fclose(fh) == 0) ? 0 : errno;
+}
+
+static collected_t parsed;
+
+DEF_TEST(parse) {
+  char file[PATH_MAX];
+
+  snprintf(file, sizeof(file), "%s/types.db", base_dir);
+  CHECK_ZERO(write_types_db(file));
+
+  FILE *fh = fopen(file, "r");
+  CHECK_NOT_NULL(fh);
+  parse_file(fh, collect, &parsed);
+  fclose(fh);
+
+  EXPECT_EQ_INT(TYPES_NUM, parsed.sets_num);
+  EXPECT_EQ_STR("type0042", parsed.sets[42].type);
+  EXPECT_EQ_INT(3, parsed.sets[42].ds_num);
+  EXPECT_EQ_STR("rx", parsed.sets[42].ds[0].name);
+  EXPECT_EQ_INT(DS_TYPE_DERIVE, parsed.sets[42].ds[0].type);
+  EXPECT_EQ_DOUBLE(0.0, parsed.sets[42].ds[0].min);
+  OK(isnan(parsed.sets[42].ds[0].max));
+  EXPECT_EQ_STR("value", parsed.sets[42].ds[2].name);
+  EXPECT_EQ_INT(DS_TYPE_GAUGE, parsed.sets[42].ds[2].type);
+  EXPECT_EQ_DOUBLE(-10.5, parsed.sets[42].ds[2].min);
+  EXPECT_EQ_DOUBLE(42.0, parsed.sets[42].ds[2].max);
+
+  collected_reset(&parsed);
+  unlink(file);
+  return 0;
+}
+
+int main(void) {
+  if (mkdtemp(base_dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", STRERRNO);
+    return 1;
+  }
+
+  RUN_TEST(parse);
+
+  rmdir(base_dir);
+
+  END_TEST;
+}
@@ -31,6 +31,7 @@
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/heap/heap.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h"
 
@@ -38,7 +39,21 @@
 
 typedef struct cache_entry_s {
   char name[6 * DATA_MAX_NAME_LEN];
+  /* Lengths of the host, plugin, plugin instance, type and type instance in
+   * "name", so the identifier can be restored without parsing it. */
+  uint8_t name_fields[5];
+
+  /* Protects the fields below. Entries are only inserted and removed with
+   * `cache_lock' locked for writing, so holding it for reading is enough to
+   * keep "ce" alive; updates of existing entries only lock the entry. */
+  pthread_mutex_t lock;
+  /* Odd while the values, rates or state are being modified. Writers hold
+   * `lock'; uc_get_rate_r() and the other getters of values and rates copy
+   * them without the lock and retry if "seq" changed in the meantime. */
+  unsigned int seq;
+
   size_t values_num;
+  /* Both point into the same allocation as the entry, see cache_alloc(). */
   gauge_t *values_gauge;
   value_t *values_raw;
   /* Time contained in the package
@@ -68,6 +83,10 @@ typedef struct cache_entry_s {
 
   meta_data_t *meta;
   unsigned long callbacks_mask;
+
+  /* Position in "expire_heap". Updates don't move the entry; it is moved when
+   * "uc_check_timeout" finds that the deadline has been pushed back. */
+  cdtime_t expires;
 } cache_entry_t;
 
 struct uc_iter_s {
@@ -77,8 +96,47 @@ struct uc_iter_s {
   cache_entry_t *entry;
 };
 
+/* Number of entries copied into a snapshot per lock of `cache_lock'. */
+#define UC_SNAPSHOT_CHUNK 1024
+
+typedef struct {
+  /* Offsets into the snapshot's "names" and "values", which are grown while
+   * the snapshot is taken. */
+  size_t name_offset;
+  size_t values_offset;
+  size_t values_num;
+  cdtime_t last_time;
+} uc_snapshot_entry_t;
+
+struct uc_snapshot_s {
+  uint64_t epoch;
+  cdtime_t time;
+  /* Protected by `snapshot_lock'. */
+  size_t refs;
+
+  uc_snapshot_entry_t *entries;
+  size_t entries_num;
+  size_t entries_size;
+
+  char *names;
+  size_t names_len;
+  size_t names_size;
+
+  gauge_t *values;
+  size_t values_len;
+  size_t values_size;
+};
+
 static c_avl_tree_t *cache_tree;
-static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static c_heap_t *expire_heap;
+static pthread_rwlock_t cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* The latest snapshot, shared by readers until it is too old. */
+static uc_snapshot_t *snapshot_current;
+static uint64_t snapshot_epoch;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Serializes taking snapshots, so that concurrent readers share one. */
+static pthread_mutex_t snapshot_create_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
 #if COLLECT_DEBUG
@@ -87,25 +145,58 @@ static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
   return strcmp(a->name, b->name);
 } /* int cache_compare */
 
+static int cache_compare_expires(const cache_entry_t *a,
+                                 const cache_entry_t *b) {
+  if (a->expires < b->expires)
+    return -1;
+  else if (a->expires > b->expires)
+    return 1;
+  return 0;
+} /* int cache_compare_expires */
+
+static cdtime_t cache_expires(const cache_entry_t *ce) {
+  return ce->last_update + ce->interval * timeout_g;
+} /* cdtime_t cache_expires */
+
+/* Restores the identifier of "ce" into "vl". */
+static void cache_entry_identifier(const cache_entry_t *ce,
+                                   value_list_t *vl) {
+  char *fields[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                    vl->type_instance};
+  const char *ptr = ce->name;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    size_t len = ce->name_fields[i];
+
+    /* Instances are only preceded by a dash if they are not empty. */
+    if (((i == 2) || (i == 4)) && (len == 0)) {
+      fields[i][0] = 0;
+      continue;
+    }
+    /* Skip the separator. */
+    if (i > 0)
+      ptr++;
+
+    memcpy(fields[i], ptr, len);
+    fields[i][len] = 0;
+    ptr += len;
+  }
+} /* void cache_entry_identifier */
+
 static cache_entry_t *cache_alloc(size_t values_num) {
   cache_entry_t *ce;
 
-  ce = calloc(1, sizeof(*ce));
+  /* The values are stored right behind the entry. */
+  ce = calloc(1, sizeof(*ce) + values_num * (sizeof(*ce->values_gauge) +
+                                             sizeof(*ce->values_raw)));
   if (ce == NULL) {
     ERROR("utils_cache: cache_alloc: calloc failed.");
     return NULL;
   }
   ce->values_num = values_num;
-
-  ce->values_gauge = calloc(values_num, sizeof(*ce->values_gauge));
-  ce->values_raw = calloc(values_num, sizeof(*ce->values_raw));
-  if ((ce->values_gauge == NULL) || (ce->values_raw == NULL)) {
-    sfree(ce->values_gauge);
-    sfree(ce->values_raw);
-    sfree(ce);
-    ERROR("utils_cache: cache_alloc: calloc failed.");
-    return NULL;
-  }
+  ce->values_gauge = (gauge_t *)(ce + 1);
+  ce->values_raw = (value_t *)(ce->values_gauge + values_num);
+  pthread_mutex_init(&ce->lock, /* attr = */ NULL);
 
   ce->history = NULL;
   ce->history_length = 0;
@@ -118,13 +209,12 @@ static void cache_free(cache_entry_t *ce) {
   if (ce == NULL)
     return;
 
-  sfree(ce->values_gauge);
-  sfree(ce->values_raw);
   sfree(ce->history);
   if (ce->meta != NULL) {
     meta_data_destroy(ce->meta);
     ce->meta = NULL;
   }
+  pthread_mutex_destroy(&ce->lock);
   sfree(ce);
 } /* void cache_free */
 
@@ -139,9 +229,51 @@ static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
   }
 } /* void uc_check_range */
 
+/* Starts modifying the values, rates or state of "ce". `ce->lock' must be
+ * held. */
+static void uc_write_begin(cache_entry_t *ce) {
+  __atomic_store_n(&ce->seq, ce->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+} /* void uc_write_begin */
+
+static void uc_write_end(cache_entry_t *ce) {
+  __atomic_store_n(&ce->seq, ce->seq + 1, __ATOMIC_RELEASE);
+} /* void uc_write_end */
+
+/* Copies the rates and / or the raw values of "ce" without taking
+ * `ce->lock'. `cache_lock' must be held for reading. Returns the state of the
+ * entry at the time of the copy. */
+static int uc_read_values(cache_entry_t *ce, gauge_t *ret_rates,
+                          value_t *ret_values) {
+  unsigned int seq;
+  int state = STATE_UNKNOWN;
+
+  do {
+    seq = __atomic_load_n(&ce->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) {
+      /* A writer holds the lock, wait for it instead of spinning. */
+      pthread_mutex_lock(&ce->lock);
+      pthread_mutex_unlock(&ce->lock);
+      continue;
+    }
+
+    state = __atomic_load_n(&ce->state, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < ce->values_num; i++) {
+      if (ret_rates != NULL)
+        __atomic_load(ce->values_gauge + i, ret_rates + i, __ATOMIC_RELAXED);
+      if (ret_values != NULL)
+        __atomic_load(ce->values_raw + i, ret_values + i, __ATOMIC_RELAXED);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || (__atomic_load_n(&ce->seq, __ATOMIC_RELAXED) != seq));
+
+  return state;
+} /* int uc_read_values */
+
 static int uc_insert(const data_set_t *ds, const value_list_t *vl,
                      const char *key) {
-  /* `cache_lock' has been locked by `uc_update' */
+  /* `cache_lock' has been locked for writing by `uc_update' */
 
   char *key_copy = strdup(key);
   if (key_copy == NULL) {
@@ -157,6 +289,11 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
   }
 
   sstrncpy(ce->name, key, sizeof(ce->name));
+  ce->name_fields[0] = (uint8_t)strlen(vl->host);
+  ce->name_fields[1] = (uint8_t)strlen(vl->plugin);
+  ce->name_fields[2] = (uint8_t)strlen(vl->plugin_instance);
+  ce->name_fields[3] = (uint8_t)strlen(vl->type);
+  ce->name_fields[4] = (uint8_t)strlen(vl->type_instance);
 
   for (size_t i = 0; i < ds->ds_num; i++) {
     switch (ds->ds[i].type) {
@@ -205,12 +342,23 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     ce->meta = meta_data_clone(vl->meta);
   }
 
+  ce->expires = cache_expires(ce);
+
   if (c_avl_insert(cache_tree, key_copy, ce) != 0) {
     sfree(key_copy);
+    cache_free(ce);
     ERROR("uc_insert: c_avl_insert failed.");
     return -1;
   }
 
+  if (c_heap_insert(expire_heap, ce) != 0) {
+    c_avl_remove(cache_tree, key, NULL, NULL);
+    sfree(key_copy);
+    cache_free(ce);
+    ERROR("uc_insert: c_heap_insert failed.");
+    return -1;
+  }
+
   DEBUG("uc_insert: Added %s to the cache.", key);
   return 0;
 } /* int uc_insert */
@@ -219,53 +367,77 @@ int uc_init(void) {
   if (cache_tree == NULL)
     cache_tree =
         c_avl_create((int (*)(const void *, const void *))cache_compare);
+  if (expire_heap == NULL)
+    expire_heap = c_heap_create(
+        (int (*)(const void *, const void *))cache_compare_expires);
 
   return 0;
 } /* int uc_init */
 
 int uc_check_timeout(void) {
   struct {
-    char *key;
+    cache_entry_t *entry;
     cdtime_t time;
     cdtime_t interval;
+    cdtime_t last_update;
     unsigned long callbacks_mask;
   } *expired = NULL;
   size_t expired_num = 0;
+  size_t expired_size = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  pthread_rwlock_wrlock(&cache_lock);
   cdtime_t now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  c_avl_iterator_t *iter = c_avl_get_iterator(cache_tree);
-  char *key = NULL;
-  cache_entry_t *ce = NULL;
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
-    /* If the entry is fresh enough, continue. */
-    if ((now - ce->last_update) < (ce->interval * timeout_g))
-      continue;
+  /* Take the entries whose deadline has passed from the heap. Entries which
+   * have been updated in the meantime are put back with their new deadline,
+   * so each entry is looked at about once per timeout. */
+  cache_entry_t *ce;
+  while ((ce = c_heap_get_root(expire_heap)) != NULL) {
+    cdtime_t expires = cache_expires(ce);
 
-    void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
-    if (tmp == NULL) {
-      ERROR("uc_check_timeout: realloc failed.");
+    if ((ce->expires > now) || (expires > now)) {
+      bool done = (ce->expires > now);
+
+      ce->expires = expires;
+      if (c_heap_insert(expire_heap, ce) != 0)
+        ERROR("uc_check_timeout: c_heap_insert (\"%s\") failed.", ce->name);
+      if (done)
+        break;
       continue;
     }
-    expired = tmp;
 
-    expired[expired_num].key = strdup(key);
+    if (expired_num >= expired_size) {
+      size_t new_size = (expired_size == 0) ? 16 : 2 * expired_size;
+      void *tmp = realloc(expired, new_size * sizeof(*expired));
+      if (tmp == NULL) {
+        ERROR("uc_check_timeout: realloc failed.");
+        c_heap_insert(expire_heap, ce);
+        break;
+      }
+      expired = tmp;
+      expired_size = new_size;
+    }
+
+    expired[expired_num].entry = ce;
     expired[expired_num].time = ce->last_time;
     expired[expired_num].interval = ce->interval;
+    expired[expired_num].last_update = ce->last_update;
     expired[expired_num].callbacks_mask = ce->callbacks_mask;
-
-    if (expired[expired_num].key == NULL) {
-      ERROR("uc_check_timeout: strdup failed.");
-      continue;
-    }
-
     expired_num++;
-  } /* while (c_avl_iterator_next) */
+  } /* while (c_heap_get_root) */
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
+
+  /* Don't keep the memory of a snapshot nobody asked for in a while. */
+  pthread_mutex_lock(&snapshot_lock);
+  uc_snapshot_t *snap = NULL;
+  if ((snapshot_current != NULL) &&
+      ((now - snapshot_current->time) > UC_SNAPSHOT_MAX_AGE)) {
+    snap = snapshot_current;
+    snapshot_current = NULL;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+  uc_snapshot_release(snap);
 
   if (expired_num == 0) {
     sfree(expired);
@@ -276,46 +448,47 @@ int uc_check_timeout(void) {
    * value from the cache, so that callbacks can still access the data stored,
    * including plugin specific meta data, rates, history, …. This must be done
    * without holding the lock, otherwise we will run into a deadlock if a
-   * plugin calls the cache interface. */
+   * plugin calls the cache interface. The entries are only freed below, and
+   * their names never change. */
   for (size_t i = 0; i < expired_num; i++) {
     value_list_t vl = {
         .time = expired[i].time,
         .interval = expired[i].interval,
     };
 
-    if (parse_identifier_vl(expired[i].key, &vl) != 0) {
-      ERROR("uc_check_timeout: parse_identifier_vl (\"%s\") failed.",
-            expired[i].key);
-      continue;
-    }
+    cache_entry_identifier(expired[i].entry, &vl);
 
     plugin_dispatch_missing(&vl);
 
     if (expired[i].callbacks_mask)
       plugin_dispatch_cache_event(CE_VALUE_EXPIRED, expired[i].callbacks_mask,
-                                  expired[i].key, &vl);
+                                  expired[i].entry->name, &vl);
   } /* for (i = 0; i < expired_num; i++) */
 
-  /* Now actually remove all the values from the cache. We don't re-evaluate
-   * the timestamp again, so in theory it is possible we remove a value after
-   * it is updated here. */
-  pthread_mutex_lock(&cache_lock);
+  /* Now actually remove all the values from the cache. Values which have
+   * been updated while the callbacks ran are kept. */
+  pthread_rwlock_wrlock(&cache_lock);
   for (size_t i = 0; i < expired_num; i++) {
     char *key = NULL;
     cache_entry_t *value = NULL;
 
-    if (c_avl_remove(cache_tree, expired[i].key, (void *)&key,
-                     (void *)&value) != 0) {
-      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", expired[i].key);
-      sfree(expired[i].key);
+    ce = expired[i].entry;
+    if (ce->last_update != expired[i].last_update) {
+      ce->expires = cache_expires(ce);
+      if (c_heap_insert(expire_heap, ce) != 0)
+        ERROR("uc_check_timeout: c_heap_insert (\"%s\") failed.", ce->name);
+      continue;
+    }
+
+    if (c_avl_remove(cache_tree, ce->name, (void *)&key, (void *)&value) !=
+        0) {
+      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", ce->name);
       continue;
     }
     sfree(key);
     cache_free(value);
-
-    sfree(expired[i].key);
   } /* for (i = 0; i < expired_num; i++) */
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   sfree(expired);
   return 0;
@@ -329,88 +502,105 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
     return -1;
   }
 
-  pthread_mutex_lock(&cache_lock);
+  pthread_rwlock_rdlock(&cache_lock);
 
   cache_entry_t *ce = NULL;
   int status = c_avl_get(cache_tree, name, (void *)&ce);
   if (status != 0) /* entry does not yet exist */
   {
-    status = uc_insert(ds, vl, name);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&cache_lock);
+    pthread_rwlock_wrlock(&cache_lock);
+
+    /* Another thread may have added the entry in the meantime. */
+    status = c_avl_get(cache_tree, name, (void *)&ce);
+    if (status != 0) {
+      status = uc_insert(ds, vl, name);
+      pthread_rwlock_unlock(&cache_lock);
 
-    if (status == 0)
-      plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, name, vl);
+      if (status == 0)
+        plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, name, vl);
 
-    return status;
+      return status;
+    }
   }
 
   assert(ce != NULL);
   assert(ce->values_num == ds->ds_num);
 
+  pthread_mutex_lock(&ce->lock);
+
   if (ce->last_time >= vl->time) {
-    pthread_mutex_unlock(&cache_lock);
+    cdtime_t last_time = ce->last_time;
+    pthread_mutex_unlock(&ce->lock);
+    pthread_rwlock_unlock(&cache_lock);
     NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
            "last cache update = %.3f;",
-           name, CDTIME_T_TO_DOUBLE(vl->time),
-           CDTIME_T_TO_DOUBLE(ce->last_time));
+           name, CDTIME_T_TO_DOUBLE(vl->time), CDTIME_T_TO_DOUBLE(last_time));
     return -1;
   }
 
+  gauge_t *history = NULL;
+  if (ce->history != NULL) {
+    assert(ce->history_index < ce->history_length);
+    history = ce->history + (ce->values_num * ce->history_index);
+  }
+
+  uc_write_begin(ce);
+
   for (size_t i = 0; i < ds->ds_num; i++) {
+    value_t raw = vl->values[i];
+    gauge_t rate;
+
     switch (ds->ds[i].type) {
     case DS_TYPE_COUNTER: {
-      counter_t diff =
-          counter_diff(ce->values_raw[i].counter, vl->values[i].counter);
-      ce->values_gauge[i] =
-          ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].counter = vl->values[i].counter;
+      counter_t diff = counter_diff(ce->values_raw[i].counter, raw.counter);
+      rate = ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
     } break;
 
     case DS_TYPE_GAUGE:
-      ce->values_raw[i].gauge = vl->values[i].gauge;
-      ce->values_gauge[i] = vl->values[i].gauge;
+      rate = raw.gauge;
       break;
 
     case DS_TYPE_DERIVE: {
-      derive_t diff = vl->values[i].derive - ce->values_raw[i].derive;
-
-      ce->values_gauge[i] =
-          ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].derive = vl->values[i].derive;
+      derive_t diff = raw.derive - ce->values_raw[i].derive;
+      rate = ((double)diff) / (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
     } break;
 
     case DS_TYPE_ABSOLUTE:
-      ce->values_gauge[i] = ((double)vl->values[i].absolute) /
-                            (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
-      ce->values_raw[i].absolute = vl->values[i].absolute;
+      rate = ((double)raw.absolute) /
+             (CDTIME_T_TO_DOUBLE(vl->time - ce->last_time));
       break;
 
     default:
       /* This shouldn't happen. */
-      pthread_mutex_unlock(&cache_lock);
+      uc_write_end(ce);
+      pthread_mutex_unlock(&ce->lock);
+      pthread_rwlock_unlock(&cache_lock);
       ERROR("uc_update: Don't know how to handle data source type %i.",
             ds->ds[i].type);
       return -1;
     } /* switch (ds->ds[i].type) */
 
-    DEBUG("uc_update: %s: ds[%" PRIsz "] = %lf", name, i, ce->values_gauge[i]);
+    DEBUG("uc_update: %s: ds[%" PRIsz "] = %lf", name, i, rate);
+
+    /* The history keeps the rates before invalid gauge data is pruned. */
+    if (history != NULL)
+      history[i] = rate;
+
+    if (!isnan(rate) && ((rate < ds->ds[i].min) || (rate > ds->ds[i].max)))
+      rate = NAN;
+
+    __atomic_store(ce->values_gauge + i, &rate, __ATOMIC_RELAXED);
+    __atomic_store(ce->values_raw + i, &raw, __ATOMIC_RELAXED);
   } /* for (i) */
 
-  /* Update the history if it exists. */
-  if (ce->history != NULL) {
-    assert(ce->history_index < ce->history_length);
-    for (size_t i = 0; i < ce->values_num; i++) {
-      size_t hist_idx = (ce->values_num * ce->history_index) + i;
-      ce->history[hist_idx] = ce->values_gauge[i];
-    }
+  uc_write_end(ce);
 
+  if (history != NULL) {
     assert(ce->history_length > 0);
     ce->history_index = (ce->history_index + 1) % ce->history_length;
   }
 
-  /* Prune invalid gauge data */
-  uc_check_range(ds, ce);
-
   ce->last_time = vl->time;
   ce->last_update = cdtime();
   ce->interval = vl->interval;
@@ -418,7 +608,8 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   /* Check if cache entry has registered callbacks */
   unsigned long callbacks_mask = ce->callbacks_mask;
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&ce->lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   if (callbacks_mask)
     plugin_dispatch_cache_event(CE_VALUE_UPDATE, callbacks_mask, name, vl);
@@ -426,18 +617,54 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   return 0;
 } /* int uc_update */
 
-int uc_set_callbacks_mask(const char *name, unsigned long mask) {
-  pthread_mutex_lock(&cache_lock);
+/* Looks up "name" and returns the entry with `cache_lock' locked for reading
+ * and the entry's lock held. Returns NULL, with no lock held, if there is no
+ * such entry. */
+static cache_entry_t *uc_lock_entry(const char *name) {
   cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) { /* Ouch, just created entry disappeared ?! */
+
+  pthread_rwlock_rdlock(&cache_lock);
+
+  if (c_avl_get(cache_tree, name, (void *)&ce) != 0) {
+    pthread_rwlock_unlock(&cache_lock);
+    return NULL;
+  }
+  assert(ce != NULL);
+
+  pthread_mutex_lock(&ce->lock);
+  return ce;
+} /* cache_entry_t *uc_lock_entry */
+
+static void uc_unlock_entry(cache_entry_t *ce) {
+  pthread_mutex_unlock(&ce->lock);
+  pthread_rwlock_unlock(&cache_lock);
+} /* void uc_unlock_entry */
+
+/* Like uc_lock_entry(), but only locks `cache_lock' for reading. Used by
+ * the getters that read the entry with uc_read_values(). */
+static cache_entry_t *uc_find_entry(const char *name) {
+  cache_entry_t *ce = NULL;
+
+  pthread_rwlock_rdlock(&cache_lock);
+
+  if (c_avl_get(cache_tree, name, (void *)&ce) != 0) {
+    pthread_rwlock_unlock(&cache_lock);
+    return NULL;
+  }
+  assert(ce != NULL);
+
+  return ce;
+} /* cache_entry_t *uc_find_entry */
+
+int uc_set_callbacks_mask(const char *name, unsigned long mask) {
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce == NULL) { /* Ouch, just created entry disappeared ?! */
     ERROR("uc_set_callbacks_mask: Couldn't find %s entry!", name);
-    pthread_mutex_unlock(&cache_lock);
     return -1;
   }
   DEBUG("uc_set_callbacks_mask: set mask for \"%s\" to %lu.", name, mask);
   ce->callbacks_mask = mask;
-  pthread_mutex_unlock(&cache_lock);
+  uc_unlock_entry(ce);
   return 0;
 }
 
@@ -445,36 +672,30 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num) {
   gauge_t *ret = NULL;
   size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_find_entry(name);
+  if (ce == NULL) {
+    DEBUG("utils_cache: uc_get_rate_by_name: No such value: %s", name);
+    return -1;
+  }
 
+  ret_num = ce->values_num;
+  ret = malloc(ret_num * sizeof(*ret));
+  if (ret == NULL) {
+    ERROR("utils_cache: uc_get_rate_by_name: malloc failed.");
+    status = -1;
+  } else if (uc_read_values(ce, ret, /* ret_values = */ NULL) ==
+             STATE_MISSING) {
     /* remove missing values from getval */
-    if (ce->state == STATE_MISSING) {
-      DEBUG("utils_cache: uc_get_rate_by_name: requested metric \"%s\" is in "
-            "state \"missing\".",
-            name);
-      status = -1;
-    } else {
-      ret_num = ce->values_num;
-      ret = malloc(ret_num * sizeof(*ret));
-      if (ret == NULL) {
-        ERROR("utils_cache: uc_get_rate_by_name: malloc failed.");
-        status = -1;
-      } else {
-        memcpy(ret, ce->values_gauge, ret_num * sizeof(gauge_t));
-      }
-    }
-  } else {
-    DEBUG("utils_cache: uc_get_rate_by_name: No such value: %s", name);
+    DEBUG("utils_cache: uc_get_rate_by_name: requested metric \"%s\" is in "
+          "state \"missing\".",
+          name);
+    sfree(ret);
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   if (status == 0) {
     *ret_values = ret;
@@ -484,27 +705,46 @@ int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
   return status;
 } /* gauge_t *uc_get_rate_by_name */
 
-gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
+int uc_get_rate_r(const data_set_t *ds, const value_list_t *vl,
+                  gauge_t *ret_rates) {
   char name[6 * DATA_MAX_NAME_LEN];
-  gauge_t *ret = NULL;
-  size_t ret_num = 0;
-  int status;
+  int status = 0;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("utils_cache: uc_get_rate: FORMAT_VL failed.");
-    return NULL;
+    ERROR("utils_cache: uc_get_rate_r: FORMAT_VL failed.");
+    return -1;
   }
 
-  status = uc_get_rate_by_name(name, &ret, &ret_num);
-  if (status != 0)
+  cache_entry_t *ce = uc_find_entry(name);
+  if (ce == NULL) {
+    DEBUG("utils_cache: uc_get_rate_r: No such value: %s", name);
+    return -1;
+  }
+
+  if (ce->values_num != ds->ds_num) {
+    /* This is important - the caller has no other way of knowing how many
+     * values are returned. */
+    ERROR("utils_cache: uc_get_rate_r: ds[%s] has %" PRIsz " values, "
+          "but the cache entry has %" PRIsz ".",
+          ds->type, ds->ds_num, ce->values_num);
+    status = -1;
+  } else if (uc_read_values(ce, ret_rates, /* ret_values = */ NULL) ==
+             STATE_MISSING) {
+    status = -1;
+  }
+
+  pthread_rwlock_unlock(&cache_lock);
+  return status;
+} /* int uc_get_rate_r */
+
+gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
+  gauge_t *ret = calloc(ds->ds_num, sizeof(*ret));
+  if (ret == NULL) {
+    ERROR("utils_cache: uc_get_rate: calloc failed.");
     return NULL;
+  }
 
-  /* This is important - the caller has no other way of knowing how many
-   * values are returned. */
-  if (ret_num != ds->ds_num) {
-    ERROR("utils_cache: uc_get_rate: ds[%s] has %" PRIsz " values, "
-          "but uc_get_rate_by_name returned %" PRIsz ".",
-          ds->type, ds->ds_num, ret_num);
+  if (uc_get_rate_r(ds, vl, ret) != 0) {
     sfree(ret);
     return NULL;
   }
@@ -516,34 +756,27 @@ int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
   value_t *ret = NULL;
   size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
   int status = 0;
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
-
-    /* remove missing values from getval */
-    if (ce->state == STATE_MISSING) {
+  cache_entry_t *ce = uc_find_entry(name);
+  if (ce != NULL) {
+    ret_num = ce->values_num;
+    ret = malloc(ret_num * sizeof(*ret));
+    if (ret == NULL) {
+      ERROR("utils_cache: uc_get_value_by_name: malloc failed.");
+      status = -1;
+    } else if (uc_read_values(ce, /* ret_rates = */ NULL, ret) ==
+               STATE_MISSING) {
+      /* remove missing values from getval */
+      sfree(ret);
       status = -1;
-    } else {
-      ret_num = ce->values_num;
-      ret = malloc(ret_num * sizeof(*ret));
-      if (ret == NULL) {
-        ERROR("utils_cache: uc_get_value_by_name: malloc failed.");
-        status = -1;
-      } else {
-        memcpy(ret, ce->values_raw, ret_num * sizeof(value_t));
-      }
     }
+    pthread_rwlock_unlock(&cache_lock);
   } else {
     DEBUG("utils_cache: uc_get_value_by_name: No such value: %s", name);
     status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   if (status == 0) {
     *ret_values = ret;
     *ret_values_num = ret_num;
@@ -583,9 +816,9 @@ value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
 size_t uc_get_size(void) {
   size_t size_arrays = 0;
 
-  pthread_mutex_lock(&cache_lock);
+  pthread_rwlock_rdlock(&cache_lock);
   size_arrays = (size_t)c_avl_size(cache_tree);
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   return size_arrays;
 }
@@ -605,13 +838,13 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   if ((ret_names == NULL) || (ret_number == NULL))
     return -1;
 
-  pthread_mutex_lock(&cache_lock);
+  pthread_rwlock_rdlock(&cache_lock);
 
   size_arrays = (size_t)c_avl_size(cache_tree);
   if (size_arrays < 1) {
     /* Handle the "no values" case here, to avoid the error message when
      * calloc() returns NULL. */
-    pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&cache_lock);
     return 0;
   }
 
@@ -621,14 +854,19 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
     ERROR("uc_get_names: calloc failed.");
     sfree(names);
     sfree(times);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_rwlock_unlock(&cache_lock);
     return ENOMEM;
   }
 
   iter = c_avl_get_iterator(cache_tree);
   while (c_avl_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
+    pthread_mutex_lock(&value->lock);
+    int state = value->state;
+    cdtime_t last_time = value->last_time;
+    pthread_mutex_unlock(&value->lock);
+
     /* remove missing values when list values */
-    if (value->state == STATE_MISSING)
+    if (state == STATE_MISSING)
       continue;
 
     /* c_avl_size does not return a number smaller than the number of elements
@@ -636,7 +874,7 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
     assert(number < size_arrays);
 
     if (ret_times != NULL)
-      times[number] = value->last_time;
+      times[number] = last_time;
 
     names[number] = strdup(key);
     if (names[number] == NULL) {
@@ -648,7 +886,7 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   } /* while (c_avl_iterator_next) */
 
   c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   if (status != 0) {
     for (size_t i = 0; i < number; i++) {
@@ -672,7 +910,6 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
 
 int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int ret = STATE_ERROR;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
@@ -680,21 +917,17 @@ int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce != NULL) {
     ret = ce->state;
+    uc_unlock_entry(ce);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_get_state */
 
 int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int ret = -1;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
@@ -702,34 +935,26 @@ int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce != NULL) {
     ret = ce->state;
-    ce->state = state;
+    uc_write_begin(ce);
+    __atomic_store_n(&ce->state, state, __ATOMIC_RELAXED);
+    uc_write_end(ce);
+    uc_unlock_entry(ce);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_set_state */
 
 int uc_get_history_by_name(const char *name, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds) {
-  cache_entry_t *ce = NULL;
-  int status = 0;
-
-  pthread_mutex_lock(&cache_lock);
-
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce == NULL)
     return -ENOENT;
-  }
 
   if (((size_t)ce->values_num) != num_ds) {
-    pthread_mutex_unlock(&cache_lock);
+    uc_unlock_entry(ce);
     return -EINVAL;
   }
 
@@ -741,7 +966,7 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
     tmp =
         realloc(ce->history, sizeof(*ce->history) * num_steps * ce->values_num);
     if (tmp == NULL) {
-      pthread_mutex_unlock(&cache_lock);
+      uc_unlock_entry(ce);
       return -ENOMEM;
     }
 
@@ -770,7 +995,7 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
            sizeof(*ret_history) * num_ds);
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  uc_unlock_entry(ce);
 
   return 0;
 } /* int uc_get_history_by_name */
@@ -789,7 +1014,6 @@ int uc_get_history(const data_set_t *ds, const value_list_t *vl,
 
 int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int ret = STATE_ERROR;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
@@ -797,21 +1021,17 @@ int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce != NULL) {
     ret = ce->hits;
+    uc_unlock_entry(ce);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_get_hits */
 
 int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int ret = -1;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
@@ -819,22 +1039,18 @@ int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = hits;
+    uc_unlock_entry(ce);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_set_hits */
 
 int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int ret = -1;
 
   if (FORMAT_VL(name, sizeof(name), vl) != 0) {
@@ -842,16 +1058,13 @@ int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
     return STATE_ERROR;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = ret + step;
+    uc_unlock_entry(ce);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return ret;
 } /* int uc_inc_hits */
 
@@ -863,10 +1076,13 @@ uc_iter_t *uc_get_iterator(void) {
   if (iter == NULL)
     return NULL;
 
-  pthread_mutex_lock(&cache_lock);
+  /* Held for reading until uc_iterator_destroy(), so that entries are not
+   * removed while the iterator points to them. */
+  pthread_rwlock_rdlock(&cache_lock);
 
   iter->iter = c_avl_get_iterator(cache_tree);
   if (iter->iter == NULL) {
+    pthread_rwlock_unlock(&cache_lock);
     free(iter);
     return NULL;
   }
@@ -882,7 +1098,11 @@ int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
 
   while ((status = c_avl_iterator_next(iter->iter, (void *)&iter->name,
                                        (void *)&iter->entry)) == 0) {
-    if (iter->entry->state == STATE_MISSING)
+    pthread_mutex_lock(&iter->entry->lock);
+    int state = iter->entry->state;
+    pthread_mutex_unlock(&iter->entry->lock);
+
+    if (state == STATE_MISSING)
       continue;
 
     break;
@@ -904,7 +1124,7 @@ void uc_iterator_destroy(uc_iter_t *iter) {
     return;
 
   c_avl_iterator_destroy(iter->iter);
-  pthread_mutex_unlock(&cache_lock);
+  pthread_rwlock_unlock(&cache_lock);
 
   free(iter);
 } /* void uc_iterator_destroy */
@@ -913,7 +1133,9 @@ int uc_iterator_get_time(uc_iter_t *iter, cdtime_t *ret_time) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_time == NULL))
     return -1;
 
+  pthread_mutex_lock(&iter->entry->lock);
   *ret_time = iter->entry->last_time;
+  pthread_mutex_unlock(&iter->entry->lock);
   return 0;
 } /* int uc_iterator_get_name */
 
@@ -926,8 +1148,10 @@ int uc_iterator_get_values(uc_iter_t *iter, value_t **ret_values,
       calloc(iter->entry->values_num, sizeof(*iter->entry->values_raw));
   if (*ret_values == NULL)
     return -1;
+  pthread_mutex_lock(&iter->entry->lock);
   for (size_t i = 0; i < iter->entry->values_num; ++i)
     (*ret_values)[i] = iter->entry->values_raw[i];
+  pthread_mutex_unlock(&iter->entry->lock);
 
   *ret_num = iter->entry->values_num;
 
@@ -938,7 +1162,9 @@ int uc_iterator_get_interval(uc_iter_t *iter, cdtime_t *ret_interval) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_interval == NULL))
     return -1;
 
+  pthread_mutex_lock(&iter->entry->lock);
   *ret_interval = iter->entry->interval;
+  pthread_mutex_unlock(&iter->entry->lock);
   return 0;
 } /* int uc_iterator_get_name */
 
@@ -946,19 +1172,253 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
   if ((iter == NULL) || (iter->entry == NULL) || (ret_meta == NULL))
     return -1;
 
+  pthread_mutex_lock(&iter->entry->lock);
   *ret_meta = meta_data_clone(iter->entry->meta);
+  pthread_mutex_unlock(&iter->entry->lock);
 
   return 0;
 } /* int uc_iterator_get_meta */
 
+/*
+ * Snapshot interface
+ */
+static void uc_snapshot_free(uc_snapshot_t *snap) {
+  if (snap == NULL)
+    return;
+
+  sfree(snap->entries);
+  sfree(snap->names);
+  sfree(snap->values);
+  sfree(snap);
+} /* void uc_snapshot_free */
+
+static int uc_snapshot_grow(void **array, size_t *size, size_t need,
+                            size_t elem_size) {
+  if (need <= *size)
+    return 0;
+
+  size_t new_size = (*size == 0) ? 1024 : *size;
+  while (new_size < need)
+    new_size *= 2;
+
+  void *tmp = realloc(*array, new_size * elem_size);
+  if (tmp == NULL)
+    return ENOMEM;
+
+  *array = tmp;
+  *size = new_size;
+  return 0;
+} /* int uc_snapshot_grow */
+
+/* `cache_lock' and the entry's lock have been locked by the caller. */
+static int uc_snapshot_append(uc_snapshot_t *snap, char const *name,
+                              cache_entry_t const *ce) {
+  size_t name_size = strlen(name) + 1;
+
+  if ((uc_snapshot_grow((void *)&snap->entries, &snap->entries_size,
+                        snap->entries_num + 1, sizeof(*snap->entries)) != 0) ||
+      (uc_snapshot_grow((void *)&snap->names, &snap->names_size,
+                        snap->names_len + name_size, 1) != 0) ||
+      (uc_snapshot_grow((void *)&snap->values, &snap->values_size,
+                        snap->values_len + ce->values_num,
+                        sizeof(*snap->values)) != 0))
+    return ENOMEM;
+
+  uc_snapshot_entry_t *e = snap->entries + snap->entries_num;
+  e->name_offset = snap->names_len;
+  e->values_offset = snap->values_len;
+  e->values_num = ce->values_num;
+  e->last_time = ce->last_time;
+
+  memcpy(snap->names + snap->names_len, name, name_size);
+  memcpy(snap->values + snap->values_len, ce->values_gauge,
+         ce->values_num * sizeof(*snap->values));
+
+  snap->entries_num++;
+  snap->names_len += name_size;
+  snap->values_len += ce->values_num;
+  return 0;
+} /* int uc_snapshot_append */
+
+/* Copies the cache UC_SNAPSHOT_CHUNK entries at a time, releasing the lock in
+ * between. The entries are not copied at the same instant, but each of them
+ * is consistent and the result is sorted. */
+static uc_snapshot_t *uc_snapshot_create(void) {
+  uc_snapshot_t *snap = calloc(1, sizeof(*snap));
+  if (snap == NULL)
+    return NULL;
+  snap->time = cdtime();
+
+  char last[sizeof(((cache_entry_t *)0)->name)] = "";
+  bool first = true;
+  bool done = false;
+  int status = 0;
+
+  while (!done && (status == 0)) {
+    /* Make room for the next chunk before taking the lock, so that memory is
+     * usually not reallocated (and copied) while uc_update() has to wait. */
+    if ((uc_snapshot_grow((void *)&snap->entries, &snap->entries_size,
+                          snap->entries_num + UC_SNAPSHOT_CHUNK,
+                          sizeof(*snap->entries)) != 0) ||
+        (uc_snapshot_grow((void *)&snap->names, &snap->names_size,
+                          snap->names_len + UC_SNAPSHOT_CHUNK * sizeof(last),
+                          1) != 0) ||
+        (uc_snapshot_grow((void *)&snap->values, &snap->values_size,
+                          snap->values_len + 4 * UC_SNAPSHOT_CHUNK,
+                          sizeof(*snap->values)) != 0)) {
+      status = ENOMEM;
+      break;
+    }
+
+    pthread_rwlock_rdlock(&cache_lock);
+
+    c_avl_iterator_t *iter = first
+                                 ? c_avl_get_iterator(cache_tree)
+                                 : c_avl_get_iterator_after(cache_tree, last);
+    if (iter == NULL) {
+      pthread_rwlock_unlock(&cache_lock);
+      status = ENOMEM;
+      break;
+    }
+    first = false;
+
+    char *key = NULL;
+    cache_entry_t *ce = NULL;
+    size_t n = 0;
+    done = true;
+    while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
+      pthread_mutex_lock(&ce->lock);
+      if (ce->state != STATE_MISSING)
+        status = uc_snapshot_append(snap, key, ce);
+      pthread_mutex_unlock(&ce->lock);
+      if (status != 0)
+        break;
+
+      if (++n >= UC_SNAPSHOT_CHUNK) {
+        sstrncpy(last, key, sizeof(last));
+        done = false;
+        break;
+      }
+    }
+
+    c_avl_iterator_destroy(iter);
+    pthread_rwlock_unlock(&cache_lock);
+  }
+
+  if (status != 0) {
+    ERROR("uc_snapshot_create: Out of memory after %" PRIsz " entries.",
+          snap->entries_num);
+    uc_snapshot_free(snap);
+    return NULL;
+  }
+
+  return snap;
+} /* uc_snapshot_t *uc_snapshot_create */
+
+static uc_snapshot_t *uc_snapshot_get_current(cdtime_t max_age) {
+  uc_snapshot_t *snap = NULL;
+
+  pthread_mutex_lock(&snapshot_lock);
+  if ((snapshot_current != NULL) &&
+      ((cdtime() - snapshot_current->time) <= max_age)) {
+    snap = snapshot_current;
+    snap->refs++;
+  }
+  pthread_mutex_unlock(&snapshot_lock);
+
+  return snap;
+} /* uc_snapshot_t *uc_snapshot_get_current */
+
+uc_snapshot_t *uc_snapshot_get(cdtime_t max_age) {
+  uc_snapshot_t *snap = uc_snapshot_get_current(max_age);
+  if (snap != NULL)
+    return snap;
+
+  pthread_mutex_lock(&snapshot_create_lock);
+
+  /* Another thread may have taken a snapshot while we were waiting. */
+  snap = uc_snapshot_get_current(max_age);
+  if (snap == NULL) {
+    snap = uc_snapshot_create();
+    if (snap != NULL) {
+      pthread_mutex_lock(&snapshot_lock);
+      uc_snapshot_t *old = snapshot_current;
+      snap->epoch = ++snapshot_epoch;
+      snap->refs = 2; /* snapshot_current and the caller */
+      snapshot_current = snap;
+      pthread_mutex_unlock(&snapshot_lock);
+
+      uc_snapshot_release(old);
+    }
+  }
+
+  pthread_mutex_unlock(&snapshot_create_lock);
+  return snap;
+} /* uc_snapshot_t *uc_snapshot_get */
+
+void uc_snapshot_release(uc_snapshot_t *snap) {
+  if (snap == NULL)
+    return;
+
+  pthread_mutex_lock(&snapshot_lock);
+  assert(snap->refs > 0);
+  bool last = (--snap->refs == 0);
+  pthread_mutex_unlock(&snapshot_lock);
+
+  if (last)
+    uc_snapshot_free(snap);
+} /* void uc_snapshot_release */
+
+uint64_t uc_snapshot_epoch(uc_snapshot_t const *snap) {
+  return (snap != NULL) ? snap->epoch : 0;
+} /* uint64_t uc_snapshot_epoch */
+
+size_t uc_snapshot_size(uc_snapshot_t const *snap) {
+  return (snap != NULL) ? snap->entries_num : 0;
+} /* size_t uc_snapshot_size */
+
+size_t uc_snapshot_find_after(uc_snapshot_t const *snap, char const *name) {
+  size_t lo = 0;
+  size_t hi = uc_snapshot_size(snap);
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (strcmp(snap->names + snap->entries[mid].name_offset, name) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+} /* size_t uc_snapshot_find_after */
+
+int uc_snapshot_entry(uc_snapshot_t const *snap, size_t index,
+                      char const **ret_name, cdtime_t *ret_time,
+                      gauge_t const **ret_values, size_t *ret_values_num) {
+  if ((snap == NULL) || (index >= snap->entries_num))
+    return -1;
+
+  uc_snapshot_entry_t const *e = snap->entries + index;
+  if (ret_name != NULL)
+    *ret_name = snap->names + e->name_offset;
+  if (ret_time != NULL)
+    *ret_time = e->last_time;
+  if (ret_values != NULL)
+    *ret_values = snap->values + e->values_offset;
+  if (ret_values_num != NULL)
+    *ret_values_num = e->values_num;
+
+  return 0;
+} /* int uc_snapshot_entry */
+
 /*
  * Meta data interface
  */
-/* XXX: This function will acquire `cache_lock' but will not free it! */
+/* XXX: This function will acquire `cache_lock' for reading but will not free
+ * it! The meta data has a lock of its own. */
 static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
 {
   char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
   int status;
 
   status = FORMAT_VL(name, sizeof(name), vl);
@@ -967,22 +1427,20 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
     return NULL;
   }
 
-  pthread_mutex_lock(&cache_lock);
-
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  cache_entry_t *ce = uc_lock_entry(name);
+  if (ce == NULL)
     return NULL;
-  }
-  assert(ce != NULL);
 
   if (ce->meta == NULL)
     ce->meta = meta_data_create();
 
-  if (ce->meta == NULL)
-    pthread_mutex_unlock(&cache_lock);
+  meta_data_t *meta = ce->meta;
+  pthread_mutex_unlock(&ce->lock);
+
+  if (meta == NULL)
+    pthread_rwlock_unlock(&cache_lock);
 
-  return ce->meta;
+  return meta;
 } /* }}} meta_data_t *uc_get_meta */
 
 /* Sorry about this preprocessor magic, but it really makes this file much
@@ -995,7 +1453,7 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key);                                         \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_rwlock_unlock(&cache_lock);                                        \
     return status;                                                             \
   }
 int uc_meta_data_exists(const value_list_t *vl, const char *key)
@@ -1021,7 +1479,7 @@ int uc_meta_data_exists(const value_list_t *vl, const char *key)
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key, value);                                  \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_rwlock_unlock(&cache_lock);                                        \
     return status;                                                             \
   }
         int uc_meta_data_add_string(const value_list_t *vl, const char *key,
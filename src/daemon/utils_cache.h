@@ -43,6 +43,10 @@ int uc_update(const data_set_t *ds, const value_list_t *vl);
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num);
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl);
+/* Like uc_get_rate(), but copies the rates into "ret_rates", which must have
+ * room for "ds->ds_num" values, instead of allocating memory. */
+int uc_get_rate_r(const data_set_t *ds, const value_list_t *vl,
+                  gauge_t *ret_rates);
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num);
 value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl);
@@ -113,6 +117,43 @@ int uc_iterator_get_interval(uc_iter_t *iter, cdtime_t *ret_interval);
 /* Return the metadata for the value at the current position. */
 int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta);
 
+/*
+ * Snapshot interface
+ */
+struct uc_snapshot_s;
+typedef struct uc_snapshot_s uc_snapshot_t;
+
+/* Snapshots older than this are not kept around. */
+#define UC_SNAPSHOT_MAX_AGE TIME_T_TO_CDTIME_T(60)
+
+/*
+ * NAME
+ *   uc_snapshot_get
+ *
+ * DESCRIPTION
+ *   Returns a read-only copy of the names, times and rates in the cache,
+ *   sorted by name. If the latest snapshot is at most `max_age' old, it is
+ *   shared. Otherwise a new snapshot with a higher epoch is taken. The cache
+ *   is copied in small steps, so that uc_update() is only ever blocked
+ *   briefly, and reading a snapshot doesn't need the cache lock at all.
+ *
+ * RETURN VALUE
+ *   A snapshot which has to be released with uc_snapshot_release() or NULL
+ *   on error.
+ */
+uc_snapshot_t *uc_snapshot_get(cdtime_t max_age);
+void uc_snapshot_release(uc_snapshot_t *snap);
+
+uint64_t uc_snapshot_epoch(uc_snapshot_t const *snap);
+size_t uc_snapshot_size(uc_snapshot_t const *snap);
+/* Returns the index of the first entry whose name is greater than `name'. */
+size_t uc_snapshot_find_after(uc_snapshot_t const *snap, char const *name);
+/* Returns the entry at `index'. The pointers stay valid until the snapshot is
+ * released. */
+int uc_snapshot_entry(uc_snapshot_t const *snap, size_t index,
+                      char const **ret_name, cdtime_t *ret_time,
+                      gauge_t const **ret_values, size_t *ret_values_num);
+
 /*
  * Meta data interface
  */
@@ -35,6 +35,12 @@ gauge_t *uc_get_rate(__attribute__((unused)) data_set_t const *ds,
   return NULL;
 }
 
+int uc_get_rate_r(__attribute__((unused)) data_set_t const *ds,
+                  __attribute__((unused)) value_list_t const *vl,
+                  __attribute__((unused)) gauge_t *ret_rates) {
+  return ENOTSUP;
+}
+
 int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
                         size_t *ret_values_num) {
   return ENOTSUP;
@@ -68,3 +74,32 @@ int uc_meta_data_add_unsigned_int(const value_list_t *vl, const char *key,
                                   uint64_t value) {
   return 0;
 }
+
+uc_snapshot_t *uc_snapshot_get(__attribute__((unused)) cdtime_t max_age) {
+  errno = ENOTSUP;
+  return NULL;
+}
+
+void uc_snapshot_release(__attribute__((unused)) uc_snapshot_t *snap) {}
+
+uint64_t uc_snapshot_epoch(__attribute__((unused)) uc_snapshot_t const *snap) {
+  return 0;
+}
+
+size_t uc_snapshot_size(__attribute__((unused)) uc_snapshot_t const *snap) {
+  return 0;
+}
+
+size_t uc_snapshot_find_after(__attribute__((unused)) uc_snapshot_t const *snap,
+                              __attribute__((unused)) char const *name) {
+  return 0;
+}
+
+int uc_snapshot_entry(__attribute__((unused)) uc_snapshot_t const *snap,
+                      __attribute__((unused)) size_t index,
+                      __attribute__((unused)) char const **ret_name,
+                      __attribute__((unused)) cdtime_t *ret_time,
+                      __attribute__((unused)) gauge_t const **ret_values,
+                      __attribute__((unused)) size_t *ret_values_num) {
+  return -1;
+}
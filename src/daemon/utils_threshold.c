@@ -39,6 +39,216 @@ c_avl_tree_t *threshold_tree = NULL;
 pthread_mutex_t threshold_lock = PTHREAD_MUTEX_INITIALIZER;
 /* }}} */
 
+/*
+ * Threshold index
+ * {{{
+ * Thresholds are indexed by type, plugin, host, plugin instance and type
+ * instance, in this order. Each level is a small hash table and the empty
+ * string is the wildcard, so a lookup is a handful of probes and does not need
+ * to format identifiers.
+ */
+typedef struct threshold_node_s threshold_node_t;
+struct threshold_node_s {
+  char *key;
+  uint32_t hash;
+  threshold_node_t *next;
+
+  threshold_node_t **children;
+  size_t children_size;
+  size_t children_num;
+
+  /* Only set in type instance nodes. */
+  threshold_t *threshold;
+};
+
+static threshold_node_t threshold_index;
+
+static uint32_t threshold_hash(const char *key) {
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+
+  for (; *key != 0; key++)
+    hash = (hash ^ (uint8_t)*key) * 16777619u;
+  return hash;
+}
+
+static threshold_node_t *threshold_node_find(const threshold_node_t *parent,
+                                             const char *key) {
+  if ((parent == NULL) || (parent->children_num == 0))
+    return NULL;
+  if (key == NULL)
+    key = "";
+
+  uint32_t hash = threshold_hash(key);
+  for (threshold_node_t *n =
+           parent->children[hash & (parent->children_size - 1)];
+       n != NULL; n = n->next)
+    if ((n->hash == hash) && (strcmp(n->key, key) == 0))
+      return n;
+
+  return NULL;
+}
+
+static int threshold_node_grow(threshold_node_t *parent) {
+  size_t size = (parent->children_size == 0) ? 4 : 2 * parent->children_size;
+  threshold_node_t **children = calloc(size, sizeof(*children));
+  if (children == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < parent->children_size; i++) {
+    threshold_node_t *n = parent->children[i];
+    while (n != NULL) {
+      threshold_node_t *next = n->next;
+      size_t bucket = n->hash & (size - 1);
+
+      n->next = children[bucket];
+      children[bucket] = n;
+      n = next;
+    }
+  }
+
+  free(parent->children);
+  parent->children = children;
+  parent->children_size = size;
+  return 0;
+}
+
+static threshold_node_t *threshold_node_get(threshold_node_t *parent,
+                                            const char *key) {
+  threshold_node_t *n = threshold_node_find(parent, key);
+  if (n != NULL)
+    return n;
+  if (key == NULL)
+    key = "";
+
+  if ((parent->children_num >= parent->children_size) &&
+      (threshold_node_grow(parent) != 0))
+    return NULL;
+
+  n = calloc(1, sizeof(*n));
+  if (n == NULL)
+    return NULL;
+  n->key = strdup(key);
+  if (n->key == NULL) {
+    free(n);
+    return NULL;
+  }
+  n->hash = threshold_hash(key);
+
+  size_t bucket = n->hash & (parent->children_size - 1);
+  n->next = parent->children[bucket];
+  parent->children[bucket] = n;
+  parent->children_num++;
+  return n;
+}
+
+/* Frees the children of "n" and its key, but not "n" itself. */
+static void threshold_node_free(threshold_node_t *n) {
+  for (size_t i = 0; i < n->children_size; i++) {
+    threshold_node_t *child = n->children[i];
+    while (child != NULL) {
+      threshold_node_t *next = child->next;
+
+      threshold_node_free(child);
+      free(child);
+      child = next;
+    }
+  }
+
+  free(n->children);
+  free(n->key);
+}
+
+/* Looks up the most specific threshold below a host node: the plugin
+ * instance is more significant than the type instance. */
+static threshold_t *threshold_search_instances(const threshold_node_t *host,
+                                               const char *plugin_instance,
+                                               const char *type_instance) {
+  const char *plugin_instances[] = {plugin_instance, ""};
+  const char *type_instances[] = {type_instance, ""};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(plugin_instances); i++) {
+    if ((i > 0) && (plugin_instance[0] == 0))
+      break;
+
+    threshold_node_t *pi = threshold_node_find(host, plugin_instances[i]);
+    if (pi == NULL)
+      continue;
+
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(type_instances); j++) {
+      if ((j > 0) && (type_instance[0] == 0))
+        break;
+
+      threshold_node_t *ti = threshold_node_find(pi, type_instances[j]);
+      if ((ti != NULL) && (ti->threshold != NULL))
+        return ti->threshold;
+    }
+  }
+
+  return NULL;
+}
+/* }}} */
+
+/*
+ * int threshold_compare
+ *
+ * Orders thresholds by type, plugin, host, plugin instance and type instance,
+ * the keys of the threshold index. This is the comparison function of
+ * "threshold_tree", which uses the first threshold of each list as key, so
+ * that the tree and the index agree on which thresholds are the same.
+ */
+int threshold_compare(const void *a, const void *b) { /* {{{ */
+  const threshold_t *th_a = a;
+  const threshold_t *th_b = b;
+  int status;
+
+  if ((status = strcmp(th_a->type, th_b->type)) != 0)
+    return status;
+  if ((status = strcmp(th_a->plugin, th_b->plugin)) != 0)
+    return status;
+  if ((status = strcmp(th_a->host, th_b->host)) != 0)
+    return status;
+  if ((status = strcmp(th_a->plugin_instance, th_b->plugin_instance)) != 0)
+    return status;
+  return strcmp(th_a->type_instance, th_b->type_instance);
+} /* }}} int threshold_compare */
+
+/*
+ * int threshold_index_add
+ *
+ * Adds a list of thresholds for one identifier to the index used by
+ * "threshold_get" and "threshold_search". The caller must hold
+ * "threshold_lock". Returns EEXIST if the identifier is already indexed.
+ */
+int threshold_index_add(threshold_t *th) { /* {{{ */
+  const char *keys[] = {th->type, th->plugin, th->host, th->plugin_instance,
+                        th->type_instance};
+  threshold_node_t *n = &threshold_index;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(keys); i++) {
+    n = threshold_node_get(n, keys[i]);
+    if (n == NULL)
+      return ENOMEM;
+  }
+
+  if (n->threshold != NULL)
+    return EEXIST;
+
+  n->threshold = th;
+  return 0;
+} /* }}} int threshold_index_add */
+
+/*
+ * void threshold_index_free
+ *
+ * Removes all thresholds from the index. The thresholds themselves are owned
+ * by the caller and are not freed. The caller must hold "threshold_lock".
+ */
+void threshold_index_free(void) { /* {{{ */
+  threshold_node_free(&threshold_index);
+  memset(&threshold_index, 0, sizeof(threshold_index));
+} /* }}} void threshold_index_free */
+
 /*
  * threshold_t *threshold_get
  *
@@ -49,18 +259,14 @@ pthread_mutex_t threshold_lock = PTHREAD_MUTEX_INITIALIZER;
 threshold_t *threshold_get(const char *hostname, const char *plugin,
                            const char *plugin_instance, const char *type,
                            const char *type_instance) { /* {{{ */
-  char name[6 * DATA_MAX_NAME_LEN];
-  threshold_t *th = NULL;
+  const char *keys[] = {type, plugin, hostname, plugin_instance,
+                        type_instance};
+  threshold_node_t *n = &threshold_index;
 
-  format_name(name, sizeof(name), (hostname == NULL) ? "" : hostname,
-              (plugin == NULL) ? "" : plugin, plugin_instance,
-              (type == NULL) ? "" : type, type_instance);
-  name[sizeof(name) - 1] = '\0';
+  for (size_t i = 0; (i < STATIC_ARRAY_SIZE(keys)) && (n != NULL); i++)
+    n = threshold_node_find(n, keys[i]);
 
-  if (c_avl_get(threshold_tree, name, (void *)&th) == 0)
-    return th;
-  else
-    return NULL;
+  return (n != NULL) ? n->threshold : NULL;
 } /* }}} threshold_t *threshold_get */
 
 /*
@@ -68,45 +274,31 @@ threshold_t *threshold_get(const char *hostname, const char *plugin,
  *
  * Searches for a threshold configuration using all the possible variations of
  * "Host", "Plugin" and "Type" blocks. Returns NULL if no threshold could be
- * found.
- * XXX: This is likely the least efficient function in collectd.
+ * found. A specific host takes precedence over a specific plugin, which takes
+ * precedence over specific instances.
  */
 threshold_t *threshold_search(const value_list_t *vl) { /* {{{ */
-  threshold_t *th;
-
-  if ((th = threshold_get(vl->host, vl->plugin, vl->plugin_instance, vl->type,
-                          vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, vl->plugin_instance,
-                               vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, vl->plugin, NULL, vl->type, NULL)) !=
-           NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, "", NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get(vl->host, "", NULL, vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, vl->plugin_instance, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, vl->plugin_instance, vl->type,
-                               NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, NULL, vl->type,
-                               vl->type_instance)) != NULL)
-    return th;
-  else if ((th = threshold_get("", vl->plugin, NULL, vl->type, NULL)) != NULL)
-    return th;
-  else if ((th = threshold_get("", "", NULL, vl->type, vl->type_instance)) !=
-           NULL)
-    return th;
-  else if ((th = threshold_get("", "", NULL, vl->type, NULL)) != NULL)
-    return th;
+  threshold_node_t *type = threshold_node_find(&threshold_index, vl->type);
+  if (type == NULL)
+    return NULL;
+
+  threshold_node_t *plugins[] = {threshold_node_find(type, vl->plugin),
+                                 threshold_node_find(type, "")};
+  const char *hosts[] = {vl->host, ""};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(hosts); i++) {
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(plugins); j++) {
+      threshold_node_t *host = threshold_node_find(plugins[j], hosts[i]);
+      if (host == NULL)
+        continue;
+
+      /* Thresholds without a plugin can't have a plugin instance. */
+      threshold_t *th = threshold_search_instances(
+          host, (j == 0) ? vl->plugin_instance : "", vl->type_instance);
+      if (th != NULL)
+        return th;
+    }
+  }
 
   return NULL;
 } /* }}} threshold_t *threshold_search */
@@ -52,6 +52,12 @@ typedef struct threshold_s {
 extern c_avl_tree_t *threshold_tree;
 extern pthread_mutex_t threshold_lock;
 
+int threshold_compare(const void *a, const void *b);
+
+int threshold_index_add(threshold_t *th);
+
+void threshold_index_free(void);
+
 threshold_t *threshold_get(const char *hostname, const char *plugin,
                            const char *plugin_instance, const char *type,
                            const char *type_instance);
@@ -0,0 +1,141 @@
+/**
+ * collectd - src/daemon/utils_threshold_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/avltree/avltree.h"
+#include "utils_threshold.h"
+
+/* host, plugin, plugin instance, type, type instance */
+static threshold_t thresholds[] = {
+    {"h", "p", "pi", "t", "ti"}, {"h", "p", "pi", "t", ""},
+    {"h", "p", "", "t", "ti"},   {"h", "p", "", "t", ""},
+    {"h", "", "", "t", "ti"},    {"h", "", "", "t", ""},
+    {"", "p", "pi", "t", "ti"},  {"", "p", "pi", "t", ""},
+    {"", "p", "", "t", "ti"},    {"", "p", "", "t", ""},
+    {"", "", "", "t", "ti"},     {"", "", "", "t", ""},
+};
+
+DEF_TEST(precedence) {
+  struct {
+    value_list_t vl;
+    int want;
+  } cases[] = {
+      {{.host = "h", .plugin = "p", .plugin_instance = "pi", .type = "t",
+        .type_instance = "ti"},
+       0},
+      {{.host = "h", .plugin = "p", .plugin_instance = "pi", .type = "t",
+        .type_instance = "x"},
+       1},
+      {{.host = "h", .plugin = "p", .plugin_instance = "x", .type = "t",
+        .type_instance = "ti"},
+       2},
+      {{.host = "h", .plugin = "p", .type = "t"}, 3},
+      {{.host = "h", .plugin = "x", .plugin_instance = "pi", .type = "t",
+        .type_instance = "ti"},
+       4},
+      {{.host = "h", .plugin = "x", .plugin_instance = "pi", .type = "t",
+        .type_instance = "x"},
+       5},
+      {{.host = "x", .plugin = "p", .plugin_instance = "pi", .type = "t",
+        .type_instance = "ti"},
+       6},
+      {{.host = "x", .plugin = "p", .plugin_instance = "pi", .type = "t"}, 7},
+      {{.host = "x", .plugin = "p", .plugin_instance = "x", .type = "t",
+        .type_instance = "ti"},
+       8},
+      {{.host = "x", .plugin = "p", .plugin_instance = "x", .type = "t",
+        .type_instance = "x"},
+       9},
+      {{.host = "x", .plugin = "x", .type = "t", .type_instance = "ti"}, 10},
+      {{.host = "x", .plugin = "x", .type = "t", .type_instance = "x"}, 11},
+      {{.host = "h", .plugin = "p", .plugin_instance = "pi", .type = "x",
+        .type_instance = "ti"},
+       -1},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(thresholds); i++) {
+    threshold_t *th = thresholds + i;
+
+    OK(threshold_get(th->host, th->plugin, th->plugin_instance, th->type,
+                     th->type_instance) == NULL);
+    CHECK_ZERO(threshold_index_add(th));
+    OK(threshold_get(th->host, th->plugin, th->plugin_instance, th->type,
+                     th->type_instance) == th);
+  }
+  EXPECT_EQ_INT(EEXIST, threshold_index_add(thresholds + 3));
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    threshold_t *want =
+        (cases[i].want < 0) ? NULL : thresholds + cases[i].want;
+
+    printf("## case %zu\n", i);
+    OK(threshold_search(&cases[i].vl) == want);
+  }
+
+  return 0;
+}
+
+/* These two have the same name, "h/a-b/t", but are different thresholds. */
+static threshold_t ambiguous[] = {
+    {"h", "a-b", "", "t", ""},
+    {"h", "a", "b", "t", ""},
+};
+
+DEF_TEST(free_and_ambiguous_names) {
+  threshold_index_free();
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(thresholds); i++) {
+    threshold_t *th = thresholds + i;
+    OK(threshold_get(th->host, th->plugin, th->plugin_instance, th->type,
+                     th->type_instance) == NULL);
+  }
+
+  OK(threshold_compare(ambiguous + 0, ambiguous + 1) != 0);
+  EXPECT_EQ_INT(0, threshold_compare(ambiguous + 0, ambiguous + 0));
+
+  c_avl_tree_t *tree = c_avl_create(threshold_compare);
+  CHECK_NOT_NULL(tree);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(ambiguous); i++) {
+    threshold_t *th = ambiguous + i;
+
+    CHECK_ZERO(c_avl_insert(tree, th, th));
+    CHECK_ZERO(threshold_index_add(th));
+  }
+  EXPECT_EQ_INT(1, c_avl_insert(tree, ambiguous + 0, ambiguous + 0));
+
+  OK(threshold_get("h", "a-b", "", "t", "") == ambiguous + 0);
+  OK(threshold_get("h", "a", "b", "t", "") == ambiguous + 1);
+
+  c_avl_destroy(tree);
+  threshold_index_free();
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(precedence);
+  RUN_TEST(free_and_ambiguous_names);
+
+  END_TEST;
+}
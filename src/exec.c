@@ -554,10 +554,10 @@ failed:
   return -1;
 } /* int fork_child }}} */
 
-static int parse_line(char *buffer) /* {{{ */
+static int parse_line(char *buffer, cmd_putval_cache_t *putval_cache) /* {{{ */
 {
   if (strncasecmp("PUTVAL", buffer, strlen("PUTVAL")) == 0)
-    return cmd_handle_putval(stdout, buffer);
+    return cmd_handle_putval_cached(stdout, buffer, putval_cache);
   else if (strncasecmp("PUTNOTIF", buffer, strlen("PUTNOTIF")) == 0)
     return handle_putnotif(stdout, buffer);
   else {
@@ -577,6 +577,8 @@ static void *exec_read_one(void *arg) /* {{{ */
   char buffer_err[1024];
   char *pbuffer = buffer;
   char *pbuffer_err = buffer_err;
+  /* Long running programs usually send the same identifiers over and over. */
+  cmd_putval_cache_t *putval_cache;
 
   status = fork_child(pl, NULL, &fd, &fd_err);
   if (status < 0) {
@@ -590,6 +592,8 @@ static void *exec_read_one(void *arg) /* {{{ */
 
   assert(pl->pid != 0);
 
+  putval_cache = cmd_putval_cache_create();
+
   fds[0].fd = fd;
   fds[0].events = POLLIN;
   fds[1].fd = fd_err;
@@ -627,7 +631,7 @@ static void *exec_read_one(void *arg) /* {{{ */
         if (*(pnl - 1) == '\r')
           *(pnl - 1) = '\0';
 
-        parse_line(pbuffer);
+        parse_line(pbuffer, putval_cache);
 
         pbuffer = ++pnl;
       }
@@ -713,6 +717,7 @@ static void *exec_read_one(void *arg) /* {{{ */
   if (fd_err >= 0)
     close(fd_err);
 
+  cmd_putval_cache_destroy(putval_cache);
   pthread_exit((void *)0);
   return NULL;
 } /* void *exec_read_one }}} */
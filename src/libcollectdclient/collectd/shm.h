@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#ifndef LIBCOLLECTD_SHM_H
+#define LIBCOLLECTD_SHM_H 1
+
+#include "collectd/lcc_features.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h> /* for size_t */
+
+/*
+ * Shared memory export
+ *
+ * The write_shm plugin publishes the latest value of every series in a file,
+ * usually on a tmpfs, which readers map read-only. This header describes the
+ * layout of that file and is shared by the plugin and the reader below. This
+ * header deliberately does not depend on "collectd/types.h", so the daemon can
+ * include it, too.
+ *
+ * All fields are in host byte order; the file is not meant to be moved
+ * between hosts. The file consists of
+ *
+ *   - a lcc_shm_header_t,
+ *   - "slots_max" slots of "slot_size" bytes each, starting at "slots_offset",
+ *   - the identifier dictionary of "dict_size" bytes, starting at
+ *     "dict_offset".
+ *
+ * The dictionary holds the null-terminated identifiers of all series
+ * ("host/plugin[-instance]/type[-instance]"), each slot refers to its
+ * identifier by offset into the dictionary. Slots are handed out in the order
+ * series are first seen and are never reused while the writer is running.
+ *
+ * A slot and its identifier are filled in completely before "slots_num" is
+ * increased, so readers may use slots [0, slots_num) at any time. Afterwards
+ * the identifier of a slot does not change.
+ *
+ * The remaining fields of a slot are protected by a sequence lock: the writer
+ * makes "seq" odd before changing the slot and even again when done. Readers
+ * copy the slot and retry if "seq" was odd or changed in the meantime.
+ *
+ * When the writer restarts, it creates a new file and renames it over the old
+ * one. On shutdown it sets "closed" to non-zero. lcc_shm_closed() checks for
+ * both.
+ */
+#define LCC_SHM_MAGIC "CDSHM001"
+#define LCC_SHM_VERSION 1
+
+/* Maximum number of values per series. Larger data sets are not exported. */
+#define LCC_SHM_VALUES_MAX 8
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t slot_size;
+  uint64_t slots_offset;
+  uint64_t slots_max;
+  uint64_t dict_offset;
+  uint64_t dict_size;
+  /* Number of slots in use. Only ever grows. */
+  uint64_t slots_num;
+  /* Number of bytes of the dictionary in use. */
+  uint64_t dict_used;
+  /* Time the file was created, in collectd's cdtime_t format (2^-30 s). */
+  uint64_t created;
+  uint32_t closed;
+  uint32_t reserved;
+} lcc_shm_header_t;
+
+typedef union {
+  uint64_t counter;
+  double gauge;
+  int64_t derive;
+  uint64_t absolute;
+} lcc_shm_value_t;
+
+typedef struct {
+  uint64_t seq;
+  /* Offset of the identifier in the dictionary. */
+  uint64_t identifier;
+  /* Time and interval in collectd's cdtime_t format (2^-30 s). */
+  uint64_t time;
+  uint64_t interval;
+  uint32_t values_len;
+  /* LCC_TYPE_* constants or, with the plugin's StoreRates option, gauges. */
+  uint8_t values_types[LCC_SHM_VALUES_MAX];
+  uint32_t reserved;
+  lcc_shm_value_t values[LCC_SHM_VALUES_MAX];
+} lcc_shm_slot_t;
+
+LCC_BEGIN_DECLS
+
+/* lcc_shm_series_t is a consistent copy of one series. */
+typedef struct {
+  /* identifier points into the mapped file and is valid until lcc_shm_close()
+   * is called. */
+  char const *identifier;
+  double time;
+  double interval;
+  size_t values_len;
+  int values_types[LCC_SHM_VALUES_MAX];
+  lcc_shm_value_t values[LCC_SHM_VALUES_MAX];
+} lcc_shm_series_t;
+
+struct lcc_shm_s;
+typedef struct lcc_shm_s lcc_shm_t;
+
+/* lcc_shm_open maps the file written by the write_shm plugin read-only.
+ * Returns zero on success and an errno value otherwise; EPROTO means the file
+ * is not in the expected format. */
+int lcc_shm_open(char const *file, lcc_shm_t **ret_shm);
+
+void lcc_shm_close(lcc_shm_t *shm);
+
+/* lcc_shm_series_num returns the number of series currently exported. Series
+ * are added at the end, so the indexes of known series stay valid. */
+size_t lcc_shm_series_num(lcc_shm_t *shm);
+
+/* lcc_shm_read copies the series with the given index to "ret_series".
+ * Returns ENOENT if the index is out of range and EAGAIN if the series was
+ * being updated on every attempt to read it. */
+int lcc_shm_read(lcc_shm_t *shm, size_t index, lcc_shm_series_t *ret_series);
+
+/* lcc_shm_scan calls "callback" with every exported series. Series that could
+ * not be read consistently (see lcc_shm_read) are skipped. Stops and returns
+ * the callback's return value if it is non-zero. */
+int lcc_shm_scan(lcc_shm_t *shm,
+                 int (*callback)(lcc_shm_series_t const *series,
+                                 void *user_data),
+                 void *user_data);
+
+/* lcc_shm_closed returns true if the writer has shut down or replaced the
+ * file, in which case the file should be opened again. */
+bool lcc_shm_closed(lcc_shm_t *shm);
+
+LCC_END_DECLS
+
+#endif /* LIBCOLLECTD_SHM_H */
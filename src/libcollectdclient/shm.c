@@ -0,0 +1,239 @@
+/**
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ **/
+
+#include "config.h"
+
+#include "collectd/lcc_features.h"
+#include "collectd/shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Number of attempts to read a slot the writer keeps updating. */
+#define LCC_SHM_READ_RETRIES 64
+
+#define CDTIME_TO_DOUBLE(t) ((double)(t) / 1073741824.0)
+
+struct lcc_shm_s {
+  char *file;
+  dev_t dev;
+  ino_t ino;
+
+  void *map;
+  size_t map_size;
+
+  lcc_shm_header_t const *header;
+  char const *slots;
+  char const *dict;
+};
+
+/* Reads a field the writer may change concurrently. Loads following this one
+ * are not reordered before it. */
+static uint64_t shm_load(uint64_t const *ptr) {
+  uint64_t value = *(uint64_t const volatile *)ptr;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return value;
+}
+
+static int shm_validate(lcc_shm_header_t const *h, size_t size) {
+  if ((size < sizeof(*h)) ||
+      (memcmp(h->magic, LCC_SHM_MAGIC, sizeof(h->magic)) != 0) ||
+      (h->version != LCC_SHM_VERSION) ||
+      (h->slot_size < sizeof(lcc_shm_slot_t)) || (h->slot_size % 8 != 0))
+    return EPROTO;
+
+  if ((h->slots_offset < sizeof(*h)) || (h->slots_offset % 8 != 0) ||
+      (h->slots_offset > size) ||
+      (h->slots_max > (size - h->slots_offset) / h->slot_size))
+    return EPROTO;
+
+  if ((h->dict_offset < h->slots_offset + h->slots_max * h->slot_size) ||
+      (h->dict_offset > size) || (h->dict_size > size - h->dict_offset))
+    return EPROTO;
+
+  return 0;
+}
+
+int lcc_shm_open(char const *file, lcc_shm_t **ret_shm) {
+  struct stat statbuf;
+  int status;
+
+  if ((file == NULL) || (ret_shm == NULL))
+    return EINVAL;
+
+  int fd = open(file, O_RDONLY);
+  if (fd < 0)
+    return errno;
+
+  if (fstat(fd, &statbuf) != 0) {
+    status = errno;
+    close(fd);
+    return status;
+  }
+  if ((size_t)statbuf.st_size < sizeof(lcc_shm_header_t)) {
+    close(fd);
+    return EPROTO;
+  }
+
+  lcc_shm_t *shm = calloc(1, sizeof(*shm));
+  if (shm == NULL) {
+    close(fd);
+    return ENOMEM;
+  }
+  shm->dev = statbuf.st_dev;
+  shm->ino = statbuf.st_ino;
+  shm->map_size = (size_t)statbuf.st_size;
+
+  shm->map = mmap(NULL, shm->map_size, PROT_READ, MAP_SHARED, fd, 0);
+  status = errno;
+  close(fd);
+  if (shm->map == MAP_FAILED) {
+    free(shm);
+    return status;
+  }
+
+  shm->header = shm->map;
+  status = shm_validate(shm->header, shm->map_size);
+  shm->file = strdup(file);
+  if ((status == 0) && (shm->file == NULL))
+    status = ENOMEM;
+  if (status != 0) {
+    lcc_shm_close(shm);
+    return status;
+  }
+
+  shm->slots = (char const *)shm->map + shm->header->slots_offset;
+  shm->dict = (char const *)shm->map + shm->header->dict_offset;
+
+  *ret_shm = shm;
+  return 0;
+}
+
+void lcc_shm_close(lcc_shm_t *shm) {
+  if (shm == NULL)
+    return;
+
+  munmap(shm->map, shm->map_size);
+  free(shm->file);
+  free(shm);
+}
+
+size_t lcc_shm_series_num(lcc_shm_t *shm) {
+  if (shm == NULL)
+    return 0;
+
+  uint64_t num = shm_load(&shm->header->slots_num);
+  if (num > shm->header->slots_max)
+    num = shm->header->slots_max;
+  return (size_t)num;
+}
+
+int lcc_shm_read(lcc_shm_t *shm, size_t index, lcc_shm_series_t *ret_series) {
+  if ((shm == NULL) || (ret_series == NULL))
+    return EINVAL;
+  if (index >= lcc_shm_series_num(shm))
+    return ENOENT;
+
+  lcc_shm_slot_t const *slot =
+      (lcc_shm_slot_t const *)(shm->slots + index * shm->header->slot_size);
+
+  /* The identifier is immutable once the slot has been published. */
+  if (slot->identifier >= shm->header->dict_size)
+    return EPROTO;
+  char const *identifier = shm->dict + slot->identifier;
+  if (memchr(identifier, 0, shm->header->dict_size - slot->identifier) ==
+      NULL)
+    return EPROTO;
+
+  for (int i = 0; i < LCC_SHM_READ_RETRIES; i++) {
+    uint64_t seq = shm_load(&slot->seq);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+
+    lcc_shm_slot_t copy;
+    memcpy(&copy, slot, sizeof(copy));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if (*(uint64_t const volatile *)&slot->seq != seq)
+      continue;
+
+    size_t values_len = copy.values_len;
+    if (values_len > LCC_SHM_VALUES_MAX)
+      return EPROTO;
+
+    ret_series->identifier = identifier;
+    ret_series->time = CDTIME_TO_DOUBLE(copy.time);
+    ret_series->interval = CDTIME_TO_DOUBLE(copy.interval);
+    ret_series->values_len = values_len;
+    for (size_t j = 0; j < values_len; j++) {
+      ret_series->values_types[j] = (int)copy.values_types[j];
+      ret_series->values[j] = copy.values[j];
+    }
+    return 0;
+  }
+
+  return EAGAIN;
+}
+
+int lcc_shm_scan(lcc_shm_t *shm,
+                 int (*callback)(lcc_shm_series_t const *series,
+                                 void *user_data),
+                 void *user_data) {
+  if ((shm == NULL) || (callback == NULL))
+    return EINVAL;
+
+  size_t num = lcc_shm_series_num(shm);
+  for (size_t i = 0; i < num; i++) {
+    lcc_shm_series_t series;
+    if (lcc_shm_read(shm, i, &series) != 0)
+      continue;
+
+    int status = callback(&series, user_data);
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+}
+
+bool lcc_shm_closed(lcc_shm_t *shm) {
+  struct stat statbuf;
+
+  if (shm == NULL)
+    return true;
+
+  if (*(uint32_t const volatile *)&shm->header->closed != 0)
+    return true;
+
+  if (stat(shm->file, &statbuf) != 0)
+    return true;
+
+  return (statbuf.st_dev != shm->dev) || (statbuf.st_ino != shm->ino);
+}
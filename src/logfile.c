@@ -32,11 +32,13 @@
 #include "utils/common/common.h"
 
 #if COLLECT_DEBUG
-static int log_level = LOG_DEBUG;
+#define LOGFILE_DEFAULT_LEVEL LOG_DEBUG
 #else
-static int log_level = LOG_INFO;
+#define LOGFILE_DEFAULT_LEVEL LOG_INFO
 #endif /* COLLECT_DEBUG */
 
+static int log_level = LOGFILE_DEFAULT_LEVEL;
+
 static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static char *log_file;
@@ -196,10 +198,23 @@ static int logfile_notification(const notification_t *n,
   return 0;
 } /* int logfile_notification */
 
+static int logfile_reset(void) {
+  pthread_mutex_lock(&file_lock);
+  sfree(log_file);
+  pthread_mutex_unlock(&file_lock);
+
+  log_level = LOGFILE_DEFAULT_LEVEL;
+  print_timestamp = 1;
+  print_severity = 0;
+
+  return 0;
+} /* int logfile_reset */
+
 void module_register(void) {
   plugin_register_config("logfile", logfile_config, config_keys,
                          config_keys_num);
   plugin_register_log("logfile", logfile_log, /* user_data = */ NULL);
   plugin_register_notification("logfile", logfile_notification,
                                /* user_data = */ NULL);
+  plugin_register_reset("logfile", logfile_reset);
 } /* void module_register (void) */
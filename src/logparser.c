@@ -31,8 +31,14 @@
 #include "utils/message_parser/message_parser.h"
 #include "utils_llist.h"
 
+#include <poll.h>
+
 #define PLUGIN_NAME "logparser"
 
+/* Upper bound for the follow threads' sleep, so that shutdown is not
+ * delayed */
+#define LOGPARSER_WAIT_TIMEOUT MS_TO_CDTIME_T(1000)
+
 #define LOGPARSER_SEV_OK_STR "OK"
 #define LOGPARSER_SEV_WARN_STR "WARNING"
 #define LOGPARSER_SEV_FAIL_STR "FAILURE"
@@ -83,16 +89,39 @@ typedef struct log_parser_s {
   char *def_type;
   char *def_type_inst;
   int def_severity;
+  derive_t skipped_lines;
+  /* Reused for every notification of this message */
+  notification_builder_t *builder;
 } log_parser_t;
 
+typedef struct log_file_s {
+  char *filename;
+  /* Maximum number of unread bytes, 0 means no limit */
+  uint64_t max_backlog;
+  /* Parsers of this file are stored consecutively in logparser_ctx.parsers */
+  size_t parsers_start;
+  size_t parsers_num;
+  /* Serializes the read callback and the follow thread */
+  pthread_mutex_t lock;
+  pthread_t follow_thread;
+  bool follow_thread_running;
+  bool follow_thread_loop;
+} log_file_t;
+
 typedef struct logparser_ctx_s {
   log_parser_t *parsers;
   size_t parsers_len;
+  log_file_t *files;
+  size_t files_len;
+  /* Set once the locks of the files have been initialized */
+  bool files_initialized;
 } logparser_ctx_t;
 
 static logparser_ctx_t logparser_ctx;
 
 static int logparser_shutdown(void);
+static int logparser_read(user_data_t *ud);
+static void *logparser_follow(void *arg);
 
 static void logparser_free_user_data(void *data) {
   message_item_user_data_t *user_data = (message_item_user_data_t *)data;
@@ -318,6 +347,9 @@ error:
 static int logparser_config_logfile(oconfig_item_t *ci) {
   char *filename = NULL;
   bool first_read = false; // First full read
+  int max_backlog = 0;
+  size_t parsers_start = logparser_ctx.parsers_len;
+  log_file_t *ptr;
   int ret = 0;
 
   ret = cf_util_get_string(ci, &filename);
@@ -330,7 +362,13 @@ static int logparser_config_logfile(oconfig_item_t *ci) {
     oconfig_item_t *child = ci->children + i;
     if (strcasecmp("FirstFullRead", child->key) == 0)
       ret = cf_util_get_boolean(child, &first_read);
-    else if (strcasecmp("Message", child->key) == 0)
+    else if (strcasecmp("MaxBacklog", child->key) == 0) {
+      ret = cf_util_get_int(child, &max_backlog);
+      if (ret == 0 && max_backlog < 0) {
+        ERROR(PLUGIN_NAME ": MaxBacklog must not be negative");
+        goto error;
+      }
+    } else if (strcasecmp("Message", child->key) == 0)
       ret = logparser_config_message(child, filename, first_read);
     else {
       ERROR(PLUGIN_NAME ": Invalid configuration option \"%s\".", child->key);
@@ -343,6 +381,20 @@ static int logparser_config_logfile(oconfig_item_t *ci) {
     }
   }
 
+  ptr = realloc(logparser_ctx.files,
+                sizeof(*ptr) * (logparser_ctx.files_len + 1));
+  if (ptr == NULL) {
+    ERROR(PLUGIN_NAME ": Error reallocating memory for log files.");
+    goto error;
+  }
+  logparser_ctx.files = ptr;
+  logparser_ctx.files[logparser_ctx.files_len++] = (log_file_t){
+      .filename = filename,
+      .max_backlog = (uint64_t)max_backlog,
+      .parsers_start = parsers_start,
+      .parsers_num = logparser_ctx.parsers_len - parsers_start,
+  };
+
   return 0;
 
 error:
@@ -524,6 +576,10 @@ static int logparser_init(void) {
   logparser_print_config();
 #endif
 
+  for (size_t i = 0; i < logparser_ctx.files_len; i++)
+    pthread_mutex_init(&logparser_ctx.files[i].lock, /* attr = */ NULL);
+  logparser_ctx.files_initialized = true;
+
   for (size_t i = 0; i < logparser_ctx.parsers_len; i++) {
     log_parser_t *parser = logparser_ctx.parsers + i;
     parser->job = message_parser_init(parser->filename, START_IDX, STOP_IDX,
@@ -536,6 +592,49 @@ static int logparser_init(void) {
     }
   }
 
+  /* Every file is read by its own callback, so that the read threads parse
+   * them in parallel and a slow file does not delay the others */
+  for (size_t i = 0; i < logparser_ctx.files_len; i++) {
+    char name[64];
+
+    snprintf(name, sizeof(name), PLUGIN_NAME "-%zu", i);
+    int status = plugin_register_complex_read(
+        PLUGIN_NAME, name, logparser_read, 0,
+        &(user_data_t){.data = logparser_ctx.files + i});
+    if (status != 0) {
+      ERROR(PLUGIN_NAME ": Failed to register read callback for %s.",
+            logparser_ctx.files[i].filename);
+      logparser_shutdown();
+      return -1;
+    }
+  }
+
+  /* The follow threads dispatch messages as soon as they are logged. Without
+   * change notifications they would only poll, which the read callbacks do
+   * already. */
+  for (size_t i = 0; i < logparser_ctx.files_len; i++) {
+    log_file_t *file = logparser_ctx.files + i;
+    bool follow = true;
+
+    for (size_t j = 0; follow && (j < file->parsers_num); j++) {
+      log_parser_t *parser = logparser_ctx.parsers + file->parsers_start + j;
+      follow = (message_parser_fd(parser->job) >= 0);
+    }
+    if (!follow)
+      continue;
+
+    file->follow_thread_loop = true;
+    if (plugin_thread_create(&file->follow_thread, logparser_follow, file,
+                             PLUGIN_NAME) == 0)
+      file->follow_thread_running = true;
+    else {
+      file->follow_thread_loop = false;
+      WARNING(PLUGIN_NAME ": Starting follow thread for %s failed, polling "
+                          "every interval",
+              file->filename);
+    }
+  }
+
   return 0;
 }
 
@@ -548,19 +647,28 @@ static void logparser_dispatch_notification(notification_t *n) {
 
 static void logparser_process_msg(log_parser_t *parser, message_t *msg,
                                   unsigned int max_items) {
-  notification_t n = {.severity = parser->def_severity,
-                      .time = cdtime(),
-                      .plugin = PLUGIN_NAME,
-                      .meta = NULL};
+  if (parser->builder == NULL) {
+    parser->builder = plugin_notification_builder_create();
+    if (parser->builder == NULL) {
+      ERROR(PLUGIN_NAME ": Failed to create notification builder");
+      return;
+    }
+  }
+
+  notification_t *n = plugin_notification_builder_reset(parser->builder);
+  n->severity = parser->def_severity;
+  n->time = cdtime();
+  sstrncpy(n->host, hostname_g, sizeof(n->host));
+  sstrncpy(n->plugin, PLUGIN_NAME, sizeof(n->plugin));
 
   /* Writing  default values if set */
   if (parser->def_plugin_inst != NULL)
-    sstrncpy(n.plugin_instance, parser->def_plugin_inst,
-             sizeof(n.plugin_instance));
+    sstrncpy(n->plugin_instance, parser->def_plugin_inst,
+             sizeof(n->plugin_instance));
   if (parser->def_type != NULL)
-    sstrncpy(n.type, parser->def_type, sizeof(n.type));
+    sstrncpy(n->type, parser->def_type, sizeof(n->type));
   if (parser->def_type_inst != NULL)
-    sstrncpy(n.type_instance, parser->def_type_inst, sizeof(n.type_instance));
+    sstrncpy(n->type_instance, parser->def_type_inst, sizeof(n->type_instance));
 
   for (int i = 0; i < max_items; i++) {
     message_item_t *item = msg->message_items + i;
@@ -578,19 +686,19 @@ static void logparser_process_msg(log_parser_t *parser, message_t *msg,
         size_t size = 0;
         switch (user_data->infos[i].type) {
         case MSG_ITEM_SEVERITY:
-          n.severity = user_data->infos[i].val.severity;
+          n->severity = user_data->infos[i].val.severity;
           break;
         case MSG_ITEM_PLUGIN_INST:
-          ptr = n.plugin_instance;
-          size = sizeof(n.plugin_instance);
+          ptr = n->plugin_instance;
+          size = sizeof(n->plugin_instance);
           break;
         case MSG_ITEM_TYPE:
-          ptr = n.type;
-          size = sizeof(n.type);
+          ptr = n->type;
+          size = sizeof(n->type);
           break;
         case MSG_ITEM_TYPE_INST:
-          ptr = n.type_instance;
-          size = sizeof(n.type_instance);
+          ptr = n->type_instance;
+          size = sizeof(n->type_instance);
           break;
         default:
           ERROR(PLUGIN_NAME ": Message item has wrong type!");
@@ -606,12 +714,13 @@ static void logparser_process_msg(log_parser_t *parser, message_t *msg,
       }
     }
 
-    if (plugin_notification_meta_add_string(&n, item->name, item->value))
+    if (plugin_notification_builder_add_string(parser->builder, item->name,
+                                               item->value))
       ERROR(PLUGIN_NAME ": Failed to add notification meta data %s:%s",
             item->name, item->value);
   }
 
-  logparser_dispatch_notification(&n);
+  plugin_notification_builder_dispatch(parser->builder);
 }
 
 static int logparser_parser_read(log_parser_t *parser) {
@@ -641,26 +750,133 @@ static int logparser_parser_read(log_parser_t *parser) {
   return 0;
 }
 
-static int logparser_read(__attribute__((unused)) user_data_t *ud) {
+static void logparser_parser_skip(log_parser_t *parser, uint64_t max_backlog) {
+  uint64_t skipped = 0;
+
+  if (message_parser_skip(parser->job, max_backlog, &skipped) != 0)
+    return;
+
+  if (skipped > 0) {
+    WARNING(PLUGIN_NAME ": More than %" PRIu64 " bytes to parse in %s, "
+                        "skipped %" PRIu64 " lines (message: \"%s\")",
+            max_backlog, parser->filename, skipped, parser->name);
+    parser->skipped_lines += (derive_t)skipped;
+  }
+
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = &(value_t){.derive = parser->skipped_lines};
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, PLUGIN_NAME, sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, parser->name, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "skipped_lines", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+}
+
+/* Reads all messages of "file". file->lock must be held. */
+static int logparser_read_file(log_file_t *file) {
   int ret = 0;
 
-  for (size_t i = 0; i < logparser_ctx.parsers_len; i++) {
-    log_parser_t *parser = logparser_ctx.parsers + i;
-    ret = logparser_parser_read(parser);
-    if (parser->first_read)
-      parser->first_read = false;
+  for (size_t i = 0; i < file->parsers_num; i++) {
+    log_parser_t *parser = logparser_ctx.parsers + file->parsers_start + i;
 
-    if (ret < 0) {
+    if (file->max_backlog > 0)
+      logparser_parser_skip(parser, file->max_backlog);
+
+    /* A failing message parser does not keep the others from running */
+    if (logparser_parser_read(parser) < 0) {
       ERROR(PLUGIN_NAME ": Failed to parse %s messages from %s", parser->name,
             parser->filename);
-      break;
+      ret = -1;
     }
+    if (parser->first_read)
+      parser->first_read = false;
   }
 
   return ret;
 }
 
+static int logparser_read(user_data_t *ud) {
+  log_file_t *file = ud->data;
+
+  pthread_mutex_lock(&file->lock);
+  int ret = logparser_read_file(file);
+  pthread_mutex_unlock(&file->lock);
+
+  return ret;
+}
+
+/* Reads "file" whenever it changes. The read callback is kept as a fallback,
+ * e.g. for files which could not be opened yet. The change notification descriptors stay
+ * valid until the parser jobs are cleaned up and are polled without the
+ * lock. */
+static void *logparser_follow(void *arg) {
+  log_file_t *file = arg;
+  struct pollfd pfds[file->parsers_num];
+
+  pthread_mutex_lock(&file->lock);
+  for (size_t i = 0; i < file->parsers_num; i++) {
+    log_parser_t *parser = logparser_ctx.parsers + file->parsers_start + i;
+    pfds[i] = (struct pollfd){.fd = message_parser_fd(parser->job),
+                              .events = POLLIN};
+  }
+
+  while (file->follow_thread_loop) {
+    pthread_mutex_unlock(&file->lock);
+
+    int status = poll(pfds, file->parsers_num,
+                      (int)CDTIME_T_TO_MS(LOGPARSER_WAIT_TIMEOUT));
+    if ((status < 0) && (errno != EINTR)) {
+      ERROR(PLUGIN_NAME ": poll failed, polling %s every interval: %s",
+            file->filename, STRERRNO);
+      return NULL;
+    }
+
+    pthread_mutex_lock(&file->lock);
+    if (!file->follow_thread_loop)
+      break;
+
+    /* Consumes the pending change notifications of every parser */
+    bool changed = false;
+    for (size_t i = 0; i < file->parsers_num; i++) {
+      log_parser_t *parser = logparser_ctx.parsers + file->parsers_start + i;
+      if (message_parser_wait(parser->job, 0) == 0)
+        changed = true;
+    }
+    if (changed)
+      logparser_read_file(file);
+  }
+  pthread_mutex_unlock(&file->lock);
+
+  return NULL;
+}
+
 static int logparser_shutdown(void) {
+  if (logparser_ctx.files_len > 0)
+    plugin_unregister_read_group(PLUGIN_NAME);
+
+  for (size_t i = 0; logparser_ctx.files_initialized &&
+                     (i < logparser_ctx.files_len);
+       i++) {
+    log_file_t *file = logparser_ctx.files + i;
+
+    pthread_mutex_lock(&file->lock);
+    file->follow_thread_loop = false;
+    pthread_mutex_unlock(&file->lock);
+
+    if (file->follow_thread_running) {
+      pthread_join(file->follow_thread, NULL);
+      file->follow_thread_running = false;
+    }
+    pthread_mutex_destroy(&file->lock);
+  }
+  logparser_ctx.files_initialized = false;
+
+  for (size_t i = 0; i < logparser_ctx.files_len; i++)
+    sfree(logparser_ctx.files[i].filename);
+  sfree(logparser_ctx.files);
+  logparser_ctx.files_len = 0;
+
   if (logparser_ctx.parsers == NULL)
     return 0;
 
@@ -669,6 +885,7 @@ static int logparser_shutdown(void) {
 
     if (parser->job != NULL)
       message_parser_cleanup(parser->job);
+    plugin_notification_builder_destroy(parser->builder);
 
     for (size_t j = 0; j < parser->patterns_len; j++) {
       if (parser->patterns[j].free_user_data != NULL)
@@ -680,7 +897,6 @@ static int logparser_shutdown(void) {
     }
 
     sfree(parser->patterns);
-    sfree(parser->filename);
     sfree(parser->def_plugin_inst);
     sfree(parser->def_type);
     sfree(parser->def_type_inst);
@@ -688,6 +904,7 @@ static int logparser_shutdown(void) {
   }
 
   sfree(logparser_ctx.parsers);
+  logparser_ctx.parsers_len = 0;
 
   return 0;
 }
@@ -695,6 +912,5 @@ static int logparser_shutdown(void) {
 void module_register(void) {
   plugin_register_complex_config(PLUGIN_NAME, logparser_config);
   plugin_register_init(PLUGIN_NAME, logparser_init);
-  plugin_register_complex_read(NULL, PLUGIN_NAME, logparser_read, 0, NULL);
   plugin_register_shutdown(PLUGIN_NAME, logparser_shutdown);
 }
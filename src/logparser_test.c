@@ -335,6 +335,11 @@ DEF_TEST(config_logfile) {
   EXPECT_EQ_INT(0, ret);
 
   EXPECT_EQ_INT(1, logparser_ctx.parsers_len);
+  EXPECT_EQ_INT(1, logparser_ctx.files_len);
+  EXPECT_EQ_STR("/path/to/a/file", logparser_ctx.files[0].filename);
+  EXPECT_EQ_INT(0, logparser_ctx.files[0].parsers_start);
+  EXPECT_EQ_INT(1, logparser_ctx.files[0].parsers_num);
+  EXPECT_EQ_UINT64(0, logparser_ctx.files[0].max_backlog);
 
   log_parser_t *parser = &logparser_ctx.parsers[0];
 
@@ -31,8 +31,10 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 #include "utils/ignorelist/ignorelist.h"
+#include "utils/tail/tail.h"
 
 #include <limits.h>
+#include <poll.h>
 #include <regex.h>
 #include <stdio.h>
 #include <string.h>
@@ -48,12 +50,18 @@
 #define SYSLOG_PATH "/var/log/syslog"
 #define SYSLOG_MSG_PATH "/var/log/messages"
 
-#define MAX_SYSLOG_MESSAGE_LENGTH 1024
 #define MAX_ERROR_MSG 100
 #define MAX_MATCHES 4
 #define MD_ARRAY_NAME_PREFIX_LEN 7
 
-static FILE *syslog_file;
+// Upper bound for the follow thread's sleep, so that shutdown is not delayed
+#define MD_EVENTS_WAIT_TIMEOUT MS_TO_CDTIME_T(1000)
+
+static cu_tail_t *syslog_tail;
+static pthread_mutex_t syslog_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t follow_thread;
+static bool follow_thread_running;
+static bool follow_thread_loop;
 static regex_t regex;
 static ignorelist_t *event_ignorelist;
 static ignorelist_t *array_ignorelist;
@@ -325,19 +333,68 @@ static int md_events_match_regex(regex_t *regex, const char *to_match) {
   return 0;
 }
 
-static int md_events_read(void) {
-  char syslog_line[MAX_SYSLOG_MESSAGE_LENGTH];
-  while (fgets(syslog_line, sizeof(syslog_line), syslog_file))
-    // don't check the return code here; exiting from read callback with
-    // nonzero status causes the suspension of next read call;
-    md_events_match_regex(&regex, syslog_line);
+static int md_events_line_cb(void *data, char *line, int len) {
+  // don't check the return code here; a non-zero status stops reading
+  md_events_match_regex(&regex, line);
+  return 0;
+}
+
+static int md_events_read_lines(void) {
+  pthread_mutex_lock(&syslog_lock);
+  int status = cu_tail_read(syslog_tail, md_events_line_cb, NULL, false);
+  pthread_mutex_unlock(&syslog_lock);
+  return status;
+}
 
+static int md_events_read(void) {
+  // exiting from read callback with nonzero status causes the suspension of
+  // next read call; errors are reported by utils_tail
+  md_events_read_lines();
   return 0;
 }
 
+// Dispatches events as soon as mdadm logs them instead of once per interval.
+// The read callback is kept as a fallback and shares the tail object, so the
+// object is only used with syslog_lock held. The change notification
+// descriptor stays valid until the object is destroyed and is polled without
+// the lock.
+static void *md_events_follow(void *arg) {
+  pthread_mutex_lock(&syslog_lock);
+  int fd = cu_tail_fd(syslog_tail);
+  while (follow_thread_loop) {
+    pthread_mutex_unlock(&syslog_lock);
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int status = poll(&pfd, 1, (int)CDTIME_T_TO_MS(MD_EVENTS_WAIT_TIMEOUT));
+    if ((status < 0) && (errno != EINTR)) {
+      MD_EVENTS_ERROR("poll failed, polling every interval: %s\n", STRERRNO);
+      return NULL;
+    }
+
+    pthread_mutex_lock(&syslog_lock);
+    // consumes the pending change notifications
+    if (follow_thread_loop && (cu_tail_wait(syslog_tail, 0) == 0))
+      cu_tail_read(syslog_tail, md_events_line_cb, NULL, false);
+  }
+  pthread_mutex_unlock(&syslog_lock);
+
+  return NULL;
+}
+
 static int md_events_shutdown(void) {
-  if (syslog_file)
-    fclose(syslog_file);
+  pthread_mutex_lock(&syslog_lock);
+  follow_thread_loop = false;
+  pthread_mutex_unlock(&syslog_lock);
+
+  if (follow_thread_running) {
+    pthread_join(follow_thread, NULL);
+    follow_thread_running = false;
+  }
+
+  if (syslog_tail) {
+    cu_tail_destroy(syslog_tail);
+    syslog_tail = NULL;
+  }
 
   regfree(&regex);
   ignorelist_free(event_ignorelist);
@@ -351,10 +408,11 @@ static int md_events_shutdown(void) {
 }
 
 static int md_events_init(void) {
-  syslog_file = fopen(SYSLOG_PATH, "r");
-  if (!syslog_file) {
-    syslog_file = fopen(SYSLOG_MSG_PATH, "r");
-    if (!syslog_file) {
+  const char *path = SYSLOG_PATH;
+
+  if (access(path, R_OK) != 0) {
+    path = SYSLOG_MSG_PATH;
+    if (access(path, R_OK) != 0) {
       MD_EVENTS_ERROR(
           "/var/log/syslog and /var/log/messages files are not present. Are "
           "you sure that you have rsyslog utility installed on your system?\n");
@@ -362,19 +420,41 @@ static int md_events_init(void) {
     }
   }
 
-  // monitor events only from point of collectd start
-  if (fseek(syslog_file, 0, SEEK_END)) {
-    MD_EVENTS_ERROR("fseek on syslog file failed, error: %s\n",
-                    strerror(errno));
-    fclose(syslog_file);
+  syslog_tail = cu_tail_create(path);
+  if (syslog_tail == NULL) {
+    MD_EVENTS_ERROR("cu_tail_create (%s) failed\n", path);
+    return -1;
+  }
+
+  // monitor events only from point of collectd start: the first read opens
+  // the file and seeks to its end
+  if (cu_tail_read(syslog_tail, md_events_line_cb, NULL, false)) {
+    MD_EVENTS_ERROR("opening %s failed\n", path);
+    cu_tail_destroy(syslog_tail);
+    syslog_tail = NULL;
     return -1;
   }
 
   if (md_events_compile_regex(&regex, regex_pattern)) {
-    fclose(syslog_file);
+    cu_tail_destroy(syslog_tail);
+    syslog_tail = NULL;
     return -1;
   }
 
+  // without change notifications the thread would only poll, which the read
+  // callback does already
+  if (cu_tail_fd(syslog_tail) >= 0) {
+    follow_thread_loop = true;
+    if (plugin_thread_create(&follow_thread, md_events_follow, NULL,
+                             MD_EVENTS_PLUGIN) == 0)
+      follow_thread_running = true;
+    else {
+      follow_thread_loop = false;
+      MD_EVENTS_ERROR("starting follow thread failed, polling every "
+                      "interval\n");
+    }
+  }
+
   return 0;
 }
 
@@ -266,7 +266,8 @@ typedef struct receive_list_entry_s receive_list_entry_t;
  */
 static int network_config_ttl;
 /* Ethernet - (IPv6 + UDP) = 1500 - (40 + 8) = 1452 */
-static size_t network_config_packet_size = 1452;
+#define NETWORK_DEFAULT_PACKET_SIZE 1452
+static size_t network_config_packet_size = NETWORK_DEFAULT_PACKET_SIZE;
 static bool network_config_forward;
 static bool network_config_stats;
 
@@ -283,7 +284,10 @@ static struct pollfd *listen_sockets_pollfd;
 static size_t listen_sockets_num;
 
 /* The receive and dispatch threads will run as long as `listen_loop' is set to
- * zero. */
+ * zero. The receive thread checks it at least once per `LISTEN_WAIT_TIMEOUT'
+ * milliseconds, so that it can be stopped without a signal on reset. */
+#define LISTEN_WAIT_TIMEOUT 1000
+static bool have_init;
 static int listen_loop;
 static int receive_thread_running;
 static pthread_t receive_thread_id;
@@ -2275,8 +2279,11 @@ static int network_receive(void) /* {{{ */
   private_list_length = 0;
 
   while (listen_loop == 0) {
-    status = poll(listen_sockets_pollfd, listen_sockets_num, -1);
-    if (status <= 0) {
+    status = poll(listen_sockets_pollfd, listen_sockets_num,
+                  LISTEN_WAIT_TIMEOUT);
+    if (status == 0)
+      continue;
+    if (status < 0) {
       if (errno == EINTR)
         continue;
       ERROR("network plugin: poll(2) failed: %s", STRERRNO);
@@ -3117,13 +3124,17 @@ static int network_notification(const notification_t *n,
   return 0;
 } /* int network_notification */
 
-static int network_shutdown(void) {
+/* Stops the threads, flushes the send buffer and closes all sockets. The
+ * receive thread is only interrupted by a signal on shutdown, because SIGTERM
+ * stops the daemon. */
+static void network_stop(bool interrupt) {
   listen_loop++;
 
   /* Kill the listening thread */
   if (receive_thread_running != 0) {
     INFO("network plugin: Stopping receive thread.");
-    pthread_kill(receive_thread_id, SIGTERM);
+    if (interrupt)
+      pthread_kill(receive_thread_id, SIGTERM);
     pthread_join(receive_thread_id, NULL /* no return value */);
     memset(&receive_thread_id, 0, sizeof(receive_thread_id));
     receive_thread_running = 0;
@@ -3140,6 +3151,9 @@ static int network_shutdown(void) {
   }
 
   sockent_destroy(listen_sockets);
+  listen_sockets = NULL;
+  sfree(listen_sockets_pollfd);
+  listen_sockets_num = 0;
 
   if (send_buffer_fill > 0)
     flush_buffer();
@@ -3149,6 +3163,11 @@ static int network_shutdown(void) {
   for (sockent_t *se = sending_sockets; se != NULL; se = se->next)
     sockent_client_disconnect(se);
   sockent_destroy(sending_sockets);
+  sending_sockets = NULL;
+} /* void network_stop */
+
+static int network_shutdown(void) {
+  network_stop(/* interrupt = */ true);
 
   plugin_unregister_config("network");
   plugin_unregister_init("network");
@@ -3158,6 +3177,21 @@ static int network_shutdown(void) {
   return 0;
 } /* int network_shutdown */
 
+static int network_reset(void) {
+  network_stop(/* interrupt = */ false);
+  listen_loop = 0;
+  /* The dispatch thread decrements the length once more on its way out. */
+  receive_list_length = 0;
+  have_init = false;
+
+  network_config_ttl = 0;
+  network_config_packet_size = NETWORK_DEFAULT_PACKET_SIZE;
+  network_config_forward = false;
+  network_config_stats = false;
+
+  return 0;
+} /* int network_reset */
+
 static int network_stats_read(void) /* {{{ */
 {
   derive_t copy_octets_rx;
@@ -3230,8 +3264,6 @@ static int network_stats_read(void) /* {{{ */
 } /* }}} int network_stats_read */
 
 static int network_init(void) {
-  static bool have_init;
-
   /* Check if we were already initialized. If so, just return - there's
    * nothing more to do (for now, that is). */
   if (have_init)
@@ -3320,4 +3352,5 @@ void module_register(void) {
   plugin_register_init("network", network_init);
   plugin_register_flush("network", network_flush,
                         /* user_data = */ NULL);
+  plugin_register_reset("network", network_reset);
 } /* void module_register */
@@ -103,6 +103,11 @@
 #ifndef CONFIG_HZ
 #define CONFIG_HZ 100
 #endif
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -188,6 +193,7 @@ typedef struct process_entry_s {
   unsigned long id;
   char name[PROCSTAT_NAME_LEN];
   unsigned long uid;
+  unsigned long long starttime;
 
   unsigned long num_proc;
   unsigned long num_lwp;
@@ -326,7 +332,120 @@ static mach_msg_type_number_t pset_list_len;
 
 #elif KERNEL_LINUX
 static long pagesize_g;
-static void ps_fill_details(const procstat_t *ps, process_entry_t *entry);
+
+/* State kept across reads for every PID in /proc. A PID is identified by its
+ * number and start time, so that a reused PID starts with a fresh state. The
+ * match result is reused until the name (comm) or the user of the process
+ * changes; an exec(3) that keeps the name is therefore not noticed. */
+typedef struct ps_pid_state_s {
+  unsigned long pid;
+  unsigned long long starttime;
+  char name[PROCSTAT_NAME_LEN];
+  unsigned long uid;
+  char *cmdline;
+  char *username;
+
+  bool matched;
+  procstat_t *match;
+  procstat_entry_t *instance;
+
+  uint64_t generation;
+  struct ps_pid_state_s *next;
+} ps_pid_state_t;
+
+static ps_pid_state_t **pid_table;
+static size_t pid_table_size;
+static size_t pid_table_count;
+static uint64_t pid_generation;
+
+/* Set by ps_init() if any group needs the command line or the user name. */
+static bool need_cmdline;
+static bool need_username;
+
+/* Cache of user names and user_re results by uid. Entries are resolved again
+ * after USER_CACHE_TTL, and the cache is flushed if /etc/passwd changes or
+ * it holds more than USER_CACHE_MAX entries. */
+#define USER_CACHE_BUCKETS 256
+#define USER_CACHE_MAX 4096
+#define USER_CACHE_TTL TIME_T_TO_CDTIME_T(300)
+
+typedef struct ps_user_s {
+  unsigned long uid;
+  char *name;
+  cdtime_t expires;
+  /* user_re result for every group, in the order of list_head_g */
+  bool *match;
+  struct ps_user_s *next;
+} ps_user_t;
+
+static ps_user_t *user_cache[USER_CACHE_BUCKETS];
+static size_t user_cache_num;
+static struct timespec passwd_mtime;
+static size_t groups_num;
+
+/* With UseProcessConnector the PID table is kept up to date by the kernel's
+ * process events, and /proc is only scanned if events have been lost. */
+static bool use_connector;
+static int connector_fd = -1;
+static bool connector_rescan = true;
+static int ps_connector_open(void);
+#if HAVE_LIBTASKSTATS
+static int ps_exit_listener_open(void);
+#endif
+
+/* With ReadThreads the processes are split across workers. Worker 0 runs in
+ * the thread of the read callback, the others are started by ps_init() and
+ * wait for ps_run_stage() to hand them a stage. Every worker has its own
+ * taskstats socket. */
+typedef struct ps_worker_s {
+  size_t index;
+  pthread_t thread;
+  bool started;
+  /* The last stage_generation this worker has run. */
+  uint64_t generation;
+#if HAVE_LIBTASKSTATS
+  ts_t *ts;
+  c_complain_t delay_complaint;
+#endif
+} ps_worker_t;
+
+static ps_worker_t *workers;
+static size_t workers_num = 1;
+
+/* The stage the workers run, protected by stage_lock. Incrementing
+ * stage_generation starts the stage; stage_pending counts the workers which
+ * have not finished it yet. */
+static pthread_mutex_t stage_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stage_start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t stage_done_cond = PTHREAD_COND_INITIALIZER;
+static void (*stage_func)(ps_worker_t *);
+static uint64_t stage_generation;
+static size_t stage_pending;
+static bool stage_shutdown;
+
+static void *ps_worker_thread(void *arg);
+
+/* A process to read during the current read. The results are only written
+ * by the worker owning the task and accounted by the read callback after
+ * all workers have finished, so that no locking is required. */
+typedef struct {
+  process_entry_t entry;
+  char state;
+  bool valid;
+  bool have_status;
+  procstat_t *match;
+  procstat_entry_t *instance;
+} ps_task_t;
+
+static ps_task_t *tasks;
+static size_t tasks_num;
+static size_t tasks_size;
+
+#if HAVE_LIBTASKSTATS
+/* Receives the delay accounting totals of exiting processes. */
+static bool report_delay_exits;
+static ts_t *exit_listener;
+#endif
 /* #endif KERNEL_LINUX */
 
 #elif HAVE_LIBKVM_GETPROCS &&                                                  \
@@ -354,10 +473,6 @@ int getthrds64(pid_t, void *, int, tid64_t *, int);
 int getargs(void *processBuffer, int bufferLen, char *argsBuffer, int argsLen);
 #endif /* HAVE_PROCINFO_H */
 
-#if HAVE_LIBTASKSTATS
-static ts_t *taskstats_handle;
-#endif
-
 /* put name of process from config to list_head_g tree
  * list_head_g is a list of 'procstat_t' structs with
  * processes names we want to watch */
@@ -479,11 +594,10 @@ static procstat_t *ps_list_register(const char *name, const char *cmd_regexp,
   return new;
 } /* void ps_list_register */
 
-/* try to match name against entry, returns 1 if success */
-static int ps_list_match(const char *name, const char *cmdline,
-                         const char *username, procstat_t *ps) {
+/* try to match name or command line against entry */
+static bool ps_list_match_name(const char *name, const char *cmdline,
+                               procstat_t *ps) {
   bool match_name = false;
-  bool match_user = true;
 #if HAVE_REGEX_H
   if (ps->cmd_re != NULL) {
     int status;
@@ -506,6 +620,12 @@ static int ps_list_match(const char *name, const char *cmdline,
       if (strcmp(ps->name, name) == 0)
     match_name = true;
 
+  return match_name;
+} /* bool ps_list_match_name */
+
+/* try to match user name against entry */
+static bool ps_list_match_user(const char *username, procstat_t *ps) {
+  bool match_user = true;
 #if HAVE_PWD_H
   if (ps->user_re != NULL && username != NULL) {
     int status;
@@ -519,7 +639,14 @@ static int ps_list_match(const char *name, const char *cmdline,
   }
 #endif
 
-  return match_name && match_user;
+  return match_user;
+} /* bool ps_list_match_user */
+
+/* try to match name against entry, returns 1 if success */
+static int ps_list_match(const char *name, const char *cmdline,
+                         const char *username, procstat_t *ps) {
+  return ps_list_match_name(name, cmdline, ps) &&
+         ps_list_match_user(username, ps);
 } /* int ps_list_match */
 
 static void ps_update_counter(derive_t *group_counter, derive_t *curr_counter,
@@ -576,94 +703,116 @@ static void ps_update_delay(procstat_t *out, procstat_entry_t *prev,
 }
 #endif
 
-/* add process entry to 'instances' of process 'name' (or refresh it) */
-static void ps_list_add(const char *name, const char *cmdline,
-                        const char *username, process_entry_t *entry) {
+/* return the first group matching the process, or NULL */
+static procstat_t *ps_list_search(const char *name, const char *cmdline,
+                                  const char *username) {
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next)
+    if (ps_list_match(name, cmdline, username, ps))
+      return ps;
+
+  return NULL;
+} /* procstat_t *ps_list_search */
+
+/* return the instance 'id' of group 'ps', adding it if it does not exist */
+static procstat_entry_t *ps_list_instance(procstat_t *ps, unsigned long id) {
   procstat_entry_t *pse;
 
-  if (entry->id == 0)
-    return;
+  for (pse = ps->instances; pse != NULL; pse = pse->next)
+    if ((pse->id == id) || (pse->next == NULL))
+      break;
 
-  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
-    if ((ps_list_match(name, cmdline, username, ps)) == 0)
-      continue;
+  if ((pse == NULL) || (pse->id != id)) {
+    procstat_entry_t *new;
 
-#if KERNEL_LINUX
-    ps_fill_details(ps, entry);
-#endif
+    new = calloc(1, sizeof(*new));
+    if (new == NULL)
+      return NULL;
+    new->id = id;
 
-    for (pse = ps->instances; pse != NULL; pse = pse->next)
-      if ((pse->id == entry->id) || (pse->next == NULL))
-        break;
+    if (pse == NULL)
+      ps->instances = new;
+    else
+      pse->next = new;
 
-    if ((pse == NULL) || (pse->id != entry->id)) {
-      procstat_entry_t *new;
+    pse = new;
+  }
 
-      new = calloc(1, sizeof(*new));
-      if (new == NULL)
-        return;
-      new->id = entry->id;
+  return pse;
+} /* procstat_entry_t *ps_list_instance */
 
-      if (pse == NULL)
-        ps->instances = new;
-      else
-        pse->next = new;
+/* add the counters of process entry to group 'ps' and refresh instance 'pse' */
+static void ps_list_account(procstat_t *ps, procstat_entry_t *pse,
+                            process_entry_t *entry) {
+  pse->age = 0;
 
-      pse = new;
-    }
+  ps->num_proc += entry->num_proc;
+  ps->num_lwp += entry->num_lwp;
+  ps->num_fd += entry->num_fd;
+  ps->num_maps += entry->num_maps;
+  ps->vmem_size += entry->vmem_size;
+  ps->vmem_rss += entry->vmem_rss;
+  ps->vmem_data += entry->vmem_data;
+  ps->vmem_code += entry->vmem_code;
+  ps->stack_size += entry->stack_size;
 
-    pse->age = 0;
-
-    ps->num_proc += entry->num_proc;
-    ps->num_lwp += entry->num_lwp;
-    ps->num_fd += entry->num_fd;
-    ps->num_maps += entry->num_maps;
-    ps->vmem_size += entry->vmem_size;
-    ps->vmem_rss += entry->vmem_rss;
-    ps->vmem_data += entry->vmem_data;
-    ps->vmem_code += entry->vmem_code;
-    ps->stack_size += entry->stack_size;
-
-    if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
-      ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
-      ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
-    }
+  if ((entry->io_rchar != -1) && (entry->io_wchar != -1)) {
+    ps_update_counter(&ps->io_rchar, &pse->io_rchar, entry->io_rchar);
+    ps_update_counter(&ps->io_wchar, &pse->io_wchar, entry->io_wchar);
+  }
 
-    if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
-      ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
-      ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
-    }
+  if ((entry->io_syscr != -1) && (entry->io_syscw != -1)) {
+    ps_update_counter(&ps->io_syscr, &pse->io_syscr, entry->io_syscr);
+    ps_update_counter(&ps->io_syscw, &pse->io_syscw, entry->io_syscw);
+  }
 
-    if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
-      ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
-      ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
-    }
+  if ((entry->io_diskr != -1) && (entry->io_diskw != -1)) {
+    ps_update_counter(&ps->io_diskr, &pse->io_diskr, entry->io_diskr);
+    ps_update_counter(&ps->io_diskw, &pse->io_diskw, entry->io_diskw);
+  }
 
-    if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
-      ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol,
-                        entry->cswitch_vol);
-      ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
-                        entry->cswitch_invol);
-    }
+  if ((entry->cswitch_vol != -1) && (entry->cswitch_invol != -1)) {
+    ps_update_counter(&ps->cswitch_vol, &pse->cswitch_vol, entry->cswitch_vol);
+    ps_update_counter(&ps->cswitch_invol, &pse->cswitch_invol,
+                      entry->cswitch_invol);
+  }
 
-    ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
-                      entry->vmem_minflt_counter);
-    ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
-                      entry->vmem_majflt_counter);
+  ps_update_counter(&ps->vmem_minflt_counter, &pse->vmem_minflt_counter,
+                    entry->vmem_minflt_counter);
+  ps_update_counter(&ps->vmem_majflt_counter, &pse->vmem_majflt_counter,
+                    entry->vmem_majflt_counter);
 
-    ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
-                      entry->cpu_user_counter);
-    ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
-                      entry->cpu_system_counter);
+  ps_update_counter(&ps->cpu_user_counter, &pse->cpu_user_counter,
+                    entry->cpu_user_counter);
+  ps_update_counter(&ps->cpu_system_counter, &pse->cpu_system_counter,
+                    entry->cpu_system_counter);
 
 #if HAVE_LIBTASKSTATS
-    if (entry->has_delay)
-      ps_update_delay(ps, pse, entry);
+  if (entry->has_delay)
+    ps_update_delay(ps, pse, entry);
 #endif
+} /* void ps_list_account */
 
-    break;
-  }
+#if !KERNEL_LINUX
+/* add process entry to 'instances' of process 'name' (or refresh it) */
+static void ps_list_add(const char *name, const char *cmdline,
+                        const char *username, process_entry_t *entry) {
+  procstat_t *ps;
+  procstat_entry_t *pse;
+
+  if (entry->id == 0)
+    return;
+
+  ps = ps_list_search(name, cmdline, username);
+  if (ps == NULL)
+    return;
+
+  pse = ps_list_instance(ps, entry->id);
+  if (pse == NULL)
+    return;
+
+  ps_list_account(ps, pse, entry);
 }
+#endif /* !KERNEL_LINUX */
 
 /* remove old entries from instances of processes in list_head_g */
 static void ps_list_reset(void) {
@@ -816,6 +965,32 @@ static int ps_config(oconfig_item_t *ci) {
 #else
       WARNING(LOG_KEY "The plugin has been compiled without support "
                       "for the \"CollectDelayAccounting\" option.");
+#endif
+    } else if (strcasecmp(c->key, "CollectDelayAccountingExits") == 0) {
+#if KERNEL_LINUX && HAVE_LIBTASKSTATS
+      cf_util_get_boolean(c, &report_delay_exits);
+#else
+      WARNING(LOG_KEY "The plugin has been compiled without support "
+                      "for the \"CollectDelayAccountingExits\" option.");
+#endif
+    } else if (strcasecmp(c->key, "ReadThreads") == 0) {
+#if KERNEL_LINUX
+      int tmp = 0;
+      if ((cf_util_get_int(c, &tmp) != 0) || (tmp < 1)) {
+        ERROR(LOG_KEY "`ReadThreads' expects a positive integer.");
+        continue;
+      }
+      workers_num = (size_t)tmp;
+#else
+      WARNING(LOG_KEY "The \"ReadThreads\" option is only "
+                      "available on Linux.");
+#endif
+    } else if (strcasecmp(c->key, "UseProcessConnector") == 0) {
+#if KERNEL_LINUX
+      cf_util_get_boolean(c, &use_connector);
+#else
+      WARNING(LOG_KEY "The \"UseProcessConnector\" option is only "
+                      "available on Linux.");
 #endif
     } else {
       ERROR(LOG_KEY "The `%s' configuration option is not "
@@ -856,13 +1031,55 @@ static int ps_init(void) {
   pagesize_g = sysconf(_SC_PAGESIZE);
   DEBUG(LOG_KEY "pagesize_g = %li; CONFIG_HZ = %i;", pagesize_g, CONFIG_HZ);
 
+  groups_num = 0;
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next) {
+#if HAVE_REGEX_H
+    if (ps->cmd_re != NULL)
+      need_cmdline = true;
+    if (ps->user_re != NULL)
+      need_username = true;
+#endif
+    groups_num++;
+  }
+
+  if (use_connector && (connector_fd < 0) && (ps_connector_open() != 0))
+    WARNING(LOG_KEY "Receiving process events failed, scanning /proc in "
+                    "every interval instead.");
+
+  if (workers == NULL) {
+    workers = calloc(workers_num, sizeof(*workers));
+    if (workers == NULL) {
+      ERROR(LOG_KEY "calloc failed.");
+      return -1;
+    }
+
+    for (size_t i = 0; i < workers_num; i++) {
+      workers[i].index = i;
 #if HAVE_LIBTASKSTATS
-  if (taskstats_handle == NULL) {
-    taskstats_handle = ts_create();
-    if (taskstats_handle == NULL) {
-      WARNING(LOG_KEY "Creating taskstats handle failed.");
+      workers[i].ts = ts_create();
+      if (workers[i].ts == NULL) {
+        WARNING(LOG_KEY "Creating taskstats handle failed.");
+      }
+#endif
+    }
+
+    /* Workers which fail to start are run by the read callback. */
+    stage_shutdown = false;
+    for (size_t i = 1; i < workers_num; i++) {
+      workers[i].generation = stage_generation;
+      workers[i].started = (plugin_thread_create(&workers[i].thread,
+                                                 ps_worker_thread, workers + i,
+                                                 "processes2") == 0);
+      if (!workers[i].started)
+        WARNING(LOG_KEY "Starting read thread %zu failed.", i);
     }
   }
+
+#if HAVE_LIBTASKSTATS
+  if (report_delay_exits && (exit_listener == NULL) &&
+      (ps_exit_listener_open() != 0))
+    WARNING(LOG_KEY "Listening for the delay accounting information of "
+                    "exiting processes failed.");
 #endif
   /* #endif KERNEL_LINUX */
 
@@ -1314,19 +1531,15 @@ static int ps_count_fd(int pid) {
 } /* int ps_count_fd (pid) */
 
 #if HAVE_LIBTASKSTATS
-static int ps_delay(process_entry_t *ps) {
-  if (taskstats_handle == NULL) {
-    return ENOTCONN;
-  }
-
-  int status = ts_delay_by_tgid(taskstats_handle, (uint32_t)ps->id, &ps->delay);
+/* ps_delay_error reports an error returned by ts_delay_by_tgids(). "c" limits
+ * the permission errors of the calling thread. */
+static void ps_delay_error(c_complain_t *c, int status) {
   if (status == EPERM) {
-    static c_complain_t c;
 #if defined(HAVE_SYS_CAPABILITY_H) && defined(CAP_NET_ADMIN)
     if (check_capability(CAP_NET_ADMIN) != 0) {
       if (getuid() == 0) {
         c_complain(
-            LOG_ERR, &c,
+            LOG_ERR, c,
             LOG_KEY
             "Reading Delay Accounting metric failed: %s. "
             "collectd is running as root, but missing the CAP_NET_ADMIN "
@@ -1335,7 +1548,7 @@ static int ps_delay(process_entry_t *ps) {
             STRERROR(status));
       } else {
         c_complain(
-            LOG_ERR, &c,
+            LOG_ERR, c,
             LOG_KEY
             "Reading Delay Accounting metric failed: %s. "
             "collectd is not running as root and missing the CAP_NET_ADMIN "
@@ -1346,26 +1559,22 @@ static int ps_delay(process_entry_t *ps) {
       }
     } else {
       ERROR(LOG_KEY
-            "ts_delay_by_tgid failed: %s. The CAP_NET_ADMIN "
+            "ts_delay_by_tgids failed: %s. The CAP_NET_ADMIN "
             "capability is available (I checked), so this error is utterly "
             "unexpected.",
             STRERROR(status));
     }
 #else
-    c_complain(LOG_ERR, &c,
+    c_complain(LOG_ERR, c,
                LOG_KEY
                "Reading Delay Accounting metric failed: %s. "
                "Reading Delay Accounting metrics requires root privileges.",
                STRERROR(status));
 #endif
-    return status;
-  } else if (status != 0) {
-    ERROR(LOG_KEY "ts_delay_by_tgid failed: %s", STRERROR(status));
-    return status;
+  } else {
+    ERROR(LOG_KEY "ts_delay_by_tgids failed: %s", STRERROR(status));
   }
-
-  return 0;
-}
+} /* void ps_delay_error */
 #endif
 
 static void ps_fill_details(const procstat_t *ps, process_entry_t *entry) {
@@ -1396,14 +1605,6 @@ static void ps_fill_details(const procstat_t *ps, process_entry_t *entry) {
     }
     entry->has_fd = true;
   }
-
-#if HAVE_LIBTASKSTATS
-  if (ps->report_delay && !entry->has_delay) {
-    if (ps_delay(entry) == 0) {
-      entry->has_delay = true;
-    }
-  }
-#endif
 } /* void ps_fill_details (...) */
 
 /* ps_read_process reads process counters on Linux. */
@@ -1476,18 +1677,14 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
   }
 
   *state = fields[0][0];
+  ps->starttime = strtoull(fields[19], /* endptr = */ NULL, /* base = */ 10);
 
+  /* /proc/<pid>/status is only read by the stages if it is needed. */
   if (*state == 'Z') {
     ps->num_lwp = 0;
     ps->num_proc = 0;
   } else {
     ps->num_lwp = strtoul(fields[17], /* endptr = */ NULL, /* base = */ 10);
-    if ((ps_read_status(pid, ps)) != 0) {
-      /* No VMem data */
-      ps->vmem_data = -1;
-      ps->vmem_code = -1;
-      DEBUG(LOG_KEY "ps_read_process: did not get vmem data for pid %li", pid);
-    }
     if (ps->num_lwp == 0)
       ps->num_lwp = 1;
     ps->num_proc = 1;
@@ -1542,15 +1739,20 @@ static int ps_read_process(long pid, process_entry_t *ps, char *state) {
   return 0;
 } /* int ps_read_process (...) */
 
-static int procs_running(void) {
+/* procs_stat returns the value of "procs_running" or "procs_blocked" from
+ * /proc/stat. */
+static int procs_stat(const char *key) {
   char buffer[65536] = {};
-  char id[] = "procs_running "; /* white space terminated */
+  char id[32];
   char *running;
   char *endptr = NULL;
   long result = 0L;
 
   ssize_t status;
 
+  /* white space terminated */
+  snprintf(id, sizeof(id), "%s ", key);
+
   status = read_file_contents("/proc/stat", buffer, sizeof(buffer) - 1);
   if (status <= 0) {
     return -1;
@@ -1564,7 +1766,7 @@ static int procs_running(void) {
    */
   running = strstr(buffer, id);
   if (!running) {
-    WARNING(LOG_KEY "procs_running not found");
+    WARNING(LOG_KEY "%s not found", key);
     return -1;
   }
   running += strlen(id);
@@ -1683,6 +1885,761 @@ static char *ps_get_username(unsigned long uid, char *buf, size_t buf_len) {
   return buf;
 }
 
+static void ps_user_cache_flush(void) {
+  for (size_t i = 0; i < USER_CACHE_BUCKETS; i++) {
+    while (user_cache[i] != NULL) {
+      ps_user_t *u = user_cache[i];
+
+      user_cache[i] = u->next;
+      sfree(u->name);
+      sfree(u->match);
+      sfree(u);
+    }
+  }
+  user_cache_num = 0;
+} /* void ps_user_cache_flush */
+
+/* ps_user_cache_check flushes the cache if /etc/passwd has been modified. */
+static void ps_user_cache_check(void) {
+  struct stat statbuf;
+
+  if (stat("/etc/passwd", &statbuf) != 0)
+    return;
+
+  if ((statbuf.st_mtim.tv_sec == passwd_mtime.tv_sec) &&
+      (statbuf.st_mtim.tv_nsec == passwd_mtime.tv_nsec))
+    return;
+
+  DEBUG(LOG_KEY "/etc/passwd has changed, flushing the user cache.");
+  ps_user_cache_flush();
+  passwd_mtime = statbuf.st_mtim;
+} /* void ps_user_cache_check */
+
+static int ps_user_resolve(ps_user_t *u) {
+  char username[USER_NAME_BUFFER_SIZE];
+  size_t i = 0;
+  char *name;
+
+  name = strdup(ps_get_username(u->uid, username, sizeof(username)));
+  if (name == NULL)
+    return ENOMEM;
+  sfree(u->name);
+  u->name = name;
+
+  for (procstat_t *ps = list_head_g; (ps != NULL) && (i < groups_num);
+       ps = ps->next, i++)
+    u->match[i] = ps_list_match_user(u->name, ps);
+
+  u->expires = cdtime() + USER_CACHE_TTL;
+  return 0;
+} /* int ps_user_resolve */
+
+/* ps_user_lookup returns the cached user "uid", resolving it if it is new or
+ * has expired. Returns NULL if memory is exhausted. */
+static ps_user_t *ps_user_lookup(unsigned long uid) {
+  size_t idx = uid % USER_CACHE_BUCKETS;
+  ps_user_t *u;
+
+  for (u = user_cache[idx]; u != NULL; u = u->next)
+    if (u->uid == uid)
+      break;
+
+  if (u == NULL) {
+    if (user_cache_num >= USER_CACHE_MAX) {
+      ps_user_cache_flush();
+      idx = uid % USER_CACHE_BUCKETS;
+    }
+
+    u = calloc(1, sizeof(*u));
+    if (u == NULL)
+      return NULL;
+    u->uid = uid;
+    u->match = calloc(groups_num + 1, sizeof(*u->match));
+    if (u->match == NULL) {
+      sfree(u);
+      return NULL;
+    }
+
+    u->next = user_cache[idx];
+    user_cache[idx] = u;
+    user_cache_num++;
+  } else if (u->expires > cdtime()) {
+    return u;
+  }
+
+  /* Keep using the old name if resolving fails. */
+  if ((ps_user_resolve(u) != 0) && (u->name == NULL))
+    return NULL;
+
+  return u;
+} /* ps_user_t *ps_user_lookup */
+
+/* return the first group matching the process, using the cached user_re
+ * results of "user" */
+static procstat_t *ps_list_search_user(const char *name, const char *cmdline,
+                                       const ps_user_t *user) {
+  size_t i = 0;
+
+  for (procstat_t *ps = list_head_g; ps != NULL; ps = ps->next, i++)
+    if (user->match[i] && ps_list_match_name(name, cmdline, ps))
+      return ps;
+
+  return NULL;
+} /* procstat_t *ps_list_search_user */
+
+static void ps_pid_free(ps_pid_state_t *st) {
+  if (st == NULL)
+    return;
+
+  sfree(st->cmdline);
+  sfree(st->username);
+  sfree(st);
+} /* void ps_pid_free */
+
+static int ps_pid_table_grow(void) {
+  size_t new_size = (pid_table_size == 0) ? 1024 : 2 * pid_table_size;
+  ps_pid_state_t **new_table;
+
+  new_table = calloc(new_size, sizeof(*new_table));
+  if (new_table == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < pid_table_size; i++) {
+    ps_pid_state_t *st = pid_table[i];
+    while (st != NULL) {
+      ps_pid_state_t *next = st->next;
+      size_t idx = st->pid & (new_size - 1);
+
+      st->next = new_table[idx];
+      new_table[idx] = st;
+      st = next;
+    }
+  }
+
+  sfree(pid_table);
+  pid_table = new_table;
+  pid_table_size = new_size;
+  return 0;
+} /* int ps_pid_table_grow */
+
+static ps_pid_state_t *ps_pid_find(unsigned long pid) {
+  if (pid_table_size == 0)
+    return NULL;
+
+  for (ps_pid_state_t *st = pid_table[pid & (pid_table_size - 1)]; st != NULL;
+       st = st->next)
+    if (st->pid == pid)
+      return st;
+
+  return NULL;
+} /* ps_pid_state_t *ps_pid_find */
+
+static void ps_pid_remove(unsigned long pid) {
+  if (pid_table_size == 0)
+    return;
+
+  for (ps_pid_state_t **prev = &pid_table[pid & (pid_table_size - 1)];
+       *prev != NULL; prev = &(*prev)->next) {
+    ps_pid_state_t *st = *prev;
+
+    if (st->pid != pid)
+      continue;
+
+    *prev = st->next;
+    ps_pid_free(st);
+    pid_table_count--;
+    return;
+  }
+} /* void ps_pid_remove */
+
+/* ps_pid_lookup returns the state of the process "pid", adding it if the PID
+ * is new and resetting it if the PID has been reused. */
+static ps_pid_state_t *ps_pid_lookup(unsigned long pid,
+                                     unsigned long long starttime) {
+  ps_pid_state_t *st;
+  size_t idx;
+
+  st = ps_pid_find(pid);
+  if (st != NULL) {
+    if (st->starttime != starttime) {
+      sfree(st->cmdline);
+      sfree(st->username);
+      st->starttime = starttime;
+      st->name[0] = 0;
+      st->matched = false;
+      st->match = NULL;
+      st->instance = NULL;
+    }
+    return st;
+  }
+
+  if ((pid_table_count >= pid_table_size) && (ps_pid_table_grow() != 0) &&
+      (pid_table_size == 0)) {
+    ERROR(LOG_KEY "ps_pid_lookup: calloc failed.");
+    return NULL;
+  }
+
+  st = calloc(1, sizeof(*st));
+  if (st == NULL) {
+    ERROR(LOG_KEY "ps_pid_lookup: calloc failed.");
+    return NULL;
+  }
+  st->pid = pid;
+  st->starttime = starttime;
+
+  idx = pid & (pid_table_size - 1);
+  st->next = pid_table[idx];
+  pid_table[idx] = st;
+  pid_table_count++;
+
+  return st;
+} /* ps_pid_state_t *ps_pid_lookup */
+
+/* ps_pid_sweep removes the state of all processes not seen by the current
+ * read. Their instances are freed by ps_list_reset() during the next read,
+ * so a cached instance pointer is always valid. */
+static void ps_pid_sweep(void) {
+  for (size_t i = 0; i < pid_table_size; i++) {
+    ps_pid_state_t **prev = &pid_table[i];
+
+    while (*prev != NULL) {
+      ps_pid_state_t *st = *prev;
+
+      if (st->generation == pid_generation) {
+        prev = &st->next;
+        continue;
+      }
+
+      *prev = st->next;
+      ps_pid_free(st);
+      pid_table_count--;
+    }
+  }
+} /* void ps_pid_sweep */
+
+static void ps_pid_table_free(void) {
+  for (size_t i = 0; i < pid_table_size; i++) {
+    while (pid_table[i] != NULL) {
+      ps_pid_state_t *st = pid_table[i];
+      pid_table[i] = st->next;
+      ps_pid_free(st);
+    }
+  }
+
+  sfree(pid_table);
+  pid_table_size = 0;
+  pid_table_count = 0;
+} /* void ps_pid_table_free */
+
+static void ps_read_status_entry(long pid, process_entry_t *entry) {
+  if ((ps_read_status(pid, entry)) != 0) {
+    /* No VMem data */
+    entry->vmem_data = -1;
+    entry->vmem_code = -1;
+    DEBUG(LOG_KEY "ps_read_status_entry: did not get vmem data for pid %li",
+          pid);
+  }
+} /* void ps_read_status_entry */
+
+/* ps_match_task matches a process against the configured groups. The
+ * command line, user name and match result are cached in the PID state, so
+ * that only new and changed processes are matched again. */
+static void ps_match_task(ps_task_t *t) {
+  process_entry_t *entry = &t->entry;
+  ps_user_t *user = NULL;
+  ps_pid_state_t *st;
+
+  st = ps_pid_lookup(entry->id, entry->starttime);
+  if (st == NULL)
+    return;
+  st->generation = pid_generation;
+
+  if (strcmp(st->name, entry->name) != 0) {
+    sstrncpy(st->name, entry->name, sizeof(st->name));
+    sfree(st->cmdline);
+    st->matched = false;
+  }
+
+  /* Zombies have no uid and are reported as root. */
+  if (need_username) {
+    user = ps_user_lookup(entry->uid);
+    if ((user != NULL) &&
+        ((st->username == NULL) || (st->uid != entry->uid) ||
+         (strcmp(st->username, user->name) != 0))) {
+      sfree(st->username);
+      st->username = strdup(user->name);
+      st->uid = entry->uid;
+      st->matched = false;
+    }
+  }
+
+  if (need_cmdline && (st->cmdline == NULL)) {
+    char cmdline[CMDLINE_BUFFER_SIZE];
+    char *tmp;
+
+    /* NULL if the process has exited meanwhile, the name is used then. */
+    tmp = ps_get_cmdline(entry->id, entry->name, cmdline, sizeof(cmdline));
+    st->cmdline = strdup((tmp != NULL) ? tmp : "");
+    st->matched = false;
+  }
+
+  if (!st->matched) {
+    procstat_t *ps;
+
+    if (user != NULL)
+      ps = ps_list_search_user(entry->name, st->cmdline, user);
+    else
+      ps = ps_list_search(entry->name, st->cmdline, st->username);
+
+    if (ps != st->match) {
+      st->match = ps;
+      st->instance = NULL;
+    }
+    st->matched = true;
+  }
+
+  if (st->match == NULL)
+    return;
+
+  if (st->instance == NULL)
+    st->instance = ps_list_instance(st->match, entry->id);
+  if (st->instance == NULL)
+    return;
+
+  t->match = st->match;
+  t->instance = st->instance;
+} /* void ps_match_task */
+
+/* Stage 1: read /proc/<pid>/stat, and the status file if the uid is required
+ * for matching. */
+static void ps_stage_stat(ps_worker_t *w) {
+  for (size_t i = w->index; i < tasks_num; i += workers_num) {
+    ps_task_t *t = tasks + i;
+    long pid = (long)t->entry.id;
+
+    if (ps_read_process(pid, &t->entry, &t->state) != 0) {
+      DEBUG(LOG_KEY "ps_read_process failed for pid %li", pid);
+      continue;
+    }
+    t->valid = true;
+
+    if (need_username && (t->state != 'Z')) {
+      ps_read_status_entry(pid, &t->entry);
+      t->have_status = true;
+    }
+  }
+} /* void ps_stage_stat */
+
+#if HAVE_LIBTASKSTATS
+/* ps_read_delay queries the delay accounting information of the worker's
+ * matched processes in one batch. */
+static void ps_read_delay(ps_worker_t *w) {
+  uint32_t *tgids = NULL;
+  ts_delay_t *delays = NULL;
+  int *statuses = NULL;
+  size_t num = 0;
+
+  if (w->ts == NULL)
+    return;
+
+  for (size_t i = w->index; i < tasks_num; i += workers_num)
+    if ((tasks[i].match != NULL) && tasks[i].match->report_delay)
+      num++;
+  if (num == 0)
+    return;
+
+  tgids = calloc(num, sizeof(*tgids));
+  delays = calloc(num, sizeof(*delays));
+  statuses = calloc(num, sizeof(*statuses));
+  if ((tgids == NULL) || (delays == NULL) || (statuses == NULL)) {
+    ERROR(LOG_KEY "ps_read_delay: calloc failed.");
+    goto out;
+  }
+
+  num = 0;
+  for (size_t i = w->index; i < tasks_num; i += workers_num)
+    if ((tasks[i].match != NULL) && tasks[i].match->report_delay)
+      tgids[num++] = (uint32_t)tasks[i].entry.id;
+
+  int status = ts_delay_by_tgids(w->ts, tgids, num, delays, statuses);
+  if (status != 0)
+    ps_delay_error(&w->delay_complaint, status);
+
+  num = 0;
+  for (size_t i = w->index; i < tasks_num; i += workers_num) {
+    ps_task_t *t = tasks + i;
+
+    if ((t->match == NULL) || !t->match->report_delay)
+      continue;
+
+    if (statuses[num] == 0) {
+      t->entry.delay = delays[num];
+      t->entry.has_delay = true;
+    } else if ((status == 0) && (statuses[num] != ESRCH)) {
+      /* ESRCH: the process has exited meanwhile. */
+      ps_delay_error(&w->delay_complaint, statuses[num]);
+      status = statuses[num];
+    }
+    num++;
+  }
+
+out:
+  sfree(tgids);
+  sfree(delays);
+  sfree(statuses);
+} /* void ps_read_delay */
+#endif
+
+#if HAVE_LIBTASKSTATS
+static int ps_exit_listener_open(void) {
+  char cpumask[256];
+  ssize_t len;
+  int status;
+
+  len = read_text_file_contents("/sys/devices/system/cpu/possible", cpumask,
+                                sizeof(cpumask));
+  if (len <= 0) {
+    ERROR(LOG_KEY "Reading the possible CPUs failed.");
+    return -1;
+  }
+  while ((len > 0) && isspace((int)cpumask[len - 1]))
+    cpumask[--len] = 0;
+
+  exit_listener = ts_create();
+  if (exit_listener == NULL)
+    return -1;
+
+  status = ts_listen(exit_listener, cpumask);
+  if (status != 0) {
+    static c_complain_t c = C_COMPLAIN_INIT_STATIC;
+    /* Only called by ps_init(), so "c" is not shared between threads. */
+    ps_delay_error(&c, status);
+    ts_destroy(exit_listener);
+    exit_listener = NULL;
+    return -1;
+  }
+
+  return 0;
+} /* int ps_exit_listener_open */
+
+/* ps_exit_account adds the delay of a process, which has exited since the
+ * last read, to the rate of its group. Its PID state and instance are still
+ * around at this point. */
+static void ps_exit_account(uint32_t id, bool thread_group,
+                            ts_delay_t const *delay,
+                            __attribute__((unused)) void *user_data) {
+  ps_pid_state_t *st = ps_pid_find(id);
+  process_entry_t entry = {
+      .id = id,
+      .delay = *delay,
+      .has_delay = true,
+  };
+
+  if ((st == NULL) || (st->match == NULL) || (st->instance == NULL) ||
+      !st->match->report_delay)
+    return;
+
+  ps_update_delay(st->match, st->instance, &entry);
+
+  /* Don't account the process twice. */
+  ps_pid_remove(id);
+} /* void ps_exit_account */
+
+static void ps_read_exits(void) {
+  int status = ts_read_exits(exit_listener, ps_exit_account, NULL);
+
+  if (status == ENOBUFS) {
+    DEBUG(LOG_KEY "Delay accounting records of exited processes were lost.");
+  } else if (status != 0) {
+    ERROR(LOG_KEY "ts_read_exits failed: %s", STRERROR(status));
+    ts_destroy(exit_listener);
+    exit_listener = NULL;
+  }
+} /* void ps_read_exits */
+#endif
+
+/* Stage 2: read the remaining files of matched processes. */
+static void ps_stage_details(ps_worker_t *w) {
+  for (size_t i = w->index; i < tasks_num; i += workers_num) {
+    ps_task_t *t = tasks + i;
+
+    if (t->match == NULL)
+      continue;
+
+    if (!t->have_status && (t->state != 'Z'))
+      ps_read_status_entry((long)t->entry.id, &t->entry);
+
+    ps_fill_details(t->match, &t->entry);
+  }
+
+#if HAVE_LIBTASKSTATS
+  ps_read_delay(w);
+#endif
+} /* void ps_stage_details */
+
+/* ps_worker_thread runs each stage started by ps_run_stage() until
+ * ps_shutdown() stops the workers. */
+static void *ps_worker_thread(void *arg) {
+  ps_worker_t *w = arg;
+
+  pthread_mutex_lock(&stage_lock);
+  while (42) {
+    while (!stage_shutdown && (stage_generation == w->generation))
+      pthread_cond_wait(&stage_start_cond, &stage_lock);
+    if (stage_shutdown)
+      break;
+
+    w->generation = stage_generation;
+    void (*stage)(ps_worker_t *) = stage_func;
+    pthread_mutex_unlock(&stage_lock);
+
+    stage(w);
+
+    pthread_mutex_lock(&stage_lock);
+    stage_pending--;
+    if (stage_pending == 0)
+      pthread_cond_signal(&stage_done_cond);
+  }
+  pthread_mutex_unlock(&stage_lock);
+
+  return NULL;
+} /* void *ps_worker_thread */
+
+/* ps_run_stage runs "stage" in all workers and waits for them to finish. */
+static void ps_run_stage(void (*stage)(ps_worker_t *)) {
+  size_t started = 0;
+  for (size_t i = 1; i < workers_num; i++)
+    if (workers[i].started)
+      started++;
+
+  if (started > 0) {
+    pthread_mutex_lock(&stage_lock);
+    stage_func = stage;
+    stage_pending = started;
+    stage_generation++;
+    pthread_cond_broadcast(&stage_start_cond);
+    pthread_mutex_unlock(&stage_lock);
+  }
+
+  /* Do the work of workers without a thread in this thread. */
+  for (size_t i = 1; i < workers_num; i++)
+    if (!workers[i].started)
+      stage(workers + i);
+  stage(&workers[0]);
+
+  if (started > 0) {
+    pthread_mutex_lock(&stage_lock);
+    while (stage_pending > 0)
+      pthread_cond_wait(&stage_done_cond, &stage_lock);
+    pthread_mutex_unlock(&stage_lock);
+  }
+} /* void ps_run_stage */
+
+static int ps_task_add(unsigned long pid) {
+  if (tasks_num >= tasks_size) {
+    size_t new_size = (tasks_size == 0) ? 1024 : 2 * tasks_size;
+    ps_task_t *tmp = realloc(tasks, new_size * sizeof(*tasks));
+
+    if (tmp == NULL) {
+      ERROR(LOG_KEY "realloc failed.");
+      return ENOMEM;
+    }
+    tasks = tmp;
+    tasks_size = new_size;
+  }
+
+  memset(tasks + tasks_num, 0, sizeof(*tasks));
+  tasks[tasks_num].entry.id = pid;
+  tasks_num++;
+  return 0;
+} /* int ps_task_add */
+
+/* ps_add_watched adds the processes in the PID table as tasks, skipping those
+ * known not to match any group. Used instead of scanning /proc in connector
+ * mode. */
+static void ps_add_watched(void) {
+  for (size_t i = 0; i < pid_table_size; i++) {
+    for (ps_pid_state_t *st = pid_table[i]; st != NULL; st = st->next) {
+      if (st->matched && (st->match == NULL)) {
+        st->generation = pid_generation;
+        continue;
+      }
+
+      /* If the process has exited, its state is removed by ps_pid_sweep(). */
+      if (ps_task_add(st->pid) != 0)
+        return;
+    }
+  }
+} /* void ps_add_watched */
+
+static int ps_add_proc_dir(void) {
+  struct dirent *ent;
+  DIR *proc;
+  long pid;
+
+  if ((proc = opendir("/proc")) == NULL) {
+    ERROR("Cannot open `/proc': %s", STRERRNO);
+    return -1;
+  }
+
+  while ((ent = readdir(proc)) != NULL) {
+    if (!isdigit(ent->d_name[0]))
+      continue;
+
+    if ((pid = atol(ent->d_name)) < 1)
+      continue;
+
+    if (ps_task_add(pid) != 0)
+      break;
+  }
+
+  closedir(proc);
+  return 0;
+} /* int ps_add_proc_dir */
+
+static int ps_connector_open(void) {
+  /* Let the kernel choose the port ID, the procevent plugin may use the PID
+   * of the daemon already. */
+  struct sockaddr_nl sa_nl = {
+      .nl_family = AF_NETLINK,
+      .nl_groups = CN_IDX_PROC,
+  };
+  struct __attribute__((aligned(NLMSG_ALIGNTO))) {
+    struct nlmsghdr nl_hdr;
+    struct __attribute__((__packed__)) {
+      struct cn_msg cn_msg;
+      enum proc_cn_mcast_op cn_mcast;
+    };
+  } nlcn_msg = {0};
+  int rcvbuf = 1024 * 1024;
+
+  connector_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                        NETLINK_CONNECTOR);
+  if (connector_fd < 0) {
+    ERROR(LOG_KEY "socket(NETLINK_CONNECTOR) failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* Events are only read once per interval. */
+  if (setsockopt(connector_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                 sizeof(rcvbuf)) != 0)
+    WARNING(LOG_KEY "setsockopt(SO_RCVBUF) failed: %s", STRERRNO);
+
+  if (bind(connector_fd, (struct sockaddr *)&sa_nl, sizeof(sa_nl)) != 0) {
+    ERROR(LOG_KEY "binding the netlink socket failed: %s", STRERRNO);
+    close(connector_fd);
+    connector_fd = -1;
+    return -1;
+  }
+
+  nlcn_msg.nl_hdr.nlmsg_len = sizeof(nlcn_msg);
+  nlcn_msg.nl_hdr.nlmsg_type = NLMSG_DONE;
+  nlcn_msg.cn_msg.id.idx = CN_IDX_PROC;
+  nlcn_msg.cn_msg.id.val = CN_VAL_PROC;
+  nlcn_msg.cn_msg.len = sizeof(enum proc_cn_mcast_op);
+  nlcn_msg.cn_mcast = PROC_CN_MCAST_LISTEN;
+
+  if (send(connector_fd, &nlcn_msg, sizeof(nlcn_msg), 0) < 0) {
+    ERROR(LOG_KEY "subscribing to process events failed: %s", STRERRNO);
+    close(connector_fd);
+    connector_fd = -1;
+    return -1;
+  }
+
+  connector_rescan = true;
+  return 0;
+} /* int ps_connector_open */
+
+static void ps_connector_close(void) {
+  if (connector_fd < 0)
+    return;
+
+  close(connector_fd);
+  connector_fd = -1;
+} /* void ps_connector_close */
+
+static void ps_connector_event(const struct proc_event *ev) {
+  ps_pid_state_t *st;
+
+  switch (ev->what) {
+  case PROC_EVENT_FORK:
+    /* Ignore new threads. */
+    if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid)
+      return;
+    st = ps_pid_lookup(ev->event_data.fork.child_pid, 0);
+    break;
+  case PROC_EVENT_EXEC:
+    st = ps_pid_find(ev->event_data.exec.process_pid);
+    if (st == NULL)
+      st = ps_pid_lookup(ev->event_data.exec.process_pid, 0);
+    if (st != NULL)
+      sfree(st->cmdline);
+    break;
+  case PROC_EVENT_COMM:
+    if (ev->event_data.comm.process_pid != ev->event_data.comm.process_tgid)
+      return;
+    st = ps_pid_find(ev->event_data.comm.process_pid);
+    break;
+  case PROC_EVENT_UID:
+    if (ev->event_data.id.process_pid != ev->event_data.id.process_tgid)
+      return;
+    st = ps_pid_find(ev->event_data.id.process_pid);
+    break;
+  case PROC_EVENT_EXIT:
+    if (ev->event_data.exit.process_pid == ev->event_data.exit.process_tgid)
+      ps_pid_remove(ev->event_data.exit.process_pid);
+    return;
+  default:
+    return;
+  }
+
+  /* Read and match the process again during the next read. */
+  if (st != NULL)
+    st->matched = false;
+} /* void ps_connector_event */
+
+/* ps_connector_read applies all pending process events to the PID table.
+ * Returns non-zero if the socket failed and the plugin must scan /proc. */
+static int ps_connector_read(void) {
+  char buffer[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+  while (42) {
+    ssize_t status = recv(connector_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return 0;
+      if (errno == ENOBUFS) {
+        INFO(LOG_KEY "Process events have been lost, scanning /proc.");
+        connector_rescan = true;
+        continue;
+      }
+
+      ERROR(LOG_KEY "Reading process events failed: %s", STRERRNO);
+      return -1;
+    }
+
+    int len = (int)status;
+    for (struct nlmsghdr *nlh = (struct nlmsghdr *)buffer; NLMSG_OK(nlh, len);
+         nlh = NLMSG_NEXT(nlh, len)) {
+      struct cn_msg *cn_msg = NLMSG_DATA(nlh);
+      struct proc_event ev = {0};
+
+      if ((nlh->nlmsg_type == NLMSG_ERROR) || (nlh->nlmsg_type == NLMSG_NOOP))
+        continue;
+      if ((cn_msg->id.idx != CN_IDX_PROC) || (cn_msg->id.val != CN_VAL_PROC))
+        continue;
+
+      /* The event follows the 20 byte cn_msg header and is not aligned. */
+      memcpy(&ev, cn_msg->data,
+             (cn_msg->len < sizeof(ev)) ? cn_msg->len : sizeof(ev));
+      ps_connector_event(&ev);
+    }
+  }
+} /* int ps_connector_read */
+
 static int read_fork_rate(void) {
   FILE *proc_stat;
   char buffer[1024];
@@ -2187,42 +3144,43 @@ static int ps_read(void) {
   int paging = 0;
   int blocked = 0;
 
-  struct dirent *ent;
-  DIR *proc;
-  long pid;
-
-  char cmdline[CMDLINE_BUFFER_SIZE];
-  char username[USER_NAME_BUFFER_SIZE];
-
-  int status;
-  process_entry_t pse;
-  char state;
-
   running = sleeping = zombies = stopped = paging = blocked = 0;
   ps_list_reset();
+  pid_generation++;
+  tasks_num = 0;
+  if (need_username)
+    ps_user_cache_check();
 
-  if ((proc = opendir("/proc")) == NULL) {
-    ERROR("Cannot open `/proc': %s", STRERRNO);
-    return -1;
+#if HAVE_LIBTASKSTATS
+  /* Before the connector removes the PID states of exited processes. */
+  if (exit_listener != NULL)
+    ps_read_exits();
+#endif
+
+  if ((connector_fd >= 0) && (ps_connector_read() != 0)) {
+    WARNING(LOG_KEY "Falling back to scanning /proc.");
+    ps_connector_close();
   }
 
-  while ((ent = readdir(proc)) != NULL) {
-    if (!isdigit(ent->d_name[0]))
-      continue;
+  /* Only watched processes are read when receiving process events. */
+  bool read_all = (connector_fd < 0) || connector_rescan;
+  if (read_all) {
+    if (ps_add_proc_dir() != 0)
+      return -1;
+    connector_rescan = false;
+  } else {
+    ps_add_watched();
+  }
 
-    if ((pid = atol(ent->d_name)) < 1)
-      continue;
+  ps_run_stage(ps_stage_stat);
 
-    memset(&pse, 0, sizeof(pse));
-    pse.id = pid;
+  for (size_t i = 0; i < tasks_num; i++) {
+    ps_task_t *t = tasks + i;
 
-    status = ps_read_process(pid, &pse, &state);
-    if (status != 0) {
-      DEBUG(LOG_KEY "ps_read_process failed: %i", status);
+    if (!t->valid)
       continue;
-    }
 
-    switch (state) {
+    switch (t->state) {
     case 'R':
       running++;
       break;
@@ -2243,12 +3201,19 @@ static int ps_read(void) {
       break;
     }
 
-    ps_list_add(pse.name,
-                ps_get_cmdline(pid, pse.name, cmdline, sizeof(cmdline)),
-                ps_get_username(pse.uid, username, sizeof(username)), &pse);
+    ps_match_task(t);
   }
 
-  closedir(proc);
+  ps_run_stage(ps_stage_details);
+
+  /* Merge the results once all workers are done. */
+  for (size_t i = 0; i < tasks_num; i++) {
+    ps_task_t *t = tasks + i;
+
+    if (t->match != NULL)
+      ps_list_account(t->match, t->instance, &t->entry);
+  }
+  ps_pid_sweep();
 
   /* get procs_running from /proc/stat
    * scanning /proc/stat AND computing other process stats takes too much time.
@@ -2258,14 +3223,20 @@ static int ps_read(void) {
    * stat(s).
    * The 'procs_running' number in /proc/stat on the other hand is more
    * accurate, and can be retrieved in a single 'read' call. */
-  running = procs_running();
+  running = procs_stat("procs_running");
 
   ps_submit_state("running", running);
-  ps_submit_state("sleeping", sleeping);
-  ps_submit_state("zombies", zombies);
-  ps_submit_state("stopped", stopped);
-  ps_submit_state("paging", paging);
-  ps_submit_state("blocked", blocked);
+  if (!read_all) {
+    /* Not all processes are read, only the counters in /proc/stat are
+     * available. */
+    ps_submit_state("blocked", procs_stat("procs_blocked"));
+  } else {
+    ps_submit_state("sleeping", sleeping);
+    ps_submit_state("zombies", zombies);
+    ps_submit_state("stopped", stopped);
+    ps_submit_state("paging", paging);
+    ps_submit_state("blocked", blocked);
+  }
 
   for (procstat_t *ps_ptr = list_head_g; ps_ptr != NULL; ps_ptr = ps_ptr->next)
     ps_submit_proc_list(ps_ptr);
@@ -2993,8 +3964,41 @@ static int ps_read(void) {
   return 0;
 } /* int ps_read */
 
+static int ps_shutdown(void) {
+#if KERNEL_LINUX
+  ps_connector_close();
+  ps_pid_table_free();
+  ps_user_cache_flush();
+  sfree(tasks);
+  tasks_num = 0;
+  tasks_size = 0;
+
+  pthread_mutex_lock(&stage_lock);
+  stage_shutdown = true;
+  pthread_cond_broadcast(&stage_start_cond);
+  pthread_mutex_unlock(&stage_lock);
+
+  for (size_t i = 0; (workers != NULL) && (i < workers_num); i++) {
+    if (workers[i].started)
+      pthread_join(workers[i].thread, NULL);
+#if HAVE_LIBTASKSTATS
+    ts_destroy(workers[i].ts);
+#endif
+  }
+  sfree(workers);
+
+#if HAVE_LIBTASKSTATS
+  ts_destroy(exit_listener);
+  exit_listener = NULL;
+#endif
+#endif
+
+  return 0;
+} /* int ps_shutdown */
+
 void module_register(void) {
   plugin_register_complex_config("processes2", ps_config);
   plugin_register_init("processes2", ps_init);
   plugin_register_read("processes2", ps_read);
+  plugin_register_shutdown("processes2", ps_shutdown);
 } /* void module_register */
@@ -140,6 +140,8 @@ static int buffer_length;
 static circbuf_t ring;
 static processlist_t *processlist_head = NULL;
 static int event_id = 0;
+/* Only used by the dequeue thread */
+static notification_builder_t *builder;
 
 static const char *config_keys[] = {"BufferLength", "Process", "ProcessRegex"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
@@ -834,21 +836,28 @@ static int read_event() {
 static void procevent_dispatch_notification(long pid, gauge_t value,
                                             char *process, cdtime_t timestamp) {
 
-  notification_t n = {
-      .severity = (value == 1 ? NOTIF_OKAY : NOTIF_FAILURE),
-      .time = cdtime(),
-      .plugin = "procevent",
-      .type = "gauge",
-      .type_instance = "process_status",
-  };
+  if (builder == NULL) {
+    builder = plugin_notification_builder_create();
+    if (builder == NULL) {
+      ERROR("procevent plugin: unable to create notification builder");
+      return;
+    }
+  }
 
-  sstrncpy(n.host, hostname_g, sizeof(n.host));
-  sstrncpy(n.plugin_instance, process, sizeof(n.plugin_instance));
+  notification_t *n = plugin_notification_builder_reset(builder);
+  n->severity = (value == 1 ? NOTIF_OKAY : NOTIF_FAILURE);
+  n->time = cdtime();
+  sstrncpy(n->plugin, "procevent", sizeof(n->plugin));
+  sstrncpy(n->type, "gauge", sizeof(n->type));
+  sstrncpy(n->type_instance, "process_status", sizeof(n->type_instance));
+
+  sstrncpy(n->host, hostname_g, sizeof(n->host));
+  sstrncpy(n->plugin_instance, process, sizeof(n->plugin_instance));
 
   char *buf = NULL;
   gen_message_payload(value, pid, process, timestamp, &buf);
 
-  int status = plugin_notification_meta_add_string(&n, "ves", buf);
+  int status = plugin_notification_builder_add_string(builder, "ves", buf);
 
   if (status < 0) {
     sfree(buf);
@@ -858,13 +867,12 @@ static void procevent_dispatch_notification(long pid, gauge_t value,
   }
 
   DEBUG("procevent plugin: notification VES metadata: %s",
-        n.meta->nm_value.nm_string);
+        n->meta->nm_value.nm_string);
 
   DEBUG("procevent plugin: dispatching state %d for PID %ld (%s)", (int)value,
         pid, process);
 
-  plugin_dispatch_notification(&n);
-  plugin_notification_meta_free(n.meta);
+  plugin_notification_builder_dispatch(builder);
 
   // strdup'd in gen_message_payload
   if (buf != NULL)
@@ -1277,6 +1285,9 @@ static int procevent_shutdown(void) /* {{{ */
 
   free(ring.buffer);
 
+  plugin_notification_builder_destroy(builder);
+  builder = NULL;
+
   processlist_t *pl = processlist_head;
   while (pl != NULL) {
     processlist_t *pl_next;
@@ -115,6 +115,8 @@ static pthread_cond_t sysevent_cond = PTHREAD_COND_INITIALIZER;
 static int sock = -1;
 static int event_id = 0;
 static circbuf_t ring;
+/* Only used by the dequeue thread */
+static notification_builder_t *builder;
 
 static char *listen_ip;
 static char *listen_port;
@@ -488,12 +490,19 @@ static void sysevent_dispatch_notification(const char *message,
                                            cdtime_t timestamp) {
   char *buf = NULL;
 
-  notification_t n = {
-      .severity = NOTIF_OKAY,
-      .time = cdtime(),
-      .plugin = "sysevent",
-      .type = "gauge",
-  };
+  if (builder == NULL) {
+    builder = plugin_notification_builder_create();
+    if (builder == NULL) {
+      ERROR("sysevent plugin: unable to create notification builder");
+      return;
+    }
+  }
+
+  notification_t *n = plugin_notification_builder_reset(builder);
+  n->severity = NOTIF_OKAY;
+  n->time = cdtime();
+  sstrncpy(n->plugin, "sysevent", sizeof(n->plugin));
+  sstrncpy(n->type, "gauge", sizeof(n->type));
 
 #if HAVE_YAJL_V2
   if (node != NULL) {
@@ -539,7 +548,7 @@ static void sysevent_dispatch_notification(const char *message,
       sev_num = atoi(sev_num_str);
 
       if (sev_num < 4)
-        n.severity = NOTIF_FAILURE;
+        n->severity = NOTIF_FAILURE;
     }
 
     // process
@@ -584,9 +593,9 @@ static void sysevent_dispatch_notification(const char *message,
   gen_message_payload(message, NULL, -1, NULL, hostname_g, timestamp, &buf);
 #endif
 
-  sstrncpy(n.host, hostname_g, sizeof(n.host));
+  sstrncpy(n->host, hostname_g, sizeof(n->host));
 
-  int status = plugin_notification_meta_add_string(&n, "ves", buf);
+  int status = plugin_notification_builder_add_string(builder, "ves", buf);
 
   if (status < 0) {
     sfree(buf);
@@ -596,12 +605,11 @@ static void sysevent_dispatch_notification(const char *message,
   }
 
   DEBUG("sysevent plugin: notification VES metadata: %s",
-        n.meta->nm_value.nm_string);
+        n->meta->nm_value.nm_string);
 
   DEBUG("sysevent plugin: dispatching message");
 
-  plugin_dispatch_notification(&n);
-  plugin_notification_meta_free(n.meta);
+  plugin_notification_builder_dispatch(builder);
 
   // strdup'd in gen_message_payload
   if (buf != NULL)
@@ -1134,6 +1142,9 @@ static int sysevent_shutdown(void) /* {{{ */
   free(ring.buffer);
   free(ring.timestamp);
 
+  plugin_notification_builder_destroy(builder);
+  builder = NULL;
+
   if (status != 0)
     return status;
   else
@@ -301,6 +301,13 @@ static int ctail_read(user_data_t *ud) {
   return 0;
 } /* int ctail_read */
 
+/* The matches are freed with their read callbacks. */
+static int ctail_reset(void) {
+  tail_file_num = 0;
+  return 0;
+} /* int ctail_reset */
+
 void module_register(void) {
   plugin_register_complex_config("tail", ctail_config);
+  plugin_register_reset("tail", ctail_reset);
 } /* void module_register */
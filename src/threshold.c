@@ -47,7 +47,6 @@
  */
 static int ut_threshold_add(const threshold_t *th) { /* {{{ */
   char name[6 * DATA_MAX_NAME_LEN];
-  char *name_copy;
   threshold_t *th_copy;
   threshold_t *th_ptr;
   int status = 0;
@@ -58,19 +57,13 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
     return -1;
   }
 
-  name_copy = strdup(name);
-  if (name_copy == NULL) {
-    ERROR("ut_threshold_add: strdup failed.");
-    return -1;
-  }
-
   th_copy = malloc(sizeof(*th_copy));
   if (th_copy == NULL) {
-    sfree(name_copy);
     ERROR("ut_threshold_add: malloc failed.");
     return -1;
   }
   memcpy(th_copy, th, sizeof(threshold_t));
+  th_copy->next = NULL;
 
   DEBUG("ut_threshold_add: Adding entry `%s'", name);
 
@@ -84,19 +77,23 @@ static int ut_threshold_add(const threshold_t *th) { /* {{{ */
 
   if (th_ptr == NULL) /* no such threshold yet */
   {
-    status = c_avl_insert(threshold_tree, name_copy, th_copy);
+    /* The tree and the index use the same keys, see threshold_compare(). */
+    status = c_avl_insert(threshold_tree, th_copy, th_copy);
+    if (status == 0) {
+      status = threshold_index_add(th_copy);
+      if (status != 0) {
+        c_avl_remove(threshold_tree, th_copy, NULL, NULL);
+      }
+    }
   } else /* th_ptr points to the last threshold in the list */
   {
     th_ptr->next = th_copy;
-    /* name_copy isn't needed */
-    sfree(name_copy);
   }
 
   pthread_mutex_unlock(&threshold_lock);
 
   if (status != 0) {
     ERROR("ut_threshold_add: c_avl_insert (%s) failed.", name);
-    sfree(name_copy);
     sfree(th_copy);
   }
 
@@ -610,7 +607,6 @@ static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
                               __attribute__((unused))
                               user_data_t *ud) { /* {{{ */
   threshold_t *th;
-  gauge_t *values;
   int status;
 
   int worst_state = -1;
@@ -630,8 +626,8 @@ static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
 
   DEBUG("ut_check_threshold: Found matching threshold(s)");
 
-  values = uc_get_rate(ds, vl);
-  if (values == NULL)
+  gauge_t values[ds->ds_num];
+  if (uc_get_rate_r(ds, vl, values) != 0)
     return 0;
 
   while (th != NULL) {
@@ -640,7 +636,6 @@ static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
     status = ut_check_one_threshold(ds, vl, th, values, &ds_index);
     if (status < 0) {
       ERROR("ut_check_threshold: ut_check_one_threshold failed.");
-      sfree(values);
       return -1;
     }
 
@@ -657,12 +652,9 @@ static int ut_check_threshold(const data_set_t *ds, const value_list_t *vl,
       ut_report_state(ds, vl, worst_th, values, worst_ds_index, worst_state);
   if (status != 0) {
     ERROR("ut_check_threshold: ut_report_state failed.");
-    sfree(values);
     return -1;
   }
 
-  sfree(values);
-
   return 0;
 } /* }}} int ut_check_threshold */
 
@@ -702,12 +694,38 @@ static int ut_missing(const value_list_t *vl,
   return 0;
 } /* }}} int ut_missing */
 
+static int ut_shutdown(void) { /* {{{ */
+  threshold_t *key;
+  threshold_t *th;
+
+  plugin_unregister_missing("threshold");
+  plugin_unregister_write("threshold");
+  plugin_unregister_shutdown("threshold");
+
+  pthread_mutex_lock(&threshold_lock);
+  threshold_index_free();
+  if (threshold_tree != NULL) {
+    while (c_avl_pick(threshold_tree, (void *)&key, (void *)&th) == 0) {
+      while (th != NULL) {
+        threshold_t *next = th->next;
+        sfree(th);
+        th = next;
+      }
+    }
+    c_avl_destroy(threshold_tree);
+    threshold_tree = NULL;
+  }
+  pthread_mutex_unlock(&threshold_lock);
+
+  return 0;
+} /* }}} int ut_shutdown */
+
 static int ut_config(oconfig_item_t *ci) { /* {{{ */
   int status = 0;
   int old_size = c_avl_size(threshold_tree);
 
   if (threshold_tree == NULL) {
-    threshold_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+    threshold_tree = c_avl_create(threshold_compare);
     if (threshold_tree == NULL) {
       ERROR("ut_config: c_avl_create failed.");
       return -1;
@@ -746,6 +764,7 @@ static int ut_config(oconfig_item_t *ci) { /* {{{ */
                             /* user data = */ NULL);
     plugin_register_write("threshold", ut_check_threshold,
                           /* user data = */ NULL);
+    plugin_register_shutdown("threshold", ut_shutdown);
   }
 
   return status;
@@ -753,4 +772,7 @@ static int ut_config(oconfig_item_t *ci) { /* {{{ */
 
 void module_register(void) {
   plugin_register_complex_config("threshold", ut_config);
+  /* ut_shutdown() frees all thresholds, so the configuration reload can
+   * configure the plugin again. */
+  plugin_register_reset("threshold", ut_shutdown);
 }
@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils_complain.h"
 
 #include "utils/cmds/flush.h"
 #include "utils/cmds/getthreshold.h"
@@ -40,6 +41,12 @@
 #include <sys/un.h>
 
 #include <grp.h>
+#include <poll.h>
+
+#if HAVE_SYS_EPOLL_H
+#include <fcntl.h>
+#include <sys/epoll.h>
+#endif
 
 #ifndef UNIX_PATH_MAX
 #define UNIX_PATH_MAX sizeof(((struct sockaddr_un *)0)->sun_path)
@@ -47,12 +54,22 @@
 
 #define US_DEFAULT_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-unixsock"
 
+#define US_DEFAULT_WORKERS 4
+/* Size of the per-connection read buffer, i.e. the maximum line length. */
+#define US_BUFFER_SIZE 65536
+/* Maximum number of reads per wake-up, so one busy client can't starve the
+ * others. */
+#define US_READS_MAX 16
+/* Upper bound for the listen thread's sleep in milliseconds, so that it can
+ * be stopped without a signal when the plugin is reset. */
+#define US_WAIT_TIMEOUT 1000
+
 /*
  * Private variables
  */
 /* valid configuration file keys */
 static const char *config_keys[] = {"SocketFile", "SocketGroup", "SocketPerms",
-                                    "DeleteSocket"};
+                                    "DeleteSocket", "Workers"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int loop;
@@ -64,7 +81,53 @@ static char *sock_group;
 static int sock_perms = S_IRWXU | S_IRWXG;
 static bool delete_socket;
 
+static int have_init;
 static pthread_t listen_thread = (pthread_t)0;
+static size_t us_workers_conf = US_DEFAULT_WORKERS;
+
+#if HAVE_SYS_EPOLL_H
+struct us_client_s;
+typedef struct us_client_s us_client_t;
+struct us_client_s {
+  int fd;
+  bool quiet;
+  /* Discard input up to the next newline, because the line didn't fit into
+   * the buffer. */
+  bool skip_line;
+  /* The client closed its end; close the connection once "out" is sent. */
+  bool eof;
+  /* Identifiers seen on this connection; may be NULL. */
+  cmd_putval_cache_t *putval_cache;
+  /* Limits the errors logged in quiet mode. */
+  c_complain_t putval_complaint;
+
+  char buffer[US_BUFFER_SIZE];
+  size_t buffer_fill;
+
+  /* Replies the socket did not accept yet. While they are pending, the
+   * connection waits for EPOLLOUT and no further input is read. */
+  char *out;
+  size_t out_size;
+  size_t out_done;
+
+  /* List of all connections, protected by us_queue_lock. */
+  us_client_t *prev;
+  us_client_t *next;
+  /* Queue of connections with pending input, protected by us_queue_lock. */
+  us_client_t *next_ready;
+};
+
+static int us_epoll_fd = -1;
+
+static pthread_t *us_workers;
+static size_t us_workers_num;
+
+static pthread_mutex_t us_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t us_queue_cond = PTHREAD_COND_INITIALIZER;
+static us_client_t *us_queue_head;
+static us_client_t *us_queue_tail;
+static us_client_t *us_clients;
+#endif
 
 /*
  * Functions
@@ -158,6 +221,381 @@ static int us_open_socket(void) {
   return 0;
 } /* int us_open_socket */
 
+static void us_close_socket(void) {
+  close(sock_fd);
+  sock_fd = -1;
+
+  int status = unlink((sock_file != NULL) ? sock_file : US_DEFAULT_PATH);
+  if (status != 0) {
+    NOTICE("unixsock plugin: unlink (%s) failed: %s",
+           (sock_file != NULL) ? sock_file : US_DEFAULT_PATH, STRERRNO);
+  }
+} /* void us_close_socket */
+
+/* In quiet mode, nobody reads the replies, so errors are logged instead. The
+ * complaint "ud" of the connection limits this to one message per interval. */
+static void us_error_log(void *ud, cmd_status_t status, const char *format,
+                         va_list ap) {
+  c_complain_t *complaint = ud;
+  char buf[1024];
+
+  if (status == CMD_OK)
+    return;
+
+  vsnprintf(buf, sizeof(buf), format, ap);
+  buf[sizeof(buf) - 1] = '\0';
+  c_complain(LOG_WARNING, complaint,
+             "unixsock plugin: PUTVAL failed: %s", buf);
+} /* void us_error_log */
+
+static int us_dispatch_values(value_list_t const *vl,
+                              __attribute__((unused)) void *ud) {
+  plugin_dispatch_values(vl);
+  return 0;
+} /* int us_dispatch_values */
+
+static void us_handle_putval_quiet(char *buffer, cmd_putval_cache_t *cache,
+                                   c_complain_t *complaint) {
+  cmd_error_handler_t err = {us_error_log, complaint};
+
+  cmd_parse_putval_cached(buffer, cache, NULL, &err, us_dispatch_values, NULL);
+} /* void us_handle_putval_quiet */
+
+/* Handles one line received from a client and writes the reply to "fhout".
+ * Returns non-zero if the connection should be closed. */
+static int us_handle_command(FILE *fhout, char *buffer, bool *quiet,
+                             cmd_putval_cache_t *putval_cache,
+                             c_complain_t *putval_complaint) {
+  size_t len = strlen(buffer);
+  while ((len > 0) &&
+         ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
+    buffer[--len] = '\0';
+
+  buffer += strspn(buffer, " \t");
+  if (buffer[0] == '\0')
+    return 0;
+
+  /* The handlers parse the whole line, so only the command is copied. */
+  char command[32];
+  size_t command_len = strcspn(buffer, " \t");
+  if (command_len >= sizeof(command))
+    command_len = sizeof(command) - 1;
+  memcpy(command, buffer, command_len);
+  command[command_len] = '\0';
+
+  if (strcasecmp(command, "putval") == 0) {
+    if (*quiet)
+      us_handle_putval_quiet(buffer, putval_cache, putval_complaint);
+    else
+      cmd_handle_putval_cached(fhout, buffer, putval_cache);
+  } else if (strcasecmp(command, "getval") == 0) {
+    cmd_handle_getval(fhout, buffer);
+  } else if (strcasecmp(command, "getvals") == 0) {
+    cmd_handle_getvals(fhout, buffer);
+  } else if (strcasecmp(command, "getthreshold") == 0) {
+    handle_getthreshold(fhout, buffer);
+  } else if (strcasecmp(command, "listval") == 0) {
+    cmd_handle_listval(fhout, buffer);
+  } else if (strcasecmp(command, "putnotif") == 0) {
+    handle_putnotif(fhout, buffer);
+  } else if (strcasecmp(command, "flush") == 0) {
+    cmd_handle_flush(fhout, buffer);
+  } else if (strcasecmp(command, "quiet") == 0) {
+    char *arg = buffer + strcspn(buffer, " \t");
+    arg += strspn(arg, " \t");
+
+    *quiet = (arg[0] == '\0') || IS_TRUE(arg);
+    if (fprintf(fhout, "0 Quiet mode %s.\n",
+                *quiet ? "enabled" : "disabled") < 0)
+      return -1;
+  } else {
+    if (fprintf(fhout, "-1 Unknown command: %s\n", command) < 0) {
+      WARNING("unixsock plugin: failed to write to socket #%i: %s",
+              fileno(fhout), STRERRNO);
+      return -1;
+    }
+  }
+
+  return 0;
+} /* int us_handle_command */
+
+#if HAVE_SYS_EPOLL_H
+static void us_client_close(us_client_t *c) {
+  pthread_mutex_lock(&us_queue_lock);
+  if (c->prev != NULL)
+    c->prev->next = c->next;
+  else
+    us_clients = c->next;
+  if (c->next != NULL)
+    c->next->prev = c->prev;
+  pthread_mutex_unlock(&us_queue_lock);
+
+  /* Closing the file descriptor removes it from the epoll set. */
+  close(c->fd);
+  cmd_putval_cache_destroy(c->putval_cache);
+  free(c->out);
+  free(c);
+} /* void us_client_close */
+
+/* Writes as much of the pending replies as the socket accepts without
+ * blocking. Returns non-zero if the connection should be closed. */
+static int us_client_flush(us_client_t *c) {
+  while (c->out_done < c->out_size) {
+    ssize_t status = write(c->fd, c->out + c->out_done,
+                           c->out_size - c->out_done);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return 0;
+
+      WARNING("unixsock plugin: failed to write to socket #%i: %s", c->fd,
+              STRERRNO);
+      return -1;
+    }
+
+    c->out_done += (size_t)status;
+  }
+
+  sfree(c->out);
+  c->out_size = 0;
+  c->out_done = 0;
+  return 0;
+} /* int us_client_flush */
+
+/* Handles all complete lines in the client's buffer. If "eof" is true, a
+ * trailing line without newline is handled, too. Returns non-zero if the
+ * connection should be closed. */
+static int us_client_handle_lines(us_client_t *c, FILE *fhout, bool eof) {
+  char *line = c->buffer;
+  char *end;
+
+  c->buffer[c->buffer_fill] = '\0';
+
+  while ((end = memchr(line, '\n',
+                       c->buffer_fill - (size_t)(line - c->buffer))) !=
+         NULL) {
+    *end = '\0';
+
+    if (c->skip_line)
+      c->skip_line = false;
+    else if (us_handle_command(fhout, line, &c->quiet, c->putval_cache,
+                               &c->putval_complaint) != 0)
+      return -1;
+
+    line = end + 1;
+  }
+
+  size_t rest = c->buffer_fill - (size_t)(line - c->buffer);
+  if ((rest > 0) && eof) {
+    if (!c->skip_line &&
+        (us_handle_command(fhout, line, &c->quiet, c->putval_cache,
+                           &c->putval_complaint) != 0))
+      return -1;
+    rest = 0;
+  } else if (rest == sizeof(c->buffer) - 1) {
+    if (!c->skip_line && (fprintf(fhout, "-1 Line too long.\n") < 0))
+      return -1;
+    c->skip_line = true;
+    rest = 0;
+  }
+
+  memmove(c->buffer, line, rest);
+  c->buffer_fill = rest;
+
+  return 0;
+} /* int us_client_handle_lines */
+
+/* Sends pending replies, then reads and handles the pending input of a
+ * client. All replies are collected and written in one go; what the socket
+ * does not accept is kept in "c->out". Returns non-zero if the connection
+ * should be closed. */
+static int us_client_process(us_client_t *c) {
+  char *reply = NULL;
+  size_t reply_size = 0;
+  int status = 0;
+
+  if (us_client_flush(c) != 0)
+    return -1;
+  /* Don't read more input until the client has read its replies. */
+  if (c->out != NULL)
+    return 0;
+  if (c->eof)
+    return -1;
+
+  FILE *fhout = open_memstream(&reply, &reply_size);
+  if (fhout == NULL) {
+    ERROR("unixsock plugin: open_memstream failed: %s", STRERRNO);
+    return -1;
+  }
+
+  for (int i = 0; i < US_READS_MAX; i++) {
+    ssize_t len = read(c->fd, c->buffer + c->buffer_fill,
+                       sizeof(c->buffer) - 1 - c->buffer_fill);
+    if (len < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+        WARNING("unixsock plugin: failed to read from socket #%i: %s", c->fd,
+                STRERRNO);
+        status = -1;
+      }
+      break;
+    }
+
+    c->buffer_fill += (size_t)len;
+    status = us_client_handle_lines(c, fhout, /* eof = */ len == 0);
+    c->eof = (len == 0);
+    if ((status != 0) || c->eof)
+      break;
+  }
+
+  fclose(fhout);
+  if ((status == 0) && (reply_size > 0)) {
+    c->out = reply;
+    c->out_size = reply_size;
+    reply = NULL;
+    status = us_client_flush(c);
+  }
+  free(reply);
+
+  /* Close the connection once all replies have been sent. */
+  if ((status == 0) && c->eof && (c->out == NULL))
+    status = -1;
+
+  return status;
+} /* int us_client_process */
+
+static void *us_worker_thread(void __attribute__((unused)) * arg) {
+  while (42) {
+    pthread_mutex_lock(&us_queue_lock);
+    while ((loop != 0) && (us_queue_head == NULL))
+      pthread_cond_wait(&us_queue_cond, &us_queue_lock);
+
+    if (loop == 0) {
+      pthread_mutex_unlock(&us_queue_lock);
+      break;
+    }
+
+    us_client_t *c = us_queue_head;
+    us_queue_head = c->next_ready;
+    if (us_queue_head == NULL)
+      us_queue_tail = NULL;
+    c->next_ready = NULL;
+    pthread_mutex_unlock(&us_queue_lock);
+
+    if (us_client_process(c) != 0) {
+      us_client_close(c);
+      continue;
+    }
+
+    /* The descriptor is registered with EPOLLONESHOT, so no other worker
+     * handles this client until it is re-armed here. */
+    struct epoll_event ev = {
+        .events = ((c->out != NULL) ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT,
+        .data.ptr = c,
+    };
+    if (epoll_ctl(us_epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) != 0) {
+      ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+      us_client_close(c);
+    }
+  }
+
+  return (void *)0;
+} /* void *us_worker_thread */
+
+static void us_accept(void) {
+  int fd = accept(sock_fd, NULL, NULL);
+  if (fd < 0) {
+    if ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+      ERROR("unixsock plugin: accept failed: %s", STRERRNO);
+    return;
+  }
+
+  int flags = fcntl(fd, F_GETFL);
+  if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+    ERROR("unixsock plugin: fcntl failed: %s", STRERRNO);
+    close(fd);
+    return;
+  }
+
+  us_client_t *c = calloc(1, sizeof(*c));
+  if (c == NULL) {
+    WARNING("unixsock plugin: calloc failed.");
+    close(fd);
+    return;
+  }
+  c->fd = fd;
+  c->putval_cache = cmd_putval_cache_create();
+
+  pthread_mutex_lock(&us_queue_lock);
+  c->next = us_clients;
+  if (us_clients != NULL)
+    us_clients->prev = c;
+  us_clients = c;
+  pthread_mutex_unlock(&us_queue_lock);
+
+  DEBUG("unixsock plugin: Accepted connection on fd #%i", fd);
+
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = c};
+  if (epoll_ctl(us_epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    us_client_close(c);
+  }
+} /* void us_accept */
+
+/* Waits for new connections and for input on existing connections. Clients
+ * with pending input are handed to the worker threads. */
+static void *us_server_thread(void __attribute__((unused)) * arg) {
+  if (us_open_socket() != 0)
+    pthread_exit((void *)1);
+
+  /* The listening socket is identified by a NULL pointer. */
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+  if (epoll_ctl(us_epoll_fd, EPOLL_CTL_ADD, sock_fd, &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    us_close_socket();
+    pthread_exit((void *)1);
+  }
+
+  while (loop != 0) {
+    struct epoll_event events[32];
+
+    int events_num =
+        epoll_wait(us_epoll_fd, events, STATIC_ARRAY_SIZE(events),
+                   US_WAIT_TIMEOUT);
+    if (events_num < 0) {
+      if (errno == EINTR)
+        continue;
+
+      ERROR("unixsock plugin: epoll_wait failed: %s", STRERRNO);
+      break;
+    }
+
+    for (int i = 0; i < events_num; i++) {
+      us_client_t *c = events[i].data.ptr;
+
+      if (c == NULL) {
+        us_accept();
+        continue;
+      }
+
+      pthread_mutex_lock(&us_queue_lock);
+      if (us_queue_tail != NULL)
+        us_queue_tail->next_ready = c;
+      else
+        us_queue_head = c;
+      us_queue_tail = c;
+      pthread_cond_signal(&us_queue_cond);
+      pthread_mutex_unlock(&us_queue_lock);
+    }
+  } /* while (loop) */
+
+  us_close_socket();
+
+  return (void *)0;
+} /* void *us_server_thread */
+#else  /* !HAVE_SYS_EPOLL_H */
 static void *us_handle_client(void *arg) {
   int fdin;
   int fdout;
@@ -203,11 +641,12 @@ static void *us_handle_client(void *arg) {
     return (void *)0;
   }
 
+  bool quiet = false;
+  cmd_putval_cache_t *putval_cache = cmd_putval_cache_create();
+  c_complain_t putval_complaint = C_COMPLAIN_INIT_STATIC;
+
   while (42) {
     char buffer[1024];
-    char buffer_copy[1024];
-    char *fields[128];
-    int fields_num;
 
     errno = 0;
     if (fgets(buffer, sizeof(buffer), fhin) == NULL) {
@@ -221,48 +660,13 @@ static void *us_handle_client(void *arg) {
       break;
     }
 
-    size_t len = strlen(buffer);
-    while ((len > 0) &&
-           ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
-      buffer[--len] = '\0';
-
-    if (len == 0)
-      continue;
-
-    sstrncpy(buffer_copy, buffer, sizeof(buffer_copy));
-
-    fields_num =
-        strsplit(buffer_copy, fields, sizeof(fields) / sizeof(fields[0]));
-    if (fields_num < 1) {
-      fprintf(fhout, "-1 Internal error\n");
-      fclose(fhin);
-      fclose(fhout);
-      pthread_exit((void *)1);
-      return (void *)1;
-    }
-
-    if (strcasecmp(fields[0], "getval") == 0) {
-      cmd_handle_getval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "getthreshold") == 0) {
-      handle_getthreshold(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putval") == 0) {
-      cmd_handle_putval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "listval") == 0) {
-      cmd_handle_listval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putnotif") == 0) {
-      handle_putnotif(fhout, buffer);
-    } else if (strcasecmp(fields[0], "flush") == 0) {
-      cmd_handle_flush(fhout, buffer);
-    } else {
-      if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
-        WARNING("unixsock plugin: failed to write to socket #%i: %s",
-                fileno(fhout), STRERRNO);
-        break;
-      }
-    }
+    if (us_handle_command(fhout, buffer, &quiet, putval_cache,
+                          &putval_complaint) != 0)
+      break;
   } /* while (fgets) */
 
   DEBUG("unixsock plugin: us_handle_client: Exiting..");
+  cmd_putval_cache_destroy(putval_cache);
   fclose(fhin);
   fclose(fhout);
 
@@ -279,6 +683,16 @@ static void *us_server_thread(void __attribute__((unused)) * arg) {
     pthread_exit((void *)1);
 
   while (loop != 0) {
+    struct pollfd pfd = {.fd = sock_fd, .events = POLLIN};
+    status = poll(&pfd, 1, US_WAIT_TIMEOUT);
+    if ((status == 0) || ((status < 0) && (errno == EINTR)))
+      continue;
+    if (status < 0) {
+      ERROR("unixsock plugin: poll failed: %s", STRERRNO);
+      us_close_socket();
+      pthread_exit((void *)1);
+    }
+
     DEBUG("unixsock plugin: Calling accept..");
     status = accept(sock_fd, NULL, NULL);
     if (status < 0) {
@@ -314,17 +728,11 @@ static void *us_server_thread(void __attribute__((unused)) * arg) {
     }
   } /* while (loop) */
 
-  close(sock_fd);
-  sock_fd = -1;
-
-  status = unlink((sock_file != NULL) ? sock_file : US_DEFAULT_PATH);
-  if (status != 0) {
-    NOTICE("unixsock plugin: unlink (%s) failed: %s",
-           (sock_file != NULL) ? sock_file : US_DEFAULT_PATH, STRERRNO);
-  }
+  us_close_socket();
 
   return (void *)0;
 } /* void *us_server_thread */
+#endif /* !HAVE_SYS_EPOLL_H */
 
 static int us_config(const char *key, const char *val) {
   if (strcasecmp(key, "SocketFile") == 0) {
@@ -348,6 +756,13 @@ static int us_config(const char *key, const char *val) {
       delete_socket = true;
     else
       delete_socket = false;
+  } else if (strcasecmp(key, "Workers") == 0) {
+    int tmp = atoi(val);
+    if (tmp < 1) {
+      ERROR("unixsock plugin: \"Workers\" must be at least 1.");
+      return 1;
+    }
+    us_workers_conf = (size_t)tmp;
   } else {
     return -1;
   }
@@ -356,8 +771,6 @@ static int us_config(const char *key, const char *val) {
 } /* int us_config */
 
 static int us_init(void) {
-  static int have_init;
-
   int status;
 
   /* Initialize only once. */
@@ -367,6 +780,32 @@ static int us_init(void) {
 
   loop = 1;
 
+#if HAVE_SYS_EPOLL_H
+  us_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (us_epoll_fd < 0) {
+    ERROR("unixsock plugin: epoll_create1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  us_workers = calloc(us_workers_conf, sizeof(*us_workers));
+  if (us_workers == NULL) {
+    ERROR("unixsock plugin: calloc failed.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < us_workers_conf; i++) {
+    status = plugin_thread_create(&us_workers[us_workers_num],
+                                  us_worker_thread, NULL, "unixsock worker");
+    if (status != 0) {
+      ERROR("unixsock plugin: pthread_create failed: %s", STRERRNO);
+      break;
+    }
+    us_workers_num++;
+  }
+  if (us_workers_num == 0)
+    return -1;
+#endif
+
   status = plugin_thread_create(&listen_thread, us_server_thread, NULL,
                                 "unixsock listen");
   if (status != 0) {
@@ -377,25 +816,67 @@ static int us_init(void) {
   return 0;
 } /* int us_init */
 
-static int us_shutdown(void) {
+/* Stops the threads and closes the socket. The listen thread is only
+ * interrupted by a signal on shutdown, because SIGTERM stops the daemon. */
+static void us_stop(bool interrupt) {
   void *ret;
 
   loop = 0;
 
   if (listen_thread != (pthread_t)0) {
-    pthread_kill(listen_thread, SIGTERM);
+    if (interrupt)
+      pthread_kill(listen_thread, SIGTERM);
     pthread_join(listen_thread, &ret);
     listen_thread = (pthread_t)0;
   }
 
+#if HAVE_SYS_EPOLL_H
+  pthread_mutex_lock(&us_queue_lock);
+  pthread_cond_broadcast(&us_queue_cond);
+  pthread_mutex_unlock(&us_queue_lock);
+
+  for (size_t i = 0; i < us_workers_num; i++)
+    pthread_join(us_workers[i], &ret);
+  sfree(us_workers);
+  us_workers_num = 0;
+
+  while (us_clients != NULL)
+    us_client_close(us_clients);
+  us_queue_head = NULL;
+  us_queue_tail = NULL;
+
+  if (us_epoll_fd >= 0) {
+    close(us_epoll_fd);
+    us_epoll_fd = -1;
+  }
+#endif
+} /* void us_stop */
+
+static int us_shutdown(void) {
+  us_stop(/* interrupt = */ true);
+
   plugin_unregister_init("unixsock");
   plugin_unregister_shutdown("unixsock");
 
   return 0;
 } /* int us_shutdown */
 
+static int us_reset(void) {
+  us_stop(/* interrupt = */ false);
+  have_init = 0;
+
+  sfree(sock_file);
+  sfree(sock_group);
+  sock_perms = S_IRWXU | S_IRWXG;
+  delete_socket = false;
+  us_workers_conf = US_DEFAULT_WORKERS;
+
+  return 0;
+} /* int us_reset */
+
 void module_register(void) {
   plugin_register_config("unixsock", us_config, config_keys, config_keys_num);
   plugin_register_init("unixsock", us_init);
   plugin_register_shutdown("unixsock", us_shutdown);
+  plugin_register_reset("unixsock", us_reset);
 } /* void module_register (void) */
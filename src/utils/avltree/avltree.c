@@ -641,6 +641,29 @@ int c_avl_iterator_prev(c_avl_iterator_t *iter, void **key, void **value) {
 
 void c_avl_iterator_destroy(c_avl_iterator_t *iter) { free(iter); }
 
+c_avl_iterator_t *c_avl_get_iterator_after(c_avl_tree_t *t, const void *key) {
+  c_avl_iterator_t *iter = c_avl_get_iterator(t);
+  if (iter == NULL)
+    return NULL;
+
+  /* Position the iterator at the greatest key less than or equal to "key".
+   * If there is none, the iterator starts at the smallest key. */
+  c_avl_node_t *n = t->root;
+  while (n != NULL) {
+    int cmp = t->compare(key, n->key);
+    if (cmp < 0) {
+      n = n->left;
+    } else {
+      iter->node = n;
+      if (cmp == 0)
+        break;
+      n = n->right;
+    }
+  }
+
+  return iter;
+} /* c_avl_iterator_t *c_avl_get_iterator_after */
+
 int c_avl_size(c_avl_tree_t *t) {
   if (t == NULL)
     return 0;
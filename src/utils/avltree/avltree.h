@@ -151,6 +151,21 @@ int c_avl_iterator_next(c_avl_iterator_t *iter, void **key, void **value);
 int c_avl_iterator_prev(c_avl_iterator_t *iter, void **key, void **value);
 void c_avl_iterator_destroy(c_avl_iterator_t *iter);
 
+/*
+ * NAME
+ *   c_avl_get_iterator_after
+ *
+ * DESCRIPTION
+ *   Creates an iterator which is positioned at `key', so that the first call
+ *   to c_avl_iterator_next returns the smallest key greater than `key'. The
+ *   key itself does not need to be in the tree. This allows to continue an
+ *   iteration after the tree has been modified.
+ *
+ * RETURN VALUE
+ *   An iterator or NULL on error.
+ */
+c_avl_iterator_t *c_avl_get_iterator_after(c_avl_tree_t *t, const void *key);
+
 /*
  * NAME
  *   c_avl_size
@@ -117,6 +117,40 @@ DEF_TEST(success) {
     EXPECT_EQ_INT(i, STATIC_ARRAY_SIZE(cases));
   }
 
+  /* continue after a key */
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    /* A key just before the i-th key, which is not in the tree. */
+    char before[32];
+    snprintf(before, sizeof(before), "%s", sorted_cases[i].key);
+    before[strlen(before) - 1]--;
+
+    for (int exact = 0; exact < 2; exact++) {
+      c_avl_iterator_t *iter;
+      char *key;
+      char *value;
+      size_t j = exact ? i + 1 : i;
+
+      CHECK_NOT_NULL(iter = c_avl_get_iterator_after(
+                         t, exact ? sorted_cases[i].key : before));
+      while (c_avl_iterator_next(iter, (void **)&key, (void **)&value) == 0) {
+        EXPECT_EQ_STR(sorted_cases[j].key, key);
+        j++;
+      }
+      c_avl_iterator_destroy(iter);
+      EXPECT_EQ_INT(STATIC_ARRAY_SIZE(cases), j);
+    }
+  }
+  {
+    c_avl_iterator_t *iter;
+    char *key;
+    char *value;
+
+    CHECK_NOT_NULL(iter = c_avl_get_iterator_after(t, "zzz"));
+    EXPECT_EQ_INT(-1, c_avl_iterator_next(iter, (void **)&key,
+                                          (void **)&value));
+    c_avl_iterator_destroy(iter);
+  }
+
   /* iterate backward */
   {
     c_avl_iterator_t *iter = c_avl_get_iterator(t);
@@ -29,6 +29,7 @@
 
 #include "plugin.h"
 
+#include <regex.h>
 #include <stdarg.h>
 
 typedef enum {
@@ -37,6 +38,7 @@ typedef enum {
   CMD_GETVAL = 2,
   CMD_LISTVAL = 3,
   CMD_PUTVAL = 4,
+  CMD_GETVALS = 5,
 } cmd_type_t;
 #define CMD_TO_STRING(type)                                                    \
   ((type) == CMD_FLUSH)                                                        \
@@ -45,7 +47,9 @@ typedef enum {
             ? "GETVAL"                                                         \
             : ((type) == CMD_LISTVAL)                                          \
                   ? "LISTVAL"                                                  \
-                  : ((type) == CMD_PUTVAL) ? "PUTVAL" : "UNKNOWN"
+                  : ((type) == CMD_PUTVAL)                                     \
+                        ? "PUTVAL"                                             \
+                        : ((type) == CMD_GETVALS) ? "GETVALS" : "UNKNOWN"
 
 typedef struct {
   double timeout;
@@ -61,6 +65,18 @@ typedef struct {
   identifier_t identifier;
 } cmd_getval_t;
 
+/* Used by LISTVAL and GETVALS. */
+typedef struct {
+  /* Only identifiers matching the shell wildcard pattern and / or the regular
+   * expression are returned, if set. */
+  char *glob;
+  regex_t *regex;
+  /* The maximum number of identifiers to return or zero. */
+  size_t limit;
+  /* Continue after this identifier. */
+  char *cursor;
+} cmd_listval_t;
+
 typedef struct {
   /* The raw identifier as provided by the user. */
   char *raw_identifier;
@@ -83,6 +99,7 @@ typedef struct {
   union {
     cmd_flush_t flush;
     cmd_getval_t getval;
+    cmd_listval_t listval;
     cmd_putval_t putval;
   } cmd;
 } cmd_t;
@@ -32,6 +32,7 @@
 #include "utils/common/common.h"
 #include "testing.h"
 #include "utils/cmds/cmds.h"
+#include "utils/cmds/putval.h"
 // clang-format on
 
 static void error_cb(void *ud, cmd_status_t status, const char *format,
@@ -158,6 +159,18 @@ static struct {
         CMD_OK,
         CMD_LISTVAL,
     },
+    {
+        "LISTVAL limit=100 glob=myhost/cpu-*/* cursor=myhost/cpu-0/cpu-idle",
+        NULL,
+        CMD_OK,
+        CMD_LISTVAL,
+    },
+    {
+        "LISTVAL regex=^myhost/(cpu|memory)",
+        NULL,
+        CMD_OK,
+        CMD_LISTVAL,
+    },
 
     /* Invalid LISTVAL commands. */
     {
@@ -166,6 +179,52 @@ static struct {
         CMD_PARSE_ERROR,
         CMD_UNKNOWN,
     },
+    {
+        "LISTVAL limit=0",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+    {
+        "LISTVAL limit=10x",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+    {
+        "LISTVAL regex=(",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+    {
+        "LISTVAL invalid=1",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
+
+    /* Valid GETVALS commands. */
+    {
+        "GETVALS myhost/cpu-*/* limit=100",
+        NULL,
+        CMD_OK,
+        CMD_GETVALS,
+    },
+    {
+        "GETVALS",
+        NULL,
+        CMD_OK,
+        CMD_GETVALS,
+    },
+
+    /* Invalid GETVALS commands. */
+    {
+        "GETVALS myhost/cpu-*/* myhost/memory/*",
+        NULL,
+        CMD_PARSE_ERROR,
+        CMD_UNKNOWN,
+    },
 
     /* Valid PUTVAL commands. */
     {
@@ -330,7 +389,181 @@ DEF_TEST(parse) {
   return test_result;
 }
 
+typedef struct {
+  value_list_t vl[4];
+  derive_t value[4];
+  size_t num;
+} putval_result_t;
+
+static int putval_check_cb(value_list_t const *vl, void *ud) {
+  putval_result_t *r = ud;
+
+  if ((r->num >= STATIC_ARRAY_SIZE(r->vl)) || (vl->values_len != 1))
+    return -1;
+
+  r->vl[r->num] = *vl;
+  /* Only keep the value; the array belongs to the parser. */
+  r->vl[r->num].values = NULL;
+  r->value[r->num] = vl->values[0].derive;
+  r->num++;
+  return 0;
+}
+
+DEF_TEST(parse_putval_cached) {
+  cmd_error_handler_t err = {error_cb, NULL};
+  cmd_putval_cache_t *cache;
+  int test_result = 0;
+
+  CHECK_NOT_NULL(cache = cmd_putval_cache_create());
+
+  /* The fast path must agree with cmd_parse() on all PUTVAL commands. Each
+   * command runs twice, so that the second run hits the cache. */
+  for (size_t i = 0; i < 2 * STATIC_ARRAY_SIZE(parse_data); i++) {
+    size_t n = i % STATIC_ARRAY_SIZE(parse_data);
+    if (strncmp("PUTVAL", parse_data[n].input, strlen("PUTVAL")) != 0)
+      continue;
+
+    char *input = strdup(parse_data[n].input);
+    putval_result_t r = {0};
+    cmd_putval_cache_t *c = (i < STATIC_ARRAY_SIZE(parse_data)) ? NULL : cache;
+
+    cmd_status_t status = cmd_parse_putval_cached(
+        input, c, parse_data[n].opts, &err, putval_check_cb, &r);
+
+    char description[1024];
+    ssnprintf(description, sizeof(description),
+              "cmd_parse_putval_cached (\"%s\", cache=%p) = %d; want %d",
+              parse_data[n].input, (void *)c, status,
+              parse_data[n].expected_status);
+    bool result = (status == parse_data[n].expected_status);
+    LOG(result, description);
+    if (!result)
+      test_result = -1;
+
+    free(input);
+  }
+
+  struct {
+    char *input;
+    size_t num;
+    cdtime_t time[2];
+    cdtime_t interval[2];
+    derive_t value[2];
+  } cases[] = {
+      {"PUTVAL myhost/magic/MAGIC interval=2 1234:42 interval=5 2345:23",
+       2,
+       {TIME_T_TO_CDTIME_T(1234), TIME_T_TO_CDTIME_T(2345)},
+       {TIME_T_TO_CDTIME_T(2), TIME_T_TO_CDTIME_T(5)},
+       {42, 23}},
+      /* The interval must not leak from the previous command. */
+      {"putval  \"myhost/magic/MAGIC\"   1234.5::7",
+       1,
+       {DOUBLE_TO_CDTIME_T(1234.5)},
+       {0},
+       {7}},
+      /* Nothing is handled if any value list is invalid. */
+      {"PUTVAL myhost/magic/MAGIC 1234:42 2345:x", 0},
+      {"PUTVAL myhost/magic/MAGIC 1234:1:2", 0},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char *input = strdup(cases[i].input);
+    putval_result_t r = {0};
+
+    printf("## %s\n", cases[i].input);
+    cmd_putval_cache_t *c = (i % 2) ? NULL : cache;
+    cmd_status_t status =
+        cmd_parse_putval_cached(input, c, NULL, &err, putval_check_cb, &r);
+    EXPECT_EQ_INT(cases[i].num ? CMD_OK : CMD_PARSE_ERROR, status);
+    EXPECT_EQ_INT(cases[i].num, r.num);
+
+    for (size_t j = 0; j < r.num; j++) {
+      EXPECT_EQ_STR("myhost", r.vl[j].host);
+      EXPECT_EQ_STR("magic", r.vl[j].plugin);
+      EXPECT_EQ_STR("MAGIC", r.vl[j].type);
+      EXPECT_EQ_UINT64(cases[i].time[j], r.vl[j].time);
+      EXPECT_EQ_UINT64(cases[i].interval[j], r.vl[j].interval);
+      EXPECT_EQ_INT(cases[i].value[j], r.value[j]);
+    }
+    free(input);
+  }
+
+  cmd_putval_cache_destroy(cache);
+  return test_result;
+}
+
+static int putval_count_cb(value_list_t const *vl, void *ud) {
+  (*(uint64_t *)ud) += (uint64_t)vl->values[0].derive;
+  return 0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+/* PUTVAL lines for 1000 different identifiers, as sent by collectd-tg. Only
+ * runs when "--benchmark" is passed, not as part of "make check". */
+DEF_TEST(putval_benchmark) {
+  cmd_error_handler_t err = {error_cb, NULL};
+  size_t lines_num = 200000;
+  size_t idents_num = 1000;
+  cmd_putval_cache_t *cache;
+  uint64_t sum_parse = 0;
+  uint64_t sum_cached = 0;
+  size_t failed_parse = 0;
+  size_t failed_cached = 0;
+  char lines[idents_num][128];
+  char buffer[128];
+
+  for (size_t i = 0; i < idents_num; i++)
+    snprintf(lines[i], sizeof(lines[i]),
+             "PUTVAL myhost/plugin-%zu/MAGIC interval=10.000 %zu.000:%zu", i,
+             1700000000 + i, i % 7);
+
+  CHECK_NOT_NULL(cache = cmd_putval_cache_create());
+
+  double start = now_seconds();
+  for (size_t i = 0; i < lines_num; i++) {
+    cmd_t cmd;
+
+    /* Both parsers modify the buffer. */
+    memcpy(buffer, lines[i % idents_num], sizeof(buffer));
+    if (cmd_parse(buffer, &cmd, NULL, &err) != CMD_OK) {
+      failed_parse++;
+      continue;
+    }
+    sum_parse += (uint64_t)cmd.cmd.putval.vl[0].values[0].derive;
+    cmd_destroy(&cmd);
+  }
+  double parse_time = now_seconds() - start;
+
+  start = now_seconds();
+  for (size_t i = 0; i < lines_num; i++) {
+    memcpy(buffer, lines[i % idents_num], sizeof(buffer));
+    if (cmd_parse_putval_cached(buffer, cache, NULL, &err, putval_count_cb,
+                                &sum_cached) != CMD_OK)
+      failed_cached++;
+  }
+  double cached_time = now_seconds() - start;
+
+  EXPECT_EQ_INT(0, failed_parse);
+  EXPECT_EQ_INT(0, failed_cached);
+  EXPECT_EQ_UINT64(sum_parse, sum_cached);
+  printf("%zu lines: cmd_parse %.0f lines/s, cmd_parse_putval_cached "
+         "%.0f lines/s\n",
+         lines_num, (double)lines_num / parse_time,
+         (double)lines_num / cached_time);
+
+  cmd_putval_cache_destroy(cache);
+  return 0;
+}
+
 int main(int argc, char **argv) {
   RUN_TEST(parse);
+  RUN_TEST(parse_putval_cached);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(putval_benchmark);
   END_TEST;
 }
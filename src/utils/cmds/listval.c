@@ -33,71 +33,280 @@
 #include "utils/cmds/parse_option.h"
 #include "utils_cache.h"
 
+#include <fnmatch.h>
+
+/* A listing without a cursor may be served from a snapshot this old. Requests
+ * with a cursor continue in the latest snapshot, if there still is one. */
+#define CMD_LISTVAL_MAX_AGE TIME_T_TO_CDTIME_T(1)
+
+/* Parses the options shared by LISTVAL and GETVALS. If "pattern_arg" is true,
+ * one argument which isn't an option is taken as wildcard pattern. */
+static cmd_status_t cmd_parse_listval_options(size_t argc, char **argv,
+                                              cmd_listval_t *ret_listval,
+                                              bool pattern_arg,
+                                              cmd_error_handler_t *err) {
+  if (ret_listval == NULL) {
+    errno = EINVAL;
+    cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_listval.");
+    return CMD_ERROR;
+  }
+
+  for (size_t i = 0; i < argc; i++) {
+    char *opt_key = NULL;
+    char *opt_value = NULL;
+
+    int status = cmd_parse_option(argv[i], &opt_key, &opt_value, err);
+    if ((status == CMD_NO_OPTION) && pattern_arg &&
+        (ret_listval->glob == NULL)) {
+      opt_key = "glob";
+      opt_value = argv[i];
+    } else if (status == CMD_NO_OPTION) {
+      cmd_error(CMD_PARSE_ERROR, err, "Garbage after end of command: `%s'.",
+                argv[i]);
+      cmd_destroy_listval(ret_listval);
+      return CMD_PARSE_ERROR;
+    } else if (status != CMD_OK) {
+      cmd_destroy_listval(ret_listval);
+      return CMD_PARSE_ERROR;
+    }
+
+    if ((strcasecmp("glob", opt_key) == 0) && (ret_listval->glob == NULL)) {
+      ret_listval->glob = sstrdup(opt_value);
+    } else if ((strcasecmp("regex", opt_key) == 0) &&
+               (ret_listval->regex == NULL)) {
+      ret_listval->regex = calloc(1, sizeof(*ret_listval->regex));
+      if (ret_listval->regex == NULL) {
+        cmd_error(CMD_ERROR, err, "calloc failed.");
+        cmd_destroy_listval(ret_listval);
+        return CMD_ERROR;
+      }
+      if (regcomp(ret_listval->regex, opt_value, REG_EXTENDED | REG_NOSUB) !=
+          0) {
+        sfree(ret_listval->regex);
+        cmd_error(CMD_PARSE_ERROR, err, "Invalid regular expression `%s'.",
+                  opt_value);
+        cmd_destroy_listval(ret_listval);
+        return CMD_PARSE_ERROR;
+      }
+    } else if (strcasecmp("limit", opt_key) == 0) {
+      char *endptr = NULL;
+
+      errno = 0;
+      unsigned long long limit = strtoull(opt_value, &endptr, 10);
+      if ((endptr == opt_value) || (*endptr != '\0') || (errno != 0) ||
+          (limit == 0) || (opt_value[0] == '-')) {
+        cmd_error(CMD_PARSE_ERROR, err, "Invalid value for option `limit': %s",
+                  opt_value);
+        cmd_destroy_listval(ret_listval);
+        return CMD_PARSE_ERROR;
+      }
+      ret_listval->limit = (size_t)limit;
+    } else if ((strcasecmp("cursor", opt_key) == 0) &&
+               (ret_listval->cursor == NULL)) {
+      ret_listval->cursor = sstrdup(opt_value);
+    } else {
+      cmd_error(CMD_PARSE_ERROR, err, "Cannot parse option `%s'.", opt_key);
+      cmd_destroy_listval(ret_listval);
+      return CMD_PARSE_ERROR;
+    }
+  }
+
+  return CMD_OK;
+} /* cmd_status_t cmd_parse_listval_options */
+
 cmd_status_t cmd_parse_listval(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
                                const cmd_options_t *opts
                                __attribute__((unused)),
                                cmd_error_handler_t *err) {
-  if (argc != 0) {
-    cmd_error(CMD_PARSE_ERROR, err, "Garbage after end of command: `%s'.",
-              argv[0]);
-    return CMD_PARSE_ERROR;
-  }
-
-  return CMD_OK;
+  return cmd_parse_listval_options(argc, argv, ret_listval,
+                                   /* pattern_arg = */ false, err);
 } /* cmd_status_t cmd_parse_listval */
 
-#define free_everything_and_return(status)                                     \
-  do {                                                                         \
-    for (size_t j = 0; j < number; j++) {                                      \
-      sfree(names[j]);                                                         \
-      names[j] = NULL;                                                         \
-    }                                                                          \
-    sfree(names);                                                              \
-    sfree(times);                                                              \
-    return status;                                                             \
-  } while (0)
-
-#define print_to_socket(fh, ...)                                               \
-  do {                                                                         \
-    if (fprintf(fh, __VA_ARGS__) < 0) {                                        \
-      WARNING("handle_listval: failed to write to socket #%i: %s", fileno(fh), \
-              STRERRNO);                                                       \
-      free_everything_and_return(CMD_ERROR);                                   \
-    }                                                                          \
-    fflush(fh);                                                                \
-  } while (0)
+cmd_status_t cmd_parse_getvals(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
+                               const cmd_options_t *opts
+                               __attribute__((unused)),
+                               cmd_error_handler_t *err) {
+  return cmd_parse_listval_options(argc, argv, ret_listval,
+                                   /* pattern_arg = */ true, err);
+} /* cmd_status_t cmd_parse_getvals */
 
-cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
+static bool cmd_listval_match(cmd_listval_t const *listval,
+                              char const *name) {
+  if ((listval->glob != NULL) &&
+      (fnmatch(listval->glob, name, /* flags = */ 0) != 0))
+    return false;
+  if ((listval->regex != NULL) &&
+      (regexec(listval->regex, name, 0, NULL, /* flags = */ 0) != 0))
+    return false;
+  return true;
+} /* bool cmd_listval_match */
+
+/* Prints the rates of one entry as "<ds name>=<rate>" pairs. */
+static int cmd_getvals_print_values(FILE *fh, char const *name,
+                                    gauge_t const *values, size_t values_num) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  char *host;
+  char *plugin;
+  char *plugin_instance;
+  char *type;
+  char *type_instance;
+  data_set_t const *ds = NULL;
+
+  sstrncpy(buffer, name, sizeof(buffer));
+  if (parse_identifier(buffer, &host, &plugin, &plugin_instance, &type,
+                       &type_instance, NULL) == 0)
+    ds = plugin_get_ds(type);
+  /* The type may have been removed since the value was cached. */
+  if ((ds != NULL) && (ds->ds_num != values_num))
+    ds = NULL;
+
+  for (size_t i = 0; i < values_num; i++) {
+    int status;
+
+    if (ds != NULL)
+      status = fprintf(fh, " %s=", ds->ds[i].name);
+    else
+      status = fprintf(fh, " %" PRIsz "=", i);
+    if (status < 0)
+      return -1;
+
+    if (isnan(values[i]))
+      status = fprintf(fh, "NaN");
+    else
+      status = fprintf(fh, "%e", values[i]);
+    if (status < 0)
+      return -1;
+  }
+
+  return 0;
+} /* int cmd_getvals_print_values */
+
+static cmd_status_t cmd_handle_listval_common(FILE *fh, char *buffer,
+                                              cmd_type_t type) {
   cmd_error_handler_t err = {cmd_error_fh, fh};
   cmd_status_t status;
   cmd_t cmd;
 
-  char **names = NULL;
-  cdtime_t *times = NULL;
-  size_t number = 0;
-
   DEBUG("utils_cmd_listval: handle_listval (fh = %p, buffer = %s);", (void *)fh,
         buffer);
 
   if ((status = cmd_parse(buffer, &cmd, NULL, &err)) != CMD_OK)
     return status;
-  if (cmd.type != CMD_LISTVAL) {
+  if (cmd.type != type) {
     cmd_error(CMD_UNKNOWN_COMMAND, &err, "Unexpected command: `%s'.",
               CMD_TO_STRING(cmd.type));
-    free_everything_and_return(CMD_UNKNOWN_COMMAND);
+    cmd_destroy(&cmd);
+    return CMD_UNKNOWN_COMMAND;
+  }
+  cmd_listval_t *listval = &cmd.cmd.listval;
+
+  /* The snapshot is read without holding the cache lock, so listing a large
+   * cache doesn't stall uc_update(). */
+  uc_snapshot_t *snap = uc_snapshot_get(
+      (listval->cursor != NULL) ? UC_SNAPSHOT_MAX_AGE : CMD_LISTVAL_MAX_AGE);
+  if (snap == NULL) {
+    cmd_error(CMD_ERROR, &err, "uc_snapshot_get failed.");
+    cmd_destroy(&cmd);
+    return CMD_ERROR;
+  }
+
+  size_t snap_size = uc_snapshot_size(snap);
+  DEBUG("utils_cmd_listval: Using snapshot %" PRIu64 " with %" PRIsz
+        " entries.",
+        uc_snapshot_epoch(snap), snap_size);
+  size_t index = 0;
+  if (listval->cursor != NULL)
+    index = uc_snapshot_find_after(snap, listval->cursor);
+
+  /* The number of values is printed first, so matches are collected before
+   * printing them. */
+  size_t *matches = NULL;
+  size_t matches_num = 0;
+  size_t matches_size = 0;
+  bool more = false;
+
+  for (; index < snap_size; index++) {
+    char const *name = NULL;
+
+    uc_snapshot_entry(snap, index, &name, NULL, NULL, NULL);
+    if (!cmd_listval_match(listval, name))
+      continue;
+
+    if ((listval->limit != 0) && (matches_num >= listval->limit)) {
+      more = true;
+      break;
+    }
+
+    if (matches_num >= matches_size) {
+      size_t new_size = (matches_size == 0) ? 64 : 2 * matches_size;
+      size_t *tmp = realloc(matches, new_size * sizeof(*matches));
+      if (tmp == NULL) {
+        cmd_error(CMD_ERROR, &err, "realloc failed.");
+        sfree(matches);
+        uc_snapshot_release(snap);
+        cmd_destroy(&cmd);
+        return CMD_ERROR;
+      }
+      matches = tmp;
+      matches_size = new_size;
+    }
+    matches[matches_num] = index;
+    matches_num++;
   }
 
-  status = uc_get_names(&names, &times, &number);
-  if (status != 0) {
-    DEBUG("command listval: uc_get_names failed with status %i", status);
-    cmd_error(CMD_ERROR, &err, "uc_get_names failed.");
-    free_everything_and_return(CMD_ERROR);
+  status = CMD_OK;
+  if (fprintf(fh, "%" PRIsz " Value%s found%s\n", matches_num,
+              (matches_num == 1) ? "" : "s",
+              more ? " (more available)" : "") < 0)
+    status = CMD_ERROR;
+
+  for (size_t i = 0; (i < matches_num) && (status == CMD_OK); i++) {
+    char const *name = NULL;
+    cdtime_t time = 0;
+    gauge_t const *values = NULL;
+    size_t values_num = 0;
+
+    uc_snapshot_entry(snap, matches[i], &name, &time, &values, &values_num);
+    if (fprintf(fh, "%.3f %s", CDTIME_T_TO_DOUBLE(time), name) < 0)
+      status = CMD_ERROR;
+    else if ((type == CMD_GETVALS) &&
+             (cmd_getvals_print_values(fh, name, values, values_num) != 0))
+      status = CMD_ERROR;
+    else if (fprintf(fh, "\n") < 0)
+      status = CMD_ERROR;
   }
 
-  print_to_socket(fh, "%i Value%s found\n", (int)number,
-                  (number == 1) ? "" : "s");
-  for (size_t i = 0; i < number; i++)
-    print_to_socket(fh, "%.3f %s\n", CDTIME_T_TO_DOUBLE(times[i]), names[i]);
+  if ((status == CMD_OK) && (fflush(fh) != 0))
+    status = CMD_ERROR;
+  if (status != CMD_OK)
+    WARNING("handle_listval: failed to write to socket #%i: %s", fileno(fh),
+            STRERRNO);
+
+  sfree(matches);
+  uc_snapshot_release(snap);
+  cmd_destroy(&cmd);
+  return status;
+} /* cmd_status_t cmd_handle_listval_common */
 
-  free_everything_and_return(CMD_OK);
+cmd_status_t cmd_handle_listval(FILE *fh, char *buffer) {
+  return cmd_handle_listval_common(fh, buffer, CMD_LISTVAL);
 } /* cmd_status_t cmd_handle_listval */
+
+cmd_status_t cmd_handle_getvals(FILE *fh, char *buffer) {
+  return cmd_handle_listval_common(fh, buffer, CMD_GETVALS);
+} /* cmd_status_t cmd_handle_getvals */
+
+void cmd_destroy_listval(cmd_listval_t *listval) {
+  if (listval == NULL)
+    return;
+
+  sfree(listval->glob);
+  if (listval->regex != NULL) {
+    regfree(listval->regex);
+    sfree(listval->regex);
+  }
+  sfree(listval->cursor);
+  listval->limit = 0;
+} /* void cmd_destroy_listval */
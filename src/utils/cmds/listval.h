@@ -32,9 +32,20 @@
 #include "utils/cmds/cmds.h"
 
 cmd_status_t cmd_parse_listval(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
+                               const cmd_options_t *opts,
+                               cmd_error_handler_t *err);
+
+/* GETVALS takes the same options as LISTVAL and an optional wildcard
+ * pattern. */
+cmd_status_t cmd_parse_getvals(size_t argc, char **argv,
+                               cmd_listval_t *ret_listval,
                                const cmd_options_t *opts,
                                cmd_error_handler_t *err);
 
 cmd_status_t cmd_handle_listval(FILE *fh, char *buffer);
+cmd_status_t cmd_handle_getvals(FILE *fh, char *buffer);
+
+void cmd_destroy_listval(cmd_listval_t *listval);
 
 #endif /* UTILS_CMD_LISTVAL_H */
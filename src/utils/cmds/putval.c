@@ -28,9 +28,28 @@
 
 #include "collectd.h"
 
+#include "utils/avltree/avltree.h"
 #include "utils/cmds/putval.h"
 #include "utils/common/common.h"
 
+/* Maximum number of identifiers kept by a cmd_putval_cache_t. When it is
+ * exceeded, the cache is cleared. */
+#define CMD_PUTVAL_CACHE_MAX 16384
+
+/* A parsed identifier: the value list with all but the values and time set,
+ * and the data set of its type. */
+typedef struct {
+  value_list_t vl;
+  data_set_t const *ds;
+  char *identifier;
+} putval_entry_t;
+
+struct cmd_putval_cache_s {
+  c_avl_tree_t *entries;
+  /* The identifier_default_host the entries have been parsed with. */
+  char *default_host;
+};
+
 /*
  * private helper functions
  */
@@ -271,34 +290,492 @@ void cmd_destroy_putval(cmd_putval_t *putval) {
   putval->vl_num = 0;
 } /* void cmd_destroy_putval */
 
-cmd_status_t cmd_handle_putval(FILE *fh, char *buffer) {
-  cmd_error_handler_t err = {cmd_error_fh, fh};
-  cmd_t cmd;
+/* Returns the next field of "*buffer" and advances the buffer. Fields are
+ * split and unquoted in place, following the same rules as cmd_split(). At the
+ * end of the buffer, "*ret_field" is set to NULL. */
+static cmd_status_t putval_next_field(char **buffer, char **ret_field,
+                                      cmd_error_handler_t *err) {
+  char *string = *buffer;
+  while (isspace((int)string[0]))
+    string++;
+
+  if (string[0] == '\0') {
+    *buffer = string;
+    *ret_field = NULL;
+    return CMD_OK;
+  }
 
-  int status;
+  char *field = string;
+  *ret_field = field;
 
-  DEBUG("utils_cmd_putval: cmd_handle_putval (fh = %p, buffer = %s);",
-        (void *)fh, buffer);
+  bool in_quotes = false;
+  for (; string[0] != '\0'; string++) {
+    if (isspace((int)string[0]) && !in_quotes)
+      break;
+
+    if (string[0] == '"') {
+      /* A closing quotation mark always ends the field. */
+      if (in_quotes) {
+        in_quotes = false;
+        string++;
+        break;
+      }
+      in_quotes = true;
+      continue;
+    }
+
+    if ((string[0] == '\\') && in_quotes) {
+      if (string[1] == '\0') {
+        cmd_error(CMD_PARSE_ERROR, err, "Backslash at end of string.");
+        return CMD_PARSE_ERROR;
+      }
+      string++;
+    }
+
+    *field = string[0];
+    field++;
+  }
+
+  if (in_quotes) {
+    cmd_error(CMD_PARSE_ERROR, err, "Unterminated quoted string.");
+    return CMD_PARSE_ERROR;
+  }
+
+  /* Determine the next position before terminating the field, which may
+   * overwrite the separating space. */
+  *buffer = isspace((int)string[0]) ? string + 1 : string;
+  *field = '\0';
+  return CMD_OK;
+} /* cmd_status_t putval_next_field */
+
+/* Checks whether "field" is an option, like cmd_parse_option() does, without
+ * modifying it. Returns the length of the key or zero. */
+static size_t putval_option_key_len(char const *field) {
+  size_t len = 0;
+
+  while (isalnum((int)field[len]) || (field[len] == '_') ||
+         (field[len] == ':'))
+    len++;
+
+  return ((len > 0) && (field[len] == '=')) ? len : 0;
+} /* size_t putval_option_key_len */
+
+static int putval_parse_value(char const *str, value_t *ret_value,
+                              int ds_type) {
+  char *endptr = NULL;
+
+  switch (ds_type) {
+  case DS_TYPE_COUNTER:
+    ret_value->counter = (counter_t)strtoull(str, &endptr, 0);
+    break;
+  case DS_TYPE_GAUGE:
+    ret_value->gauge = (gauge_t)strtod(str, &endptr);
+    break;
+  case DS_TYPE_DERIVE:
+    ret_value->derive = (derive_t)strtoll(str, &endptr, 0);
+    break;
+  case DS_TYPE_ABSOLUTE:
+    ret_value->absolute = (absolute_t)strtoull(str, &endptr, 0);
+    break;
+  default:
+    return -1;
+  }
+
+  /* Like parse_value(), trailing garbage is ignored. */
+  return (endptr == str) ? -1 : 0;
+} /* int putval_parse_value */
+
+/* Parses a "<time>:<value>[:<value>...]" field like parse_values(), but
+ * without modifying the string or allocating memory. */
+static int putval_parse_values(char const *str, value_list_t *vl,
+                               data_set_t const *ds) {
+  bool have_time = false;
+  size_t i = 0;
+
+  while (42) {
+    /* Like strtok_r(), skip empty fields. */
+    while (str[0] == ':')
+      str++;
+    if (str[0] == '\0')
+      break;
+
+    size_t len = strcspn(str, ":");
+
+    if (!have_time) {
+      if ((len == 1) && (str[0] == 'N'))
+        vl->time = cdtime();
+      else {
+        char *endptr = NULL;
+
+        errno = 0;
+        double tmp = strtod(str, &endptr);
+        if ((errno != 0) || (endptr != str + len))
+          return -1;
+        vl->time = DOUBLE_TO_CDTIME_T(tmp);
+      }
+      have_time = true;
+    } else {
+      if (i >= vl->values_len)
+        return -1;
+
+      if ((len == 1) && (str[0] == 'U') && (ds->ds[i].type == DS_TYPE_GAUGE))
+        vl->values[i].gauge = NAN;
+      else if (putval_parse_value(str, &vl->values[i], ds->ds[i].type) != 0)
+        return -1;
+      i++;
+    }
+
+    str += len;
+  }
+
+  if (i == 0)
+    return -1;
+
+  /* Missing values are zero, as with cmd_parse_putval(). */
+  for (; i < vl->values_len; i++)
+    memset(&vl->values[i], 0, sizeof(vl->values[i]));
+
+  return 0;
+} /* int putval_parse_values */
+
+/* Parses "identifier" into the fields of "e". The values are not set. */
+static cmd_status_t putval_entry_init(putval_entry_t *e,
+                                      char const *identifier,
+                                      const cmd_options_t *opts,
+                                      cmd_error_handler_t *err) {
+  char buffer[6 * DATA_MAX_NAME_LEN];
+  char *hostname;
+  char *plugin;
+  char *plugin_instance;
+  char *type;
+  char *type_instance;
+
+  if (strlen(identifier) >= sizeof(buffer)) {
+    cmd_error(CMD_PARSE_ERROR, err, "Identifier too long.");
+    return CMD_PARSE_ERROR;
+  }
+  sstrncpy(buffer, identifier, sizeof(buffer));
+
+  if (parse_identifier(buffer, &hostname, &plugin, &plugin_instance, &type,
+                       &type_instance, opts->identifier_default_host) != 0) {
+    cmd_error(CMD_PARSE_ERROR, err, "Cannot parse identifier `%s'.",
+              identifier);
+    return CMD_PARSE_ERROR;
+  }
+
+  memset(e, 0, sizeof(*e));
+  if ((strlen(hostname) >= sizeof(e->vl.host)) ||
+      (strlen(plugin) >= sizeof(e->vl.plugin)) ||
+      ((plugin_instance != NULL) &&
+       (strlen(plugin_instance) >= sizeof(e->vl.plugin_instance))) ||
+      ((type_instance != NULL) &&
+       (strlen(type_instance) >= sizeof(e->vl.type_instance)))) {
+    cmd_error(CMD_PARSE_ERROR, err, "Identifier too long.");
+    return CMD_PARSE_ERROR;
+  }
+
+  sstrncpy(e->vl.host, hostname, sizeof(e->vl.host));
+  sstrncpy(e->vl.plugin, plugin, sizeof(e->vl.plugin));
+  sstrncpy(e->vl.type, type, sizeof(e->vl.type));
+  if (plugin_instance != NULL)
+    sstrncpy(e->vl.plugin_instance, plugin_instance,
+             sizeof(e->vl.plugin_instance));
+  if (type_instance != NULL)
+    sstrncpy(e->vl.type_instance, type_instance, sizeof(e->vl.type_instance));
+
+  e->ds = plugin_get_ds(type);
+  if (e->ds == NULL) {
+    cmd_error(CMD_PARSE_ERROR, err, "1 Type `%s' isn't defined.", type);
+    return CMD_PARSE_ERROR;
+  }
+  e->vl.values_len = e->ds->ds_num;
+
+  return CMD_OK;
+} /* cmd_status_t putval_entry_init */
+
+static void putval_cache_clear(cmd_putval_cache_t *cache) {
+  void *key;
+  void *value;
+
+  while (c_avl_pick(cache->entries, &key, &value) == 0)
+    free(value);
+} /* void putval_cache_clear */
+
+/* Returns the cached entry for "identifier", parsing and adding it if
+ * necessary. */
+static cmd_status_t putval_cache_get(cmd_putval_cache_t *cache,
+                                     char const *identifier,
+                                     const cmd_options_t *opts,
+                                     cmd_error_handler_t *err,
+                                     putval_entry_t **ret_entry) {
+  char const *default_host = opts->identifier_default_host;
+  if ((cache->default_host != default_host) &&
+      ((cache->default_host == NULL) || (default_host == NULL) ||
+       (strcmp(cache->default_host, default_host) != 0))) {
+    putval_cache_clear(cache);
+    sfree(cache->default_host);
+    if (default_host != NULL) {
+      cache->default_host = strdup(default_host);
+      if (cache->default_host == NULL) {
+        cmd_error(CMD_ERROR, err, "strdup failed.");
+        return CMD_ERROR;
+      }
+    }
+  }
 
-  if ((status = cmd_parse(buffer, &cmd, NULL, &err)) != CMD_OK)
+  if (c_avl_get(cache->entries, identifier, (void *)ret_entry) == 0)
+    return CMD_OK;
+
+  putval_entry_t tmp;
+  cmd_status_t status = putval_entry_init(&tmp, identifier, opts, err);
+  if (status != CMD_OK)
+    return status;
+
+  /* The entry, its values and the identifier share one allocation. */
+  size_t identifier_size = strlen(identifier) + 1;
+  putval_entry_t *e =
+      malloc(sizeof(*e) + tmp.vl.values_len * sizeof(value_t) +
+             identifier_size);
+  if (e == NULL) {
+    cmd_error(CMD_ERROR, err, "malloc failed.");
+    return CMD_ERROR;
+  }
+  memcpy(e, &tmp, sizeof(*e));
+  e->vl.values = (value_t *)(e + 1);
+  e->identifier = (char *)(e->vl.values + e->vl.values_len);
+  memcpy(e->identifier, identifier, identifier_size);
+
+  if (c_avl_size(cache->entries) >= CMD_PUTVAL_CACHE_MAX)
+    putval_cache_clear(cache);
+
+  if (c_avl_insert(cache->entries, e->identifier, e) != 0) {
+    free(e);
+    cmd_error(CMD_ERROR, err, "c_avl_insert failed.");
+    return CMD_ERROR;
+  }
+
+  *ret_entry = e;
+  return CMD_OK;
+} /* cmd_status_t putval_cache_get */
+
+/* Parses the option and value fields following the identifier. All fields
+ * are checked before the first value list is passed to "cb", so that either
+ * all or none of the values are handled, as with cmd_parse_putval(). */
+static cmd_status_t putval_handle_fields(putval_entry_t *e, size_t argc,
+                                         char **argv,
+                                         cmd_error_handler_t *err,
+                                         cmd_putval_cb_t cb, void *ud) {
+  size_t values_num = 0;
+
+  for (size_t i = 0; i < argc; i++) {
+    size_t key_len = putval_option_key_len(argv[i]);
+    if (key_len == 0)
+      values_num++;
+    /* Meta data is handled by cmd_parse_putval(). */
+    else if ((key_len != strlen("interval")) ||
+             (strncasecmp("interval", argv[i], key_len) != 0))
+      return CMD_ERROR;
+  }
+
+  for (size_t i = 0; (values_num > 1) && (i < argc); i++) {
+    if ((putval_option_key_len(argv[i]) == 0) &&
+        (putval_parse_values(argv[i], &e->vl, e->ds) != 0)) {
+      cmd_error(CMD_PARSE_ERROR, err, "Parsing the values string failed.");
+      return CMD_PARSE_ERROR;
+    }
+  }
+
+  e->vl.interval = 0;
+  for (size_t i = 0; i < argc; i++) {
+    size_t key_len = putval_option_key_len(argv[i]);
+    if (key_len != 0) {
+      argv[i][key_len] = '\0';
+      set_option(&e->vl, argv[i], argv[i] + key_len + 1, err);
+      continue;
+    }
+
+    if (putval_parse_values(argv[i], &e->vl, e->ds) != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Parsing the values string failed.");
+      return CMD_PARSE_ERROR;
+    }
+
+    if ((*cb)(&e->vl, ud) != 0)
+      return CMD_ERROR;
+  }
+
+  return CMD_OK;
+} /* cmd_status_t putval_handle_fields */
+
+/* Handles commands the fast path doesn't support using cmd_parse(). */
+static cmd_status_t putval_parse_generic(char *buffer,
+                                         const cmd_options_t *opts,
+                                         cmd_error_handler_t *err,
+                                         cmd_putval_cb_t cb, void *ud) {
+  cmd_t cmd;
+  cmd_status_t status;
+
+  if ((status = cmd_parse(buffer, &cmd, opts, err)) != CMD_OK)
     return status;
   if (cmd.type != CMD_PUTVAL) {
-    cmd_error(CMD_UNKNOWN_COMMAND, &err, "Unexpected command: `%s'.",
+    cmd_error(CMD_UNKNOWN_COMMAND, err, "Unexpected command: `%s'.",
               CMD_TO_STRING(cmd.type));
     cmd_destroy(&cmd);
     return CMD_UNKNOWN_COMMAND;
   }
 
-  for (size_t i = 0; i < cmd.cmd.putval.vl_num; ++i)
-    plugin_dispatch_values(&cmd.cmd.putval.vl[i]);
+  status = CMD_OK;
+  for (size_t i = 0; i < cmd.cmd.putval.vl_num; ++i) {
+    if ((*cb)(&cmd.cmd.putval.vl[i], ud) != 0) {
+      status = CMD_ERROR;
+      break;
+    }
+  }
+
+  cmd_destroy(&cmd);
+  return status;
+} /* cmd_status_t putval_parse_generic */
+
+static int putval_dispatch_cb(value_list_t const *vl, void *ud) {
+  size_t *num = ud;
+
+  plugin_dispatch_values(vl);
+  (*num)++;
+  return 0;
+} /* int putval_dispatch_cb */
+
+cmd_putval_cache_t *cmd_putval_cache_create(void) {
+  cmd_putval_cache_t *cache = calloc(1, sizeof(*cache));
+  if (cache == NULL)
+    return NULL;
+
+  cache->entries = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (cache->entries == NULL) {
+    free(cache);
+    return NULL;
+  }
+
+  return cache;
+} /* cmd_putval_cache_t *cmd_putval_cache_create */
+
+void cmd_putval_cache_destroy(cmd_putval_cache_t *cache) {
+  if (cache == NULL)
+    return;
+
+  putval_cache_clear(cache);
+  c_avl_destroy(cache->entries);
+  free(cache->default_host);
+  free(cache);
+} /* void cmd_putval_cache_destroy */
+
+cmd_status_t cmd_parse_putval_cached(char *buffer, cmd_putval_cache_t *cache,
+                                     const cmd_options_t *opts,
+                                     cmd_error_handler_t *err,
+                                     cmd_putval_cb_t cb, void *ud) {
+  static cmd_options_t default_options = {
+      /* identifier_default_host = */ NULL,
+  };
+  char *fields_static[32];
+  char **fields = fields_static;
+  size_t fields_size = STATIC_ARRAY_SIZE(fields_static);
+  size_t fields_num = 0;
+
+  if ((buffer == NULL) || (cb == NULL)) {
+    errno = EINVAL;
+    cmd_error(CMD_ERROR, err, "Invalid arguments to cmd_parse_putval_cached.");
+    return CMD_ERROR;
+  }
+  if (opts == NULL)
+    opts = &default_options;
+
+  /* Meta data needs allocations anyway. Other commands, including a quoted
+   * "PUTVAL", are left to cmd_parse() so that the error messages match. */
+  char *ptr = buffer;
+  while (isspace((int)ptr[0]))
+    ptr++;
+  if ((strncasecmp("PUTVAL", ptr, strlen("PUTVAL")) != 0) ||
+      ((ptr[strlen("PUTVAL")] != '\0') &&
+       !isspace((int)ptr[strlen("PUTVAL")])) ||
+      (strstr(ptr, "meta:") != NULL))
+    return putval_parse_generic(buffer, opts, err, cb, ud);
+  ptr += strlen("PUTVAL");
+
+  cmd_status_t status;
+  while (42) {
+    char *field = NULL;
+
+    status = putval_next_field(&ptr, &field, err);
+    if ((status != CMD_OK) || (field == NULL))
+      break;
+
+    if (fields_num >= fields_size) {
+      size_t new_size = 2 * fields_size;
+      char **tmp = (fields == fields_static)
+                       ? malloc(new_size * sizeof(*fields))
+                       : realloc(fields, new_size * sizeof(*fields));
+      if (tmp == NULL) {
+        cmd_error(CMD_ERROR, err, "malloc failed.");
+        status = CMD_ERROR;
+        break;
+      }
+      if (fields == fields_static)
+        memcpy(tmp, fields_static, sizeof(fields_static));
+      fields = tmp;
+      fields_size = new_size;
+    }
+    fields[fields_num] = field;
+    fields_num++;
+  }
+
+  if ((status == CMD_OK) && (fields_num < 2)) {
+    cmd_error(CMD_PARSE_ERROR, err, "Missing identifier and/or value-list.");
+    status = CMD_PARSE_ERROR;
+  }
+
+  if ((status == CMD_OK) && (cache != NULL)) {
+    putval_entry_t *e = NULL;
+
+    status = putval_cache_get(cache, fields[0], opts, err, &e);
+    if (status == CMD_OK)
+      status = putval_handle_fields(e, fields_num - 1, fields + 1, err, cb, ud);
+  } else if (status == CMD_OK) {
+    putval_entry_t e;
+
+    status = putval_entry_init(&e, fields[0], opts, err);
+    if (status == CMD_OK) {
+      value_t values[e.vl.values_len];
+      e.vl.values = values;
+      status =
+          putval_handle_fields(&e, fields_num - 1, fields + 1, err, cb, ud);
+    }
+  }
+
+  if (fields != fields_static)
+    free(fields);
+  return status;
+} /* cmd_status_t cmd_parse_putval_cached */
+
+cmd_status_t cmd_handle_putval_cached(FILE *fh, char *buffer,
+                                      cmd_putval_cache_t *cache) {
+  cmd_error_handler_t err = {cmd_error_fh, fh};
+  size_t num = 0;
+
+  DEBUG("utils_cmd_putval: cmd_handle_putval (fh = %p, buffer = %s);",
+        (void *)fh, buffer);
+
+  cmd_status_t status = cmd_parse_putval_cached(buffer, cache, NULL, &err,
+                                                putval_dispatch_cb, &num);
+  if (status != CMD_OK)
+    return status;
 
   if (fh != stdout)
-    cmd_error(CMD_OK, &err, "Success: %i %s been dispatched.",
-              (int)cmd.cmd.putval.vl_num,
-              (cmd.cmd.putval.vl_num == 1) ? "value has" : "values have");
+    cmd_error(CMD_OK, &err, "Success: %i %s been dispatched.", (int)num,
+              (num == 1) ? "value has" : "values have");
 
-  cmd_destroy(&cmd);
   return CMD_OK;
+} /* cmd_status_t cmd_handle_putval_cached */
+
+cmd_status_t cmd_handle_putval(FILE *fh, char *buffer) {
+  return cmd_handle_putval_cached(fh, buffer, /* cache = */ NULL);
 } /* int cmd_handle_putval */
 
 int cmd_create_putval(char *ret, size_t ret_len, /* {{{ */
@@ -39,6 +39,27 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
 
 cmd_status_t cmd_handle_putval(FILE *fh, char *buffer);
 
+/* Cache of parsed identifiers, mapping them to their data set and a prepared
+ * value list. A cache must only be used by one thread at a time. */
+typedef struct cmd_putval_cache_s cmd_putval_cache_t;
+
+cmd_putval_cache_t *cmd_putval_cache_create(void);
+void cmd_putval_cache_destroy(cmd_putval_cache_t *cache);
+
+/* Called for each value list of a PUTVAL command. The value list is only
+ * valid during the call. Returning non-zero aborts the command. */
+typedef int (*cmd_putval_cb_t)(value_list_t const *vl, void *user_data);
+
+/* Parses a PUTVAL command line in place without allocating memory for the
+ * common case and calls "cb" for each value list. "cache" may be NULL. */
+cmd_status_t cmd_parse_putval_cached(char *buffer, cmd_putval_cache_t *cache,
+                                     const cmd_options_t *opts,
+                                     cmd_error_handler_t *err,
+                                     cmd_putval_cb_t cb, void *user_data);
+
+cmd_status_t cmd_handle_putval_cached(FILE *fh, char *buffer,
+                                      cmd_putval_cache_t *cache);
+
 void cmd_destroy_putval(cmd_putval_t *putval);
 
 int cmd_create_putval(char *ret, size_t ret_len, const data_set_t *ds,
@@ -0,0 +1,1036 @@
+/**
+ * collectd - src/utils/columnar/columnar.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* This file is linked into the daemon as well as into stand-alone programs,
+ * so it must not use any of the plugin API (e.g. the logging macros). */
+
+#include "collectd.h"
+
+#include "utils/columnar/columnar.h"
+#include "utils/crc32/crc32.h"
+
+/* Upper bound for dictionary ids accepted by the decoder. Protects against
+ * huge allocations caused by garbage input. */
+#define COLUMNAR_MAX_ID (1 << 24)
+
+/*
+ * Byte buffer
+ */
+static int buf_reserve(columnar_buf_t *b, size_t n) /* {{{ */
+{
+  size_t new_size;
+  uint8_t *tmp;
+
+  if ((b->size - b->len) >= n)
+    return 0;
+
+  new_size = (b->size == 0) ? 4096 : b->size;
+  while ((new_size - b->len) < n)
+    new_size *= 2;
+
+  tmp = realloc(b->data, new_size);
+  if (tmp == NULL)
+    return ENOMEM;
+
+  b->data = tmp;
+  b->size = new_size;
+  return 0;
+} /* }}} int buf_reserve */
+
+static int buf_add(columnar_buf_t *b, const void *data, size_t n) /* {{{ */
+{
+  if (buf_reserve(b, n) != 0)
+    return ENOMEM;
+
+  if (n > 0)
+    memcpy(b->data + b->len, data, n);
+  b->len += n;
+  return 0;
+} /* }}} int buf_add */
+
+static int buf_add_varint(columnar_buf_t *b, uint64_t v) /* {{{ */
+{
+  uint8_t tmp[10];
+  size_t n = 0;
+
+  do {
+    tmp[n] = (uint8_t)(v & 0x7f);
+    v >>= 7;
+    if (v != 0)
+      tmp[n] |= 0x80;
+    n++;
+  } while (v != 0);
+
+  return buf_add(b, tmp, n);
+} /* }}} int buf_add_varint */
+
+static int buf_add_string(columnar_buf_t *b, const char *s) /* {{{ */
+{
+  size_t len = strlen(s);
+  int status;
+
+  status = buf_add_varint(b, (uint64_t)len);
+  if (status != 0)
+    return status;
+  return buf_add(b, s, len);
+} /* }}} int buf_add_string */
+
+static void put_u32(uint8_t *p, uint32_t v) /* {{{ */
+{
+  p[0] = (uint8_t)(v);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+} /* }}} void put_u32 */
+
+static uint32_t get_u32(const uint8_t *p) /* {{{ */
+{
+  return ((uint32_t)p[0]) | (((uint32_t)p[1]) << 8) |
+         (((uint32_t)p[2]) << 16) | (((uint32_t)p[3]) << 24);
+} /* }}} uint32_t get_u32 */
+
+void columnar_buf_reset(columnar_buf_t *b) /* {{{ */
+{
+  if (b != NULL)
+    b->len = 0;
+} /* }}} void columnar_buf_reset */
+
+void columnar_buf_free(columnar_buf_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return;
+
+  free(b->data);
+  b->data = NULL;
+  b->size = 0;
+  b->len = 0;
+} /* }}} void columnar_buf_free */
+
+/*
+ * Bit streams
+ */
+static int count_leading_zeros(uint64_t v) /* {{{ */
+{
+#if defined(__GNUC__)
+  return (v == 0) ? 64 : __builtin_clzll(v);
+#else
+  int n = 0;
+  if (v == 0)
+    return 64;
+  while ((v & (UINT64_C(1) << 63)) == 0) {
+    v <<= 1;
+    n++;
+  }
+  return n;
+#endif
+} /* }}} int count_leading_zeros */
+
+static int count_trailing_zeros(uint64_t v) /* {{{ */
+{
+#if defined(__GNUC__)
+  return (v == 0) ? 64 : __builtin_ctzll(v);
+#else
+  int n = 0;
+  if (v == 0)
+    return 64;
+  while ((v & 1) == 0) {
+    v >>= 1;
+    n++;
+  }
+  return n;
+#endif
+} /* }}} int count_trailing_zeros */
+
+int columnar_bits_write(columnar_bits_t *b, uint64_t value, /* {{{ */
+                        int nbits) {
+  size_t need;
+
+  if ((nbits < 1) || (nbits > 64))
+    return EINVAL;
+
+  need = (b->bits + (size_t)nbits + 7) / 8;
+  if (need > b->size) {
+    size_t new_size = (b->size == 0) ? 64 : 2 * b->size;
+    uint8_t *tmp;
+
+    while (new_size < need)
+      new_size *= 2;
+    tmp = realloc(b->data, new_size);
+    if (tmp == NULL)
+      return ENOMEM;
+    b->data = tmp;
+    b->size = new_size;
+  }
+
+  if (nbits < 64)
+    value &= (UINT64_C(1) << nbits) - 1;
+
+  while (nbits > 0) {
+    size_t byte = b->bits / 8;
+    int used = (int)(b->bits % 8);
+    int space = 8 - used;
+    int n = (nbits < space) ? nbits : space;
+    uint8_t chunk = (uint8_t)((value >> (nbits - n)) & ((1u << n) - 1));
+
+    if (used == 0)
+      b->data[byte] = 0;
+    b->data[byte] |= (uint8_t)(chunk << (space - n));
+
+    b->bits += (size_t)n;
+    nbits -= n;
+  }
+
+  return 0;
+} /* }}} int columnar_bits_write */
+
+int columnar_bits_read(columnar_reader_t *r, int nbits, /* {{{ */
+                       uint64_t *ret) {
+  uint64_t value = 0;
+
+  if ((nbits < 1) || (nbits > 64))
+    return EINVAL;
+  if ((r->bits - r->pos) < (size_t)nbits)
+    return ENODATA;
+
+  while (nbits > 0) {
+    size_t byte = r->pos / 8;
+    int used = (int)(r->pos % 8);
+    int avail = 8 - used;
+    int n = (nbits < avail) ? nbits : avail;
+    uint8_t chunk =
+        (uint8_t)((r->data[byte] >> (avail - n)) & ((1u << n) - 1));
+
+    value = (value << n) | chunk;
+    r->pos += (size_t)n;
+    nbits -= n;
+  }
+
+  *ret = value;
+  return 0;
+} /* }}} int columnar_bits_read */
+
+/*
+ * Delta-of-delta encoding
+ *
+ * The first value is stored verbatim. For every following value the
+ * difference between its delta and the previous delta is stored using a
+ * variable length prefix:
+ *
+ *   0                 dod == 0
+ *   10    + 7 bits    -64 <= dod < 64
+ *   110   + 9 bits    -256 <= dod < 256
+ *   1110  + 12 bits   -2048 <= dod < 2048
+ *   11110 + 32 bits
+ *   11111 + 64 bits
+ */
+#define DOD_CLASSES 6
+static const int dod_widths[DOD_CLASSES] = {0, 7, 9, 12, 32, 64};
+
+static bool fits_signed(int64_t v, int nbits) /* {{{ */
+{
+  int64_t limit;
+
+  if (nbits >= 64)
+    return true;
+
+  limit = INT64_C(1) << (nbits - 1);
+  return (v >= -limit) && (v < limit);
+} /* }}} bool fits_signed */
+
+int columnar_dod_encode(columnar_bits_t *b, columnar_dod_t *s, /* {{{ */
+                        uint64_t v) {
+  uint64_t delta;
+  int64_t dod;
+  int status;
+
+  if (s->count == 0) {
+    status = columnar_bits_write(b, v, 64);
+    if (status != 0)
+      return status;
+
+    s->prev = v;
+    s->prev_delta = 0;
+    s->count = 1;
+    return 0;
+  }
+
+  delta = v - s->prev;
+  dod = (int64_t)(delta - s->prev_delta);
+
+  if (dod == 0) {
+    status = columnar_bits_write(b, 0, 1);
+  } else {
+    size_t i;
+
+    for (i = 1; i < DOD_CLASSES - 1; i++)
+      if (fits_signed(dod, dod_widths[i]))
+        break;
+
+    /* i ones, followed by a zero unless this is the widest class. */
+    if (i < DOD_CLASSES - 1)
+      status = columnar_bits_write(b, ((UINT64_C(1) << i) - 1) << 1,
+                                   (int)i + 1);
+    else
+      status = columnar_bits_write(b, (UINT64_C(1) << i) - 1, (int)i);
+    if (status == 0)
+      status = columnar_bits_write(b, (uint64_t)dod, dod_widths[i]);
+  }
+  if (status != 0)
+    return status;
+
+  s->prev = v;
+  s->prev_delta = delta;
+  s->count++;
+  return 0;
+} /* }}} int columnar_dod_encode */
+
+int columnar_dod_decode(columnar_reader_t *r, columnar_dod_t *s, /* {{{ */
+                        uint64_t *ret) {
+  uint64_t tmp;
+  uint64_t dod = 0;
+  size_t ones = 0;
+  int status;
+
+  if (s->count == 0) {
+    status = columnar_bits_read(r, 64, &tmp);
+    if (status != 0)
+      return status;
+
+    s->prev = tmp;
+    s->prev_delta = 0;
+    s->count = 1;
+    *ret = tmp;
+    return 0;
+  }
+
+  while (ones < DOD_CLASSES - 1) {
+    status = columnar_bits_read(r, 1, &tmp);
+    if (status != 0)
+      return status;
+    if (tmp == 0)
+      break;
+    ones++;
+  }
+
+  if (ones > 0) {
+    int width = dod_widths[ones];
+
+    status = columnar_bits_read(r, width, &dod);
+    if (status != 0)
+      return status;
+
+    /* sign extension */
+    if ((width < 64) && (dod & (UINT64_C(1) << (width - 1))))
+      dod |= ~((UINT64_C(1) << width) - 1);
+  }
+
+  s->prev_delta += dod;
+  s->prev += s->prev_delta;
+  s->count++;
+  *ret = s->prev;
+  return 0;
+} /* }}} int columnar_dod_decode */
+
+/*
+ * XOR encoding of floating point values ("Gorilla")
+ *
+ * The first value is stored verbatim. Following values are XORed with their
+ * predecessor:
+ *
+ *   0                           same value
+ *   10 + meaningful bits        XOR fits into the previous leading/trailing
+ *                               zero window
+ *   11 + 5 bits leading zeros + 6 bits (length - 1) + meaningful bits
+ */
+int columnar_xor_encode(columnar_bits_t *b, columnar_xor_t *s, /* {{{ */
+                        double v) {
+  uint64_t bits;
+  uint64_t x;
+  int status;
+
+  memcpy(&bits, &v, sizeof(bits));
+
+  if (s->count == 0) {
+    status = columnar_bits_write(b, bits, 64);
+    if (status != 0)
+      return status;
+
+    s->prev = bits;
+    s->leading = -1;
+    s->trailing = 0;
+    s->count = 1;
+    return 0;
+  }
+
+  x = bits ^ s->prev;
+  if (x == 0) {
+    status = columnar_bits_write(b, 0, 1);
+  } else {
+    int leading = count_leading_zeros(x);
+    int trailing = count_trailing_zeros(x);
+
+    if (leading > 31)
+      leading = 31;
+
+    if ((s->leading >= 0) && (leading >= s->leading) &&
+        (trailing >= s->trailing)) {
+      status = columnar_bits_write(b, 2, 2);
+      if (status == 0)
+        status = columnar_bits_write(b, x >> s->trailing,
+                                     64 - s->leading - s->trailing);
+    } else {
+      int length = 64 - leading - trailing;
+
+      status = columnar_bits_write(b, 3, 2);
+      if (status == 0)
+        status = columnar_bits_write(b, (uint64_t)leading, 5);
+      if (status == 0)
+        status = columnar_bits_write(b, (uint64_t)(length - 1), 6);
+      if (status == 0)
+        status = columnar_bits_write(b, x >> trailing, length);
+
+      s->leading = leading;
+      s->trailing = trailing;
+    }
+  }
+  if (status != 0)
+    return status;
+
+  s->prev = bits;
+  s->count++;
+  return 0;
+} /* }}} int columnar_xor_encode */
+
+int columnar_xor_decode(columnar_reader_t *r, columnar_xor_t *s, /* {{{ */
+                        double *ret) {
+  uint64_t tmp;
+  int status;
+
+  if (s->count == 0) {
+    status = columnar_bits_read(r, 64, &tmp);
+    if (status != 0)
+      return status;
+
+    s->prev = tmp;
+    s->leading = -1;
+    s->trailing = 0;
+  } else {
+    status = columnar_bits_read(r, 1, &tmp);
+    if (status != 0)
+      return status;
+
+    if (tmp != 0) {
+      uint64_t x;
+
+      status = columnar_bits_read(r, 1, &tmp);
+      if (status != 0)
+        return status;
+
+      if (tmp != 0) {
+        uint64_t leading;
+        uint64_t length;
+
+        status = columnar_bits_read(r, 5, &leading);
+        if (status == 0)
+          status = columnar_bits_read(r, 6, &length);
+        if (status != 0)
+          return status;
+
+        length++;
+        if ((leading + length) > 64)
+          return EILSEQ;
+
+        s->leading = (int)leading;
+        s->trailing = 64 - (int)leading - (int)length;
+      } else if (s->leading < 0) {
+        return EILSEQ;
+      }
+
+      status = columnar_bits_read(r, 64 - s->leading - s->trailing, &x);
+      if (status != 0)
+        return status;
+
+      s->prev ^= x << s->trailing;
+    }
+  }
+
+  s->count++;
+  memcpy(ret, &s->prev, sizeof(*ret));
+  return 0;
+} /* }}} int columnar_xor_decode */
+
+/*
+ * Series
+ */
+static void column_reset(columnar_column_t *c) /* {{{ */
+{
+  c->bits.bits = 0;
+  memset(&c->state, 0, sizeof(c->state));
+} /* }}} void column_reset */
+
+columnar_series_t *columnar_series_create(uint64_t id, /* {{{ */
+                                          const char *name, size_t ds_num,
+                                          const int *ds_types,
+                                          const char *const *ds_names) {
+  columnar_series_t *s;
+
+  s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->id = id;
+  s->ds_num = ds_num;
+  s->name = strdup(name);
+  s->ds_names = calloc(ds_num, sizeof(*s->ds_names));
+  s->values = calloc(ds_num, sizeof(*s->values));
+  if ((s->name == NULL) || (s->ds_names == NULL) || (s->values == NULL)) {
+    columnar_series_destroy(s);
+    return NULL;
+  }
+
+  s->time.type = COLUMNAR_DS_DERIVE;
+  for (size_t i = 0; i < ds_num; i++) {
+    s->values[i].type = ds_types[i];
+    s->ds_names[i] = strdup(ds_names[i]);
+    if (s->ds_names[i] == NULL) {
+      columnar_series_destroy(s);
+      return NULL;
+    }
+  }
+
+  return s;
+} /* }}} columnar_series_t *columnar_series_create */
+
+void columnar_series_destroy(columnar_series_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  free(s->time.bits.data);
+  for (size_t i = 0; i < s->ds_num; i++) {
+    if (s->values != NULL)
+      free(s->values[i].bits.data);
+    if (s->ds_names != NULL)
+      free(s->ds_names[i]);
+  }
+  free(s->values);
+  free(s->ds_names);
+  free(s->name);
+  free(s);
+} /* }}} void columnar_series_destroy */
+
+static void series_reset(columnar_series_t *s) /* {{{ */
+{
+  column_reset(&s->time);
+  for (size_t i = 0; i < s->ds_num; i++)
+    column_reset(s->values + i);
+  s->points = 0;
+} /* }}} void series_reset */
+
+static int column_append(columnar_column_t *c, /* {{{ */
+                         columnar_value_t v) {
+  switch (c->type) {
+  case COLUMNAR_DS_GAUGE:
+    return columnar_xor_encode(&c->bits, &c->state.xor, v.gauge);
+  case COLUMNAR_DS_COUNTER:
+    return columnar_dod_encode(&c->bits, &c->state.dod, v.counter);
+  case COLUMNAR_DS_DERIVE:
+    return columnar_dod_encode(&c->bits, &c->state.dod, (uint64_t)v.derive);
+  case COLUMNAR_DS_ABSOLUTE:
+    return columnar_dod_encode(&c->bits, &c->state.dod, v.absolute);
+  }
+
+  return EINVAL;
+} /* }}} int column_append */
+
+int columnar_series_append(columnar_series_t *s, int64_t time_ms, /* {{{ */
+                           const columnar_value_t *values) {
+  int status;
+
+  status = column_append(&s->time, (columnar_value_t){.derive = time_ms});
+  for (size_t i = 0; (status == 0) && (i < s->ds_num); i++)
+    status = column_append(s->values + i, values[i]);
+
+  if (status != 0) {
+    /* Out of memory: throw away the block's data for this series rather
+     * than leaving the columns with different lengths. */
+    series_reset(s);
+    return status;
+  }
+
+  s->points++;
+  return 0;
+} /* }}} int columnar_series_append */
+
+size_t columnar_series_size(const columnar_series_t *s) /* {{{ */
+{
+  size_t size = (s->time.bits.bits + 7) / 8;
+
+  for (size_t i = 0; i < s->ds_num; i++)
+    size += (s->values[i].bits.bits + 7) / 8;
+
+  return size;
+} /* }}} size_t columnar_series_size */
+
+/*
+ * Blocks
+ */
+static int buf_add_column(columnar_buf_t *b, /* {{{ */
+                          const columnar_column_t *c) {
+  int status;
+
+  status = buf_add_varint(b, (uint64_t)c->bits.bits);
+  if (status != 0)
+    return status;
+  return buf_add(b, c->bits.data, (c->bits.bits + 7) / 8);
+} /* }}} int buf_add_column */
+
+static int block_write_payload(columnar_buf_t *out, /* {{{ */
+                               columnar_series_t *const *dict,
+                               size_t dict_num,
+                               columnar_series_t *const *series,
+                               size_t series_num) {
+  size_t active = 0;
+
+#define CHECK(cmd)                                                             \
+  do {                                                                         \
+    int status__ = (cmd);                                                      \
+    if (status__ != 0)                                                         \
+      return status__;                                                         \
+  } while (0)
+
+  CHECK(buf_add_varint(out, (uint64_t)dict_num));
+  for (size_t i = 0; i < dict_num; i++) {
+    const columnar_series_t *s = dict[i];
+    uint8_t type;
+
+    CHECK(buf_add_varint(out, s->id));
+    CHECK(buf_add_string(out, s->name));
+    CHECK(buf_add_varint(out, (uint64_t)s->ds_num));
+    for (size_t j = 0; j < s->ds_num; j++) {
+      type = (uint8_t)s->values[j].type;
+      CHECK(buf_add(out, &type, 1));
+      CHECK(buf_add_string(out, s->ds_names[j]));
+    }
+  }
+
+  for (size_t i = 0; i < series_num; i++)
+    if (series[i]->points > 0)
+      active++;
+
+  CHECK(buf_add_varint(out, (uint64_t)active));
+  for (size_t i = 0; i < series_num; i++) {
+    const columnar_series_t *s = series[i];
+
+    if (s->points == 0)
+      continue;
+
+    CHECK(buf_add_varint(out, s->id));
+    CHECK(buf_add_varint(out, s->points));
+    CHECK(buf_add_column(out, &s->time));
+    for (size_t j = 0; j < s->ds_num; j++)
+      CHECK(buf_add_column(out, s->values + j));
+  }
+
+#undef CHECK
+
+  return 0;
+} /* }}} int block_write_payload */
+
+int columnar_block_write(columnar_buf_t *out, int flags, /* {{{ */
+                         columnar_series_t *const *dict, size_t dict_num,
+                         columnar_series_t *const *series,
+                         size_t series_num) {
+  size_t start = out->len;
+  size_t payload_size;
+  uint8_t *header;
+  int status;
+
+  status = buf_reserve(out, COLUMNAR_BLOCK_HEADER_SIZE);
+  if (status != 0)
+    return status;
+  out->len += COLUMNAR_BLOCK_HEADER_SIZE;
+
+  status = block_write_payload(out, dict, dict_num, series, series_num);
+  if (status != 0) {
+    out->len = start;
+    return status;
+  }
+
+  payload_size = out->len - start - COLUMNAR_BLOCK_HEADER_SIZE;
+  if (payload_size > UINT32_MAX) {
+    out->len = start;
+    return EFBIG;
+  }
+
+  header = out->data + start;
+  put_u32(header, COLUMNAR_BLOCK_MAGIC);
+  header[4] = COLUMNAR_BLOCK_VERSION;
+  header[5] = (uint8_t)flags;
+  header[6] = 0;
+  header[7] = 0;
+  put_u32(header + 8, (uint32_t)payload_size);
+  put_u32(header + 12,
+          crc32_buffer(header + COLUMNAR_BLOCK_HEADER_SIZE, payload_size));
+
+  for (size_t i = 0; i < series_num; i++)
+    series_reset(series[i]);
+
+  return 0;
+} /* }}} int columnar_block_write */
+
+/*
+ * Decoding
+ */
+typedef struct {
+  const uint8_t *ptr;
+  size_t left;
+} cursor_t;
+
+static int cursor_varint(cursor_t *c, uint64_t *ret) /* {{{ */
+{
+  uint64_t v = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte;
+
+    if (c->left == 0)
+      return EILSEQ;
+    byte = *c->ptr;
+    c->ptr++;
+    c->left--;
+
+    v |= ((uint64_t)(byte & 0x7f)) << shift;
+    if ((byte & 0x80) == 0) {
+      *ret = v;
+      return 0;
+    }
+  }
+
+  return EILSEQ;
+} /* }}} int cursor_varint */
+
+static int cursor_bytes(cursor_t *c, size_t n, /* {{{ */
+                        const uint8_t **ret) {
+  if (c->left < n)
+    return EILSEQ;
+
+  *ret = c->ptr;
+  c->ptr += n;
+  c->left -= n;
+  return 0;
+} /* }}} int cursor_bytes */
+
+static int cursor_string(cursor_t *c, char **ret) /* {{{ */
+{
+  const uint8_t *data;
+  uint64_t len;
+  char *s;
+
+  if ((cursor_varint(c, &len) != 0) || (len > c->left) ||
+      (cursor_bytes(c, (size_t)len, &data) != 0))
+    return EILSEQ;
+
+  s = malloc((size_t)len + 1);
+  if (s == NULL)
+    return ENOMEM;
+  memcpy(s, data, (size_t)len);
+  s[len] = 0;
+
+  *ret = s;
+  return 0;
+} /* }}} int cursor_string */
+
+static void entry_clear(columnar_entry_t *e) /* {{{ */
+{
+  if (e->ds_names != NULL)
+    for (size_t i = 0; i < e->ds_num; i++)
+      free(e->ds_names[i]);
+  free(e->ds_names);
+  free(e->ds_types);
+  free(e->name);
+  memset(e, 0, sizeof(*e));
+} /* }}} void entry_clear */
+
+void columnar_dict_free(columnar_dict_t *d) /* {{{ */
+{
+  if (d == NULL)
+    return;
+
+  for (size_t i = 0; i < d->entries_num; i++)
+    entry_clear(d->entries + i);
+  free(d->entries);
+  d->entries = NULL;
+  d->entries_num = 0;
+} /* }}} void columnar_dict_free */
+
+static int dict_read_entry(cursor_t *c, columnar_dict_t *d) /* {{{ */
+{
+  columnar_entry_t e = {0};
+  uint64_t ds_num;
+  int status;
+
+  if ((cursor_varint(c, &e.id) != 0) || (e.id >= COLUMNAR_MAX_ID))
+    return EILSEQ;
+
+  status = cursor_string(c, &e.name);
+  if (status != 0)
+    return status;
+
+  /* Every data source takes at least two bytes. */
+  if ((cursor_varint(c, &ds_num) != 0) || (ds_num == 0) ||
+      (ds_num > (c->left / 2))) {
+    entry_clear(&e);
+    return EILSEQ;
+  }
+  e.ds_num = (size_t)ds_num;
+
+  e.ds_types = calloc(e.ds_num, sizeof(*e.ds_types));
+  e.ds_names = calloc(e.ds_num, sizeof(*e.ds_names));
+  if ((e.ds_types == NULL) || (e.ds_names == NULL)) {
+    entry_clear(&e);
+    return ENOMEM;
+  }
+
+  for (size_t i = 0; i < e.ds_num; i++) {
+    const uint8_t *type;
+
+    status = cursor_bytes(c, 1, &type);
+    if ((status == 0) && (*type > COLUMNAR_DS_ABSOLUTE))
+      status = EILSEQ;
+    if (status == 0)
+      status = cursor_string(c, e.ds_names + i);
+    if (status != 0) {
+      entry_clear(&e);
+      return status;
+    }
+    e.ds_types[i] = *type;
+  }
+
+  if (e.id >= d->entries_num) {
+    columnar_entry_t *tmp;
+
+    tmp = realloc(d->entries, (size_t)(e.id + 1) * sizeof(*tmp));
+    if (tmp == NULL) {
+      entry_clear(&e);
+      return ENOMEM;
+    }
+    memset(tmp + d->entries_num, 0,
+           (size_t)(e.id + 1 - d->entries_num) * sizeof(*tmp));
+    d->entries = tmp;
+    d->entries_num = (size_t)(e.id + 1);
+  }
+
+  entry_clear(d->entries + e.id);
+  d->entries[e.id] = e;
+  return 0;
+} /* }}} int dict_read_entry */
+
+static int column_decode(columnar_reader_t *r, int type, /* {{{ */
+                         columnar_dod_t *dod, columnar_xor_t *xor,
+                         columnar_value_t *ret) {
+  uint64_t tmp = 0;
+  int status;
+
+  if (type == COLUMNAR_DS_GAUGE)
+    return columnar_xor_decode(r, xor, &ret->gauge);
+
+  status = columnar_dod_decode(r, dod, &tmp);
+  if (status != 0)
+    return status;
+
+  if (type == COLUMNAR_DS_DERIVE)
+    ret->derive = (int64_t)tmp;
+  else if (type == COLUMNAR_DS_COUNTER)
+    ret->counter = tmp;
+  else
+    ret->absolute = tmp;
+
+  return 0;
+} /* }}} int column_decode */
+
+static int series_read(cursor_t *c, columnar_dict_t *d, /* {{{ */
+                       columnar_point_cb cb, void *user_data) {
+  columnar_entry_t *e;
+  uint64_t id;
+  uint64_t points;
+  columnar_reader_t *readers;
+  columnar_dod_t *dods;
+  columnar_xor_t *xors;
+  columnar_value_t *values;
+  int status = 0;
+
+  if ((cursor_varint(c, &id) != 0) || (cursor_varint(c, &points) != 0))
+    return EILSEQ;
+  if ((id >= d->entries_num) || (d->entries[id].name == NULL))
+    return EILSEQ;
+  e = d->entries + id;
+
+  /* Column 0 holds the timestamps, column i + 1 data source i. */
+  readers = calloc(e->ds_num + 1, sizeof(*readers));
+  dods = calloc(e->ds_num + 1, sizeof(*dods));
+  xors = calloc(e->ds_num + 1, sizeof(*xors));
+  values = calloc(e->ds_num, sizeof(*values));
+  if ((readers == NULL) || (dods == NULL) || (xors == NULL) ||
+      (values == NULL))
+    status = ENOMEM;
+
+  for (size_t i = 0; (status == 0) && (i < e->ds_num + 1); i++) {
+    uint64_t bits = 0;
+
+    if ((cursor_varint(c, &bits) != 0) || (bits > ((uint64_t)c->left) * 8) ||
+        (cursor_bytes(c, (size_t)((bits + 7) / 8), &readers[i].data) != 0)) {
+      status = EILSEQ;
+      break;
+    }
+    readers[i].bits = (size_t)bits;
+  }
+
+  for (uint64_t p = 0; (status == 0) && (p < points); p++) {
+    columnar_value_t time;
+
+    status = column_decode(readers, COLUMNAR_DS_DERIVE, dods, xors, &time);
+    for (size_t i = 0; (status == 0) && (i < e->ds_num); i++)
+      status = column_decode(readers + i + 1, e->ds_types[i], dods + i + 1,
+                             xors + i + 1, values + i);
+    if (status != 0) {
+      status = EILSEQ;
+      break;
+    }
+
+    if (cb != NULL) {
+      status = cb(e, time.derive, values, user_data);
+      if (status != 0)
+        status = ECANCELED;
+    }
+  }
+
+  free(values);
+  free(xors);
+  free(dods);
+  free(readers);
+  return status;
+} /* }}} int series_read */
+
+int64_t columnar_block_read(const uint8_t *data, size_t size, /* {{{ */
+                            columnar_dict_t *dict, columnar_point_cb cb,
+                            void *user_data) {
+  cursor_t c;
+  uint32_t payload_size;
+  uint64_t num;
+  int status;
+
+  if (size < COLUMNAR_BLOCK_HEADER_SIZE)
+    return 0;
+
+  if (get_u32(data) != COLUMNAR_BLOCK_MAGIC)
+    return -EILSEQ;
+  if (data[4] != COLUMNAR_BLOCK_VERSION)
+    return -ENOTSUP;
+
+  payload_size = get_u32(data + 8);
+  if (payload_size > (size - COLUMNAR_BLOCK_HEADER_SIZE))
+    return 0;
+
+  c.ptr = data + COLUMNAR_BLOCK_HEADER_SIZE;
+  c.left = payload_size;
+  if (crc32_buffer(c.ptr, c.left) != get_u32(data + 12))
+    return -EILSEQ;
+
+  if (data[5] & COLUMNAR_FLAG_DICT_RESET)
+    columnar_dict_free(dict);
+
+  if (cursor_varint(&c, &num) != 0)
+    return -EILSEQ;
+  for (uint64_t i = 0; i < num; i++) {
+    status = dict_read_entry(&c, dict);
+    if (status != 0)
+      return -status;
+  }
+
+  if (cursor_varint(&c, &num) != 0)
+    return -EILSEQ;
+  for (uint64_t i = 0; i < num; i++) {
+    status = series_read(&c, dict, cb, user_data);
+    if (status != 0)
+      return -status;
+  }
+
+  return (int64_t)(COLUMNAR_BLOCK_HEADER_SIZE + payload_size);
+} /* }}} int64_t columnar_block_read */
+
+int columnar_file_read(FILE *fh, columnar_point_cb cb, /* {{{ */
+                       void *user_data) {
+  char magic[COLUMNAR_FILE_MAGIC_SIZE];
+  columnar_dict_t dict = {0};
+  columnar_buf_t buf = {0};
+  int status = 0;
+
+  if (fread(magic, sizeof(magic), 1, fh) != 1)
+    return ferror(fh) ? EIO : EILSEQ;
+  if (memcmp(magic, COLUMNAR_FILE_MAGIC, sizeof(magic)) != 0)
+    return EILSEQ;
+
+  while (status == 0) {
+    size_t payload_size;
+    int64_t block_size;
+
+    buf.len = 0;
+    status = buf_reserve(&buf, COLUMNAR_BLOCK_HEADER_SIZE);
+    if (status != 0)
+      break;
+    if (fread(buf.data, COLUMNAR_BLOCK_HEADER_SIZE, 1, fh) != 1) {
+      if (ferror(fh))
+        status = EIO;
+      break; /* end of file or truncated header */
+    }
+    buf.len = COLUMNAR_BLOCK_HEADER_SIZE;
+
+    /* Check the magic before trusting the size field. */
+    if (get_u32(buf.data) != COLUMNAR_BLOCK_MAGIC) {
+      status = EILSEQ;
+      break;
+    }
+
+    payload_size = (size_t)get_u32(buf.data + 8);
+    status = buf_reserve(&buf, payload_size);
+    if (status != 0)
+      break;
+    if ((payload_size > 0) &&
+        (fread(buf.data + buf.len, payload_size, 1, fh) != 1)) {
+      if (ferror(fh))
+        status = EIO;
+      break; /* truncated payload */
+    }
+    buf.len += payload_size;
+
+    block_size = columnar_block_read(buf.data, buf.len, &dict, cb, user_data);
+    if (block_size < 0)
+      status = (int)-block_size;
+  }
+
+  columnar_buf_free(&buf);
+  columnar_dict_free(&dict);
+
+  return (status == ECANCELED) ? 0 : status;
+} /* }}} int columnar_file_read */
@@ -0,0 +1,202 @@
+/**
+ * collectd - src/utils/columnar/columnar.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_COLUMNAR_H
+#define UTILS_COLUMNAR_H 1
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * On-disk format
+ *
+ * A file starts with the eight byte COLUMNAR_FILE_MAGIC and is followed by any
+ * number of blocks. All fixed-size integers are little endian, "varint" is
+ * the LEB128 encoding of an unsigned integer.
+ *
+ *   block    := u32 magic, u8 version, u8 flags, u16 reserved,
+ *               u32 payload_size, u32 crc32(payload), payload
+ *   payload  := varint dict_num, dict_entry * dict_num,
+ *               varint series_num, series * series_num
+ *   dict_entry := varint id, string name, varint ds_num,
+ *               (u8 ds_type, string ds_name) * ds_num
+ *   series   := varint id, varint points, column * (ds_num + 1)
+ *   column   := varint bits, u8 * ((bits + 7) / 8)
+ *   string   := varint length, u8 * length
+ *
+ * Identifiers are dictionary encoded: a series' name and data sources are
+ * written once per file and referred to by "id" afterwards. A block with the
+ * COLUMNAR_FLAG_DICT_RESET flag starts a new dictionary; this is written
+ * whenever a file is (re-)opened for appending.
+ *
+ * The first column of a series holds the timestamps in milliseconds since the
+ * epoch, encoded as delta-of-deltas. The other columns hold one data source
+ * each: gauges are XOR-compressed as described in the "Gorilla" paper,
+ * integer data sources are encoded as delta-of-deltas, too. Every block is
+ * self-contained apart from the dictionary.
+ */
+#define COLUMNAR_FILE_MAGIC "CDCOLv1\n"
+#define COLUMNAR_FILE_MAGIC_SIZE 8
+#define COLUMNAR_BLOCK_MAGIC 0x4b4c4243 /* "CBLK" */
+#define COLUMNAR_BLOCK_VERSION 1
+#define COLUMNAR_BLOCK_HEADER_SIZE 16
+
+#define COLUMNAR_FLAG_DICT_RESET 0x01
+
+/* Same values as DS_TYPE_* in plugin.h. */
+#define COLUMNAR_DS_COUNTER 0
+#define COLUMNAR_DS_GAUGE 1
+#define COLUMNAR_DS_DERIVE 2
+#define COLUMNAR_DS_ABSOLUTE 3
+
+typedef union {
+  uint64_t counter;
+  double gauge;
+  int64_t derive;
+  uint64_t absolute;
+} columnar_value_t;
+
+/* Growable byte buffer. */
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t len;
+} columnar_buf_t;
+
+/* Growable bit stream, written MSB first. */
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t bits;
+} columnar_bits_t;
+
+typedef struct {
+  const uint8_t *data;
+  size_t bits;
+  size_t pos;
+} columnar_reader_t;
+
+/* Encoder / decoder state of a delta-of-delta column. */
+typedef struct {
+  uint64_t prev;
+  uint64_t prev_delta;
+  uint64_t count;
+} columnar_dod_t;
+
+/* Encoder / decoder state of an XOR-compressed column. */
+typedef struct {
+  uint64_t prev;
+  int leading;
+  int trailing;
+  uint64_t count;
+} columnar_xor_t;
+
+typedef struct {
+  int type;
+  columnar_bits_t bits;
+  union {
+    columnar_dod_t dod;
+    columnar_xor_t xor;
+  } state;
+} columnar_column_t;
+
+/* A series is one identifier with its data sources. Values are encoded into
+ * the columns as they arrive; columnar_block_write() moves them to a block and
+ * resets the columns. */
+typedef struct {
+  uint64_t id;
+  char *name;
+  size_t ds_num;
+  char **ds_names;
+  uint64_t points;
+  columnar_column_t time;
+  columnar_column_t *values;
+} columnar_series_t;
+
+columnar_series_t *columnar_series_create(uint64_t id, const char *name,
+                                          size_t ds_num, const int *ds_types,
+                                          const char *const *ds_names);
+void columnar_series_destroy(columnar_series_t *s);
+
+/* Appends one point. "values" must hold "ds_num" elements. */
+int columnar_series_append(columnar_series_t *s, int64_t time_ms,
+                           const columnar_value_t *values);
+
+/* Returns the number of bytes currently held in the series' columns. */
+size_t columnar_series_size(const columnar_series_t *s);
+
+void columnar_buf_reset(columnar_buf_t *b);
+void columnar_buf_free(columnar_buf_t *b);
+
+/* Appends a block to "out". Dictionary entries are written for all series in
+ * "dict", series data for all series in "series" which have points. */
+int columnar_block_write(columnar_buf_t *out, int flags,
+                         columnar_series_t *const *dict, size_t dict_num,
+                         columnar_series_t *const *series, size_t series_num);
+
+/*
+ * Decoding
+ */
+typedef struct {
+  uint64_t id;
+  char *name;
+  size_t ds_num;
+  int *ds_types;
+  char **ds_names;
+} columnar_entry_t;
+
+typedef struct {
+  columnar_entry_t *entries;
+  size_t entries_num;
+} columnar_dict_t;
+
+void columnar_dict_free(columnar_dict_t *d);
+
+/* Called for every point. Returning non-zero stops decoding. */
+typedef int (*columnar_point_cb)(const columnar_entry_t *entry,
+                                 int64_t time_ms,
+                                 const columnar_value_t *values,
+                                 void *user_data);
+
+/* Decodes one block. "data" points to the block header and "size" is the
+ * number of bytes available. On success the size of the block is returned;
+ * zero means "data" does not hold a complete block. A negative errno value is
+ * returned when the block is corrupt. */
+int64_t columnar_block_read(const uint8_t *data, size_t size,
+                            columnar_dict_t *dict, columnar_point_cb cb,
+                            void *user_data);
+
+/* Decodes all blocks in "fh". A truncated block at the end of the file, e.g.
+ * after a crash, is silently ignored. Returns zero on success. */
+int columnar_file_read(FILE *fh, columnar_point_cb cb, void *user_data);
+
+/* Bit-level primitives, exported for testing. */
+int columnar_bits_write(columnar_bits_t *b, uint64_t value, int nbits);
+int columnar_bits_read(columnar_reader_t *r, int nbits, uint64_t *ret);
+int columnar_dod_encode(columnar_bits_t *b, columnar_dod_t *s, uint64_t v);
+int columnar_dod_decode(columnar_reader_t *r, columnar_dod_t *s,
+                        uint64_t *ret);
+int columnar_xor_encode(columnar_bits_t *b, columnar_xor_t *s, double v);
+int columnar_xor_decode(columnar_reader_t *r, columnar_xor_t *s, double *ret);
+
+#endif /* UTILS_COLUMNAR_H */
@@ -0,0 +1,266 @@
+/**
+ * collectd - src/utils/columnar/columnar_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/columnar/columnar.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+DEF_TEST(dod) {
+  uint64_t values[] = {
+      1700000000000, 1700000001000, 1700000002000, 1700000003001,
+      1700000003999, 1700000005000, 1700000015000, 1700000015000,
+      1699999000000, UINT64_MAX,    0,             INT64_MAX,
+      1,
+  };
+  columnar_bits_t bits = {0};
+  columnar_dod_t enc = {0};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++)
+    CHECK_ZERO(columnar_dod_encode(&bits, &enc, values[i]));
+
+  columnar_reader_t r = {.data = bits.data, .bits = bits.bits};
+  columnar_dod_t dec = {0};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++) {
+    uint64_t got = 0;
+    CHECK_ZERO(columnar_dod_decode(&r, &dec, &got));
+    EXPECT_EQ_UINT64(values[i], got);
+  }
+  EXPECT_EQ_INT(bits.bits, r.pos);
+
+  uint64_t unused;
+  EXPECT_EQ_INT(ENODATA, columnar_dod_decode(&r, &dec, &unused));
+
+  free(bits.data);
+  return 0;
+}
+
+DEF_TEST(dod_regular) {
+  columnar_bits_t bits = {0};
+  columnar_dod_t enc = {0};
+
+  /* A perfectly regular series costs one bit per value after the first two.
+   */
+  for (uint64_t i = 0; i < 1000; i++)
+    CHECK_ZERO(columnar_dod_encode(&bits, &enc, 1700000000000 + 1000 * i));
+
+  EXPECT_EQ_INT(64 + 4 + 12 + 998, bits.bits);
+
+  free(bits.data);
+  return 0;
+}
+
+DEF_TEST(xor) {
+  double values[] = {
+      12.0, 12.0, 24.0, 15.5, -0.0, 0.0, 1e300, -1e-300, NAN, NAN,
+      INFINITY, 3.14159, 3.14160, 3.14161, 3.14161, 42.0,
+  };
+  columnar_bits_t bits = {0};
+  columnar_xor_t enc = {0};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++)
+    CHECK_ZERO(columnar_xor_encode(&bits, &enc, values[i]));
+
+  columnar_reader_t r = {.data = bits.data, .bits = bits.bits};
+  columnar_xor_t dec = {0};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(values); i++) {
+    double got = 0;
+    CHECK_ZERO(columnar_xor_decode(&r, &dec, &got));
+    /* Compare the representation, so that -0.0 and NAN are checked, too. */
+    OK(memcmp(&values[i], &got, sizeof(got)) == 0);
+  }
+  EXPECT_EQ_INT(bits.bits, r.pos);
+
+  free(bits.data);
+  return 0;
+}
+
+typedef struct {
+  int64_t time_ms[16];
+  columnar_value_t values[16][2];
+  char names[16][64];
+  size_t num;
+} collect_t;
+
+static int collect_cb(const columnar_entry_t *entry, int64_t time_ms,
+                      const columnar_value_t *values, void *user_data) {
+  collect_t *c = user_data;
+
+  if (c->num >= STATIC_ARRAY_SIZE(c->time_ms))
+    return -1;
+
+  c->time_ms[c->num] = time_ms;
+  for (size_t i = 0; (i < entry->ds_num) && (i < 2); i++)
+    c->values[c->num][i] = values[i];
+  snprintf(c->names[c->num], sizeof(c->names[c->num]), "%s", entry->name);
+  c->num++;
+  return 0;
+}
+
+DEF_TEST(block) {
+  int if_types[] = {COLUMNAR_DS_DERIVE, COLUMNAR_DS_DERIVE};
+  const char *if_names[] = {"rx", "tx"};
+  int load_types[] = {COLUMNAR_DS_GAUGE};
+  const char *load_names[] = {"value"};
+  columnar_series_t *series[2];
+  columnar_buf_t out = {0};
+
+  CHECK_NOT_NULL(series[0] = columnar_series_create(
+                     0, "host/interface-eth0/if_octets", 2, if_types,
+                     if_names));
+  CHECK_NOT_NULL(series[1] =
+                     columnar_series_create(1, "host/load/load", 1,
+                                            load_types, load_names));
+
+  for (int i = 0; i < 3; i++) {
+    columnar_value_t if_values[] = {{.derive = 1000 * i},
+                                    {.derive = -5 * i}};
+    columnar_value_t load_values[] = {{.gauge = 0.25 * i}};
+
+    CHECK_ZERO(columnar_series_append(series[0], 1000 * i, if_values));
+    if (i < 2)
+      CHECK_ZERO(columnar_series_append(series[1], 1000 * i + 1,
+                                        load_values));
+  }
+
+  CHECK_ZERO(columnar_block_write(&out, COLUMNAR_FLAG_DICT_RESET, series, 2,
+                                  series, 2));
+  EXPECT_EQ_INT(0, series[0]->points);
+  EXPECT_EQ_INT(0, columnar_series_size(series[0]));
+
+  /* Second block: no new dictionary entries, only the load series. */
+  size_t first_block = out.len;
+  CHECK_ZERO(columnar_series_append(series[1], 5000,
+                                    (columnar_value_t[]){{.gauge = 9.5}}));
+  CHECK_ZERO(columnar_block_write(&out, 0, NULL, 0, series, 2));
+
+  collect_t c = {0};
+  columnar_dict_t dict = {0};
+  EXPECT_EQ_INT(first_block,
+                columnar_block_read(out.data, out.len, &dict, collect_cb, &c));
+  EXPECT_EQ_INT(out.len - first_block,
+                columnar_block_read(out.data + first_block,
+                                    out.len - first_block, &dict, collect_cb,
+                                    &c));
+
+  EXPECT_EQ_INT(6, c.num);
+  EXPECT_EQ_STR("host/interface-eth0/if_octets", c.names[0]);
+  EXPECT_EQ_INT(2000, c.time_ms[2]);
+  EXPECT_EQ_INT(2000, c.values[2][0].derive);
+  EXPECT_EQ_INT(-10, c.values[2][1].derive);
+  EXPECT_EQ_STR("host/load/load", c.names[4]);
+  EXPECT_EQ_INT(1001, c.time_ms[4]);
+  EXPECT_EQ_DOUBLE(0.25, c.values[4][0].gauge);
+  EXPECT_EQ_INT(5000, c.time_ms[5]);
+  EXPECT_EQ_DOUBLE(9.5, c.values[5][0].gauge);
+
+  /* Incomplete and corrupted blocks. */
+  EXPECT_EQ_INT(0, columnar_block_read(out.data, first_block - 1, &dict,
+                                       NULL, NULL));
+  out.data[first_block - 1] ^= 0x01;
+  EXPECT_EQ_INT(-EILSEQ, columnar_block_read(out.data, first_block, &dict,
+                                             NULL, NULL));
+
+  columnar_dict_free(&dict);
+  columnar_buf_free(&out);
+  columnar_series_destroy(series[0]);
+  columnar_series_destroy(series[1]);
+  return 0;
+}
+
+DEF_TEST(file) {
+  int types[] = {COLUMNAR_DS_GAUGE};
+  const char *names[] = {"value"};
+  columnar_series_t *s;
+  columnar_buf_t out = {0};
+  FILE *fh;
+
+  CHECK_NOT_NULL(s = columnar_series_create(0, "h/p/t", 1, types, names));
+  CHECK_NOT_NULL(fh = tmpfile());
+  OK(fwrite(COLUMNAR_FILE_MAGIC, COLUMNAR_FILE_MAGIC_SIZE, 1, fh) == 1);
+
+  for (int i = 0; i < 4; i++) {
+    columnar_value_t v = {.gauge = i};
+
+    CHECK_ZERO(columnar_series_append(s, i, &v));
+    /* Every block re-sends the dictionary, as after a restart. */
+    CHECK_ZERO(columnar_block_write(&out, COLUMNAR_FLAG_DICT_RESET, &s, 1,
+                                    &s, 1));
+  }
+  /* Simulate a crash in the middle of writing the last block. */
+  OK(fwrite(out.data, out.len - 3, 1, fh) == 1);
+  rewind(fh);
+
+  collect_t c = {0};
+  CHECK_ZERO(columnar_file_read(fh, collect_cb, &c));
+  EXPECT_EQ_INT(3, c.num);
+  EXPECT_EQ_DOUBLE(2.0, c.values[2][0].gauge);
+
+  fclose(fh);
+  columnar_buf_free(&out);
+  columnar_series_destroy(s);
+  return 0;
+}
+
+DEF_TEST(compression) {
+  int types[] = {COLUMNAR_DS_GAUGE, COLUMNAR_DS_DERIVE};
+  const char *names[] = {"temperature", "bytes"};
+  columnar_series_t *s;
+  columnar_buf_t out = {0};
+  size_t points = 3600;
+
+  CHECK_NOT_NULL(s = columnar_series_create(0, "edge/sensor/example", 2,
+                                            types, names));
+
+  /* One hour at 1s resolution with a little jitter on the timestamps, a
+   * slowly changing gauge and a counter growing at a fixed rate. */
+  for (size_t i = 0; i < points; i++) {
+    columnar_value_t v[] = {{.gauge = 21.5 + (double)((i / 60) % 5) * 0.5},
+                            {.derive = (int64_t)(1500 * i)}};
+    CHECK_ZERO(columnar_series_append(s, 1700000000000 + 1000 * i + (i % 3),
+                                      v));
+  }
+  CHECK_ZERO(columnar_block_write(&out, COLUMNAR_FLAG_DICT_RESET, &s, 1, &s,
+                                  1));
+
+  /* CSV would need roughly 30 bytes per line. */
+  printf("columnar: %zu points in %zu bytes (%.2f bytes/point)\n", points,
+         out.len, ((double)out.len) / ((double)points));
+  OK(out.len < 2 * points);
+
+  columnar_buf_free(&out);
+  columnar_series_destroy(s);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(dod);
+  RUN_TEST(dod_regular);
+  RUN_TEST(xor);
+  RUN_TEST(block);
+  RUN_TEST(file);
+  RUN_TEST(compression);
+
+  END_TEST;
+}
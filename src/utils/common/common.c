@@ -907,7 +907,8 @@ int format_values(char *ret, size_t ret_len, /* {{{ */
                   bool store_rates) {
   size_t offset = 0;
   int status;
-  gauge_t *rates = NULL;
+  gauge_t rates[ds->ds_num];
+  bool have_rates = false;
 
   assert(0 == strcmp(ds->type, vl->type));
 
@@ -917,10 +918,8 @@ int format_values(char *ret, size_t ret_len, /* {{{ */
   do {                                                                         \
     status = snprintf(ret + offset, ret_len - offset, __VA_ARGS__);            \
     if (status < 1) {                                                          \
-      sfree(rates);                                                            \
       return -1;                                                               \
     } else if (((size_t)status) >= (ret_len - offset)) {                       \
-      sfree(rates);                                                            \
       return -1;                                                               \
     } else                                                                     \
       offset += ((size_t)status);                                              \
@@ -932,12 +931,11 @@ int format_values(char *ret, size_t ret_len, /* {{{ */
     if (ds->ds[i].type == DS_TYPE_GAUGE)
       BUFFER_ADD(":" GAUGE_FORMAT, vl->values[i].gauge);
     else if (store_rates) {
-      if (rates == NULL)
-        rates = uc_get_rate(ds, vl);
-      if (rates == NULL) {
-        WARNING("format_values: uc_get_rate failed.");
+      if (!have_rates && (uc_get_rate_r(ds, vl, rates) != 0)) {
+        WARNING("format_values: uc_get_rate_r failed.");
         return -1;
       }
+      have_rates = true;
       BUFFER_ADD(":" GAUGE_FORMAT, rates[i]);
     } else if (ds->ds[i].type == DS_TYPE_COUNTER)
       BUFFER_ADD(":%" PRIu64, (uint64_t)vl->values[i].counter);
@@ -947,17 +945,60 @@ int format_values(char *ret, size_t ret_len, /* {{{ */
       BUFFER_ADD(":%" PRIu64, vl->values[i].absolute);
     else {
       ERROR("format_values: Unknown data source type: %i", ds->ds[i].type);
-      sfree(rates);
       return -1;
     }
   } /* for ds->ds_num */
 
 #undef BUFFER_ADD
 
-  sfree(rates);
   return 0;
 } /* }}} int format_values */
 
+static int format_digits(char *buffer, size_t buffer_size, /* {{{ */
+                         uint64_t value, bool negative) {
+  /* 20 digits for UINT64_MAX plus the sign. */
+  char temp[21];
+  size_t pos = sizeof(temp);
+
+  do {
+    temp[--pos] = (char)('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+  if (negative)
+    temp[--pos] = '-';
+
+  size_t len = sizeof(temp) - pos;
+  if (buffer_size > 0) {
+    size_t copy = (len < buffer_size) ? len : buffer_size - 1;
+    memcpy(buffer, temp + pos, copy);
+    buffer[copy] = 0;
+  }
+
+  return (int)len;
+} /* }}} int format_digits */
+
+int format_uint64(char *buffer, size_t buffer_size, uint64_t value) {
+  return format_digits(buffer, buffer_size, value, false);
+} /* int format_uint64 */
+
+int format_int64(char *buffer, size_t buffer_size, int64_t value) {
+  if (value < 0)
+    /* Negate in unsigned arithmetic so INT64_MIN does not overflow. */
+    return format_digits(buffer, buffer_size, 0 - (uint64_t)value, true);
+  return format_digits(buffer, buffer_size, (uint64_t)value, false);
+} /* int format_int64 */
+
+int format_gauge(char *buffer, size_t buffer_size, gauge_t value) {
+  /* GAUGE_FORMAT ("%.15g") prints integral values with up to 15 digits
+   * without exponent or decimal point, i.e. exactly like "%" PRIi64. Negative
+   * zero is printed as "-0" and is left to snprintf(). */
+  if ((value > -1e15) && (value < 1e15) && (value == (gauge_t)(int64_t)value) &&
+      ((value != 0.0) || !signbit(value)))
+    return format_int64(buffer, buffer_size, (int64_t)value);
+
+  return snprintf(buffer, buffer_size, GAUGE_FORMAT, value);
+} /* int format_gauge */
+
 int parse_identifier(char *str, char **ret_host, char **ret_plugin,
                      char **ret_plugin_instance, char **ret_type,
                      char **ret_type_instance, char *default_host) {
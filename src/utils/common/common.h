@@ -326,6 +326,24 @@ int format_name(char *ret, int ret_len, const char *hostname,
 int format_values(char *ret, size_t ret_len, const data_set_t *ds,
                   const value_list_t *vl, bool store_rates);
 
+/*
+ * NAME
+ *   format_uint64, format_int64, format_gauge
+ *
+ * DESCRIPTION
+ *   Convert a number to its decimal representation without going through the
+ *   printf(3) machinery. The output is identical to that of snprintf(3) with
+ *   the format "%" PRIu64, "%" PRIi64 and GAUGE_FORMAT respectively;
+ *   format_gauge() only falls back to snprintf(3) for non-integral values.
+ *
+ * RETURN VALUE
+ *   Like snprintf(3), the number of characters (excluding the null byte)
+ *   which would have been written if `buffer_size' had been large enough.
+ */
+int format_uint64(char *buffer, size_t buffer_size, uint64_t value);
+int format_int64(char *buffer, size_t buffer_size, int64_t value);
+int format_gauge(char *buffer, size_t buffer_size, gauge_t value);
+
 int parse_identifier(char *str, char **ret_host, char **ret_plugin,
                      char **ret_plugin_instance, char **ret_type,
                      char **ret_type_instance, char *default_host);
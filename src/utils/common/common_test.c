@@ -375,6 +375,43 @@ DEF_TEST(value_to_rate) {
   return 0;
 }
 
+DEF_TEST(format_numbers) {
+  uint64_t u64[] = {0, 1, 9, 10, 42, 1000000, UINT64_MAX};
+  int64_t i64[] = {0, 1, -1, 42, -42, INT64_MAX, INT64_MIN};
+  gauge_t gauges[] = {0.0,    -0.0,     1.0,      -1.0,   42.0,
+                      0.5,    -0.25,    1e14,     -1e14,  999999999999999.0,
+                      1e15,   1e16,     1.0 / 3,  1e-7,   NAN,
+                      INFINITY, -INFINITY};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(u64); i++) {
+    char want[32], got[32];
+    snprintf(want, sizeof(want), "%" PRIu64, u64[i]);
+    EXPECT_EQ_INT(strlen(want), format_uint64(got, sizeof(got), u64[i]));
+    EXPECT_EQ_STR(want, got);
+  }
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(i64); i++) {
+    char want[32], got[32];
+    snprintf(want, sizeof(want), "%" PRIi64, i64[i]);
+    EXPECT_EQ_INT(strlen(want), format_int64(got, sizeof(got), i64[i]));
+    EXPECT_EQ_STR(want, got);
+  }
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(gauges); i++) {
+    char want[64], got[64];
+    snprintf(want, sizeof(want), GAUGE_FORMAT, gauges[i]);
+    EXPECT_EQ_INT(strlen(want), format_gauge(got, sizeof(got), gauges[i]));
+    EXPECT_EQ_STR(want, got);
+  }
+
+  /* truncation behaves like snprintf() */
+  char small[4] = "xxx";
+  EXPECT_EQ_INT(5, format_int64(small, sizeof(small), -1234));
+  EXPECT_EQ_STR("-12", small);
+
+  return 0;
+}
+
 int main(void) {
   RUN_TEST(sstrncpy);
   RUN_TEST(sstrdup);
@@ -385,6 +422,7 @@ int main(void) {
   RUN_TEST(strunescape);
   RUN_TEST(parse_values);
   RUN_TEST(value_to_rate);
+  RUN_TEST(format_numbers);
 
   END_TEST;
 }
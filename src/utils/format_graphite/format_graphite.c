@@ -66,64 +66,51 @@ void reverse_hostname(char *r_host, char const *orig_host) {
 static int gr_format_values(char *ret, size_t ret_len, int ds_num,
                             const data_set_t *ds, const value_list_t *vl,
                             gauge_t const *rates) {
-  size_t offset = 0;
   int status;
 
   assert(0 == strcmp(ds->type, vl->type));
 
-  memset(ret, 0, ret_len);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(ret + offset, ret_len - offset, __VA_ARGS__);            \
-    if (status < 1) {                                                          \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (ret_len - offset)) {                       \
-      return -1;                                                               \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
   if (ds->ds[ds_num].type == DS_TYPE_GAUGE)
-    BUFFER_ADD(GAUGE_FORMAT, vl->values[ds_num].gauge);
+    status = format_gauge(ret, ret_len, vl->values[ds_num].gauge);
   else if (rates != NULL)
-    BUFFER_ADD("%f", rates[ds_num]);
+    status = snprintf(ret, ret_len, "%f", rates[ds_num]);
   else if (ds->ds[ds_num].type == DS_TYPE_COUNTER)
-    BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[ds_num].counter);
+    status = format_uint64(ret, ret_len, (uint64_t)vl->values[ds_num].counter);
   else if (ds->ds[ds_num].type == DS_TYPE_DERIVE)
-    BUFFER_ADD("%" PRIi64, vl->values[ds_num].derive);
+    status = format_int64(ret, ret_len, vl->values[ds_num].derive);
   else if (ds->ds[ds_num].type == DS_TYPE_ABSOLUTE)
-    BUFFER_ADD("%" PRIu64, vl->values[ds_num].absolute);
+    status = format_uint64(ret, ret_len, vl->values[ds_num].absolute);
   else {
     P_ERROR("gr_format_values: Unknown data source type: %i",
             ds->ds[ds_num].type);
     return -1;
   }
 
-#undef BUFFER_ADD
+  if ((status < 1) || (((size_t)status) >= ret_len))
+    return -1;
 
-  return 0;
+  return status;
 }
 
 static void gr_copy_escape_part(char *dst, const char *src, size_t dst_len,
                                 char escape_char, bool preserve_separator) {
-  memset(dst, 0, dst_len);
-
-  if (src == NULL)
+  if (dst_len == 0)
     return;
 
-  for (size_t i = 0; i < dst_len; i++) {
-    if (src[i] == 0) {
-      dst[i] = 0;
-      break;
+  size_t i = 0;
+  if (src != NULL) {
+    /* Equivalent to isspace() || iscntrl() in the C locale, without the
+     * per-character function call. */
+    for (; (i < dst_len - 1) && (src[i] != 0); i++) {
+      unsigned char c = (unsigned char)src[i];
+
+      if ((c <= ' ') || (c == 0x7f) || (!preserve_separator && (c == '.')))
+        dst[i] = escape_char;
+      else
+        dst[i] = src[i];
     }
-
-    if ((!preserve_separator && (src[i] == '.')) || isspace((int)src[i]) ||
-        iscntrl((int)src[i]))
-      dst[i] = escape_char;
-    else
-      dst[i] = src[i];
   }
+  dst[i] = 0;
 }
 
 static int gr_format_name_tagged(char *ret, int ret_len, value_list_t const *vl,
@@ -286,12 +273,29 @@ static int gr_format_name(char *ret, int ret_len, value_list_t const *vl,
   return 0;
 }
 
+/* Lookup table for GRAPHITE_FORBIDDEN; replaces the strcspn() scan, which
+ * rebuilds its character set on every call. */
+static const bool gr_forbidden[256] = {
+    [' '] = true,
+    ['\t'] = true,
+    ['"'] = true,
+    ['\\'] = true,
+    [':'] = true,
+    ['!'] = true,
+    [','] = true,
+    ['/'] = true,
+    ['('] = true,
+    [')'] = true,
+    ['\n'] = true,
+    ['\r'] = true,
+};
+
 static void escape_graphite_string(char *buffer, char escape_char) {
   assert(strchr(GRAPHITE_FORBIDDEN, escape_char) == NULL);
 
-  for (char *head = buffer + strcspn(buffer, GRAPHITE_FORBIDDEN); *head != '\0';
-       head += strcspn(head, GRAPHITE_FORBIDDEN))
-    *head = escape_char;
+  for (unsigned char *head = (unsigned char *)buffer; *head != '\0'; head++)
+    if (gr_forbidden[*head])
+      *head = (unsigned char)escape_char;
 }
 
 int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
@@ -314,8 +318,11 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
     char const *ds_name = NULL;
     char key[10 * DATA_MAX_NAME_LEN];
     char values[512];
+    char timestamp[32];
+    size_t key_len;
+    size_t values_len;
+    size_t timestamp_len;
     size_t message_len;
-    char message[1024];
 
     if ((flags & GRAPHITE_ALWAYS_APPEND_DS) || (ds->ds_num > 1))
       ds_name = ds->ds[i].name;
@@ -340,27 +347,25 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
     }
 
     escape_graphite_string(key, escape_char);
+    key_len = strlen(key);
 
     /* Convert the values to an ASCII representation and put that into
      * `values'. */
     status = gr_format_values(values, sizeof(values), i, ds, vl, rates);
-    if (status != 0) {
+    if (status < 0) {
       P_ERROR("format_graphite: error with gr_format_values");
       sfree(rates);
       return status;
     }
+    values_len = (size_t)status;
+    status = 0;
 
-    /* Compute the graphite command */
-    message_len =
-        (size_t)snprintf(message, sizeof(message), "%s %s %u\r\n", key, values,
-                         (unsigned int)CDTIME_T_TO_TIME_T(vl->time));
-    if (message_len >= sizeof(message)) {
-      P_ERROR("format_graphite: message buffer too small: "
-              "Need %" PRIsz " bytes.",
-              message_len + 1);
-      sfree(rates);
-      return -ENOMEM;
-    }
+    timestamp_len = (size_t)format_uint64(
+        timestamp, sizeof(timestamp),
+        (uint64_t)(unsigned int)CDTIME_T_TO_TIME_T(vl->time));
+
+    /* Compute the graphite command: "<key> <values> <timestamp>\r\n" */
+    message_len = key_len + 1 + values_len + 1 + timestamp_len + 2;
 
     /* Append it in case we got multiple data set */
     if ((buffer_pos + message_len) >= buffer_size) {
@@ -368,7 +373,18 @@ int format_graphite(char *buffer, size_t buffer_size, data_set_t const *ds,
       sfree(rates);
       return -ENOMEM;
     }
-    memcpy((void *)(buffer + buffer_pos), message, message_len);
+
+    char *message = buffer + buffer_pos;
+    memcpy(message, key, key_len);
+    message += key_len;
+    *(message++) = ' ';
+    memcpy(message, values, values_len);
+    message += values_len;
+    *(message++) = ' ';
+    memcpy(message, timestamp, timestamp_len);
+    message += timestamp_len;
+    memcpy(message, "\r\n", 2);
+
     buffer_pos += message_len;
     buffer[buffer_pos] = '\0';
   }
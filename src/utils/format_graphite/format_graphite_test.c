@@ -36,7 +36,6 @@ static data_set_t ds_single = {
     .ds = &(data_source_t){"value", DS_TYPE_GAUGE, NAN, NAN},
 };
 
-/*
 static data_set_t ds_double = {
     .type = "double",
     .ds_num = 2,
@@ -45,7 +44,6 @@ static data_set_t ds_double = {
             {"one", DS_TYPE_DERIVE, 0, NAN}, {"two", DS_TYPE_DERIVE, 0, NAN},
         },
 };
-*/
 
 DEF_TEST(metric_name) {
   struct {
@@ -205,9 +203,108 @@ DEF_TEST(null_termination) {
   return 0;
 }
 
-int main(void) {
+DEF_TEST(values) {
+  struct {
+    gauge_t gauge;
+    char const *want;
+  } cases[] = {
+      {42, "42"},         {-42, "-42"},   {0.5, "0.5"},
+      {1e15, "1e+15"},    {-0.0, "-0"},   {NAN, "nan"},
+      {1.0 / 3.0, "0.333333333333333"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    value_list_t vl = {
+        .values = &(value_t){.gauge = cases[i].gauge},
+        .values_len = 1,
+        .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+        .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+        .host = "example.com",
+        .plugin = "test",
+        .type = "single",
+    };
+
+    char want[1024];
+    ssnprintf(want, sizeof(want), "example_com.test.single %s 1480063672\r\n",
+              cases[i].want);
+
+    char got[1024];
+    EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_single, &vl, NULL,
+                                     NULL, '_', 0));
+    EXPECT_EQ_STR(want, got);
+  }
+
+  value_list_t vl = {
+      .values = (value_t[]){{.derive = INT64_MIN}, {.derive = 1337}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "double",
+  };
+  char const *want =
+      "example_com.test.double.one -9223372036854775808 1480063672\r\n"
+      "example_com.test.double.two 1337 1480063672\r\n";
+
+  char got[1024];
+  EXPECT_EQ_INT(0, format_graphite(got, sizeof(got), &ds_double, &vl, NULL,
+                                   NULL, '_', 0));
+  EXPECT_EQ_STR(want, got);
+
+  /* target buffer too small */
+  EXPECT_EQ_INT(-ENOMEM, format_graphite(got, strlen(want), &ds_double, &vl,
+                                         NULL, NULL, '_', 0));
+
+  return 0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+/* Only runs when "--benchmark" is passed. */
+DEF_TEST(benchmark) {
+  value_list_t vl = {
+      .values = (value_t[]){{.derive = 1234567}, {.derive = 987654321}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "build-server-0042.example.com",
+      .plugin = "interface",
+      .plugin_instance = "enp0s31f6 (uplink)",
+      .type = "double",
+      .type_instance = "rx/tx",
+  };
+
+  char buffer[1024];
+  size_t total = 0;
+  int status = 0;
+
+  double start = now_seconds();
+  for (int i = 0; (i < 100000) && (status == 0); i++) {
+    status = format_graphite(buffer, sizeof(buffer), &ds_double, &vl,
+                             "collectd.", NULL, '_', 0);
+    total += strlen(buffer);
+  }
+  double elapsed = now_seconds() - start;
+  EXPECT_EQ_INT(0, status);
+
+  printf("format_graphite: %.1f MB/s (%zu bytes in %.3f s)\n",
+         ((double)total) / (elapsed * 1e6), total, elapsed);
+  OK(total > 0);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
   RUN_TEST(metric_name);
   RUN_TEST(null_termination);
+  RUN_TEST(values);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(benchmark);
 
   END_TEST;
 }
@@ -32,19 +32,33 @@
 #include "utils/common/common.h"
 #include "utils_cache.h"
 
-#if HAVE_LIBYAJL
-#include <yajl/yajl_common.h>
-#include <yajl/yajl_gen.h>
-#if HAVE_YAJL_YAJL_VERSION_H
-#include <yajl/yajl_version.h>
-#endif
-#if defined(YAJL_MAJOR) && (YAJL_MAJOR > 1)
-#define HAVE_YAJL_V2 1
-#endif
-#endif
+/* Word-at-a-time ("SIMD within a register") scanning used by
+ * json_escape_string() to skip over characters which can be copied
+ * verbatim. */
+#define JSON_WORD_ONES UINT64_C(0x0101010101010101)
+#define JSON_WORD_HIGHS UINT64_C(0x8080808080808080)
+
+/* Returns non-zero if any of the eight bytes in "w" is a double quote, a
+ * backslash or a control character. Bytes with the high bit set (UTF-8
+ * sequences) are copied verbatim. False positives are possible and are handled
+ * by the byte-wise slow path; false negatives are not. */
+static inline uint64_t json_word_is_special(uint64_t w) /* {{{ */
+{
+  uint64_t quote = w ^ (JSON_WORD_ONES * '"');
+  uint64_t backslash = w ^ (JSON_WORD_ONES * '\\');
+
+  return (((quote - JSON_WORD_ONES) & ~quote) |
+          ((backslash - JSON_WORD_ONES) & ~backslash) |
+          ((w - JSON_WORD_ONES * 0x20) & ~w)) &
+         JSON_WORD_HIGHS;
+} /* }}} uint64_t json_word_is_special */
 
+/* Writes "string" as a quoted JSON string to "buffer". Returns the number of
+ * bytes written (excluding the null byte) or a negative errno value. */
 static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
                               const char *string) {
+  size_t src_len;
+  size_t src_pos;
   size_t dst_pos;
 
   if ((buffer == NULL) || (string == NULL))
@@ -53,6 +67,8 @@ static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
   if (buffer_size < 3)
     return -ENOMEM;
 
+  src_len = strlen(string);
+  src_pos = 0;
   dst_pos = 0;
 
 #define BUFFER_ADD(c)                                                          \
@@ -67,170 +83,229 @@ static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
 
   /* Escape special characters */
   BUFFER_ADD('"');
-  for (size_t src_pos = 0; string[src_pos] != 0; src_pos++) {
-    if ((string[src_pos] == '"') || (string[src_pos] == '\\')) {
-      BUFFER_ADD('\\');
-      BUFFER_ADD(string[src_pos]);
-    } else if (string[src_pos] <= 0x001F)
-      BUFFER_ADD('?');
-    else
-      BUFFER_ADD(string[src_pos]);
-  } /* for */
+  while (src_pos < src_len) {
+    /* Fast path: copy runs of clean words with a single memcpy(). */
+    size_t run_end = src_pos;
+    while ((src_len - run_end) >= sizeof(uint64_t)) {
+      uint64_t w;
+      memcpy(&w, string + run_end, sizeof(w));
+      if (json_word_is_special(w))
+        break;
+      run_end += sizeof(w);
+    }
+
+    if (run_end > src_pos) {
+      size_t run_len = run_end - src_pos;
+      if (run_len >= (buffer_size - 1 - dst_pos)) {
+        buffer[dst_pos] = '\0';
+        return -ENOMEM;
+      }
+      memcpy(buffer + dst_pos, string + src_pos, run_len);
+      dst_pos += run_len;
+      src_pos = run_end;
+    }
+
+    /* Slow path: handle the (possibly) offending word byte by byte. */
+    size_t slow_end = src_pos + sizeof(uint64_t);
+    if (slow_end > src_len)
+      slow_end = src_len;
+    for (; src_pos < slow_end; src_pos++) {
+      unsigned char c = (unsigned char)string[src_pos];
+
+      if ((c == '"') || (c == '\\')) {
+        BUFFER_ADD('\\');
+        BUFFER_ADD(c);
+      } else if (c == '\n') {
+        BUFFER_ADD('\\');
+        BUFFER_ADD('n');
+      } else if (c == '\r') {
+        BUFFER_ADD('\\');
+        BUFFER_ADD('r');
+      } else if (c == '\t') {
+        BUFFER_ADD('\\');
+        BUFFER_ADD('t');
+      } else if (c < 0x20) {
+        BUFFER_ADD('\\');
+        BUFFER_ADD('u');
+        BUFFER_ADD('0');
+        BUFFER_ADD('0');
+        BUFFER_ADD("0123456789abcdef"[c >> 4]);
+        BUFFER_ADD("0123456789abcdef"[c & 0x0f]);
+      } else /* includes UTF-8 sequences */
+        BUFFER_ADD(c);
+    }
+  } /* while (src_pos < src_len) */
   BUFFER_ADD('"');
   buffer[dst_pos] = 0;
 
 #undef BUFFER_ADD
 
-  return 0;
+  return (int)dst_pos;
 } /* }}} int json_escape_string */
 
-static int values_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                          const data_set_t *ds, const value_list_t *vl,
-                          int store_rates) {
-  size_t offset = 0;
-  gauge_t *rates = NULL;
+/* The following functions append to "buffer" at "*ret_offset" and update the
+ * offset. "buffer" is kept null-terminated; when it is too small, -ENOMEM is
+ * returned. Strings and numbers are copied directly instead of going through
+ * snprintf(). */
+#define BUFFER_ADD_STRING(str, len)                                            \
+  do {                                                                         \
+    size_t len__ = (len);                                                      \
+    if (len__ >= (buffer_size - offset))                                       \
+      return -ENOMEM;                                                          \
+    memcpy(buffer + offset, (str), len__);                                     \
+    offset += len__;                                                           \
+    buffer[offset] = 0;                                                        \
+  } while (0)
+
+#define BUFFER_ADD_LITERAL(str) BUFFER_ADD_STRING(str, sizeof(str) - 1)
 
-  memset(buffer, 0, buffer_size);
+/* format_gauge() is a faster equivalent of GAUGE_FORMAT only; builds which
+ * override JSON_GAUGE_FORMAT get their format through snprintf(). */
+static int json_format_gauge(char *buffer, size_t buffer_size, gauge_t value) {
+  if (strcmp(JSON_GAUGE_FORMAT, GAUGE_FORMAT) == 0)
+    return format_gauge(buffer, buffer_size, value);
+  return snprintf(buffer, buffer_size, JSON_GAUGE_FORMAT, value);
+} /* int json_format_gauge */
+
+/* "func" is one of json_format_gauge(), format_int64() and format_uint64(). */
+#define BUFFER_ADD_NUMBER(func, value)                                         \
+  do {                                                                         \
+    int status__ = func(buffer + offset, buffer_size - offset, (value));       \
+    if (status__ < 1)                                                          \
+      return -1;                                                               \
+    else if (((size_t)status__) >= (buffer_size - offset))                     \
+      return -ENOMEM;                                                          \
+    offset += (size_t)status__;                                                \
+  } while (0)
 
 #define BUFFER_ADD(...)                                                        \
   do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1) {                                                          \
-      sfree(rates);                                                            \
+    int status__ =                                                             \
+        snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);          \
+    if (status__ < 1)                                                          \
       return -1;                                                               \
-    } else if (((size_t)status) >= (buffer_size - offset)) {                   \
-      sfree(rates);                                                            \
+    else if (((size_t)status__) >= (buffer_size - offset))                     \
       return -ENOMEM;                                                          \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
+    offset += (size_t)status__;                                                \
   } while (0)
 
-  BUFFER_ADD("[");
+#define BUFFER_ADD_ESCAPED(str)                                                \
+  do {                                                                         \
+    int status__ =                                                             \
+        json_escape_string(buffer + offset, buffer_size - offset, (str));      \
+    if (status__ < 0)                                                          \
+      return status__;                                                         \
+    offset += (size_t)status__;                                                \
+  } while (0)
+
+static int gauges_to_json(char *buffer, size_t buffer_size, /* {{{ */
+                          size_t *ret_offset, const data_set_t *ds,
+                          const value_list_t *vl, gauge_t const *rates) {
+  size_t offset = *ret_offset;
+
+  BUFFER_ADD_LITERAL("[");
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD_LITERAL(",");
 
     if (ds->ds[i].type == DS_TYPE_GAUGE) {
       if (isfinite(vl->values[i].gauge))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, vl->values[i].gauge);
+        BUFFER_ADD_NUMBER(json_format_gauge, vl->values[i].gauge);
       else
-        BUFFER_ADD("null");
-    } else if (store_rates) {
-      if (rates == NULL)
-        rates = uc_get_rate(ds, vl);
-      if (rates == NULL) {
-        WARNING("utils_format_json: uc_get_rate failed.");
-        sfree(rates);
-        return -1;
-      }
-
+        BUFFER_ADD_LITERAL("null");
+    } else if (rates != NULL) {
       if (isfinite(rates[i]))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, rates[i]);
+        BUFFER_ADD_NUMBER(json_format_gauge, rates[i]);
       else
-        BUFFER_ADD("null");
+        BUFFER_ADD_LITERAL("null");
     } else if (ds->ds[i].type == DS_TYPE_COUNTER)
-      BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[i].counter);
+      BUFFER_ADD_NUMBER(format_uint64, (uint64_t)vl->values[i].counter);
     else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      BUFFER_ADD("%" PRIi64, vl->values[i].derive);
+      BUFFER_ADD_NUMBER(format_int64, vl->values[i].derive);
     else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      BUFFER_ADD("%" PRIu64, vl->values[i].absolute);
+      BUFFER_ADD_NUMBER(format_uint64, vl->values[i].absolute);
     else {
       ERROR("format_json: Unknown data source type: %i", ds->ds[i].type);
-      sfree(rates);
       return -1;
     }
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
+  BUFFER_ADD_LITERAL("]");
 
-#undef BUFFER_ADD
+  *ret_offset = offset;
+  return 0;
+} /* }}} int gauges_to_json */
+
+static int values_to_json(char *buffer, size_t buffer_size, /* {{{ */
+                          size_t *ret_offset, const data_set_t *ds,
+                          const value_list_t *vl, int store_rates) {
+  gauge_t *rates = NULL;
+  int status;
+
+  if (store_rates) {
+    for (size_t i = 0; i < ds->ds_num; i++) {
+      if (ds->ds[i].type == DS_TYPE_GAUGE)
+        continue;
+
+      rates = uc_get_rate(ds, vl);
+      if (rates == NULL) {
+        WARNING("utils_format_json: uc_get_rate failed.");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  status = gauges_to_json(buffer, buffer_size, ret_offset, ds, vl, rates);
 
   sfree(rates);
-  return 0;
+  return status;
 } /* }}} int values_to_json */
 
 static int dstypes_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
+                           size_t *ret_offset, const data_set_t *ds) {
+  size_t offset = *ret_offset;
 
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
+  BUFFER_ADD_LITERAL("[");
   for (size_t i = 0; i < ds->ds_num; i++) {
+    char const *type = DS_TYPE_TO_STRING(ds->ds[i].type);
+
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD_LITERAL(",");
 
-    BUFFER_ADD("\"%s\"", DS_TYPE_TO_STRING(ds->ds[i].type));
+    BUFFER_ADD_LITERAL("\"");
+    BUFFER_ADD_STRING(type, strlen(type));
+    BUFFER_ADD_LITERAL("\"");
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
+  BUFFER_ADD_LITERAL("]");
 
+  *ret_offset = offset;
   return 0;
 } /* }}} int dstypes_to_json */
 
 static int dsnames_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
+                           size_t *ret_offset, const data_set_t *ds) {
+  size_t offset = *ret_offset;
 
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
+  BUFFER_ADD_LITERAL("[");
   for (size_t i = 0; i < ds->ds_num; i++) {
     if (i > 0)
-      BUFFER_ADD(",");
+      BUFFER_ADD_LITERAL(",");
 
-    BUFFER_ADD("\"%s\"", ds->ds[i].name);
+    BUFFER_ADD_LITERAL("\"");
+    BUFFER_ADD_STRING(ds->ds[i].name, strlen(ds->ds[i].name));
+    BUFFER_ADD_LITERAL("\"");
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
+  BUFFER_ADD_LITERAL("]");
 
+  *ret_offset = offset;
   return 0;
 } /* }}} int dsnames_to_json */
 
 static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                                  meta_data_t *meta, char **keys,
-                                  size_t keys_num) {
-  size_t offset = 0;
-  int status;
-
-  buffer[0] = 0;
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
+                                  size_t *ret_offset, meta_data_t *meta,
+                                  char **keys, size_t keys_num) {
+  size_t start = *ret_offset;
+  size_t offset = *ret_offset;
 
   for (size_t i = 0; i < keys_num; ++i) {
     int type;
@@ -240,23 +315,28 @@ static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
     if (type == MD_TYPE_STRING) {
       char *value = NULL;
       if (meta_data_get_string(meta, key, &value) == 0) {
-        char temp[512] = "";
+        int status;
 
-        status = json_escape_string(temp, sizeof(temp), value);
+        BUFFER_ADD(",\"%s\":", key);
+        status =
+            json_escape_string(buffer + offset, buffer_size - offset, value);
         sfree(value);
-        if (status != 0)
+        if (status < 0)
           return status;
-
-        BUFFER_ADD(",\"%s\":%s", key, temp);
+        offset += (size_t)status;
       }
     } else if (type == MD_TYPE_SIGNED_INT) {
       int64_t value = 0;
-      if (meta_data_get_signed_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIi64, key, value);
+      if (meta_data_get_signed_int(meta, key, &value) == 0) {
+        BUFFER_ADD(",\"%s\":", key);
+        BUFFER_ADD_NUMBER(format_int64, value);
+      }
     } else if (type == MD_TYPE_UNSIGNED_INT) {
       uint64_t value = 0;
-      if (meta_data_get_unsigned_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIu64, key, value);
+      if (meta_data_get_unsigned_int(meta, key, &value) == 0) {
+        BUFFER_ADD(",\"%s\":", key);
+        BUFFER_ADD_NUMBER(format_uint64, value);
+      }
     } else if (type == MD_TYPE_DOUBLE) {
       double value = 0.0;
       if (meta_data_get_double(meta, key, &value) == 0)
@@ -268,19 +348,18 @@ static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
     }
   } /* for (keys) */
 
-  if (offset == 0)
+  if (offset == start)
     return ENOENT;
 
-  buffer[0] = '{'; /* replace leading ',' */
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD
+  buffer[start] = '{'; /* replace leading ',' */
+  BUFFER_ADD_LITERAL("}");
 
+  *ret_offset = offset;
   return 0;
 } /* }}} int meta_data_keys_to_json */
 
 static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                             meta_data_t *meta) {
+                             size_t *ret_offset, meta_data_t *meta) {
   char **keys = NULL;
   size_t keys_num;
   int status;
@@ -293,7 +372,8 @@ static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
     return status;
   keys_num = (size_t)status;
 
-  status = meta_data_keys_to_json(buffer, buffer_size, meta, keys, keys_num);
+  status = meta_data_keys_to_json(buffer, buffer_size, ret_offset, meta, keys,
+                                  keys_num);
 
   for (size_t i = 0; i < keys_num; ++i)
     sfree(keys[i]);
@@ -302,56 +382,45 @@ static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
   return status;
 } /* }}} int meta_data_to_json */
 
+/* Formats "vl" directly into "buffer" in one pass. Returns the number of bytes
+ * written or a negative errno value. */
 static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
                               const data_set_t *ds, const value_list_t *vl,
                               int store_rates) {
-  char temp[512];
   size_t offset = 0;
   int status;
 
-  memset(buffer, 0, buffer_size);
+  if (buffer_size < 1)
+    return -ENOMEM;
+  buffer[0] = 0;
 
-#define BUFFER_ADD(...)                                                        \
+#define BUFFER_ADD_KEYVAL(key, value)                                          \
   do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
+    BUFFER_ADD_LITERAL(",\"" key "\":");                                       \
+    BUFFER_ADD_ESCAPED(value);                                                 \
   } while (0)
 
   /* All value lists have a leading comma. The first one will be replaced with
    * a square bracket in `format_json_finalize'. */
-  BUFFER_ADD(",{");
+  BUFFER_ADD_LITERAL(",{\"values\":");
 
-  status = values_to_json(temp, sizeof(temp), ds, vl, store_rates);
+  status = values_to_json(buffer, buffer_size, &offset, ds, vl, store_rates);
   if (status != 0)
     return status;
-  BUFFER_ADD("\"values\":%s", temp);
 
-  status = dstypes_to_json(temp, sizeof(temp), ds);
+  BUFFER_ADD_LITERAL(",\"dstypes\":");
+  status = dstypes_to_json(buffer, buffer_size, &offset, ds);
   if (status != 0)
     return status;
-  BUFFER_ADD(",\"dstypes\":%s", temp);
 
-  status = dsnames_to_json(temp, sizeof(temp), ds);
+  BUFFER_ADD_LITERAL(",\"dsnames\":");
+  status = dsnames_to_json(buffer, buffer_size, &offset, ds);
   if (status != 0)
     return status;
-  BUFFER_ADD(",\"dsnames\":%s", temp);
 
   BUFFER_ADD(",\"time\":%.3f", CDTIME_T_TO_DOUBLE(vl->time));
   BUFFER_ADD(",\"interval\":%.3f", CDTIME_T_TO_DOUBLE(vl->interval));
 
-#define BUFFER_ADD_KEYVAL(key, value)                                          \
-  do {                                                                         \
-    status = json_escape_string(temp, sizeof(temp), (value));                  \
-    if (status != 0)                                                           \
-      return status;                                                           \
-    BUFFER_ADD(",\"%s\":%s", (key), temp);                                     \
-  } while (0)
-
   BUFFER_ADD_KEYVAL("host", vl->host);
   BUFFER_ADD_KEYVAL("plugin", vl->plugin);
   BUFFER_ADD_KEYVAL("plugin_instance", vl->plugin_instance);
@@ -359,40 +428,186 @@ static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
   BUFFER_ADD_KEYVAL("type_instance", vl->type_instance);
 
   if (vl->meta != NULL) {
-    char meta_buffer[buffer_size];
-    memset(meta_buffer, 0, sizeof(meta_buffer));
-    status = meta_data_to_json(meta_buffer, sizeof(meta_buffer), vl->meta);
-    if (status != 0)
-      return status;
-
-    BUFFER_ADD(",\"meta\":%s", meta_buffer);
+    size_t meta_offset = offset;
+
+    BUFFER_ADD_LITERAL(",\"meta\":");
+    size_t value_offset = offset;
+    status = meta_data_to_json(buffer, buffer_size, &offset, vl->meta);
+    if ((status == ENOENT) || ((status == 0) && (offset == value_offset))) {
+      /* no meta data to add; remove the key again */
+      offset = meta_offset;
+      buffer[offset] = 0;
+    } else if (status != 0)
+      return (status < 0) ? status : -status;
   } /* if (vl->meta != NULL) */
 
-  BUFFER_ADD("}");
+  BUFFER_ADD_LITERAL("}");
 
 #undef BUFFER_ADD_KEYVAL
-#undef BUFFER_ADD
 
-  return 0;
+  return (int)offset;
 } /* }}} int value_list_to_json */
 
+static int notification_meta_to_json(char *buffer, /* {{{ */
+                                      size_t buffer_size, size_t *ret_offset,
+                                      notification_meta_t const *meta) {
+  size_t offset = *ret_offset;
+
+  /* Annotations are string-to-string maps, so all values are quoted. */
+  for (; meta != NULL; meta = meta->next) {
+    BUFFER_ADD_LITERAL(",");
+    BUFFER_ADD_ESCAPED(meta->name);
+    BUFFER_ADD_LITERAL(":");
+
+    switch (meta->type) {
+    case NM_TYPE_STRING:
+      BUFFER_ADD_ESCAPED(meta->nm_value.nm_string);
+      break;
+    case NM_TYPE_SIGNED_INT:
+      BUFFER_ADD_LITERAL("\"");
+      BUFFER_ADD_NUMBER(format_int64, meta->nm_value.nm_signed_int);
+      BUFFER_ADD_LITERAL("\"");
+      break;
+    case NM_TYPE_UNSIGNED_INT:
+      BUFFER_ADD_LITERAL("\"");
+      BUFFER_ADD_NUMBER(format_uint64, meta->nm_value.nm_unsigned_int);
+      BUFFER_ADD_LITERAL("\"");
+      break;
+    case NM_TYPE_DOUBLE:
+      BUFFER_ADD("\"" JSON_GAUGE_FORMAT "\"", meta->nm_value.nm_double);
+      break;
+    case NM_TYPE_BOOLEAN:
+      if (meta->nm_value.nm_boolean)
+        BUFFER_ADD_LITERAL("\"true\"");
+      else
+        BUFFER_ADD_LITERAL("\"false\"");
+      break;
+    default:
+      ERROR("format_json_meta: unknown meta data type %d (name \"%s\")",
+            meta->type, meta->name);
+      BUFFER_ADD_LITERAL("null");
+    }
+  }
+
+  *ret_offset = offset;
+  return 0;
+} /* }}} int notification_meta_to_json */
+
+/*
+ * Format (prometheus/alertmanager v1):
+ *
+ * [{
+ *   "labels": {
+ *     "alertname": "collectd_cpu",
+ *     "instance":  "host.example.com",
+ *     "severity":  "FAILURE",
+ *     "service":   "collectd",
+ *     "cpu":       "0",
+ *     "type":      "wait"
+ *   },
+ *   "annotations": {
+ *     "summary": "...",
+ *     // meta
+ *   },
+ *   "startsAt": <rfc3339 time>,
+ *   "endsAt": <rfc3339 time>, // not used
+ * }]
+ *
+ * Returns the number of bytes written or a negative errno value.
+ */
+static int notification_to_json(char *buffer, size_t buffer_size, /* {{{ */
+                                notification_t const *n) {
+  char alertname[2 * DATA_MAX_NAME_LEN + 16];
+  char time_str[RFC3339NANO_SIZE] = "";
+  size_t offset = 0;
+  int status;
+
+  if (buffer_size < 1)
+    return -ENOMEM;
+  buffer[0] = 0;
+
+  if (strncmp(n->plugin, n->type, strlen(n->plugin)) == 0)
+    ssnprintf(alertname, sizeof(alertname), "collectd_%s", n->type);
+  else
+    ssnprintf(alertname, sizeof(alertname), "collectd_%s_%s", n->plugin,
+              n->type);
+
+  if (rfc3339nano(time_str, sizeof(time_str), n->time) != 0)
+    return -EINVAL;
+
+  BUFFER_ADD_LITERAL("[{\"labels\":{\"alertname\":");
+  BUFFER_ADD_ESCAPED(alertname);
+  BUFFER_ADD_LITERAL(",\"instance\":");
+  BUFFER_ADD_ESCAPED(n->host);
+
+  /* mangling of plugin instance and type instance into labels is copied from
+   * the Prometheus collectd exporter. */
+  if (n->plugin_instance[0] != 0) {
+    BUFFER_ADD_LITERAL(",");
+    BUFFER_ADD_ESCAPED(n->plugin);
+    BUFFER_ADD_LITERAL(":");
+    BUFFER_ADD_ESCAPED(n->plugin_instance);
+  }
+  if (n->type_instance[0] != 0) {
+    BUFFER_ADD_LITERAL(",");
+    if (n->plugin_instance[0] != 0)
+      BUFFER_ADD_LITERAL("\"type\"");
+    else
+      BUFFER_ADD_ESCAPED(n->plugin);
+    BUFFER_ADD_LITERAL(":");
+    BUFFER_ADD_ESCAPED(n->type_instance);
+  }
+
+  BUFFER_ADD_LITERAL(",\"severity\":");
+  if (n->severity == NOTIF_FAILURE)
+    BUFFER_ADD_LITERAL("\"FAILURE\"");
+  else if (n->severity == NOTIF_WARNING)
+    BUFFER_ADD_LITERAL("\"WARNING\"");
+  else if (n->severity == NOTIF_OKAY)
+    BUFFER_ADD_LITERAL("\"OKAY\"");
+  else
+    BUFFER_ADD_LITERAL("\"UNKNOWN\"");
+
+  BUFFER_ADD_LITERAL(",\"service\":\"collectd\"},\"annotations\":{"
+                     "\"summary\":");
+  BUFFER_ADD_ESCAPED(n->message);
+
+  status = notification_meta_to_json(buffer, buffer_size, &offset, n->meta);
+  if (status != 0)
+    return status;
+
+  BUFFER_ADD_LITERAL("},\"startsAt\":\"");
+  BUFFER_ADD_STRING(time_str, strlen(time_str));
+  BUFFER_ADD_LITERAL("\"}]");
+
+  return (int)offset;
+} /* }}} int notification_to_json */
+
+#undef BUFFER_ADD_ESCAPED
+#undef BUFFER_ADD
+#undef BUFFER_ADD_NUMBER
+#undef BUFFER_ADD_LITERAL
+#undef BUFFER_ADD_STRING
+
 static int format_json_value_list_nocheck(char *buffer, /* {{{ */
                                           size_t *ret_buffer_fill,
                                           size_t *ret_buffer_free,
                                           const data_set_t *ds,
                                           const value_list_t *vl,
                                           int store_rates, size_t temp_size) {
-  char temp[temp_size];
   int status;
 
-  status = value_list_to_json(temp, sizeof(temp), ds, vl, store_rates);
-  if (status != 0)
+  /* Format in place, right after the already formatted value lists. On
+   * failure, the buffer is restored to its previous state. */
+  status = value_list_to_json(buffer + (*ret_buffer_fill), temp_size, ds, vl,
+                              store_rates);
+  if (status < 0) {
+    buffer[*ret_buffer_fill] = 0;
     return status;
-  temp_size = strlen(temp);
+  }
 
-  memcpy(buffer + (*ret_buffer_fill), temp, temp_size + 1);
-  (*ret_buffer_fill) += temp_size;
-  (*ret_buffer_free) -= temp_size;
+  (*ret_buffer_fill) += (size_t)status;
+  (*ret_buffer_free) -= (size_t)status;
 
   return 0;
 } /* }}} int format_json_value_list_nocheck */
@@ -465,231 +680,185 @@ int format_json_value_list(char *buffer, /* {{{ */
                                         (*ret_buffer_free) - 2);
 } /* }}} int format_json_value_list */
 
-#if HAVE_LIBYAJL
-static int json_add_string(yajl_gen g, char const *str) /* {{{ */
-{
-  if (str == NULL)
-    return (int)yajl_gen_null(g);
-
-  return (int)yajl_gen_string(g, (const unsigned char *)str,
-                              (unsigned int)strlen(str));
-} /* }}} int json_add_string */
+int format_json_notification(char *buffer, size_t buffer_size, /* {{{ */
+                             notification_t const *n) {
+  int status;
 
-#define JSON_ADD(g, str)                                                       \
-  do {                                                                         \
-    yajl_gen_status status = json_add_string(g, str);                          \
-    if (status != yajl_gen_status_ok) {                                        \
-      return -1;                                                               \
-    }                                                                          \
-  } while (0)
+  if ((buffer == NULL) || (n == NULL))
+    return EINVAL;
 
-#define JSON_ADDF(g, format, ...)                                              \
-  do {                                                                         \
-    char *str = ssnprintf_alloc(format, __VA_ARGS__);                          \
-    yajl_gen_status status = json_add_string(g, str);                          \
-    free(str);                                                                 \
-    if (status != yajl_gen_status_ok) {                                        \
-      return -1;                                                               \
-    }                                                                          \
-  } while (0)
+  status = notification_to_json(buffer, buffer_size, n);
+  if (status < 0)
+    return -status;
 
-#define CHECK_SUCCESS(cmd)                                                     \
-  do {                                                                         \
-    yajl_gen_status s = (cmd);                                                 \
-    if (s != yajl_gen_status_ok) {                                             \
-      return (int)s;                                                           \
-    }                                                                          \
-  } while (0)
+  return 0;
+} /* }}} int format_json_notification */
 
-static int format_json_meta(yajl_gen g, notification_meta_t *meta) /* {{{ */
-{
-  if (meta == NULL)
-    return 0;
-
-  JSON_ADD(g, meta->name);
-  switch (meta->type) {
-  case NM_TYPE_STRING:
-    JSON_ADD(g, meta->nm_value.nm_string);
-    break;
-  case NM_TYPE_SIGNED_INT:
-    JSON_ADDF(g, "%" PRIi64, meta->nm_value.nm_signed_int);
-    break;
-  case NM_TYPE_UNSIGNED_INT:
-    JSON_ADDF(g, "%" PRIu64, meta->nm_value.nm_unsigned_int);
-    break;
-  case NM_TYPE_DOUBLE:
-    JSON_ADDF(g, JSON_GAUGE_FORMAT, meta->nm_value.nm_double);
-    break;
-  case NM_TYPE_BOOLEAN:
-    JSON_ADD(g, meta->nm_value.nm_boolean ? "true" : "false");
-    break;
-  default:
-    ERROR("format_json_meta: unknown meta data type %d (name \"%s\")",
-          meta->type, meta->name);
-    CHECK_SUCCESS(yajl_gen_null(g));
-  }
+/*
+ * Growable output buffers
+ *
+ * The formatters above write straight into the destination memory and report
+ * -ENOMEM when it is too small. The json_buffer_t functions retry such
+ * attempts after doubling the allocation, so the output is never truncated
+ * and, once the buffer has grown to the working-set size, no further
+ * allocations happen.
+ */
+#define JSON_BUFFER_MIN_SIZE 4096
 
-  return format_json_meta(g, meta->next);
-} /* }}} int format_json_meta */
+static pthread_key_t json_thread_buffer_key;
+static pthread_once_t json_thread_buffer_once = PTHREAD_ONCE_INIT;
 
-static int format_time(yajl_gen g, cdtime_t t) /* {{{ */
+static int json_buffer_grow(json_buffer_t *b) /* {{{ */
 {
-  char buffer[RFC3339NANO_SIZE] = "";
+  size_t new_size = (b->size < JSON_BUFFER_MIN_SIZE) ? JSON_BUFFER_MIN_SIZE
+                                                     : 2 * b->size;
+  char *tmp;
+
+  if (new_size <= b->size) /* overflow */
+    return ENOMEM;
 
-  if (rfc3339nano(buffer, sizeof(buffer), t) != 0)
-    return -1;
+  tmp = realloc(b->data, new_size);
+  if (tmp == NULL)
+    return ENOMEM;
 
-  JSON_ADD(g, buffer);
+  if (b->data == NULL)
+    tmp[0] = 0;
+  b->data = tmp;
+  b->size = new_size;
   return 0;
-} /* }}} int format_time */
+} /* }}} int json_buffer_grow */
 
-static int format_alert(yajl_gen g, notification_t const *n) /* {{{ */
+void json_buffer_reset(json_buffer_t *b) /* {{{ */
 {
-  CHECK_SUCCESS(yajl_gen_array_open(g)); /* BEGIN array */
-  CHECK_SUCCESS(yajl_gen_map_open(g));   /* BEGIN alert */
+  if (b == NULL)
+    return;
 
-  /*
-   * labels
-   */
-  JSON_ADD(g, "labels");
-  CHECK_SUCCESS(yajl_gen_map_open(g)); /* BEGIN labels */
+  b->fill = 0;
+  b->count = 0;
+  if (b->data != NULL)
+    b->data[0] = 0;
+} /* }}} void json_buffer_reset */
 
-  JSON_ADD(g, "alertname");
-  if (strncmp(n->plugin, n->type, strlen(n->plugin)) == 0)
-    JSON_ADDF(g, "collectd_%s", n->type);
-  else
-    JSON_ADDF(g, "collectd_%s_%s", n->plugin, n->type);
+void json_buffer_free(json_buffer_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return;
 
-  JSON_ADD(g, "instance");
-  JSON_ADD(g, n->host);
+  sfree(b->data);
+  b->size = 0;
+  b->fill = 0;
+  b->count = 0;
+} /* }}} void json_buffer_free */
 
-  /* mangling of plugin instance and type instance into labels is copied from
-   * the Prometheus collectd exporter. */
-  if (strlen(n->plugin_instance) > 0) {
-    JSON_ADD(g, n->plugin);
-    JSON_ADD(g, n->plugin_instance);
-  }
-  if (strlen(n->type_instance) > 0) {
-    if (strlen(n->plugin_instance) > 0)
-      JSON_ADD(g, "type");
-    else
-      JSON_ADD(g, n->plugin);
-    JSON_ADD(g, n->type_instance);
-  }
+static void json_thread_buffer_destroy(void *arg) /* {{{ */
+{
+  json_buffer_t *b = arg;
 
-  JSON_ADD(g, "severity");
-  JSON_ADD(g, (n->severity == NOTIF_FAILURE)
-                  ? "FAILURE"
-                  : (n->severity == NOTIF_WARNING)
-                        ? "WARNING"
-                        : (n->severity == NOTIF_OKAY) ? "OKAY" : "UNKNOWN");
+  json_buffer_free(b);
+  sfree(b);
+} /* }}} void json_thread_buffer_destroy */
 
-  JSON_ADD(g, "service");
-  JSON_ADD(g, "collectd");
+static void json_thread_buffer_key_create(void) /* {{{ */
+{
+  pthread_key_create(&json_thread_buffer_key, json_thread_buffer_destroy);
+} /* }}} void json_thread_buffer_key_create */
 
-  CHECK_SUCCESS(yajl_gen_map_close(g)); /* END labels */
+json_buffer_t *json_buffer_thread(void) /* {{{ */
+{
+  json_buffer_t *b;
+
+  pthread_once(&json_thread_buffer_once, json_thread_buffer_key_create);
+
+  b = pthread_getspecific(json_thread_buffer_key);
+  if (b == NULL) {
+    b = calloc(1, sizeof(*b));
+    if (b == NULL)
+      return NULL;
+    if (pthread_setspecific(json_thread_buffer_key, b) != 0) {
+      sfree(b);
+      return NULL;
+    }
+  }
 
-  /*
-   * annotations
-   */
-  JSON_ADD(g, "annotations");
-  CHECK_SUCCESS(yajl_gen_map_open(g)); /* BEGIN annotations */
+  json_buffer_reset(b);
+  return b;
+} /* }}} json_buffer_t *json_buffer_thread */
 
-  JSON_ADD(g, "summary");
-  JSON_ADD(g, n->message);
+int json_buffer_value_list(json_buffer_t *b, /* {{{ */
+                           const data_set_t *ds, const value_list_t *vl,
+                           int store_rates) {
+  if ((b == NULL) || (ds == NULL) || (vl == NULL))
+    return EINVAL;
 
-  if (format_json_meta(g, n->meta) != 0) {
-    return -1;
-  }
+  while (1) {
+    int status;
+
+    /* Keep room for the closing bracket and the null byte, so that
+     * json_buffer_finalize() never has to grow the buffer. */
+    if ((b->size - b->fill) > 2) {
+      status = value_list_to_json(b->data + b->fill, b->size - b->fill - 1,
+                                  ds, vl, store_rates);
+      if (status >= 0) {
+        if (b->count == 0)
+          b->data[b->fill] = '['; /* replace leading ',' */
+        b->fill += (size_t)status;
+        b->count++;
+        return 0;
+      }
 
-  CHECK_SUCCESS(yajl_gen_map_close(g)); /* END annotations */
+      b->data[b->fill] = 0;
+      if (status != -ENOMEM)
+        return -status;
+    }
 
-  JSON_ADD(g, "startsAt");
-  if (format_time(g, n->time) != 0) {
-    return -1;
+    if (json_buffer_grow(b) != 0) {
+      ERROR("format_json: Growing the output buffer beyond %" PRIsz
+            " bytes failed.",
+            b->size);
+      return ENOMEM;
+    }
   }
+} /* }}} int json_buffer_value_list */
 
-  CHECK_SUCCESS(yajl_gen_map_close(g));   /* END alert */
-  CHECK_SUCCESS(yajl_gen_array_close(g)); /* END array */
+int json_buffer_finalize(json_buffer_t *b) /* {{{ */
+{
+  if ((b == NULL) || (b->count == 0))
+    return EINVAL;
+
+  /* json_buffer_value_list() reserved the space for this. */
+  b->data[b->fill] = ']';
+  b->fill++;
+  b->data[b->fill] = 0;
 
   return 0;
-} /* }}} format_alert */
+} /* }}} int json_buffer_finalize */
 
-/*
- * Format (prometheus/alertmanager v1):
- *
- * [{
- *   "labels": {
- *     "alertname": "collectd_cpu",
- *     "instance":  "host.example.com",
- *     "severity":  "FAILURE",
- *     "service":   "collectd",
- *     "cpu":       "0",
- *     "type":      "wait"
- *   },
- *   "annotations": {
- *     "summary": "...",
- *     // meta
- *   },
- *   "startsAt": <rfc3339 time>,
- *   "endsAt": <rfc3339 time>, // not used
- * }]
- */
-int format_json_notification(char *buffer, size_t buffer_size, /* {{{ */
+int json_buffer_notification(json_buffer_t *b, /* {{{ */
                              notification_t const *n) {
-  yajl_gen g;
-  unsigned char const *out;
-#if HAVE_YAJL_V2
-  size_t unused_out_len;
-#else
-  unsigned int unused_out_len;
-#endif
-
-  if ((buffer == NULL) || (n == NULL))
+  if ((b == NULL) || (n == NULL))
     return EINVAL;
 
-#if HAVE_YAJL_V2
-  g = yajl_gen_alloc(NULL);
-  if (g == NULL)
-    return -1;
-#if COLLECT_DEBUG
-  yajl_gen_config(g, yajl_gen_beautify, 1);
-  yajl_gen_config(g, yajl_gen_validate_utf8, 1);
-#endif
-
-#else /* !HAVE_YAJL_V2 */
-  yajl_gen_config conf = {0};
-#if COLLECT_DEBUG
-  conf.beautify = 1;
-  conf.indentString = "  ";
-#endif
-  g = yajl_gen_alloc(&conf, NULL);
-  if (g == NULL)
-    return -1;
-#endif
-
-  if (format_alert(g, n) != 0) {
-    yajl_gen_clear(g);
-    yajl_gen_free(g);
-    return -1;
-  }
+  while (1) {
+    int status = -ENOMEM;
 
-  /* copy to output buffer */
-  if (yajl_gen_get_buf(g, &out, &unused_out_len) != yajl_gen_status_ok) {
-    yajl_gen_clear(g);
-    yajl_gen_free(g);
-    return -1;
-  }
-  sstrncpy(buffer, (void *)out, buffer_size);
+    if ((b->size - b->fill) > 1) {
+      status = notification_to_json(b->data + b->fill, b->size - b->fill, n);
+      if (status >= 0) {
+        b->fill += (size_t)status;
+        b->count++;
+        return 0;
+      }
 
-  yajl_gen_clear(g);
-  yajl_gen_free(g);
-  return 0;
-} /* }}} format_json_notification */
-#else
-int format_json_notification(char *buffer, size_t buffer_size, /* {{{ */
-                             notification_t const *n) {
-  ERROR("format_json_notification: Not available (requires libyajl).");
-  return ENOTSUP;
-} /* }}} int format_json_notification */
-#endif
+      b->data[b->fill] = 0;
+      if (status != -ENOMEM)
+        return -status;
+    }
+
+    if (json_buffer_grow(b) != 0) {
+      ERROR("format_json: Growing the output buffer beyond %" PRIsz
+            " bytes failed.",
+            b->size);
+      return ENOMEM;
+    }
+  }
+} /* }}} int json_buffer_notification */
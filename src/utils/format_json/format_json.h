@@ -45,4 +45,27 @@ int format_json_finalize(char *buffer, size_t *ret_buffer_fill,
 int format_json_notification(char *buffer, size_t buffer_size,
                              notification_t const *n);
 
+/* Growable output buffer. "data" is always null-terminated; "fill" is the
+ * length of the formatted output and "count" the number of value lists or
+ * notifications in it. */
+typedef struct {
+  char *data;
+  size_t size;
+  size_t fill;
+  size_t count;
+} json_buffer_t;
+
+/* Returns the calling thread's buffer, emptied. It is owned by the thread and
+ * freed when the thread exits. */
+json_buffer_t *json_buffer_thread(void);
+void json_buffer_reset(json_buffer_t *b);
+void json_buffer_free(json_buffer_t *b);
+
+/* Appends "vl" to the JSON array in "b", growing the buffer as needed.
+ * json_buffer_finalize() closes the array. */
+int json_buffer_value_list(json_buffer_t *b, const data_set_t *ds,
+                           const value_list_t *vl, int store_rates);
+int json_buffer_finalize(json_buffer_t *b);
+int json_buffer_notification(json_buffer_t *b, notification_t const *n);
+
 #endif /* UTILS_FORMAT_JSON_H */
@@ -177,8 +177,279 @@ DEF_TEST(notification) {
   return expect_json_labels(got, labels, STATIC_ARRAY_SIZE(labels));
 }
 
-int main(void) {
+static data_set_t ds_double = {
+    .type = "double",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"one", DS_TYPE_GAUGE, NAN, NAN},
+            {"two", DS_TYPE_DERIVE, 0, NAN},
+        },
+};
+
+DEF_TEST(value_list) {
+  value_list_t vl = {
+      .values = (value_t[]){{.gauge = 42}, {.derive = -23}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .plugin_instance = "0.5",
+      .type = "double",
+      .type_instance = "with \"quotes\", a \\ and a\ttab",
+  };
+  char const *want =
+      "[{\"values\":[42,-23],\"dstypes\":[\"gauge\",\"derive\"],"
+      "\"dsnames\":[\"one\",\"two\"],\"time\":1480063672.000,"
+      "\"interval\":10.000,\"host\":\"example.com\",\"plugin\":\"test\","
+      "\"plugin_instance\":\"0.5\",\"type\":\"double\","
+      "\"type_instance\":\"with \\\"quotes\\\", a \\\\ and a\\ttab\"}]";
+
+  char buffer[1024];
+  size_t bfill = 0;
+  size_t bfree = sizeof(buffer);
+  CHECK_ZERO(format_json_initialize(buffer, &bfill, &bfree));
+  CHECK_ZERO(
+      format_json_value_list(buffer, &bfill, &bfree, &ds_double, &vl, 0));
+  CHECK_ZERO(format_json_finalize(buffer, &bfill, &bfree));
+  EXPECT_EQ_STR(want, buffer);
+  EXPECT_EQ_INT(strlen(want), bfill);
+  EXPECT_EQ_INT(sizeof(buffer) - strlen(want), bfree);
+
+  /* A buffer which is too small must be left untouched. */
+  char small[64];
+  bfill = 0;
+  bfree = sizeof(small);
+  CHECK_ZERO(format_json_initialize(small, &bfill, &bfree));
+  EXPECT_EQ_INT(-ENOMEM, format_json_value_list(small, &bfill, &bfree,
+                                                &ds_double, &vl, 0));
+  EXPECT_EQ_INT(0, bfill);
+  EXPECT_EQ_INT(sizeof(small), bfree);
+  EXPECT_EQ_STR("", small);
+
+  return 0;
+}
+
+DEF_TEST(json_buffer) {
+  value_list_t vl = {
+      .values = (value_t[]){{.gauge = 42}, {.derive = -23}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "double",
+  };
+  char const *want_one =
+      "{\"values\":[42,-23],\"dstypes\":[\"gauge\",\"derive\"],"
+      "\"dsnames\":[\"one\",\"two\"],\"time\":1480063672.000,"
+      "\"interval\":10.000,\"host\":\"example.com\",\"plugin\":\"test\","
+      "\"plugin_instance\":\"\",\"type\":\"double\","
+      "\"type_instance\":\"\"}";
+
+  json_buffer_t b = {0};
+  CHECK_ZERO(json_buffer_value_list(&b, &ds_double, &vl, 0));
+  CHECK_ZERO(json_buffer_value_list(&b, &ds_double, &vl, 0));
+  CHECK_ZERO(json_buffer_finalize(&b));
+
+  char want[1024];
+  snprintf(want, sizeof(want), "[%s,%s]", want_one, want_one);
+  EXPECT_EQ_STR(want, b.data);
+  EXPECT_EQ_INT(strlen(want), b.fill);
+  EXPECT_EQ_INT(2, b.count);
+
+  /* Meta data larger than the initial allocation must not be truncated. */
+  char *big = malloc(20000);
+  CHECK_NOT_NULL(big);
+  memset(big, 'x', 19999);
+  big[19999] = 0;
+
+  CHECK_NOT_NULL(vl.meta = meta_data_create());
+  CHECK_ZERO(meta_data_add_string(vl.meta, "big", big));
+
+  json_buffer_reset(&b);
+  EXPECT_EQ_INT(0, b.fill);
+  CHECK_ZERO(json_buffer_value_list(&b, &ds_double, &vl, 0));
+  CHECK_ZERO(json_buffer_finalize(&b));
+  OK(b.fill > 20000);
+  OK(strstr(b.data, big) != NULL);
+  EXPECT_EQ_STR("\"}}]", b.data + b.fill - 4);
+
+  meta_data_destroy(vl.meta);
+  vl.meta = NULL;
+  free(big);
+  json_buffer_free(&b);
+
+  /* The per-thread buffer is handed out empty. */
+  json_buffer_t *tb = json_buffer_thread();
+  CHECK_NOT_NULL(tb);
+  CHECK_ZERO(json_buffer_value_list(tb, &ds_double, &vl, 0));
+  OK(tb == json_buffer_thread());
+  EXPECT_EQ_INT(0, tb->fill);
+
+  return 0;
+}
+
+DEF_TEST(notification_meta) {
+  notification_meta_t meta_bool = {
+      .name = "flag", .type = NM_TYPE_BOOLEAN, .nm_value.nm_boolean = true};
+  notification_meta_t meta_int = {.name = "count",
+                                  .type = NM_TYPE_SIGNED_INT,
+                                  .nm_value.nm_signed_int = -7,
+                                  .next = &meta_bool};
+  notification_meta_t meta_str = {.name = "path",
+                                  .type = NM_TYPE_STRING,
+                                  .nm_value.nm_string = "C:\\tmp",
+                                  .next = &meta_int};
+  notification_t n = {NOTIF_FAILURE,
+                      1555083754651779072ULL,
+                      "disk \"full\"",
+                      "example.com",
+                      "df",
+                      "root",
+                      "percent_bytes",
+                      "used",
+                      &meta_str};
+  char const *want =
+      "[{\"labels\":{\"alertname\":\"collectd_df_percent_bytes\","
+      "\"instance\":\"example.com\",\"df\":\"root\",\"type\":\"used\","
+      "\"severity\":\"FAILURE\",\"service\":\"collectd\"},"
+      "\"annotations\":{\"summary\":\"disk \\\"full\\\"\","
+      "\"path\":\"C:\\\\tmp\",\"count\":\"-7\",\"flag\":\"true\"},"
+      "\"startsAt\":\"2015-11-23T13:16:46.125000000Z\"}]";
+
+  char got[1024];
+  CHECK_ZERO(format_json_notification(got, sizeof(got), &n));
+  EXPECT_EQ_STR(want, got);
+
+  char small[32];
+  EXPECT_EQ_INT(ENOMEM, format_json_notification(small, sizeof(small), &n));
+
+  json_buffer_t b = {0};
+  CHECK_ZERO(json_buffer_notification(&b, &n));
+  EXPECT_EQ_STR(want, b.data);
+  json_buffer_free(&b);
+
+  return 0;
+}
+
+DEF_TEST(notification_escape) {
+  notification_t n = {NOTIF_OKAY,
+                      1555083754651779072ULL,
+                      "line one\nline\ttwo\r\x01 Gr\xc3\xbc\xc3\x9f"
+                      "e \xe2\x82\xac",
+                      "example.com",
+                      "unit",
+                      "",
+                      "test",
+                      "",
+                      NULL};
+  char const *want =
+      "[{\"labels\":{\"alertname\":\"collectd_unit_test\","
+      "\"instance\":\"example.com\",\"severity\":\"OKAY\","
+      "\"service\":\"collectd\"},"
+      "\"annotations\":{\"summary\":\"line one\\nline\\ttwo\\r\\u0001 "
+      "Gr\xc3\xbc\xc3\x9f"
+      "e \xe2\x82\xac\"},"
+      "\"startsAt\":\"2015-11-23T13:16:46.125000000Z\"}]";
+
+  char got[1024];
+  CHECK_ZERO(format_json_notification(got, sizeof(got), &n));
+  EXPECT_EQ_STR(want, got);
+
+  return 0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+/* Only runs when "--benchmark" is passed. */
+DEF_TEST(benchmark) {
+  value_list_t vl = {
+      .values = (value_t[]){{.gauge = 1234567}, {.derive = 987654321}},
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T_STATIC(1480063672),
+      .interval = TIME_T_TO_CDTIME_T_STATIC(10),
+      .host = "build-server-0042.example.com",
+      .plugin = "interface",
+      .plugin_instance = "enp0s31f6",
+      .type = "double",
+      .type_instance = "a somewhat longer \"type instance\" value",
+  };
+
+  char buffer[65536];
+  size_t bfill = 0;
+  size_t bfree = sizeof(buffer);
+  size_t total = 0;
+  int status = 0;
+
+  format_json_initialize(buffer, &bfill, &bfree);
+  double start = now_seconds();
+  for (int i = 0; (i < 100000) && (status == 0); i++) {
+    status = format_json_value_list(buffer, &bfill, &bfree, &ds_double, &vl, 0);
+    if (status == -ENOMEM) {
+      /* Buffer is full: account for it and start over, like write_http. */
+      total += bfill;
+      format_json_initialize(buffer, &bfill, &bfree);
+      status =
+          format_json_value_list(buffer, &bfill, &bfree, &ds_double, &vl, 0);
+    }
+  }
+  total += bfill;
+  double elapsed = now_seconds() - start;
+  EXPECT_EQ_INT(0, status);
+
+  printf("format_json_value_list: %.1f MB/s (%zu bytes in %.3f s)\n",
+         ((double)total) / (elapsed * 1e6), total, elapsed);
+  OK(total > 0);
+
+  /* One document per value list, as write_log and write_dlt do: a 16 KiB
+   * stack buffer versus the per-thread growable buffer. */
+  total = 0;
+  start = now_seconds();
+  for (int i = 0; (i < 100000) && (status == 0); i++) {
+    char message[16384];
+    bfill = 0;
+    bfree = sizeof(message);
+    format_json_initialize(message, &bfill, &bfree);
+    status = format_json_value_list(message, &bfill, &bfree, &ds_double, &vl,
+                                    0);
+    format_json_finalize(message, &bfill, &bfree);
+    total += bfill;
+  }
+  elapsed = now_seconds() - start;
+  EXPECT_EQ_INT(0, status);
+  printf("stack buffer per message: %.1f MB/s\n",
+         ((double)total) / (elapsed * 1e6));
+
+  total = 0;
+  start = now_seconds();
+  for (int i = 0; (i < 100000) && (status == 0); i++) {
+    json_buffer_t *b = json_buffer_thread();
+    status = json_buffer_value_list(b, &ds_double, &vl, 0);
+    json_buffer_finalize(b);
+    total += b->fill;
+  }
+  elapsed = now_seconds() - start;
+  EXPECT_EQ_INT(0, status);
+  printf("json_buffer per message:  %.1f MB/s\n",
+         ((double)total) / (elapsed * 1e6));
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
   RUN_TEST(notification);
+  RUN_TEST(notification_meta);
+  RUN_TEST(notification_escape);
+  RUN_TEST(value_list);
+  RUN_TEST(json_buffer);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(benchmark);
 
   END_TEST;
 }
@@ -374,3 +374,440 @@ void *match_get_user_data(cu_match_t *obj) {
     return NULL;
   return obj->user_data;
 } /* void *match_get_user_data */
+
+/*
+ * Match sets
+ */
+/* Longest literal kept for prefiltering. */
+#define MATCH_LITERAL_MAX 64
+
+typedef struct {
+  cu_match_t *match;
+  char *regex;
+  /* String which occurs in every matching line, or its prefix if `anchored'
+   * is set. NULL if none could be determined. */
+  char *literal;
+  size_t literal_len;
+  bool anchored;
+  /* No literal: checked by the set's combined regular expression first. */
+  bool gated;
+} match_set_entry_t;
+
+struct cu_match_set_s {
+  match_set_entry_t *entries;
+  size_t entries_num;
+
+  regex_t gate;
+  bool have_gate;
+  bool dirty;
+
+  /* Scratch space for the sub-match strings. */
+  char *buffer;
+  size_t buffer_size;
+};
+
+/* Skips a bracket expression starting at `ptr' and returns a pointer to the
+ * closing bracket, or NULL if there is none. */
+static const char *match_skip_bracket(const char *ptr) {
+  ptr++;
+  if (*ptr == '^')
+    ptr++;
+  /* A leading ']' is part of the list. */
+  if (*ptr == ']')
+    ptr++;
+  while ((*ptr != 0) && (*ptr != ']')) {
+    /* Character classes such as [:alpha:] may contain a ']'. */
+    if ((ptr[0] == '[') && ((ptr[1] == ':') || (ptr[1] == '.') ||
+                            (ptr[1] == '='))) {
+      const char *end = strchr(ptr + 2, ptr[1]);
+      if ((end == NULL) || (end[1] != ']'))
+        return NULL;
+      ptr = end + 2;
+      continue;
+    }
+    ptr++;
+  }
+  return (*ptr == ']') ? ptr : NULL;
+} /* const char *match_skip_bracket */
+
+/* Skips a parenthesized group starting at `ptr' and returns a pointer to the
+ * closing parenthesis, or NULL if it is not balanced. */
+static const char *match_skip_group(const char *ptr) {
+  int depth = 0;
+
+  for (; *ptr != 0; ptr++) {
+    if (*ptr == '\\') {
+      if (ptr[1] == 0)
+        return NULL;
+      ptr++;
+    } else if (*ptr == '[') {
+      ptr = match_skip_bracket(ptr);
+      if (ptr == NULL)
+        return NULL;
+    } else if (*ptr == '(') {
+      depth++;
+    } else if (*ptr == ')') {
+      depth--;
+      if (depth == 0)
+        return ptr;
+    }
+  }
+  return NULL;
+} /* const char *match_skip_group */
+
+/* Keeps `run' as the literal if it is better than what was found so far. An
+ * anchored prefix always wins, because comparing it is the cheapest check. */
+static void match_literal_keep(char *buffer, size_t buffer_size,
+                               const char *run, size_t run_len,
+                               bool anchored, size_t *best_len,
+                               bool *ret_anchored) {
+  if (run_len == 0)
+    return;
+
+  if (anchored) {
+    if (run_len >= buffer_size)
+      run_len = buffer_size - 1;
+    *ret_anchored = true;
+  } else if (*ret_anchored || (run_len <= *best_len) ||
+             (run_len >= buffer_size)) {
+    return;
+  }
+
+  memcpy(buffer, run, run_len);
+  buffer[run_len] = 0;
+  *best_len = run_len;
+} /* void match_literal_keep */
+
+/* Determines a literal which every string matching the extended regular
+ * expression `regex' must contain: the longest run of plain characters
+ * outside of alternatives and optional parts. If the expression is anchored
+ * and starts with such a run, that run is returned as a prefix and
+ * `ret_anchored' is set.
+ * Returns the length of the literal stored in `buffer', zero if there is
+ * none. */
+static size_t match_literal(const char *regex, char *buffer,
+                            size_t buffer_size, bool *ret_anchored) {
+  char run[MATCH_LITERAL_MAX];
+  size_t run_len = 0;
+  size_t best_len = 0;
+  /* Still in the first run directly after a leading '^'. */
+  bool at_start = (regex[0] == '^');
+
+  *ret_anchored = false;
+  if (buffer_size < 1)
+    return 0;
+  buffer[0] = 0;
+
+  for (const char *ptr = at_start ? regex + 1 : regex; *ptr != 0; ptr++) {
+    bool end_run = true;
+
+    switch (*ptr) {
+    case '|':
+      /* Top-level alternation: nothing is required. */
+      buffer[0] = 0;
+      *ret_anchored = false;
+      return 0;
+    case '(': {
+      /* A group without alternatives which is not optional is transparent:
+       * its content is scanned like the rest of the expression. */
+      const char *end = match_skip_group(ptr);
+      if (end == NULL)
+        return 0;
+      if ((memchr(ptr, '|', end - ptr) == NULL) && (end[1] != '*') &&
+          (end[1] != '?') && (end[1] != '{'))
+        end_run = false;
+      else
+        ptr = end;
+      break;
+    }
+    case '[':
+      ptr = match_skip_bracket(ptr);
+      break;
+    case '*':
+    case '?':
+    case '{':
+      /* The preceding character is optional. */
+      if (run_len > 0)
+        run_len--;
+      if (*ptr == '{')
+        ptr = strchr(ptr, '}');
+      break;
+    case '+':
+      /* The preceding character is required, but may repeat: it ends this
+       * run and starts the next one. */
+      if (run_len > 0) {
+        match_literal_keep(buffer, buffer_size, run, run_len, at_start,
+                           &best_len, ret_anchored);
+        at_start = false;
+        run[0] = run[run_len - 1];
+        run_len = 1;
+        end_run = false;
+      }
+      break;
+    case ')':
+      /* Closes a transparent group, see above. */
+      end_run = false;
+      break;
+    case '.':
+    case '^':
+    case '$':
+      break;
+    case '\\':
+      if (ptr[1] == 0)
+        return 0;
+      ptr++;
+      /* "\w", "\1" and friends are not literals, neither are the GNU word
+       * and buffer anchors "\<", "\>", "\`" and "\'". */
+      if (!isalnum((unsigned char)*ptr) && (strchr("<>`'", *ptr) == NULL)) {
+        end_run = false;
+        if (run_len < sizeof(run))
+          run[run_len++] = *ptr;
+      }
+      break;
+    default:
+      end_run = false;
+      if (run_len < sizeof(run))
+        run[run_len++] = *ptr;
+    }
+
+    if (ptr == NULL)
+      return 0;
+
+    /* A quantifier may follow, so the run cannot end here yet. */
+    if (!end_run)
+      continue;
+
+    match_literal_keep(buffer, buffer_size, run, run_len, at_start,
+                       &best_len, ret_anchored);
+    at_start = false;
+    run_len = 0;
+  }
+
+  match_literal_keep(buffer, buffer_size, run, run_len, at_start, &best_len,
+                     ret_anchored);
+  return best_len;
+} /* size_t match_literal */
+
+/* Back-references would be renumbered in the combined expression. */
+static bool match_has_backref(const char *regex) {
+  for (const char *ptr = strchr(regex, '\\'); ptr != NULL;
+       ptr = strchr(ptr + 2, '\\')) {
+    if (ptr[1] == 0)
+      break;
+    if (isdigit((unsigned char)ptr[1]))
+      return true;
+  }
+  return false;
+} /* bool match_has_backref */
+
+/* Builds the combined regular expression of all entries without a literal. */
+static void match_set_compile(cu_match_set_t *set) {
+  size_t gated_num = 0;
+  size_t size = 1;
+
+  if (set->have_gate) {
+    regfree(&set->gate);
+    set->have_gate = false;
+  }
+  set->dirty = false;
+
+  for (size_t i = 0; i < set->entries_num; i++) {
+    match_set_entry_t *e = set->entries + i;
+
+    e->gated = (e->literal == NULL) && !match_has_backref(e->regex);
+    if (e->gated) {
+      gated_num++;
+      size += strlen(e->regex) + 3;
+    }
+  }
+
+  /* With a single expression, the gate would just double the work. */
+  if (gated_num < 2) {
+    for (size_t i = 0; i < set->entries_num; i++)
+      set->entries[i].gated = false;
+    return;
+  }
+
+  char *combined = malloc(size);
+  if (combined == NULL) {
+    ERROR("utils_match: match_set_compile: malloc failed.");
+    for (size_t i = 0; i < set->entries_num; i++)
+      set->entries[i].gated = false;
+    return;
+  }
+
+  size_t pos = 0;
+  for (size_t i = 0; i < set->entries_num; i++) {
+    match_set_entry_t *e = set->entries + i;
+    if (!e->gated)
+      continue;
+
+    pos += ssnprintf(combined + pos, size - pos, "%s(%s)",
+                     (pos > 0) ? "|" : "", e->regex);
+  }
+
+  int status =
+      regcomp(&set->gate, combined, REG_EXTENDED | REG_NEWLINE | REG_NOSUB);
+  sfree(combined);
+  if (status != 0) {
+    ERROR("utils_match: match_set_compile: Compiling the combined regular "
+          "expression failed.");
+    for (size_t i = 0; i < set->entries_num; i++)
+      set->entries[i].gated = false;
+    return;
+  }
+
+  set->have_gate = true;
+} /* void match_set_compile */
+
+/* Like match_apply(), but copies the sub-matches to the set's scratch buffer
+ * instead of allocating each of them. */
+static int match_set_exec(cu_match_set_t *set, cu_match_t *obj,
+                          const char *str) {
+  regmatch_t re_match[32];
+  char *matches[32];
+  size_t matches_num;
+  size_t size = 0;
+
+  if ((obj->flags & UTILS_MATCH_FLAGS_EXCLUDE_REGEX) &&
+      (regexec(&obj->excluderegex, str, 0, NULL, /* eflags = */ 0) == 0))
+    return 0;
+
+  if (regexec(&obj->regex, str, STATIC_ARRAY_SIZE(re_match), re_match,
+              /* eflags = */ 0) != 0)
+    return 0;
+
+  for (matches_num = 0; matches_num < STATIC_ARRAY_SIZE(matches);
+       matches_num++) {
+    if ((re_match[matches_num].rm_so < 0) || (re_match[matches_num].rm_eo < 0))
+      break;
+    size += (size_t)(re_match[matches_num].rm_eo -
+                     re_match[matches_num].rm_so) +
+            1;
+  }
+
+  if (size > set->buffer_size) {
+    char *tmp = realloc(set->buffer, size);
+    if (tmp == NULL) {
+      ERROR("utils_match: match_set_exec: realloc failed.");
+      return -1;
+    }
+    set->buffer = tmp;
+    set->buffer_size = size;
+  }
+
+  char *ptr = set->buffer;
+  for (size_t i = 0; i < matches_num; i++) {
+    size_t len = (size_t)(re_match[i].rm_eo - re_match[i].rm_so);
+
+    memcpy(ptr, str + re_match[i].rm_so, len);
+    ptr[len] = 0;
+    matches[i] = ptr;
+    ptr += len + 1;
+  }
+
+  int status = obj->callback(str, matches, matches_num, obj->user_data);
+  if (status != 0)
+    ERROR("utils_match: match_set_exec: callback failed.");
+
+  return status;
+} /* int match_set_exec */
+
+cu_match_set_t *match_set_create(void) {
+  return calloc(1, sizeof(cu_match_set_t));
+} /* cu_match_set_t *match_set_create */
+
+int match_set_add(cu_match_set_t *set, const char *regex,
+                  const char *excluderegex,
+                  int (*callback)(const char *str, char *const *matches,
+                                  size_t matches_num, void *user_data),
+                  void *user_data, void (*free_user_data)(void *user_data)) {
+  char literal[MATCH_LITERAL_MAX];
+  bool anchored = false;
+
+  if ((set == NULL) || (regex == NULL))
+    return -1;
+
+  match_set_entry_t *tmp = realloc(
+      set->entries, sizeof(*set->entries) * (set->entries_num + 1));
+  if (tmp == NULL)
+    return -1;
+  set->entries = tmp;
+
+  match_set_entry_t *e = set->entries + set->entries_num;
+  *e = (match_set_entry_t){0};
+
+  e->regex = strdup(regex);
+  if (e->regex == NULL)
+    return -1;
+
+  e->match = match_create_callback(regex, excluderegex, callback, user_data,
+                                   free_user_data);
+  if (e->match == NULL) {
+    sfree(e->regex);
+    return -1;
+  }
+
+  e->literal_len = match_literal(regex, literal, sizeof(literal), &anchored);
+  if (e->literal_len > 0) {
+    e->literal = strdup(literal);
+    e->anchored = anchored;
+  }
+  DEBUG("utils_match: match_set_add: regex = %s, %s literal = %s", regex,
+        e->anchored ? "anchored" : "unanchored",
+        (e->literal != NULL) ? e->literal : "(none)");
+
+  set->dirty = true;
+  return (int)set->entries_num++;
+} /* int match_set_add */
+
+int match_set_apply(cu_match_set_t *set, const char *str) {
+  bool gate_checked = false;
+  bool gate_matched = false;
+  int status = 0;
+
+  if ((set == NULL) || (str == NULL))
+    return -1;
+
+  if (set->dirty)
+    match_set_compile(set);
+
+  for (size_t i = 0; i < set->entries_num; i++) {
+    match_set_entry_t *e = set->entries + i;
+
+    if (e->literal != NULL) {
+      if (e->anchored ? (strncmp(str, e->literal, e->literal_len) != 0)
+                      : (strstr(str, e->literal) == NULL))
+        continue;
+    } else if (e->gated) {
+      if (!gate_checked) {
+        gate_matched = (regexec(&set->gate, str, 0, NULL, 0) == 0);
+        gate_checked = true;
+      }
+      if (!gate_matched)
+        continue;
+    }
+
+    if (match_set_exec(set, e->match, str) != 0)
+      status = -1;
+  }
+
+  return status;
+} /* int match_set_apply */
+
+void match_set_destroy(cu_match_set_t *set) {
+  if (set == NULL)
+    return;
+
+  for (size_t i = 0; i < set->entries_num; i++) {
+    match_destroy(set->entries[i].match);
+    sfree(set->entries[i].regex);
+    sfree(set->entries[i].literal);
+  }
+  if (set->have_gate)
+    regfree(&set->gate);
+
+  sfree(set->entries);
+  sfree(set->buffer);
+  sfree(set);
+} /* void match_set_destroy */
@@ -176,4 +176,61 @@ int match_apply(cu_match_t *obj, const char *str);
  */
 void *match_get_user_data(cu_match_t *obj);
 
+/*
+ * Match sets
+ *
+ * A match set applies many regular expressions to the same string. Each
+ * expression is compiled with a literal prefilter: a string that must occur
+ * in every matching line (or, for anchored expressions, a prefix), so that
+ * regexec(3) only runs when the prefilter passed. Expressions without such a
+ * literal are combined into one alternation which is checked once per string
+ * before any of them is tried individually.
+ */
+struct cu_match_set_s;
+typedef struct cu_match_set_s cu_match_set_t;
+
+/*
+ * NAME
+ *  match_set_create
+ * DESCRIPTION
+ *  Creates a new, empty match set.
+ */
+cu_match_set_t *match_set_create(void);
+
+/*
+ * NAME
+ *  match_set_add
+ * DESCRIPTION
+ *  Adds a regular expression to the set. The arguments have the same meaning
+ *  as for `match_create_callback'; `free_user_data' is called when the set is
+ *  destroyed.
+ * RETURN VALUE
+ *  The index of the expression in the set, or -1 on failure.
+ */
+int match_set_add(cu_match_set_t *set, const char *regex,
+                  const char *excluderegex,
+                  int (*callback)(const char *str, char *const *matches,
+                                  size_t matches_num, void *user_data),
+                  void *user_data, void (*free_user_data)(void *user_data));
+
+/*
+ * NAME
+ *  match_set_apply
+ * DESCRIPTION
+ *  Matches `str' against all expressions in the set and calls the callback of
+ *  each one that matched, in the order they were added. The sub-match strings
+ *  passed to the callbacks are only valid during the call.
+ * RETURN VALUE
+ *  Zero if all callbacks succeeded, non-zero otherwise.
+ */
+int match_set_apply(cu_match_set_t *set, const char *str);
+
+/*
+ * NAME
+ *  match_set_destroy
+ * DESCRIPTION
+ *  Destroys the set and all expressions in it.
+ */
+void match_set_destroy(cu_match_set_t *set);
+
 #endif /* UTILS_MATCH_H */
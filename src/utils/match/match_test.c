@@ -0,0 +1,238 @@
+/**
+ * collectd - src/utils/match/match_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/match/match.c"
+
+DEF_TEST(literal) {
+  struct {
+    const char *regex;
+    const char *want;
+    bool anchored;
+  } cases[] = {
+      {"BANK ([0-9]*)", "BANK ", false},
+      {"^kernel: (.*)", "kernel: ", true},
+      {"^a?bc", "bc", false},
+      {"^ab*c", "a", true},
+      {"foo|bar", "", false},
+      {"(foo|bar) baz", " baz", false},
+      {"x+yz", "xyz", false},
+      {"CPU[0-9]+: Machine Check", ": Machine Check", false},
+      {"TSC ([a-z0-9]*)", "TSC ", false},
+      {"ab{2,3}cd", "cd", false},
+      {"10\\.0\\.0\\.1", "10.0.0.1", false},
+      {"\\w+ error", " error", false},
+      {"[]a]bcd[[:alpha:]]", "bcd", false},
+      {".*", "", false},
+      {"(Running trigger.*)", "Running trigger", false},
+      {"Hardware Error\\]: (BANK[0-9]) (.*)", "Hardware Error]: BANK", false},
+      {"^(kernel): (ab)+c", "kernel: ab", true},
+      {"(abc)?def", "def", false},
+      {"\\<error\\>", "error", false},
+      {"^\\<kernel\\>: x", "kernel", false},
+      {"\\`abc\\'", "abc", false},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char buffer[MATCH_LITERAL_MAX];
+    bool anchored = false;
+
+    printf("## regex = \"%s\"\n", cases[i].regex);
+    size_t len =
+        match_literal(cases[i].regex, buffer, sizeof(buffer), &anchored);
+    EXPECT_EQ_INT(strlen(cases[i].want), len);
+    if (len > 0) {
+      EXPECT_EQ_STR(cases[i].want, buffer);
+      EXPECT_EQ_INT(cases[i].anchored, anchored);
+    }
+  }
+
+  return 0;
+}
+
+typedef struct {
+  int id;
+  int *hits;
+  char last[64];
+} hit_t;
+
+static int hit_cb(const char *str, char *const *matches, size_t matches_num,
+                  void *user_data) {
+  hit_t *h = user_data;
+
+  /* Record the order in which the callbacks ran. */
+  for (size_t i = 0; i < 8; i++) {
+    if (h->hits[i] == -1) {
+      h->hits[i] = h->id;
+      break;
+    }
+  }
+  sstrncpy(h->last, matches[matches_num - 1], sizeof(h->last));
+  return 0;
+}
+
+DEF_TEST(set) {
+  int hits[8];
+  hit_t h[] = {
+      {.id = 0, .hits = hits},
+      {.id = 1, .hits = hits},
+      {.id = 2, .hits = hits},
+      {.id = 3, .hits = hits},
+      {.id = 4, .hits = hits},
+  };
+  cu_match_set_t *set;
+
+  CHECK_NOT_NULL(set = match_set_create());
+  EXPECT_EQ_INT(0,
+                match_set_add(set, "^mce: (.*)", NULL, hit_cb, &h[0], NULL));
+  EXPECT_EQ_INT(1, match_set_add(set, "BANK ([0-9]+)", "ignored", hit_cb,
+                                 &h[1], NULL));
+  /* No literal: these two share the combined expression, the one with a
+   * back-reference is always tried. */
+  EXPECT_EQ_INT(2,
+                match_set_add(set, "([0-9]+)$", NULL, hit_cb, &h[2], NULL));
+  EXPECT_EQ_INT(3,
+                match_set_add(set, "(a|b)(c|d)", NULL, hit_cb, &h[3], NULL));
+  EXPECT_EQ_INT(4, match_set_add(set, "(.)\\1", NULL, hit_cb, &h[4], NULL));
+  EXPECT_EQ_INT(-1, match_set_add(set, "(", NULL, hit_cb, NULL, NULL));
+
+  memset(hits, -1, sizeof(hits));
+  CHECK_ZERO(match_set_apply(set, "mce: CPU 1 BANK 42"));
+  EXPECT_EQ_INT(0, hits[0]);
+  EXPECT_EQ_INT(1, hits[1]);
+  EXPECT_EQ_INT(2, hits[2]);
+  EXPECT_EQ_INT(-1, hits[3]);
+  EXPECT_EQ_STR("CPU 1 BANK 42", h[0].last);
+  EXPECT_EQ_STR("42", h[1].last);
+  EXPECT_EQ_STR("42", h[2].last);
+
+  /* Excluded by the exclude regex and not at the start of the line. */
+  memset(hits, -1, sizeof(hits));
+  CHECK_ZERO(match_set_apply(set, "BANK 7 ignored acd xx"));
+  EXPECT_EQ_INT(3, hits[0]);
+  EXPECT_EQ_INT(4, hits[1]);
+  EXPECT_EQ_INT(-1, hits[2]);
+  EXPECT_EQ_STR("c", h[3].last);
+
+  memset(hits, -1, sizeof(hits));
+  CHECK_ZERO(match_set_apply(set, "nothing to say"));
+  EXPECT_EQ_INT(-1, hits[0]);
+
+  match_set_destroy(set);
+
+  /* Word anchors are not part of the literal. */
+  CHECK_NOT_NULL(set = match_set_create());
+  EXPECT_EQ_INT(0, match_set_add(set, "\\<error\\>", NULL, hit_cb, &h[0],
+                                 NULL));
+
+  memset(hits, -1, sizeof(hits));
+  CHECK_ZERO(match_set_apply(set, "an error occurred"));
+  EXPECT_EQ_INT(0, hits[0]);
+
+  memset(hits, -1, sizeof(hits));
+  CHECK_ZERO(match_set_apply(set, "no errors"));
+  EXPECT_EQ_INT(-1, hits[0]);
+
+  match_set_destroy(set);
+  return 0;
+}
+
+static int count_cb(const char *str, char *const *matches, size_t matches_num,
+                    void *user_data) {
+  (*(uint64_t *)user_data)++;
+  return 0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+/* 32 patterns, similar to a logparser <Message> block for kernel logs. Only
+ * runs when "--benchmark" is passed. */
+DEF_TEST(benchmark) {
+  const char *lines[] = {
+      "kernel: [12345.678901] e1000e 0000:00:19.0 eth0: Link is Up",
+      "kernel: [12345.678902] audit: type=1400 audit(1.2:3): apparmor=ALLOW",
+      "kernel: [12345.678903] mce: [Hardware Error]: CPU 3: Machine Check",
+      "kernel: [12345.678904] mce: [Hardware Error]: TSC 1a2b3c4d5e6f",
+      "kernel: [12345.678905] usb 1-1: new high-speed USB device number 4",
+      "kernel: [12345.678906] mce: [Hardware Error]: BANK5 status 0x9c00",
+      "kernel: [12345.678907] mce: MCE_7 deadbeef",
+  };
+  cu_match_t *single[32];
+  cu_match_set_t *set;
+  uint64_t single_hits = 0;
+  uint64_t set_hits = 0;
+  size_t rounds = 20000;
+
+  CHECK_NOT_NULL(set = match_set_create());
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(single); i++) {
+    char regex[128];
+    if (i % 4 == 3)
+      snprintf(regex, sizeof(regex), "MCE_%zu ([0-9a-f]+)|other_%zu", i, i);
+    else
+      snprintf(regex, sizeof(regex), "Hardware Error\\]: (BANK%zu) (.*)",
+               i);
+
+    CHECK_NOT_NULL(single[i] = match_create_callback(regex, NULL, count_cb,
+                                                     &single_hits, NULL));
+    OK(match_set_add(set, regex, NULL, count_cb, &set_hits, NULL) >= 0);
+  }
+
+  double start = now_seconds();
+  for (size_t r = 0; r < rounds; r++)
+    for (size_t l = 0; l < STATIC_ARRAY_SIZE(lines); l++)
+      for (size_t i = 0; i < STATIC_ARRAY_SIZE(single); i++)
+        match_apply(single[i], lines[l]);
+  double single_time = now_seconds() - start;
+
+  start = now_seconds();
+  for (size_t r = 0; r < rounds; r++)
+    for (size_t l = 0; l < STATIC_ARRAY_SIZE(lines); l++)
+      match_set_apply(set, lines[l]);
+  double set_time = now_seconds() - start;
+
+  EXPECT_EQ_UINT64(2 * rounds, set_hits);
+  EXPECT_EQ_UINT64(single_hits, set_hits);
+  printf("%zu lines x %zu patterns: match_apply %.0f lines/s, "
+         "match_set_apply %.0f lines/s\n",
+         rounds * STATIC_ARRAY_SIZE(lines), STATIC_ARRAY_SIZE(single),
+         (double)(rounds * STATIC_ARRAY_SIZE(lines)) / single_time,
+         (double)(rounds * STATIC_ARRAY_SIZE(lines)) / set_time);
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(single); i++)
+    match_destroy(single[i]);
+  match_set_destroy(set);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  RUN_TEST(literal);
+  RUN_TEST(set);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(benchmark);
+
+  END_TEST;
+}
@@ -49,7 +49,9 @@ struct parser_job_data_s {
   const char *filename;
   unsigned int start_idx;
   unsigned int stop_idx;
-  cu_tail_match_t *tm;
+  cu_tail_t *tail;
+  /* All patterns of the job, matched against each line in one go. */
+  cu_match_set_t *matches;
   message_t *messages_storage;
   size_t messages_max_len;
   int message_idx;
@@ -172,8 +174,7 @@ static int message_assembler(const char *row, char *const *matches,
 
   /* Every matched start pattern resets current message items and starts
    * assembling new messages */
-  if (strcmp(cm->msg_pattern.regex,
-             parser_job->message_patterns[parser_job->start_idx].regex) == 0) {
+  if (cm->msg_pattern_idx == (int)parser_job->start_idx) {
     DEBUG(UTIL_NAME ": Found beginning pattern");
     if (parser_job->start_message_assembly(parser_job) != 0)
       return -1;
@@ -195,14 +196,21 @@ static int message_assembler(const char *row, char *const *matches,
       .matched_patterns_check[cm->msg_pattern_idx] = 1;
 
   /* Handle message ending */
-  if (strcmp(cm->msg_pattern.regex,
-             parser_job->message_patterns[parser_job->stop_idx].regex) == 0) {
+  if (cm->msg_pattern_idx == (int)parser_job->stop_idx) {
     DEBUG(UTIL_NAME ": Found ending pattern");
     parser_job->end_message_assembly(parser_job);
   }
   return 0;
 }
 
+static int message_parser_line(void *data, char *buf,
+                               int __attribute__((unused)) buflen) {
+  parser_job_data_t *parser_job = data;
+
+  match_set_apply(parser_job->matches, buf);
+  return 0;
+}
+
 parser_job_data_t *message_parser_init(const char *filename,
                                        unsigned int start_idx,
                                        unsigned int stop_idx,
@@ -239,12 +247,17 @@ parser_job_data_t *message_parser_init(const char *filename,
   memcpy(parser_job->message_patterns, message_patterns,
          sizeof(*parser_job->message_patterns) * message_patterns_len);
   parser_job->message_patterns_len = message_patterns_len;
-  /* Init tail match */
-  parser_job->tm = tail_match_create(parser_job->filename);
-  if (parser_job->tm == NULL) {
-    ERROR(UTIL_NAME ": Error creating tail match");
+  /* Init tail and matches */
+  parser_job->tail = cu_tail_create(parser_job->filename);
+  if (parser_job->tail == NULL) {
+    ERROR(UTIL_NAME ": Error creating tail");
     goto free_msg_storage;
   }
+  parser_job->matches = match_set_create();
+  if (parser_job->matches == NULL) {
+    ERROR(UTIL_NAME ": Error creating match set");
+    goto free_tail;
+  }
 
   for (size_t i = 0; i < message_patterns_len; i++) {
     /* Create current_match container for passing regex info
@@ -252,29 +265,27 @@ parser_job_data_t *message_parser_init(const char *filename,
     checked_match_t *current_match = calloc(1, sizeof(*current_match));
     if (current_match == NULL) {
       ERROR(UTIL_NAME ": Error allocating current_match");
-      goto free_tail_match;
+      goto free_matches;
     }
     current_match->parser_job = parser_job;
     current_match->msg_pattern = message_patterns[i];
     current_match->msg_pattern_idx = i;
     /* Create callback */
-    cu_match_t *m = match_create_callback(
-        message_patterns[i].regex, message_patterns[i].excluderegex,
-        message_assembler, current_match, free);
-    if (m == NULL) {
+    if (match_set_add(parser_job->matches, message_patterns[i].regex,
+                      message_patterns[i].excluderegex, message_assembler,
+                      current_match, free) < 0) {
       ERROR(UTIL_NAME ": Error creating match callback");
-      goto free_tail_match;
-    }
-    if (tail_match_add_match(parser_job->tm, m, 0, 0, 0) != 0) {
-      ERROR(UTIL_NAME ": Error adding match callback");
-      goto free_tail_match;
+      sfree(current_match);
+      goto free_matches;
     }
   }
 
   return parser_job;
 
-free_tail_match:
-  tail_match_destroy(parser_job->tm);
+free_matches:
+  match_set_destroy(parser_job->matches);
+free_tail:
+  cu_tail_destroy(parser_job->tail);
 free_msg_storage:
   sfree(parser_job->messages_storage);
 free_msg_patterns:
@@ -319,7 +330,8 @@ int message_parser_read(parser_job_data_t *parser_job,
     parser_job->message_idx = -1;
   }
 
-  int status = tail_match_read(parser_job->tm, force_rewind);
+  int status = cu_tail_read(parser_job->tail, message_parser_line, parser_job,
+                            force_rewind);
   if (status != 0) {
     ERROR(UTIL_NAME ": Error while parser read. Status: %d", status);
     return -1;
@@ -334,6 +346,48 @@ int message_parser_read(parser_job_data_t *parser_job,
   return parser_job->messages_completed;
 }
 
+int message_parser_skip(parser_job_data_t *parser_job, uint64_t max_backlog,
+                        uint64_t *skipped_lines) {
+  if (parser_job == NULL) {
+    ERROR(UTIL_NAME ": Invalid parser_job pointer");
+    return -1;
+  }
+
+  if (cu_tail_skip(parser_job->tail, max_backlog, skipped_lines) != 0) {
+    ERROR(UTIL_NAME ": Error while skipping backlog of %s",
+          parser_job->filename);
+    return -1;
+  }
+
+  /* The rest of a message being assembled may have been skipped */
+  if (*skipped_lines > 0 && parser_job->message_idx >= 0 &&
+      parser_job->messages_storage[parser_job->message_idx].started &&
+      !(parser_job->messages_storage[parser_job->message_idx].completed)) {
+    DEBUG(UTIL_NAME ": Removing unfinished assembly of skipped message");
+    parser_job->messages_storage[parser_job->message_idx] =
+        (message_t){{{{0}}}};
+    parser_job->message_item_idx = 0;
+  }
+
+  return 0;
+}
+
+int message_parser_fd(parser_job_data_t *parser_job) {
+  if (parser_job == NULL)
+    return -1;
+
+  return cu_tail_fd(parser_job->tail);
+}
+
+int message_parser_wait(parser_job_data_t *parser_job, cdtime_t timeout) {
+  if (parser_job == NULL) {
+    ERROR(UTIL_NAME ": Invalid parser_job pointer");
+    return -1;
+  }
+
+  return cu_tail_wait(parser_job->tail, timeout);
+}
+
 void message_parser_cleanup(parser_job_data_t *parser_job) {
   if (parser_job == NULL) {
     ERROR(UTIL_NAME ": Invalid parser_job pointer");
@@ -341,7 +395,9 @@ void message_parser_cleanup(parser_job_data_t *parser_job) {
   }
   sfree(parser_job->messages_storage);
   sfree(parser_job->message_patterns);
-  if (parser_job->tm)
-    tail_match_destroy(parser_job->tm);
+  if (parser_job->matches)
+    match_set_destroy(parser_job->matches);
+  if (parser_job->tail)
+    cu_tail_destroy(parser_job->tail);
   sfree(parser_job);
 }
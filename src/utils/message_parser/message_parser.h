@@ -30,7 +30,8 @@
 #ifndef UTILS_MESSAGE_PARSER_H
 #define UTILS_MESSAGE_PARSER_H 1
 
-#include "utils_tail_match.h"
+#include "utils/match/match.h"
+#include "utils/tail/tail.h"
 
 typedef struct message_pattern_s {
   /* User defined name for message item */
@@ -137,6 +138,62 @@ parser_job_data_t *message_parser_init(const char *filename,
 int message_parser_read(parser_job_data_t *parser_job,
                         message_t **messages_storage, bool force_rewind);
 
+/*
+ * NAME
+ *   message_parser_skip
+ *
+ * DESCRIPTION
+ *   Drops the oldest unread lines if more than `max_backlog' bytes were
+ *   appended to the file since the previous read, so that a burst of log
+ *   messages does not delay following reads indefinitely. A message whose
+ *   assembly was in progress is discarded.
+ *
+ * PARAMETERS
+ *   `parser_job' Pointer to parser job.
+ *   `max_backlog' Maximum number of unread bytes to keep.
+ *   `skipped_lines' Set to the number of lines dropped.
+ *
+ * RETURN VALUE
+ *   Returns -1 upon failure, 0 otherwise.
+ */
+int message_parser_skip(parser_job_data_t *parser_job, uint64_t max_backlog,
+                        uint64_t *skipped_lines);
+
+/*
+ * NAME
+ *   message_parser_fd
+ *
+ * DESCRIPTION
+ *   Returns a file descriptor which becomes readable when the parsed file
+ *   changes, so that callers can wait for new messages with poll(2). Use
+ *   'message_parser_wait' with a zero timeout to consume the change events.
+ *
+ * PARAMETERS
+ *   `parser_job' Pointer to parser job.
+ *
+ * RETURN VALUE
+ *   Returns -1 if change notifications are not available, the file
+ *   descriptor otherwise.
+ */
+int message_parser_fd(parser_job_data_t *parser_job);
+
+/*
+ * NAME
+ *   message_parser_wait
+ *
+ * DESCRIPTION
+ *   Waits until the parsed file changes or `timeout' has passed.
+ *
+ * PARAMETERS
+ *   `parser_job' Pointer to parser job.
+ *   `timeout' Maximum time to wait.
+ *
+ * RETURN VALUE
+ *   Returns 0 if the file changed, ETIMEDOUT if the timeout expired and a
+ *   negative value on error.
+ */
+int message_parser_wait(parser_job_data_t *parser_job, cdtime_t timeout);
+
 /*
  * NAME
  *   message_parser_cleanup
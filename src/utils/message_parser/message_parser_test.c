@@ -370,7 +370,8 @@ DEF_TEST(msg_parser_init) {
 
   sfree(job->messages_storage);
   sfree(job->message_patterns);
-  tail_match_destroy(job->tm);
+  match_set_destroy(job->matches);
+  cu_tail_destroy(job->tail);
   sfree(job);
 
   return 0;
@@ -412,13 +413,15 @@ DEF_TEST(msg_parser_read_2) {
   job->messages_completed = 0;
   job->message_patterns = patterns;
   job->message_patterns_len = TEST_PATTERNS_LEN;
-  job->tm = tail_match_create(job->filename);
+  job->tail = cu_tail_create(job->filename);
+  job->matches = match_set_create();
 
   int ret = message_parser_read(job, NULL, 0);
 
   EXPECT_EQ_INT(-1, ret);
 
-  tail_match_destroy(job->tm);
+  match_set_destroy(job->matches);
+  cu_tail_destroy(job->tail);
   sfree(job);
 
   return 0;
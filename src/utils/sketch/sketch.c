@@ -0,0 +1,241 @@
+/**
+ * collectd - src/utils/sketch/sketch.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/sketch/sketch.h"
+
+#include <float.h>
+#include <math.h>
+
+/* Buckets of one sign. counts[i] holds the number of values in bucket
+ * "offset + i"; only buckets min_index to max_index are in use. */
+typedef struct {
+  uint64_t *counts;
+  size_t size;
+  int32_t offset;
+
+  int32_t min_index;
+  int32_t max_index;
+  uint64_t count;
+} sketch_store_t;
+
+struct sketch_s {
+  double accuracy;
+  double gamma;
+  double log_gamma;
+
+  sketch_store_t positive;
+  sketch_store_t negative;
+  uint64_t zero_count;
+};
+
+static int32_t sketch_index(sketch_t const *s, double value) {
+  return (int32_t)ceil(log(value) / s->log_gamma);
+} /* int32_t sketch_index */
+
+/* Returns the value in the middle of a bucket, which is within the relative
+ * accuracy of all values counted in it. */
+static double sketch_value(sketch_t const *s, int32_t index) {
+  return 2.0 * pow(s->gamma, (double)index) / (s->gamma + 1.0);
+} /* double sketch_value */
+
+static int store_add(sketch_store_t *st, int32_t index, uint64_t n) {
+  int32_t lo = index;
+  int32_t hi = index;
+
+  if (st->count > 0) {
+    lo = (st->min_index < lo) ? st->min_index : lo;
+    hi = (st->max_index > hi) ? st->max_index : hi;
+  }
+  /* Collapse the lowest buckets if the range gets too wide. */
+  if ((int64_t)hi - (int64_t)lo >= SKETCH_MAX_BUCKETS)
+    lo = hi - SKETCH_MAX_BUCKETS + 1;
+
+  uint64_t collapsed = 0;
+  if ((st->counts == NULL) || (lo < st->offset) ||
+      ((int64_t)hi >= (int64_t)st->offset + (int64_t)st->size)) {
+    size_t size = 2 * ((size_t)(hi - lo) + 1);
+    if (size < 16)
+      size = 16;
+    if (size > SKETCH_MAX_BUCKETS)
+      size = SKETCH_MAX_BUCKETS;
+
+    /* Leave room in the direction the store is growing to. */
+    int32_t offset = lo;
+    if ((st->counts != NULL) && (lo < st->offset))
+      offset = hi - (int32_t)size + 1;
+
+    uint64_t *counts = calloc(size, sizeof(*counts));
+    if (counts == NULL)
+      return ENOMEM;
+
+    if (st->count > 0) {
+      for (int32_t i = st->min_index; i <= st->max_index; i++) {
+        uint64_t c = st->counts[i - st->offset];
+        if (i < lo)
+          collapsed += c;
+        else
+          counts[i - offset] = c;
+      }
+    }
+
+    free(st->counts);
+    st->counts = counts;
+    st->size = size;
+    st->offset = offset;
+  } else if (st->count > 0) {
+    for (int32_t i = st->min_index; (i < lo) && (i <= st->max_index); i++) {
+      collapsed += st->counts[i - st->offset];
+      st->counts[i - st->offset] = 0;
+    }
+  }
+
+  if (index < lo)
+    index = lo;
+  st->counts[lo - st->offset] += collapsed;
+  st->counts[index - st->offset] += n;
+  st->count += n;
+  st->min_index = lo;
+  st->max_index = hi;
+  return 0;
+} /* int store_add */
+
+static void store_reset(sketch_store_t *st) {
+  if (st->count > 0)
+    memset(st->counts + (st->min_index - st->offset), 0,
+           sizeof(*st->counts) * (size_t)(st->max_index - st->min_index + 1));
+  st->count = 0;
+} /* void store_reset */
+
+sketch_t *sketch_create(double relative_accuracy) {
+  if (!(relative_accuracy > 0.0) || !(relative_accuracy < 1.0))
+    return NULL;
+
+  sketch_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->accuracy = relative_accuracy;
+  s->gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+  s->log_gamma = log(s->gamma);
+  return s;
+} /* sketch_t *sketch_create */
+
+void sketch_destroy(sketch_t *s) {
+  if (s == NULL)
+    return;
+
+  free(s->positive.counts);
+  free(s->negative.counts);
+  free(s);
+} /* void sketch_destroy */
+
+int sketch_add(sketch_t *s, double value) {
+  if (!isfinite(value))
+    return 0;
+
+  if (fabs(value) < DBL_MIN) {
+    s->zero_count++;
+    return 0;
+  } else if (value > 0.0) {
+    return store_add(&s->positive, sketch_index(s, value), 1);
+  }
+  return store_add(&s->negative, sketch_index(s, -value), 1);
+} /* int sketch_add */
+
+int sketch_merge(sketch_t *dst, sketch_t const *src) {
+  if (dst->accuracy != src->accuracy)
+    return EINVAL;
+
+  sketch_store_t *dst_stores[] = {&dst->positive, &dst->negative};
+  sketch_store_t const *src_stores[] = {&src->positive, &src->negative};
+
+  for (size_t i = 0; i < 2; i++) {
+    sketch_store_t const *st = src_stores[i];
+    if (st->count == 0)
+      continue;
+
+    for (int32_t j = st->min_index; j <= st->max_index; j++) {
+      uint64_t c = st->counts[j - st->offset];
+      if (c == 0)
+        continue;
+
+      int status = store_add(dst_stores[i], j, c);
+      if (status != 0)
+        return status;
+    }
+  }
+
+  dst->zero_count += src->zero_count;
+  return 0;
+} /* int sketch_merge */
+
+void sketch_reset(sketch_t *s) {
+  store_reset(&s->positive);
+  store_reset(&s->negative);
+  s->zero_count = 0;
+} /* void sketch_reset */
+
+uint64_t sketch_count(sketch_t const *s) {
+  return s->positive.count + s->negative.count + s->zero_count;
+} /* uint64_t sketch_count */
+
+double sketch_percentile(sketch_t const *s, double percent) {
+  uint64_t count = sketch_count(s);
+  if (count == 0)
+    return NAN;
+
+  if (percent < 0.0)
+    percent = 0.0;
+  else if (percent > 100.0)
+    percent = 100.0;
+
+  /* Zero-based rank of the value to return. */
+  uint64_t rank = (uint64_t)(percent / 100.0 * (double)(count - 1));
+  uint64_t seen = 0;
+
+  /* Negative values, the biggest magnitude first. */
+  sketch_store_t const *st = &s->negative;
+  if (st->count > 0) {
+    for (int32_t i = st->max_index; i >= st->min_index; i--) {
+      seen += st->counts[i - st->offset];
+      if (seen > rank)
+        return -sketch_value(s, i);
+    }
+  }
+
+  seen += s->zero_count;
+  if (seen > rank)
+    return 0.0;
+
+  st = &s->positive;
+  for (int32_t i = st->min_index; i <= st->max_index; i++) {
+    seen += st->counts[i - st->offset];
+    if (seen > rank)
+      return sketch_value(s, i);
+  }
+
+  /* Not reached unless the counts are inconsistent. */
+  return sketch_value(s, st->max_index);
+} /* double sketch_percentile */
@@ -0,0 +1,109 @@
+/**
+ * collectd - src/utils/sketch/sketch.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SKETCH_H
+#define UTILS_SKETCH_H 1
+
+#include <stdint.h>
+
+/*
+ * A quantile sketch with relative error guarantees, as described in the
+ * "DDSketch" paper. Values are counted in logarithmically sized buckets, so a
+ * quantile is returned with a relative error of at most the accuracy the
+ * sketch was created with. Two sketches with the same accuracy can be merged
+ * by adding up their buckets, which allows to collect values in several
+ * sketches and combine them later.
+ *
+ * The number of buckets per sign is limited to SKETCH_MAX_BUCKETS. If values
+ * span a wider range, the lowest buckets are collapsed, i.e. only the
+ * quantiles of the smallest values lose accuracy. With an accuracy of 1%, this
+ * covers about 17 orders of magnitude.
+ */
+#define SKETCH_MAX_BUCKETS 2048
+
+struct sketch_s;
+typedef struct sketch_s sketch_t;
+
+/*
+ * NAME
+ *  sketch_create
+ * DESCRIPTION
+ *  Creates a new, empty sketch. `relative_accuracy' must be between zero and
+ *  one, exclusively; 0.01 means quantiles are accurate to within 1%.
+ */
+sketch_t *sketch_create(double relative_accuracy);
+
+/*
+ * NAME
+ *  sketch_destroy
+ */
+void sketch_destroy(sketch_t *s);
+
+/*
+ * NAME
+ *  sketch_add
+ * DESCRIPTION
+ *  Adds one value to the sketch. NaN and infinite values are ignored.
+ * RETURN VALUE
+ *  Zero on success, ENOMEM if growing the buckets failed.
+ */
+int sketch_add(sketch_t *s, double value);
+
+/*
+ * NAME
+ *  sketch_merge
+ * DESCRIPTION
+ *  Adds all values counted in `src' to `dst'. Both sketches must have been
+ *  created with the same accuracy.
+ * RETURN VALUE
+ *  Zero on success, EINVAL if the accuracies differ, ENOMEM if growing the
+ *  buckets failed.
+ */
+int sketch_merge(sketch_t *dst, sketch_t const *src);
+
+/*
+ * NAME
+ *  sketch_reset
+ * DESCRIPTION
+ *  Removes all values from the sketch, keeping the allocated buckets.
+ */
+void sketch_reset(sketch_t *s);
+
+/*
+ * NAME
+ *  sketch_count
+ * DESCRIPTION
+ *  Returns the number of values added to the sketch.
+ */
+uint64_t sketch_count(sketch_t const *s);
+
+/*
+ * NAME
+ *  sketch_percentile
+ * DESCRIPTION
+ *  Returns an estimate of the `percent'th percentile (0 to 100) of the values
+ *  added to the sketch, or NaN if the sketch is empty.
+ */
+double sketch_percentile(sketch_t const *s, double percent);
+
+#endif /* UTILS_SKETCH_H */
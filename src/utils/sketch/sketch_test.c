@@ -0,0 +1,156 @@
+/**
+ * collectd - src/utils/sketch/sketch_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+#include "utils/sketch/sketch.h"
+
+static bool within(double want, double got, double accuracy) {
+  return fabs(got - want) <= accuracy * fabs(want);
+}
+
+DEF_TEST(percentile) {
+  sketch_t *s;
+
+  CHECK_NOT_NULL(s = sketch_create(0.01));
+  OK(isnan(sketch_percentile(s, 50)));
+
+  /* 1 to 10000 in random order. */
+  int status = 0;
+  for (int i = 0; i < 10000; i++)
+    status |= sketch_add(s, (double)(((i * 7919) % 10000) + 1));
+  CHECK_ZERO(status);
+  CHECK_ZERO(sketch_add(s, NAN));
+  CHECK_ZERO(sketch_add(s, INFINITY));
+  EXPECT_EQ_UINT64(10000, sketch_count(s));
+
+  double percents[] = {0, 1, 25, 50, 90, 99, 99.9, 100};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percents); i++) {
+    double want = floor(percents[i] / 100.0 * 9999.0) + 1.0;
+    double got = sketch_percentile(s, percents[i]);
+
+    printf("## percentile %g: want %g, got %g\n", percents[i], want, got);
+    OK(within(want, got, 0.01));
+  }
+
+  sketch_reset(s);
+  EXPECT_EQ_UINT64(0, sketch_count(s));
+  OK(isnan(sketch_percentile(s, 50)));
+
+  sketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(signs) {
+  sketch_t *s;
+
+  CHECK_NOT_NULL(s = sketch_create(0.01));
+  /* -100 … -1, 0 (x 11), 1 … 100 */
+  int status = 0;
+  for (int i = 1; i <= 100; i++) {
+    status |= sketch_add(s, (double)i);
+    status |= sketch_add(s, -(double)i);
+  }
+  for (int i = 0; i <= 10; i++)
+    status |= sketch_add(s, 0.0);
+  CHECK_ZERO(status);
+
+  OK(within(-100.0, sketch_percentile(s, 0), 0.01));
+  /* rank 50.4 of 210 */
+  OK(within(-50.0, sketch_percentile(s, 24), 0.01));
+  EXPECT_EQ_DOUBLE(0.0, sketch_percentile(s, 50));
+  OK(within(100.0, sketch_percentile(s, 100), 0.01));
+
+  sketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(merge) {
+  sketch_t *parts[4];
+  sketch_t *all;
+  sketch_t *merged;
+
+  CHECK_NOT_NULL(all = sketch_create(0.02));
+  CHECK_NOT_NULL(merged = sketch_create(0.02));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++)
+    CHECK_NOT_NULL(parts[i] = sketch_create(0.02));
+
+  /* Each part sees a different range, as different CPUs or containers
+   * would. */
+  int status = 0;
+  for (int i = 0; i < 4000; i++) {
+    double v = 0.5 * (double)i - 100.0;
+    status |= sketch_add(all, v);
+    status |= sketch_add(parts[i / 1000], v);
+  }
+  CHECK_ZERO(status);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++)
+    CHECK_ZERO(sketch_merge(merged, parts[i]));
+
+  EXPECT_EQ_UINT64(sketch_count(all), sketch_count(merged));
+  for (double p = 0; p <= 100; p += 12.5)
+    EXPECT_EQ_DOUBLE(sketch_percentile(all, p), sketch_percentile(merged, p));
+
+  sketch_t *other;
+  CHECK_NOT_NULL(other = sketch_create(0.01));
+  EXPECT_EQ_INT(EINVAL, sketch_merge(merged, other));
+
+  sketch_destroy(other);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(parts); i++)
+    sketch_destroy(parts[i]);
+  sketch_destroy(merged);
+  sketch_destroy(all);
+  return 0;
+}
+
+DEF_TEST(collapse) {
+  sketch_t *s;
+
+  CHECK_NOT_NULL(s = sketch_create(0.01));
+  /* Spans far more than SKETCH_MAX_BUCKETS buckets. */
+  int status = 0;
+  for (int e = -300; e <= 300; e++)
+    status |= sketch_add(s, pow(10.0, (double)e));
+  CHECK_ZERO(status);
+  EXPECT_EQ_UINT64(601, sketch_count(s));
+
+  /* The high percentiles keep their accuracy. */
+  OK(within(1e300, sketch_percentile(s, 100), 0.01));
+  OK(within(1e290, sketch_percentile(s, 590.5 / 600.0 * 100.0), 0.01));
+  /* The lowest values have been collapsed into a bigger bucket. */
+  OK(sketch_percentile(s, 0) > 1e-300);
+
+  sketch_destroy(s);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(percentile);
+  RUN_TEST(signs);
+  RUN_TEST(merge);
+  RUN_TEST(collapse);
+
+  END_TEST;
+}
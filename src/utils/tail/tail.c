@@ -35,12 +35,65 @@
 #include "utils/common/common.h"
 #include "utils/tail/tail.h"
 
+#if HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include <poll.h>
+
+/* Size of a single read(2). The buffer grows beyond this if a line does not
+ * fit, up to CU_TAIL_MAX_LINE. Longer lines are split. */
+#define CU_TAIL_BLOCK_SIZE 65536
+#define CU_TAIL_MAX_LINE (1024 * 1024)
+
 struct cu_tail_s {
   char *file;
-  FILE *fh;
+  int fd;
   struct stat stat;
+  /* Offset of the end of the buffered data in the file. */
+  off_t offset;
+
+  /* Unconsumed data is buffer[pos] up to buffer[fill]. One byte is always
+   * kept free so that lines can be null-terminated in place. */
+  char *buffer;
+  size_t buffer_size;
+  size_t pos;
+  size_t fill;
+
+  int inotify_fd;
+  int watch_file;
+  int watch_dir;
+  char *dir;
+  char *base;
 };
 
+/* Returns true if `obj->file' was replaced (e.g. rotated) or truncated since
+ * it was opened. Lines still buffered must be handed out before reopening. */
+static bool cu_tail_changed(cu_tail_t *obj) {
+  struct stat stat_buf = {0};
+
+  if (stat(obj->file, &stat_buf) != 0)
+    return false;
+
+  return (stat_buf.st_ino != obj->stat.st_ino) ||
+         (stat_buf.st_dev != obj->stat.st_dev) ||
+         (stat_buf.st_size < obj->offset);
+} /* bool cu_tail_changed */
+
+#if HAVE_SYS_INOTIFY_H
+static void cu_tail_watch_file(cu_tail_t *obj) {
+  if (obj->inotify_fd < 0)
+    return;
+
+  if (obj->watch_file >= 0)
+    inotify_rm_watch(obj->inotify_fd, obj->watch_file);
+
+  /* The directory watch reports events by name only; this one keeps track of
+   * writes to a file that was renamed but is still being written to. */
+  obj->watch_file = inotify_add_watch(obj->inotify_fd, obj->file, IN_MODIFY);
+} /* void cu_tail_watch_file */
+#endif
+
 static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   int seek_end = 0;
   struct stat stat_buf = {0};
@@ -52,17 +105,21 @@ static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   }
 
   /* The file is already open.. */
-  if ((obj->fh != NULL) && (stat_buf.st_ino == obj->stat.st_ino)) {
-    /* Seek to the beginning if file was truncated */
-    if (stat_buf.st_size < obj->stat.st_size) {
+  if ((obj->fd >= 0) && (stat_buf.st_ino == obj->stat.st_ino) &&
+      (stat_buf.st_dev == obj->stat.st_dev)) {
+    /* Seek to the beginning if file was truncated, e.g. by `copytruncate' */
+    if (stat_buf.st_size < obj->offset) {
       P_INFO("utils_tail: File `%s' was truncated.", obj->file);
-      status = fseek(obj->fh, 0, SEEK_SET);
-      if (status != 0) {
-        P_ERROR("utils_tail: fseek (%s) failed: %s", obj->file, STRERRNO);
-        fclose(obj->fh);
-        obj->fh = NULL;
+      if (lseek(obj->fd, 0, SEEK_SET) == (off_t)-1) {
+        P_ERROR("utils_tail: lseek (%s) failed: %s", obj->file, STRERRNO);
+        close(obj->fd);
+        obj->fd = -1;
         return -1;
       }
+      obj->offset = 0;
+      obj->pos = obj->fill = 0;
+      memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
+      return 0;
     }
     memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
     return 1;
@@ -74,29 +131,132 @@ static int cu_tail_reopen(cu_tail_t *obj, bool force_rewind) {
   if ((obj->stat.st_ino == 0) || (obj->stat.st_ino == stat_buf.st_ino))
     seek_end = !force_rewind;
 
-  FILE *fh = fopen(obj->file, "r");
-  if (fh == NULL) {
-    P_ERROR("utils_tail: fopen (%s) failed: %s", obj->file, STRERRNO);
+  int fd = open(obj->file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    P_ERROR("utils_tail: open (%s) failed: %s", obj->file, STRERRNO);
     return -1;
   }
 
+  off_t offset = 0;
   if (seek_end != 0) {
-    status = fseek(fh, 0, SEEK_END);
-    if (status != 0) {
-      P_ERROR("utils_tail: fseek (%s) failed: %s", obj->file, STRERRNO);
-      fclose(fh);
+    offset = lseek(fd, 0, SEEK_END);
+    if (offset == (off_t)-1) {
+      P_ERROR("utils_tail: lseek (%s) failed: %s", obj->file, STRERRNO);
+      close(fd);
       return -1;
     }
   }
 
-  if (obj->fh != NULL)
-    fclose(obj->fh);
-  obj->fh = fh;
+  if (obj->fd >= 0)
+    close(obj->fd);
+  obj->fd = fd;
+  obj->offset = offset;
+  obj->pos = obj->fill = 0;
   memcpy(&obj->stat, &stat_buf, sizeof(struct stat));
 
+#if HAVE_SYS_INOTIFY_H
+  cu_tail_watch_file(obj);
+#endif
+
   return 0;
 } /* int cu_tail_reopen */
 
+/* Reads the next block from the file. Returns the number of bytes read, zero
+ * on EOF and -1 on error. */
+static ssize_t cu_tail_fill(cu_tail_t *obj) {
+  if (obj->pos > 0) {
+    memmove(obj->buffer, obj->buffer + obj->pos, obj->fill - obj->pos);
+    obj->fill -= obj->pos;
+    obj->pos = 0;
+  }
+
+  if ((obj->buffer_size - obj->fill) < (CU_TAIL_BLOCK_SIZE / 2)) {
+    size_t new_size = 2 * obj->buffer_size;
+    char *tmp = realloc(obj->buffer, new_size);
+    if (tmp == NULL) {
+      P_ERROR("utils_tail: realloc (%" PRIsz ") failed.", new_size);
+      return -1;
+    }
+    obj->buffer = tmp;
+    obj->buffer_size = new_size;
+  }
+
+  ssize_t status;
+  do {
+    status = read(obj->fd, obj->buffer + obj->fill,
+                  obj->buffer_size - obj->fill - 1);
+  } while ((status < 0) && (errno == EINTR));
+
+  if (status < 0) {
+    P_ERROR("utils_tail: read (%s) failed: %s", obj->file, STRERRNO);
+    return -1;
+  }
+
+  obj->fill += (size_t)status;
+  obj->offset += (off_t)status;
+  return status;
+} /* ssize_t cu_tail_fill */
+
+/* Returns the next line of at most `max_len' bytes, including the newline, in
+ * `ret_line' and `ret_len'. The line is not null-terminated. Returns 1 if a
+ * line was found, 0 on EOF and -1 on error. */
+static int cu_tail_next_line(cu_tail_t *obj, size_t max_len, char **ret_line,
+                             size_t *ret_len, bool force_rewind) {
+  if (obj->fd < 0) {
+    int status = cu_tail_reopen(obj, force_rewind);
+    if (status < 0)
+      return status;
+  }
+
+  while (42) {
+    char *line = obj->buffer + obj->pos;
+    size_t avail = obj->fill - obj->pos;
+    size_t len = 0;
+
+    char *newline = (avail > 0) ? memchr(line, '\n', avail) : NULL;
+    if (newline != NULL)
+      len = (size_t)(newline - line) + 1;
+    else if (avail >= max_len || avail >= CU_TAIL_MAX_LINE)
+      len = avail;
+
+    if (len > max_len)
+      len = max_len;
+    if (len > 0) {
+      obj->pos += len;
+      *ret_line = line;
+      *ret_len = len;
+      return 1;
+    }
+
+    ssize_t status = cu_tail_fill(obj);
+    if (status > 0)
+      continue;
+    if (status < 0) {
+      close(obj->fd);
+      obj->fd = -1;
+      return -1;
+    }
+
+    /* EOF. Hand out an incomplete last line only if the file is about to be
+     * replaced; otherwise wait for the rest of it. */
+    if (!cu_tail_changed(obj))
+      return 0;
+
+    if (avail > 0) {
+      obj->pos += avail;
+      *ret_line = line;
+      *ret_len = avail;
+      return 1;
+    }
+
+    int reopen_status = cu_tail_reopen(obj, force_rewind);
+    if (reopen_status < 0)
+      return reopen_status;
+    else if (reopen_status > 0)
+      return 0;
+  }
+} /* int cu_tail_next_line */
+
 cu_tail_t *cu_tail_create(const char *file) {
   cu_tail_t *obj;
 
@@ -110,14 +270,30 @@ cu_tail_t *cu_tail_create(const char *file) {
     return NULL;
   }
 
-  obj->fh = NULL;
+  obj->buffer = malloc(CU_TAIL_BLOCK_SIZE);
+  if (obj->buffer == NULL) {
+    free(obj->file);
+    free(obj);
+    return NULL;
+  }
+  obj->buffer_size = CU_TAIL_BLOCK_SIZE;
+
+  obj->fd = -1;
+  obj->inotify_fd = -1;
+  obj->watch_file = -1;
+  obj->watch_dir = -1;
 
   return obj;
 } /* cu_tail_t *cu_tail_create */
 
 int cu_tail_destroy(cu_tail_t *obj) {
-  if (obj->fh != NULL)
-    fclose(obj->fh);
+  if (obj->fd >= 0)
+    close(obj->fd);
+  if (obj->inotify_fd >= 0)
+    close(obj->inotify_fd);
+  free(obj->buffer);
+  free(obj->dir);
+  free(obj->base);
   free(obj->file);
   free(obj);
 
@@ -125,94 +301,50 @@ int cu_tail_destroy(cu_tail_t *obj) {
 } /* int cu_tail_destroy */
 
 int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen, bool force_rewind) {
-  int status;
+  char *line = NULL;
+  size_t len = 0;
 
   if (buflen < 1) {
     ERROR("utils_tail: cu_tail_readline: buflen too small: %i bytes.", buflen);
     return -1;
   }
 
-  if (obj->fh == NULL) {
-    status = cu_tail_reopen(obj, force_rewind);
-    if (status < 0)
-      return status;
-  }
-  assert(obj->fh != NULL);
-
-  /* Try to read from the filehandle. If that succeeds, everything appears to
-   * be fine and we can return. */
-  clearerr(obj->fh);
-  if (fgets(buf, buflen, obj->fh) != NULL) {
-    buf[buflen - 1] = '\0';
-    return 0;
-  }
-
-  /* Check if we encountered an error */
-  if (ferror(obj->fh) != 0) {
-    /* Jupp, error. Force `cu_tail_reopen' to reopen the file.. */
-    fclose(obj->fh);
-    obj->fh = NULL;
-  }
-  /* else: eof -> check if the file was moved away and reopen the new file if
-   * so.. */
-
-  status = cu_tail_reopen(obj, force_rewind);
-  /* error -> return with error */
+  int status =
+      cu_tail_next_line(obj, (size_t)buflen - 1, &line, &len, force_rewind);
   if (status < 0)
     return status;
-  /* file end reached and file not reopened -> nothing more to read */
-  else if (status > 0) {
-    buf[0] = 0;
-    return 0;
-  }
 
-  /* If we get here: file was re-opened and there may be more to read.. Let's
-   * try again. */
-  if (fgets(buf, buflen, obj->fh) != NULL) {
-    buf[buflen - 1] = '\0';
-    return 0;
-  }
-
-  if (ferror(obj->fh) != 0) {
-    WARNING("utils_tail: fgets (%s) returned an error: %s", obj->file,
-            STRERRNO);
-    fclose(obj->fh);
-    obj->fh = NULL;
-    return -1;
-  }
-
-  /* EOf, well, apparently the new file is empty.. */
-  buf[0] = 0;
+  if (status > 0)
+    memcpy(buf, line, len);
+  buf[len] = 0;
   return 0;
 } /* int cu_tail_readline */
 
-int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
-                 void *data, bool force_rewind) {
+int cu_tail_read(cu_tail_t *obj, tailfunc_t *callback, void *data,
+                 bool force_rewind) {
   int status;
 
   while (42) {
-    size_t len;
+    char *line = NULL;
+    size_t len = 0;
 
-    status = cu_tail_readline(obj, buf, buflen, force_rewind);
-    if (status != 0) {
-      ERROR("utils_tail: cu_tail_read: cu_tail_readline "
-            "failed.");
+    status = cu_tail_next_line(obj, SIZE_MAX, &line, &len, force_rewind);
+    if (status < 0) {
+      ERROR("utils_tail: cu_tail_read: reading `%s' failed.", obj->file);
       break;
     }
 
     /* check for EOF */
-    if (buf[0] == 0)
+    if (status == 0)
       break;
 
-    len = strlen(buf);
-    while (len > 0) {
-      if (buf[len - 1] != '\n')
-        break;
-      buf[len - 1] = '\0';
+    while ((len > 0) && (line[len - 1] == '\n'))
       len--;
-    }
+    /* Overwrites the newline or, for an incomplete line, the spare byte at the
+     * end of the buffer. */
+    line[len] = 0;
 
-    status = callback(data, buf, buflen);
+    status = callback(data, line, (int)len);
     if (status != 0) {
       ERROR("utils_tail: cu_tail_read: callback returned "
             "status %i.",
@@ -223,3 +355,229 @@ int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
 
   return status;
 } /* int cu_tail_read */
+
+static uint64_t cu_tail_count_lines(const char *buf, size_t len) {
+  const char *end = buf + len;
+  uint64_t lines = 0;
+
+  while ((buf = memchr(buf, '\n', (size_t)(end - buf))) != NULL) {
+    lines++;
+    buf++;
+  }
+  return lines;
+} /* uint64_t cu_tail_count_lines */
+
+int cu_tail_skip(cu_tail_t *obj, uint64_t max_backlog, uint64_t *ret_lines) {
+  struct stat stat_buf = {0};
+  uint64_t lines = 0;
+
+  *ret_lines = 0;
+
+  /* Nothing has been read yet, the first read decides where to start. */
+  if (obj->fd < 0)
+    return 0;
+
+  if (fstat(obj->fd, &stat_buf) != 0) {
+    P_ERROR("utils_tail: fstat (%s) failed: %s", obj->file, STRERRNO);
+    return -1;
+  }
+  /* Truncated: the next read starts over anyway. */
+  if (stat_buf.st_size < obj->offset)
+    return 0;
+
+  size_t buffered = obj->fill - obj->pos;
+  uint64_t backlog = (uint64_t)(stat_buf.st_size - obj->offset) + buffered;
+  if (backlog <= max_backlog)
+    return 0;
+
+  /* At least one byte is dropped, so `last' is always set below. */
+  off_t target = stat_buf.st_size - (off_t)max_backlog;
+  char last = 0;
+  if (target < obj->offset) {
+    /* Only part of the buffered data has to go. */
+    size_t len = (size_t)(target - (obj->offset - (off_t)buffered));
+    lines += cu_tail_count_lines(obj->buffer + obj->pos, len);
+    obj->pos += len;
+    last = obj->buffer[obj->pos - 1];
+  } else {
+    lines += cu_tail_count_lines(obj->buffer + obj->pos, buffered);
+    if (buffered > 0)
+      last = obj->buffer[obj->fill - 1];
+    obj->pos = obj->fill = 0;
+
+    /* Read instead of seeking, so that the skipped lines can be counted. */
+    while (obj->offset < target) {
+      size_t len = obj->buffer_size - 1;
+      if ((uint64_t)(target - obj->offset) < (uint64_t)len)
+        len = (size_t)(target - obj->offset);
+
+      ssize_t status;
+      do {
+        status = read(obj->fd, obj->buffer, len);
+      } while ((status < 0) && (errno == EINTR));
+
+      if (status < 0) {
+        P_ERROR("utils_tail: read (%s) failed: %s", obj->file, STRERRNO);
+        close(obj->fd);
+        obj->fd = -1;
+        return -1;
+      }
+      if (status == 0)
+        break;
+
+      lines += cu_tail_count_lines(obj->buffer, (size_t)status);
+      last = obj->buffer[status - 1];
+      obj->offset += (off_t)status;
+    }
+  }
+
+  /* Continue at the next line boundary. If the line is not complete yet, its
+   * remainder will be handed out as a line of its own. */
+  while (last != '\n') {
+    char *newline = (obj->fill > obj->pos)
+                        ? memchr(obj->buffer + obj->pos, '\n',
+                                 obj->fill - obj->pos)
+                        : NULL;
+    if (newline != NULL) {
+      obj->pos = (size_t)(newline - obj->buffer) + 1;
+      lines++;
+      break;
+    }
+
+    obj->pos = obj->fill;
+    ssize_t status = cu_tail_fill(obj);
+    if (status < 0) {
+      close(obj->fd);
+      obj->fd = -1;
+      return -1;
+    }
+    if (status == 0)
+      break;
+  }
+
+  *ret_lines = lines;
+  return 0;
+} /* int cu_tail_skip */
+
+#if HAVE_SYS_INOTIFY_H
+static int cu_tail_watch(cu_tail_t *obj) {
+  if (obj->inotify_fd >= 0)
+    return 0;
+
+  if (obj->dir == NULL) {
+    char *slash = strrchr(obj->file, '/');
+    if (slash == NULL) {
+      obj->dir = strdup(".");
+      obj->base = strdup(obj->file);
+    } else {
+      obj->dir = (slash == obj->file) ? strdup("/")
+                                      : sstrndup(obj->file, slash - obj->file);
+      obj->base = strdup(slash + 1);
+    }
+    if ((obj->dir == NULL) || (obj->base == NULL)) {
+      sfree(obj->dir);
+      sfree(obj->base);
+      return -1;
+    }
+  }
+
+  obj->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (obj->inotify_fd < 0) {
+    P_WARNING("utils_tail: inotify_init1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* Catches creation and rotation of the file as well as writes to it. */
+  obj->watch_dir =
+      inotify_add_watch(obj->inotify_fd, obj->dir,
+                        IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM |
+                            IN_DELETE);
+  if (obj->watch_dir < 0) {
+    P_WARNING("utils_tail: inotify_add_watch (%s) failed: %s", obj->dir,
+              STRERRNO);
+    close(obj->inotify_fd);
+    obj->inotify_fd = -1;
+    return -1;
+  }
+
+  obj->watch_file = -1;
+  if (obj->fd >= 0)
+    cu_tail_watch_file(obj);
+
+  return 0;
+} /* int cu_tail_watch */
+
+/* Reads all pending events. Returns true if any of them concerns the file. */
+static bool cu_tail_consume_events(cu_tail_t *obj) {
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = false;
+
+  while (42) {
+    ssize_t len = read(obj->inotify_fd, buffer, sizeof(buffer));
+    if (len <= 0)
+      break;
+
+    for (char *ptr = buffer; ptr < buffer + len;) {
+      struct inotify_event *event = (struct inotify_event *)ptr;
+
+      if ((event->mask & IN_Q_OVERFLOW) || (event->wd == obj->watch_file) ||
+          ((event->wd == obj->watch_dir) && (event->len > 0) &&
+           (strcmp(event->name, obj->base) == 0)))
+        changed = true;
+
+      ptr += sizeof(*event) + event->len;
+    }
+  }
+
+  return changed;
+} /* bool cu_tail_consume_events */
+#endif /* HAVE_SYS_INOTIFY_H */
+
+int cu_tail_fd(cu_tail_t *obj) {
+#if HAVE_SYS_INOTIFY_H
+  if (cu_tail_watch(obj) == 0)
+    return obj->inotify_fd;
+#endif
+  return -1;
+} /* int cu_tail_fd */
+
+/* cdtime() is mocked in tests and not monotonic, so the deadline is computed
+ * here. */
+static cdtime_t cu_tail_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TIMESPEC_TO_CDTIME_T(&ts);
+} /* cdtime_t cu_tail_now */
+
+int cu_tail_wait(cu_tail_t *obj, cdtime_t timeout) {
+  cdtime_t end = cu_tail_now() + timeout;
+
+#if HAVE_SYS_INOTIFY_H
+  if (cu_tail_watch(obj) == 0) {
+    while (42) {
+      if (cu_tail_consume_events(obj))
+        return 0;
+
+      cdtime_t now = cu_tail_now();
+      if (now >= end)
+        return ETIMEDOUT;
+
+      uint64_t timeout_ms = CDTIME_T_TO_MS(end - now) + 1;
+      struct pollfd pfd = {.fd = obj->inotify_fd, .events = POLLIN};
+      int status = poll(&pfd, 1, (timeout_ms > INT_MAX) ? INT_MAX
+                                                        : (int)timeout_ms);
+      if ((status < 0) && (errno != EINTR)) {
+        P_ERROR("utils_tail: poll failed: %s", STRERRNO);
+        return -1;
+      }
+    }
+  }
+#endif
+
+  /* No change notifications: the caller polls the file. */
+  struct timespec ts = CDTIME_T_TO_TIMESPEC(timeout);
+  while ((nanosleep(&ts, &ts) != 0) && (errno == EINTR))
+    ;
+  return ETIMEDOUT;
+} /* int cu_tail_wait */
@@ -32,9 +32,14 @@
 #ifndef UTILS_TAIL_H
 #define UTILS_TAIL_H 1
 
+#include "utils_time.h"
+
 struct cu_tail_s;
 typedef struct cu_tail_s cu_tail_t;
 
+/* Called for every line read by `cu_tail_read'. `buf' points into the
+ * internal read buffer and is only valid during the call; `buflen' is the
+ * length of the line, not counting the trailing null byte. */
 typedef int tailfunc_t(void *data, char *buf, int buflen);
 
 /*
@@ -69,20 +74,60 @@ int cu_tail_destroy(cu_tail_t *obj);
  *
  * You can check if the EOF condition is reached by looking at the buffer: If
  * the length of the string stored in the buffer is zero, EOF occurred.
- * Otherwise at least the newline character will be in the buffer.
+ * Otherwise at least the newline character will be in the buffer, unless the
+ * line was longer than `buflen' or the file was rotated in the middle of a
+ * line.
  *
  * Returns 0 when successful and non-zero otherwise.
  */
 int cu_tail_readline(cu_tail_t *obj, char *buf, int buflen, bool force_rewind);
 
 /*
- * cu_tail_readline
+ * cu_tail_read
  *
- * Reads from the file until eof condition or an error is encountered.
+ * Reads from the file until eof condition or an error is encountered and calls
+ * `callback' for every complete line, with the newline removed. Data is read
+ * in large blocks and lines are split in place, i.e. without copying them.
  *
  * Returns 0 when successful and non-zero otherwise.
  */
-int cu_tail_read(cu_tail_t *obj, char *buf, int buflen, tailfunc_t *callback,
-                 void *data, bool force_rewind);
+int cu_tail_read(cu_tail_t *obj, tailfunc_t *callback, void *data,
+                 bool force_rewind);
+
+/*
+ * cu_tail_skip
+ *
+ * Limits the amount of unread data to `max_backlog' bytes: if more has been
+ * appended to the file since the last read, the oldest data is dropped and
+ * reading continues at the next line boundary. The number of dropped lines is
+ * stored in `ret_lines'. Does nothing before the first read.
+ *
+ * Returns 0 when successful and non-zero otherwise.
+ */
+int cu_tail_skip(cu_tail_t *obj, uint64_t max_backlog, uint64_t *ret_lines);
+
+/*
+ * cu_tail_fd
+ *
+ * Returns a file descriptor which becomes readable when the file was written
+ * to, created, moved or removed, so that callers can wait for multiple files
+ * with poll(2). Use `cu_tail_wait' with a zero timeout to consume the events.
+ * Returns -1 if change notifications are not available on this system.
+ */
+int cu_tail_fd(cu_tail_t *obj);
+
+/*
+ * cu_tail_wait
+ *
+ * Waits until the file changes or `timeout' has passed. Changes are detected
+ * with inotify(7) on the file and its directory, so the caller wakes up as
+ * soon as a line has been appended or the file has been rotated. On systems
+ * without inotify this simply sleeps for `timeout'. Should be called after
+ * `cu_tail_read' or `cu_tail_readline' reached EOF.
+ *
+ * Returns 0 if the file changed, ETIMEDOUT if the timeout expired and a
+ * negative value on error.
+ */
+int cu_tail_wait(cu_tail_t *obj, cdtime_t timeout);
 
 #endif /* UTILS_TAIL_H */
@@ -0,0 +1,330 @@
+/**
+ * collectd - src/utils/tail/tail_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils/tail/tail.h"
+
+/* Size of the file read by the benchmark. The numbers quoted in the commit
+ * introducing it were measured with -DTAIL_BENCHMARK_SIZE=1073741824. */
+#ifndef TAIL_BENCHMARK_SIZE
+#define TAIL_BENCHMARK_SIZE (64 * 1024 * 1024)
+#endif
+
+static char dir[] = "/tmp/collectd_tail_test.XXXXXX";
+static char file[256];
+
+typedef struct {
+  char lines[8][64];
+  size_t num;
+} lines_t;
+
+static int collect_cb(void *data, char *buf, int buflen) {
+  lines_t *l = data;
+
+  if ((l->num >= STATIC_ARRAY_SIZE(l->lines)) || ((int)strlen(buf) != buflen))
+    return -1;
+
+  sstrncpy(l->lines[l->num], buf, sizeof(l->lines[l->num]));
+  l->num++;
+  return 0;
+}
+
+static int append(const char *path, const char *str) {
+  FILE *fh = fopen(path, "a");
+  if (fh == NULL)
+    return -1;
+  fputs(str, fh);
+  return fclose(fh);
+}
+
+DEF_TEST(read) {
+  lines_t l = {0};
+  cu_tail_t *t;
+
+  CHECK_ZERO(append(file, "old line\n"));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+
+  /* Without force_rewind, the first read starts at the end of the file. */
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(0, l.num);
+
+  /* Incomplete lines are held back until the newline arrives. */
+  CHECK_ZERO(append(file, "first\nsecond\nthi"));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(2, l.num);
+  CHECK_ZERO(append(file, "rd\n\n"));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(4, l.num);
+  EXPECT_EQ_STR("first", l.lines[0]);
+  EXPECT_EQ_STR("second", l.lines[1]);
+  EXPECT_EQ_STR("third", l.lines[2]);
+  EXPECT_EQ_STR("", l.lines[3]);
+
+  cu_tail_destroy(t);
+
+  /* force_rewind starts at the beginning. */
+  l.num = 0;
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, true));
+  EXPECT_EQ_INT(5, l.num);
+  EXPECT_EQ_STR("old line", l.lines[0]);
+  cu_tail_destroy(t);
+
+  unlink(file);
+  return 0;
+}
+
+DEF_TEST(truncate) {
+  lines_t l = {0};
+  cu_tail_t *t;
+
+  CHECK_ZERO(append(file, ""));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  CHECK_ZERO(append(file, "before rotation\n"));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  CHECK_ZERO(append(file, "copied but unterminated"));
+
+  /* logrotate's "copytruncate". */
+  CHECK_ZERO(truncate(file, 0));
+  CHECK_ZERO(append(file, "new\n"));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+
+  EXPECT_EQ_INT(2, l.num);
+  EXPECT_EQ_STR("before rotation", l.lines[0]);
+  EXPECT_EQ_STR("new", l.lines[1]);
+
+  cu_tail_destroy(t);
+  unlink(file);
+  return 0;
+}
+
+DEF_TEST(rotate) {
+  char rotated[sizeof(file) + 2];
+  lines_t l = {0};
+  cu_tail_t *t;
+
+  snprintf(rotated, sizeof(rotated), "%s.1", file);
+
+  CHECK_ZERO(append(file, ""));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  CHECK_ZERO(append(file, "one\n"));
+
+  /* Rename rotation: the old file is drained, including an incomplete last
+   * line, before the new one is read from the start. */
+  CHECK_ZERO(rename(file, rotated));
+  CHECK_ZERO(append(rotated, "two\nthree"));
+  CHECK_ZERO(append(file, "four\n"));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+
+  EXPECT_EQ_INT(4, l.num);
+  EXPECT_EQ_STR("one", l.lines[0]);
+  EXPECT_EQ_STR("two", l.lines[1]);
+  EXPECT_EQ_STR("three", l.lines[2]);
+  EXPECT_EQ_STR("four", l.lines[3]);
+
+  cu_tail_destroy(t);
+  unlink(rotated);
+  unlink(file);
+  return 0;
+}
+
+DEF_TEST(readline) {
+  char buffer[8];
+  cu_tail_t *t;
+
+  CHECK_ZERO(append(file, ""));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_readline(t, buffer, sizeof(buffer), false));
+  EXPECT_EQ_STR("", buffer);
+
+  /* Lines longer than the buffer are split. */
+  CHECK_ZERO(append(file, "0123456789\nabc\n"));
+  CHECK_ZERO(cu_tail_readline(t, buffer, sizeof(buffer), false));
+  EXPECT_EQ_STR("0123456", buffer);
+  CHECK_ZERO(cu_tail_readline(t, buffer, sizeof(buffer), false));
+  EXPECT_EQ_STR("789\n", buffer);
+  CHECK_ZERO(cu_tail_readline(t, buffer, sizeof(buffer), false));
+  EXPECT_EQ_STR("abc\n", buffer);
+  CHECK_ZERO(cu_tail_readline(t, buffer, sizeof(buffer), false));
+  EXPECT_EQ_STR("", buffer);
+
+  cu_tail_destroy(t);
+  unlink(file);
+  return 0;
+}
+
+DEF_TEST(wait) {
+  lines_t l = {0};
+  cu_tail_t *t;
+
+  CHECK_ZERO(append(file, ""));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+
+  if (cu_tail_fd(t) < 0) {
+    printf("inotify not available, skipping\n");
+    cu_tail_destroy(t);
+    unlink(file);
+    return 0;
+  }
+
+  EXPECT_EQ_INT(ETIMEDOUT, cu_tail_wait(t, MS_TO_CDTIME_T(10)));
+
+  CHECK_ZERO(append(file, "wake up\n"));
+  EXPECT_EQ_INT(0, cu_tail_wait(t, TIME_T_TO_CDTIME_T(10)));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(1, l.num);
+
+  /* Creating the file after a rotation wakes the reader, too. */
+  CHECK_ZERO(unlink(file));
+  EXPECT_EQ_INT(0, cu_tail_wait(t, TIME_T_TO_CDTIME_T(10)));
+  CHECK_ZERO(append(file, "recreated\n"));
+  EXPECT_EQ_INT(0, cu_tail_wait(t, TIME_T_TO_CDTIME_T(10)));
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(2, l.num);
+  EXPECT_EQ_STR("recreated", l.lines[1]);
+
+  cu_tail_destroy(t);
+  unlink(file);
+  return 0;
+}
+
+DEF_TEST(skip) {
+  lines_t l = {0};
+  uint64_t skipped = 1;
+  cu_tail_t *t;
+
+  CHECK_ZERO(append(file, "not read yet\n"));
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+
+  /* The file is not open yet: nothing to skip. */
+  CHECK_ZERO(cu_tail_skip(t, 1, &skipped));
+  EXPECT_EQ_UINT64(0, skipped);
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+
+  CHECK_ZERO(append(file, "a\nb\nc\nddd\neeee\n"));
+  CHECK_ZERO(cu_tail_skip(t, 15, &skipped));
+  EXPECT_EQ_UINT64(0, skipped);
+
+  /* Cut in the middle of "ddd": the rest of it is skipped, too. */
+  CHECK_ZERO(cu_tail_skip(t, 7, &skipped));
+  EXPECT_EQ_UINT64(4, skipped);
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(1, l.num);
+  EXPECT_EQ_STR("eeee", l.lines[0]);
+
+  /* Cut at a line boundary. */
+  CHECK_ZERO(append(file, "x\ny\n"));
+  CHECK_ZERO(cu_tail_skip(t, 2, &skipped));
+  EXPECT_EQ_UINT64(1, skipped);
+  CHECK_ZERO(cu_tail_read(t, collect_cb, &l, false));
+  EXPECT_EQ_INT(2, l.num);
+  EXPECT_EQ_STR("y", l.lines[1]);
+
+  cu_tail_destroy(t);
+  unlink(file);
+  return 0;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+static int count_cb(void *data, char *buf, int buflen) {
+  uint64_t *bytes = data;
+  *bytes += (uint64_t)buflen + 1;
+  return 0;
+}
+
+/* Writes and reads 64 MiB. Only runs when "--benchmark" is passed. */
+DEF_TEST(benchmark) {
+  char line[256];
+  uint64_t written = 0;
+  FILE *fh;
+
+  CHECK_NOT_NULL(fh = fopen(file, "w"));
+  for (uint64_t i = 0; written < TAIL_BENCHMARK_SIZE; i++) {
+    int len = snprintf(line, sizeof(line),
+                       "Nov 23 13:16:46 host%03" PRIu64 " sshd[%" PRIu64
+                       "]: Accepted publickey for user%" PRIu64
+                       " from 192.0.2.%" PRIu64 " port %" PRIu64 "\n",
+                       i % 1000, 1000 + i % 30000, i % 77, i % 254,
+                       1024 + i % 60000);
+    fwrite(line, 1, (size_t)len, fh);
+    written += (uint64_t)len;
+  }
+  fclose(fh);
+
+  /* Baseline: what the previous implementation did per line. */
+  uint64_t bytes = 0;
+  CHECK_NOT_NULL(fh = fopen(file, "r"));
+  double start = now_seconds();
+  while (fgets(line, sizeof(line), fh) != NULL)
+    bytes += strlen(line);
+  double fgets_time = now_seconds() - start;
+  fclose(fh);
+  EXPECT_EQ_UINT64(written, bytes);
+
+  cu_tail_t *t;
+  bytes = 0;
+  CHECK_NOT_NULL(t = cu_tail_create(file));
+  start = now_seconds();
+  CHECK_ZERO(cu_tail_read(t, count_cb, &bytes, true));
+  double tail_time = now_seconds() - start;
+  cu_tail_destroy(t);
+  EXPECT_EQ_UINT64(written, bytes);
+
+  printf("%" PRIu64 " MiB: fgets %.0f MiB/s, cu_tail_read %.0f MiB/s\n",
+         written >> 20, (double)(written >> 20) / fgets_time,
+         (double)(written >> 20) / tail_time);
+
+  unlink(file);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", STRERRNO);
+    return 1;
+  }
+  snprintf(file, sizeof(file), "%s/test.log", dir);
+
+  RUN_TEST(read);
+  RUN_TEST(truncate);
+  RUN_TEST(rotate);
+  RUN_TEST(readline);
+  RUN_TEST(wait);
+  RUN_TEST(skip);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(benchmark);
+
+  rmdir(dir);
+  END_TEST;
+}
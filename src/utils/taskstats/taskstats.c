@@ -31,14 +31,26 @@
 #include <linux/genetlink.h>
 #include <linux/taskstats.h>
 
+/* Number of requests sent by ts_delay_by_tgids() before reading responses.
+ * Limited so that the responses fit into the socket's receive buffer. */
+#define TS_BATCH_WINDOW 32
+
 struct ts_s {
   struct mnl_socket *nl;
   pid_t pid;
   uint32_t seq;
   uint16_t genl_id_taskstats;
   unsigned int port_id;
+  /* CPU mask registered by ts_listen(), NULL otherwise. */
+  char *cpumask;
 };
 
+typedef struct {
+  uint32_t id;
+  struct taskstats stats;
+  bool valid;
+} ts_aggr_t;
+
 /* nlmsg_errno returns the errno encoded in nlh or zero if not an error. */
 static int nlmsg_errno(struct nlmsghdr *nlh, size_t sz) {
   if (!mnl_nlmsg_ok(nlh, (int)sz)) {
@@ -93,16 +105,14 @@ static int get_taskstats_msg_cb(const struct nlmsghdr *nlh, void *data) {
                         data);
 }
 
-static int get_taskstats(ts_t *ts, uint32_t tgid,
-                         struct taskstats *ret_taskstats) {
-  char buffer[MNL_SOCKET_BUFFER_SIZE];
-  uint32_t seq = ts->seq++;
-
+/* put_request writes the header of a TASKSTATS_CMD_GET request to buffer. */
+static struct nlmsghdr *put_request(ts_t *ts, void *buffer, uint16_t flags,
+                                    uint32_t seq) {
   struct nlmsghdr *nlh = mnl_nlmsg_put_header(buffer);
   *nlh = (struct nlmsghdr){
       .nlmsg_len = nlh->nlmsg_len,
       .nlmsg_type = ts->genl_id_taskstats,
-      .nlmsg_flags = NLM_F_REQUEST,
+      .nlmsg_flags = flags,
       .nlmsg_seq = seq,
       .nlmsg_pid = ts->pid,
   };
@@ -113,6 +123,16 @@ static int get_taskstats(ts_t *ts, uint32_t tgid,
       .version = TASKSTATS_GENL_VERSION, // or TASKSTATS_VERSION?
   };
 
+  return nlh;
+}
+
+static int get_taskstats(ts_t *ts, uint32_t tgid,
+                         struct taskstats *ret_taskstats) {
+  char buffer[MNL_SOCKET_BUFFER_SIZE];
+  uint32_t seq = ts->seq++;
+
+  struct nlmsghdr *nlh = put_request(ts, buffer, NLM_F_REQUEST, seq);
+
   // mnl_attr_put_u32(nlh, TASKSTATS_CMD_ATTR_PID, tgid);
   mnl_attr_put_u32(nlh, TASKSTATS_CMD_ATTR_TGID, tgid);
 
@@ -240,11 +260,18 @@ static int get_family_id(ts_t *ts) {
   return 0;
 }
 
+static int send_cpumask(ts_t *ts, uint16_t type, char const *cpumask);
+
 void ts_destroy(ts_t *ts) {
   if (ts == NULL) {
     return;
   }
 
+  if (ts->cpumask != NULL) {
+    send_cpumask(ts, TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK, ts->cpumask);
+    sfree(ts->cpumask);
+  }
+
   if (ts->nl != NULL) {
     mnl_socket_close(ts->nl);
     ts->nl = NULL;
@@ -285,6 +312,15 @@ ts_t *ts_create(void) {
   return ts;
 }
 
+static ts_delay_t delay_from_taskstats(struct taskstats const *raw) {
+  return (ts_delay_t){
+      .cpu_ns = raw->cpu_delay_total,
+      .blkio_ns = raw->blkio_delay_total,
+      .swapin_ns = raw->swapin_delay_total,
+      .freepages_ns = raw->freepages_delay_total,
+  };
+}
+
 int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
   if ((ts == NULL) || (out == NULL)) {
     return EINVAL;
@@ -297,11 +333,274 @@ int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out) {
     return status;
   }
 
-  *out = (ts_delay_t){
-      .cpu_ns = raw.cpu_delay_total,
-      .blkio_ns = raw.blkio_delay_total,
-      .swapin_ns = raw.swapin_delay_total,
-      .freepages_ns = raw.freepages_delay_total,
-  };
+  *out = delay_from_taskstats(&raw);
   return 0;
 }
+
+/* read_batch reads the responses to the "num" requests starting with sequence
+ * number "seq". Responses to earlier, failed batches are ignored. */
+static int read_batch(ts_t *ts, uint32_t seq, size_t num, ts_delay_t *out,
+                      int *ret_status) {
+  char buffer[MNL_SOCKET_BUFFER_SIZE];
+  size_t pending = num;
+
+  while (pending > 0) {
+    ssize_t status = mnl_socket_recvfrom(ts->nl, buffer, sizeof(buffer));
+    if (status < 0) {
+      status = errno;
+      if (status == EINTR) {
+        continue;
+      }
+      ERROR("utils_taskstats: mnl_socket_recvfrom() = %s", STRERROR(status));
+      return (int)status;
+    } else if (status == 0) {
+      ERROR("utils_taskstats: mnl_socket_recvfrom() = 0");
+      return ECONNABORTED;
+    }
+
+    int len = (int)status;
+    for (struct nlmsghdr *nlh = (void *)buffer; mnl_nlmsg_ok(nlh, len);
+         nlh = mnl_nlmsg_next(nlh, &len)) {
+      uint32_t idx = nlh->nlmsg_seq - seq;
+      if ((idx >= num) || (ret_status[idx] != EINPROGRESS)) {
+        continue;
+      }
+      pending--;
+
+      if (nlh->nlmsg_type == NLMSG_ERROR) {
+        ret_status[idx] = nlmsg_errno(nlh, (size_t)nlh->nlmsg_len);
+        continue;
+      }
+
+      struct taskstats raw = {0};
+      if (mnl_attr_parse(nlh, sizeof(struct genlmsghdr), get_taskstats_attr_cb,
+                         &raw) < MNL_CB_STOP) {
+        ret_status[idx] = EPROTO;
+        continue;
+      }
+
+      out[idx] = delay_from_taskstats(&raw);
+      ret_status[idx] = 0;
+    }
+  }
+
+  return 0;
+}
+
+int ts_delay_by_tgids(ts_t *ts, uint32_t const *tgids, size_t num,
+                      ts_delay_t *out, int *ret_status) {
+  if (ts == NULL) {
+    return EINVAL;
+  }
+  if ((num > 0) && ((tgids == NULL) || (out == NULL) || (ret_status == NULL))) {
+    return EINVAL;
+  }
+
+  char buffer[MNL_SOCKET_BUFFER_SIZE];
+
+  for (size_t i = 0; i < num; i++) {
+    ret_status[i] = EINPROGRESS;
+  }
+
+  for (size_t offset = 0; offset < num; offset += TS_BATCH_WINDOW) {
+    size_t batch_num = num - offset;
+    if (batch_num > TS_BATCH_WINDOW) {
+      batch_num = TS_BATCH_WINDOW;
+    }
+
+    uint32_t seq = ts->seq;
+    ts->seq += (uint32_t)batch_num;
+
+    int status = 0;
+    for (size_t i = 0; i < batch_num; i++) {
+      struct nlmsghdr *nlh =
+          put_request(ts, buffer, NLM_F_REQUEST, seq + (uint32_t)i);
+      mnl_attr_put_u32(nlh, TASKSTATS_CMD_ATTR_TGID, tgids[offset + i]);
+
+      if (mnl_socket_sendto(ts->nl, nlh, nlh->nlmsg_len) < 0) {
+        status = errno;
+        ERROR("utils_taskstats: mnl_socket_sendto() = %s", STRERROR(status));
+        batch_num = i;
+        break;
+      }
+    }
+
+    if (batch_num > 0) {
+      int read_status = read_batch(ts, seq, batch_num, out + offset,
+                                   ret_status + offset);
+      if (status == 0) {
+        status = read_status;
+      }
+    }
+
+    if (status != 0) {
+      for (size_t i = offset; i < num; i++) {
+        if (ret_status[i] == EINPROGRESS) {
+          ret_status[i] = status;
+        }
+      }
+      return status;
+    }
+  }
+
+  return 0;
+}
+
+/* send_cpumask registers or deregisters (depending on "type") the socket for
+ * the exit statistics of tasks on the CPUs in "cpumask". */
+static int send_cpumask(ts_t *ts, uint16_t type, char const *cpumask) {
+  char buffer[MNL_SOCKET_BUFFER_SIZE];
+  uint32_t seq = ts->seq++;
+
+  struct nlmsghdr *nlh =
+      put_request(ts, buffer, NLM_F_REQUEST | NLM_F_ACK, seq);
+  mnl_attr_put_strz(nlh, type, cpumask);
+
+  if (mnl_socket_sendto(ts->nl, nlh, nlh->nlmsg_len) < 0) {
+    int status = errno;
+    ERROR("utils_taskstats: mnl_socket_sendto() = %s", STRERROR(status));
+    return status;
+  }
+
+  /* Exit records may arrive before the acknowledgement. */
+  while (42) {
+    int status = mnl_socket_recvfrom(ts->nl, buffer, sizeof(buffer));
+    if (status < 0) {
+      status = errno;
+      ERROR("utils_taskstats: mnl_socket_recvfrom() = %s", STRERROR(status));
+      return status;
+    } else if (status == 0) {
+      return ECONNABORTED;
+    }
+
+    int len = status;
+    for (struct nlmsghdr *ack = (void *)buffer; mnl_nlmsg_ok(ack, len);
+         ack = mnl_nlmsg_next(ack, &len)) {
+      if ((ack->nlmsg_type == NLMSG_ERROR) && (ack->nlmsg_seq == seq)) {
+        return nlmsg_errno(ack, (size_t)ack->nlmsg_len);
+      }
+    }
+  }
+}
+
+int ts_listen(ts_t *ts, char const *cpumask) {
+  if ((ts == NULL) || (cpumask == NULL) || (ts->cpumask != NULL)) {
+    return EINVAL;
+  }
+
+  /* Exit records are only read once per interval. */
+  int rcvbuf = 1024 * 1024;
+  if (setsockopt(mnl_socket_get_fd(ts->nl), SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                 sizeof(rcvbuf)) != 0) {
+    WARNING("utils_taskstats: setsockopt(SO_RCVBUF) = %s", STRERRNO);
+  }
+
+  int status =
+      send_cpumask(ts, TASKSTATS_CMD_ATTR_REGISTER_CPUMASK, cpumask);
+  if (status != 0) {
+    ERROR("utils_taskstats: TASKSTATS_CMD_ATTR_REGISTER_CPUMASK(\"%s\") = %s",
+          cpumask, STRERROR(status));
+    return status;
+  }
+
+  ts->cpumask = strdup(cpumask);
+  if (ts->cpumask == NULL) {
+    send_cpumask(ts, TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK, cpumask);
+    return ENOMEM;
+  }
+
+  return 0;
+}
+
+static int get_aggr_attr_cb(const struct nlattr *attr, void *data) {
+  ts_aggr_t *aggr = data;
+
+  switch (mnl_attr_get_type(attr)) {
+  case TASKSTATS_TYPE_PID: /* fall through */
+  case TASKSTATS_TYPE_TGID:
+    if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0) {
+      return MNL_CB_ERROR;
+    }
+    aggr->id = mnl_attr_get_u32(attr);
+    return MNL_CB_OK;
+
+  case TASKSTATS_TYPE_STATS: {
+    /* The kernel's struct may be larger than ours. */
+    size_t len = mnl_attr_get_payload_len(attr);
+    if (len > sizeof(aggr->stats)) {
+      len = sizeof(aggr->stats);
+    }
+    memcpy(&aggr->stats, mnl_attr_get_payload(attr), len);
+    aggr->valid = true;
+    return MNL_CB_OK;
+  }
+  }
+
+  return MNL_CB_OK;
+}
+
+static int get_exit_attr_cb(const struct nlattr *attr, void *data) {
+  ts_aggr_t *aggr = data;
+
+  switch (mnl_attr_get_type(attr)) {
+  case TASKSTATS_TYPE_AGGR_PID:
+    return mnl_attr_parse_nested(attr, get_aggr_attr_cb, &aggr[0]);
+  case TASKSTATS_TYPE_AGGR_TGID:
+    return mnl_attr_parse_nested(attr, get_aggr_attr_cb, &aggr[1]);
+  }
+
+  return MNL_CB_OK;
+}
+
+int ts_read_exits(ts_t *ts, ts_exit_callback_t callback, void *user_data) {
+  if ((ts == NULL) || (ts->cpumask == NULL) || (callback == NULL)) {
+    return EINVAL;
+  }
+
+  char buffer[MNL_SOCKET_BUFFER_SIZE];
+  int fd = mnl_socket_get_fd(ts->nl);
+  int ret = 0;
+
+  while (42) {
+    ssize_t status = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (status < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        return ret;
+      } else if (errno == ENOBUFS) {
+        /* The kernel has dropped records, read the remaining ones. */
+        ret = ENOBUFS;
+        continue;
+      }
+      return errno;
+    } else if (status == 0) {
+      return ret;
+    }
+
+    int len = (int)status;
+    for (struct nlmsghdr *nlh = (void *)buffer; mnl_nlmsg_ok(nlh, len);
+         nlh = mnl_nlmsg_next(nlh, &len)) {
+      if (nlh->nlmsg_type != ts->genl_id_taskstats) {
+        continue;
+      }
+
+      /* [0] is the exiting task, [1] its thread group if it was the last
+       * task of the group. */
+      ts_aggr_t aggr[2] = {0};
+      if (mnl_attr_parse(nlh, sizeof(struct genlmsghdr), get_exit_attr_cb,
+                         aggr) < MNL_CB_STOP) {
+        continue;
+      }
+
+      bool thread_group = aggr[1].valid;
+      ts_aggr_t *a = thread_group ? &aggr[1] : &aggr[0];
+      if (!a->valid) {
+        continue;
+      }
+
+      ts_delay_t delay = delay_from_taskstats(&a->stats);
+      callback(a->id, thread_group, &delay, user_data);
+    }
+  }
+}
@@ -44,4 +44,29 @@ void ts_destroy(ts_t *);
  * identified by tgid. Returns zero on success and an errno otherwise. */
 int ts_delay_by_tgid(ts_t *ts, uint32_t tgid, ts_delay_t *out);
 
+/* ts_delay_by_tgids returns delay accounting information for "num" thread
+ * groups. Several requests are sent before the responses are read, so that
+ * the cost of the netlink round-trips is shared. On return, ret_status[i] is
+ * zero if out[i] has been filled and an errno otherwise. Returns zero unless
+ * communicating with the kernel failed. */
+int ts_delay_by_tgids(ts_t *ts, uint32_t const *tgids, size_t num,
+                      ts_delay_t *out, int *ret_status);
+
+/* ts_listen registers ts for the statistics of tasks exiting on the CPUs in
+ * "cpumask", for example "0-127". A handle in listener mode must only be used
+ * with ts_read_exits(). */
+int ts_listen(ts_t *ts, char const *cpumask);
+
+/* ts_exit_callback_t is called for every exited task. If thread_group is true,
+ * "id" is a TGID and "delay" holds the totals of the whole thread group.
+ * Otherwise, "id" is the PID of a single task, which is also the TGID of a
+ * single-threaded process. */
+typedef void (*ts_exit_callback_t)(uint32_t id, bool thread_group,
+                                   ts_delay_t const *delay, void *user_data);
+
+/* ts_read_exits calls "callback" for all exit records received by a handle
+ * in listener mode, without blocking. Returns ENOBUFS if records have been
+ * lost, zero on success and an errno otherwise. */
+int ts_read_exits(ts_t *ts, ts_exit_callback_t callback, void *user_data);
+
 #endif /* UTILS_TASKSTATS_H */
@@ -3162,6 +3162,6 @@ static int lv_shutdown(void) {
 
 void module_register(void) {
   plugin_register_complex_config("virt", lv_config);
-  plugin_register_init(PLUGIN_NAME, lv_init);
+  plugin_register_parallel_init(PLUGIN_NAME, lv_init);
   plugin_register_shutdown(PLUGIN_NAME, lv_shutdown);
 }
@@ -0,0 +1,458 @@
+/**
+ * collectd - src/write_columnar.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+/*
+ * Stores values in compressed, append-only files, one per hour. See
+ * src/utils/columnar/columnar.h for the file format and collectd-columnar(1)
+ * for a tool to read the files.
+ */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/avltree/avltree.h"
+#include "utils/columnar/columnar.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+#define WC_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define WC_DEFAULT_FLUSH_INTERVAL TIME_T_TO_CDTIME_T_STATIC(300)
+/* Blocks kept for retrying while writing fails, in units of BlockSize. */
+#define WC_MAX_PENDING_BLOCKS 16
+
+/*
+ * Private variables
+ */
+static char *datadir;
+static bool store_rates;
+static size_t block_size = WC_DEFAULT_BLOCK_SIZE;
+static cdtime_t flush_interval = WC_DEFAULT_FLUSH_INTERVAL;
+
+static pthread_mutex_t wc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Maps identifiers to series. The series are also kept in an array, ordered
+ * by id, which is what the block writer needs. */
+static c_avl_tree_t *wc_tree;
+static columnar_series_t **wc_series;
+static cdtime_t *wc_last_update;
+static size_t wc_series_num;
+
+/* Series [0, wc_dict_done) have been written to the current file's
+ * dictionary. */
+static size_t wc_dict_done;
+static bool wc_dict_reset;
+
+static int wc_fd = -1;
+static time_t wc_hour;
+static size_t wc_buffered;
+static cdtime_t wc_last_flush;
+static columnar_buf_t wc_out;
+
+/* Drops blocks that could not be written. Later blocks may refer to series
+ * defined in them, so the next block starts the dictionary afresh. */
+static void wc_drop_pending_nolock(void) /* {{{ */
+{
+  if (wc_out.len == 0)
+    return;
+
+  ERROR("write_columnar plugin: Dropping %" PRIsz " bytes of values that "
+        "could not be written.",
+        wc_out.len);
+  wc_out.len = 0;
+  wc_dict_reset = true;
+  wc_dict_done = 0;
+} /* }}} void wc_drop_pending_nolock */
+
+static int wc_flush_nolock(void) /* {{{ */
+{
+  int flags = wc_dict_reset ? COLUMNAR_FLAG_DICT_RESET : 0;
+  size_t dict_num = wc_series_num - wc_dict_done;
+  off_t offset;
+  int status;
+
+  if (wc_fd < 0)
+    return 0;
+
+  /* The block is appended to the ones a failed write left in "wc_out". */
+  if ((wc_buffered != 0) || (dict_num != 0)) {
+    status = columnar_block_write(&wc_out, flags, wc_series + wc_dict_done,
+                                  dict_num, wc_series, wc_series_num);
+    if (status != 0) {
+      ERROR("write_columnar plugin: Encoding block failed: %s",
+            STRERROR(status));
+      return status;
+    }
+    /* The series' columns have been reset by columnar_block_write(). The
+     * block carries the new dictionary entries from now on. */
+    wc_buffered = 0;
+    wc_dict_done = wc_series_num;
+    wc_dict_reset = false;
+  }
+
+  if (wc_out.len == 0)
+    return 0;
+  wc_last_flush = cdtime();
+
+  /* A partially written block would hide all following blocks from readers,
+   * so cut it off again on failure and keep the blocks for the next flush. */
+  offset = lseek(wc_fd, 0, SEEK_END);
+  status = swrite(wc_fd, wc_out.data, wc_out.len);
+  if (status != 0) {
+    ERROR("write_columnar plugin: Writing %" PRIsz " bytes failed: %s",
+          wc_out.len, STRERRNO);
+    if ((offset >= 0) && (ftruncate(wc_fd, offset) != 0))
+      WARNING("write_columnar plugin: ftruncate failed: %s", STRERRNO);
+    if (wc_out.len >= WC_MAX_PENDING_BLOCKS * block_size)
+      wc_drop_pending_nolock();
+    return -1;
+  }
+
+  wc_out.len = 0;
+  return 0;
+} /* }}} int wc_flush_nolock */
+
+static void wc_close_nolock(void) /* {{{ */
+{
+  if (wc_fd < 0)
+    return;
+
+  /* The blocks refer to the dictionary of this file, so they can't be
+   * written to the next one. */
+  if (wc_flush_nolock() != 0)
+    wc_drop_pending_nolock();
+  close(wc_fd);
+  wc_fd = -1;
+} /* }}} void wc_close_nolock */
+
+/* Forgets series which have not been updated since "older_than". Called when
+ * switching to a new file, where ids can be reassigned because the dictionary
+ * starts afresh. */
+static void wc_expire_nolock(cdtime_t older_than) /* {{{ */
+{
+  size_t j = 0;
+
+  for (size_t i = 0; i < wc_series_num; i++) {
+    columnar_series_t *s = wc_series[i];
+
+    if (wc_last_update[i] < older_than) {
+      c_avl_remove(wc_tree, s->name, NULL, NULL);
+      columnar_series_destroy(s);
+      continue;
+    }
+
+    s->id = (uint64_t)j;
+    wc_series[j] = s;
+    wc_last_update[j] = wc_last_update[i];
+    j++;
+  }
+
+  if (j < wc_series_num) {
+    DEBUG("write_columnar plugin: Expired %" PRIsz " series.",
+          wc_series_num - j);
+  }
+  wc_series_num = j;
+} /* }}} void wc_expire_nolock */
+
+static int wc_open_nolock(time_t hour) /* {{{ */
+{
+  char filename[PATH_MAX];
+  struct tm tm;
+  time_t t = hour * 3600;
+  struct stat statbuf;
+  int status;
+
+  if (gmtime_r(&t, &tm) == NULL)
+    return -1;
+
+  status = snprintf(filename, sizeof(filename),
+                    "%s/%04i-%02i-%02i-%02i.columnar",
+                    (datadir != NULL) ? datadir : ".", tm.tm_year + 1900,
+                    tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
+  if ((status < 0) || ((size_t)status >= sizeof(filename))) {
+    ERROR("write_columnar plugin: File name too long.");
+    return -1;
+  }
+
+  if (check_create_dir(filename) != 0)
+    return -1;
+
+  wc_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (wc_fd < 0) {
+    ERROR("write_columnar plugin: open (%s) failed: %s", filename, STRERRNO);
+    return -1;
+  }
+
+  if (fstat(wc_fd, &statbuf) != 0) {
+    ERROR("write_columnar plugin: fstat (%s) failed: %s", filename, STRERRNO);
+    close(wc_fd);
+    wc_fd = -1;
+    return -1;
+  }
+
+  if (statbuf.st_size == 0) {
+    status = swrite(wc_fd, COLUMNAR_FILE_MAGIC, COLUMNAR_FILE_MAGIC_SIZE);
+    if (status != 0) {
+      ERROR("write_columnar plugin: Writing header to %s failed: %s",
+            filename, STRERRNO);
+      close(wc_fd);
+      wc_fd = -1;
+      return -1;
+    }
+  }
+
+  /* Also when appending to an existing file: the dictionary written before
+   * may not match the current ids. */
+  wc_dict_reset = true;
+  wc_dict_done = 0;
+  wc_hour = hour;
+  wc_last_flush = cdtime();
+  return 0;
+} /* }}} int wc_open_nolock */
+
+static columnar_series_t *wc_series_get_nolock(const data_set_t *ds, /* {{{ */
+                                               const value_list_t *vl,
+                                               size_t *ret_index) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  columnar_series_t *s = NULL;
+  int types[ds->ds_num];
+  const char *names[ds->ds_num];
+
+  if (FORMAT_VL(name, sizeof(name), vl) != 0)
+    return NULL;
+
+  if (c_avl_get(wc_tree, name, (void *)&s) == 0) {
+    *ret_index = (size_t)s->id;
+    return s;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    types[i] = store_rates ? COLUMNAR_DS_GAUGE : ds->ds[i].type;
+    names[i] = ds->ds[i].name;
+  }
+
+  columnar_series_t **tmp_series =
+      realloc(wc_series, (wc_series_num + 1) * sizeof(*wc_series));
+  if (tmp_series == NULL)
+    return NULL;
+  wc_series = tmp_series;
+
+  cdtime_t *tmp_update =
+      realloc(wc_last_update, (wc_series_num + 1) * sizeof(*wc_last_update));
+  if (tmp_update == NULL)
+    return NULL;
+  wc_last_update = tmp_update;
+
+  s = columnar_series_create((uint64_t)wc_series_num, name, ds->ds_num, types,
+                             names);
+  if (s == NULL)
+    return NULL;
+
+  if (c_avl_insert(wc_tree, s->name, s) != 0) {
+    columnar_series_destroy(s);
+    return NULL;
+  }
+
+  wc_series[wc_series_num] = s;
+  wc_last_update[wc_series_num] = 0;
+  *ret_index = wc_series_num;
+  wc_series_num++;
+
+  return s;
+} /* }}} columnar_series_t *wc_series_get_nolock */
+
+static int wc_append_nolock(const data_set_t *ds, /* {{{ */
+                            const value_list_t *vl) {
+  columnar_value_t values[ds->ds_num];
+  columnar_series_t *s;
+  gauge_t *rates = NULL;
+  size_t index = 0;
+  size_t size_before;
+  int status;
+
+  s = wc_series_get_nolock(ds, vl, &index);
+  if (s == NULL) {
+    ERROR("write_columnar plugin: Creating series for %s/%s failed.",
+          vl->plugin, vl->type);
+    return ENOMEM;
+  }
+
+  if (s->ds_num != ds->ds_num) {
+    ERROR("write_columnar plugin: Series \"%s\" has %" PRIsz
+          " data sources, got %" PRIsz ".",
+          s->name, s->ds_num, ds->ds_num);
+    return EINVAL;
+  }
+
+  if (store_rates) {
+    rates = uc_get_rate(ds, vl);
+    if (rates == NULL) {
+      ERROR("write_columnar plugin: uc_get_rate failed.");
+      return -1;
+    }
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    if (rates != NULL)
+      values[i].gauge = rates[i];
+    else if (ds->ds[i].type == DS_TYPE_GAUGE)
+      values[i].gauge = vl->values[i].gauge;
+    else if (ds->ds[i].type == DS_TYPE_COUNTER)
+      values[i].counter = (uint64_t)vl->values[i].counter;
+    else if (ds->ds[i].type == DS_TYPE_DERIVE)
+      values[i].derive = vl->values[i].derive;
+    else
+      values[i].absolute = vl->values[i].absolute;
+  }
+  sfree(rates);
+
+  size_before = columnar_series_size(s);
+  status = columnar_series_append(s, (int64_t)CDTIME_T_TO_MS(vl->time),
+                                  values);
+  if (status != 0) {
+    ERROR("write_columnar plugin: Appending to \"%s\" failed: %s", s->name,
+          STRERROR(status));
+    return status;
+  }
+
+  wc_buffered += columnar_series_size(s) - size_before;
+  wc_last_update[index] = vl->time;
+  return 0;
+} /* }}} int wc_append_nolock */
+
+static int wc_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
+                    user_data_t __attribute__((unused)) * user_data) {
+  time_t hour = CDTIME_T_TO_TIME_T(vl->time) / 3600;
+  int status;
+
+  if (0 != strcmp(ds->type, vl->type)) {
+    ERROR("write_columnar plugin: DS type does not match value list type");
+    return -1;
+  }
+
+  pthread_mutex_lock(&wc_lock);
+
+  if (wc_tree == NULL) {
+    wc_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (wc_tree == NULL) {
+      pthread_mutex_unlock(&wc_lock);
+      return ENOMEM;
+    }
+  }
+
+  /* Values arriving late for the previous hour go into the current file;
+   * their timestamps are stored exactly either way. */
+  if ((wc_fd < 0) || (hour > wc_hour)) {
+    wc_close_nolock();
+    wc_expire_nolock(TIME_T_TO_CDTIME_T((hour - 1) * 3600));
+    if (wc_open_nolock(hour) != 0) {
+      pthread_mutex_unlock(&wc_lock);
+      return -1;
+    }
+  }
+
+  status = wc_append_nolock(ds, vl);
+
+  if ((status == 0) && ((wc_buffered >= block_size) ||
+                        ((cdtime() - wc_last_flush) >= flush_interval)))
+    status = wc_flush_nolock();
+
+  pthread_mutex_unlock(&wc_lock);
+  return status;
+} /* }}} int wc_write */
+
+static int wc_flush(cdtime_t __attribute__((unused)) timeout, /* {{{ */
+                    const char __attribute__((unused)) * identifier,
+                    user_data_t __attribute__((unused)) * user_data) {
+  int status;
+
+  pthread_mutex_lock(&wc_lock);
+  status = wc_flush_nolock();
+  pthread_mutex_unlock(&wc_lock);
+
+  return status;
+} /* }}} int wc_flush */
+
+static int wc_shutdown(void) /* {{{ */
+{
+  pthread_mutex_lock(&wc_lock);
+
+  wc_close_nolock();
+
+  for (size_t i = 0; i < wc_series_num; i++)
+    columnar_series_destroy(wc_series[i]);
+  sfree(wc_series);
+  sfree(wc_last_update);
+  wc_series_num = 0;
+
+  if (wc_tree != NULL) {
+    c_avl_destroy(wc_tree);
+    wc_tree = NULL;
+  }
+
+  columnar_buf_free(&wc_out);
+  sfree(datadir);
+
+  pthread_mutex_unlock(&wc_lock);
+  return 0;
+} /* }}} int wc_shutdown */
+
+static int wc_config(oconfig_item_t *ci) /* {{{ */
+{
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+    int status = 0;
+
+    if (strcasecmp("DataDir", child->key) == 0) {
+      status = cf_util_get_string(child, &datadir);
+      if (status == 0) {
+        size_t len = strlen(datadir);
+        while ((len > 1) && (datadir[len - 1] == '/'))
+          datadir[--len] = 0;
+      }
+    } else if (strcasecmp("StoreRates", child->key) == 0) {
+      status = cf_util_get_boolean(child, &store_rates);
+    } else if (strcasecmp("FlushInterval", child->key) == 0) {
+      status = cf_util_get_cdtime(child, &flush_interval);
+    } else if (strcasecmp("BlockSize", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1024)) {
+        ERROR("write_columnar plugin: BlockSize must be at least 1024.");
+        status = -1;
+      }
+      if (status == 0)
+        block_size = (size_t)tmp;
+    } else {
+      ERROR("write_columnar plugin: Invalid configuration option: `%s'.",
+            child->key);
+      status = -1;
+    }
+
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int wc_config */
+
+void module_register(void) {
+  plugin_register_complex_config("write_columnar", wc_config);
+  plugin_register_write("write_columnar", wc_write, /* user_data = */ NULL);
+  plugin_register_flush("write_columnar", wc_flush, /* user_data = */ NULL);
+  plugin_register_shutdown("write_columnar", wc_shutdown);
+} /* void module_register */
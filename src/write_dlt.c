@@ -5,21 +5,20 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/match/match.h"
 
 #include "utils/format_graphite/format_graphite.h"
 #include "utils/format_json/format_json.h"
 
 #include "dlt/dlt.h"
 
-#if HAVE_REGEX_H
-#include <regex.h>
-#endif
-
 #define WL_BUF_SIZE 16384
 #define WL_CONTEXT_MAX 100
 #define WL_FORMAT_GRAPHITE 1
 #define WL_FORMAT_JSON 2
+#define WL_ROUTE_CACHE_MAX 65536
 
 /* ************************************************************************** */
 /* constants */
@@ -100,217 +99,256 @@ void wdlt_context_clear() {
 }
 
 /* ************************************************************************** */
-/* level list */
+/* routing rules */
 /* ************************************************************************** */
 
-typedef struct level_entry_s {
-#if HAVE_REGEX_H
-  regex_t *re;
-#endif
+typedef struct wdlt_rule_s {
+  bool is_level;
   DltLogLevelType dlt_level;
-  struct level_entry_s* _next;
-} level_entry_t;
+  DltContext* dlt_context;
+} wdlt_rule_t;
 
-static level_entry_t* level_list_begin = NULL;
-static level_entry_t* level_list_end = NULL;
+typedef struct wdlt_route_s {
+  DltLogLevelType dlt_level;
+  DltContext* dlt_context;
+  bool have_level;
+  bool have_context;
+} wdlt_route_t;
 
-/* -------------------------------------------------------------------------- */
-static void wdlt_level_list_add(const char* regexp, const char* level) {
-    int status;
+/* All "MatchLevel" and "MatchContext" expressions in configuration order.
+ * They are combined into one set, so that a message is scanned once instead
+ * of once per rule. */
+static cu_match_set_t* wdlt_rules = NULL;
 
-    level_entry_t* level_entry = malloc(sizeof(level_entry_t));
-    if (level_entry == NULL) {
-      ERROR("%s: level_list_add: malloc failed.", wdlt_name);
-      return ;
-    }
+/* Route being computed by the match_set_apply() call in progress. The set
+ * uses a shared scratch buffer, so applying the rules requires the write lock
+ * of wdlt_route_lock. Looking up cached routes only requires the read lock. */
+static wdlt_route_t* wdlt_route_current = NULL;
+static pthread_rwlock_t wdlt_route_lock = PTHREAD_RWLOCK_INITIALIZER;
 
-#if HAVE_REGEX_H
-  if (regexp != NULL) {
-    level_entry->re = calloc(1, sizeof(*level_entry->re));
-    if (level_entry->re == NULL) {
-      ERROR("%s: level_list_add: calloc failed.", wdlt_name);
-      sfree(level_entry);
-      return;
-    }
+static void wdlt_cache_flush(void);
 
-    status = regcomp(level_entry->re, regexp, REG_EXTENDED | REG_NOSUB);
-    if (status != 0) {
-      DEBUG("%s: compiling the regular expression \"%s\" failed.",
-            wdlt_name, regexp);
-      regfree(level_entry->re);
-      sfree(level_entry);
-      return;
-    }
+/* -------------------------------------------------------------------------- */
+static int wdlt_rule_cb(__attribute__((unused)) const char* str,
+                        __attribute__((unused)) char* const* matches,
+                        __attribute__((unused)) size_t matches_num,
+                        void* user_data) {
+  wdlt_rule_t* rule = user_data;
+  wdlt_route_t* route = wdlt_route_current;
+
+  /* The first matching rule of each kind wins. */
+  if (rule->is_level && !route->have_level) {
+    route->dlt_level = rule->dlt_level;
+    route->have_level = true;
+  } else if (!rule->is_level && !route->have_context) {
+    route->dlt_context = rule->dlt_context;
+    route->have_context = true;
+  }
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void wdlt_rule_add(const char* regexp, wdlt_rule_t* rule) {
+  pthread_rwlock_wrlock(&wdlt_route_lock);
+  if (wdlt_rules == NULL) {
+    wdlt_rules = match_set_create();
   }
-#else
-  if (regexp != NULL) {
-    ERROR("%s: ps_list_register: "
-          "Regular expression \"%s\" found in config "
-          "file, but support for regular expressions "
-          "has been disabled at compile time.",
+  if ((wdlt_rules == NULL) ||
+      (match_set_add(wdlt_rules, regexp, NULL, wdlt_rule_cb, rule, free) < 0)) {
+    ERROR("%s: adding the regular expression \"%s\" failed.",
           wdlt_name, regexp);
-    sfree(level_entry);
-    return;
+    sfree(rule);
   }
-#endif
+  /* Cached routes were computed without this rule. */
+  wdlt_cache_flush();
+  pthread_rwlock_unlock(&wdlt_route_lock);
+}
 
-    level_entry->dlt_level = DLT_LOG_INFO;
+/* -------------------------------------------------------------------------- */
+static void wdlt_level_list_add(const char* regexp, const char* level) {
+    wdlt_rule_t* rule = calloc(1, sizeof(*rule));
+    if (rule == NULL) {
+      ERROR("%s: level_list_add: calloc failed.", wdlt_name);
+      return ;
+    }
+    rule->is_level = true;
+
+    rule->dlt_level = DLT_LOG_INFO;
     if (level != NULL) {
       if(strcasecmp(level, "DEFAULT") == 0) {
-        level_entry->dlt_level = DLT_LOG_DEFAULT;
+        rule->dlt_level = DLT_LOG_DEFAULT;
       } else if(strcasecmp(level, "OFF") == 0) {
-        level_entry->dlt_level = DLT_LOG_OFF;
+        rule->dlt_level = DLT_LOG_OFF;
       } else if(strcasecmp(level, "FATAL") == 0) {
-        level_entry->dlt_level = DLT_LOG_FATAL;
+        rule->dlt_level = DLT_LOG_FATAL;
       } else if(strcasecmp(level, "ERROR") == 0) {
-        level_entry->dlt_level = DLT_LOG_ERROR;
+        rule->dlt_level = DLT_LOG_ERROR;
       } else if(strcasecmp(level, "WARN") == 0) {
-        level_entry->dlt_level = DLT_LOG_WARN;
+        rule->dlt_level = DLT_LOG_WARN;
       } else if(strcasecmp(level, "INFO") == 0) {
-        level_entry->dlt_level = DLT_LOG_INFO;
+        rule->dlt_level = DLT_LOG_INFO;
       } else if(strcasecmp(level, "DEBUG") == 0) {
-        level_entry->dlt_level = DLT_LOG_DEBUG;
+        rule->dlt_level = DLT_LOG_DEBUG;
       } else if(strcasecmp(level, "VERBOSE") == 0) {
-        level_entry->dlt_level = DLT_LOG_VERBOSE;
+        rule->dlt_level = DLT_LOG_VERBOSE;
       }
     }
-      
+
     DEBUG("%s: add DLT level match '%s' --> %s (%d)", 
-          wdlt_name, regexp, level, level_entry->dlt_level);
-    if (level_list_begin == NULL) {
-      level_list_begin = level_entry;
-      level_list_end = level_entry;
-    } else {
-      level_list_end->_next = level_entry;      
-      level_list_end = level_entry;      
+          wdlt_name, regexp, level, rule->dlt_level);
+    wdlt_rule_add(regexp, rule);
+}
+
+/* -------------------------------------------------------------------------- */
+static void wdlt_context_list_add(const char* regexp, const char* context) {
+    wdlt_rule_t* rule = calloc(1, sizeof(*rule));
+    if (rule == NULL) {
+      ERROR("%s: context_list_add: calloc failed.", wdlt_name);
+      return ;
     }
 
+    rule->dlt_context = wdlt_context_get(context, "dynamic");
+    DEBUG("%s: add DLT context match '%s' --> %s", 
+          wdlt_name, regexp, context);
+    wdlt_rule_add(regexp, rule);
 }
 
 /* -------------------------------------------------------------------------- */
-static void wdlt_level_list_clear() {
-  DEBUG("%s: level_list_clear: begin", wdlt_name);
-  while (level_list_begin != NULL) {
-    level_entry_t* level_entry_to_delete = level_list_begin;
-    level_list_begin = level_entry_to_delete->_next;
-    regfree(level_entry_to_delete->re);
-    free(level_entry_to_delete);
-  }
-  level_list_end = NULL;
+static void wdlt_rule_clear() {
+  DEBUG("%s: rule_clear: begin", wdlt_name);
+  pthread_rwlock_wrlock(&wdlt_route_lock);
+  match_set_destroy(wdlt_rules);
+  wdlt_rules = NULL;
+  wdlt_cache_flush();
+  pthread_rwlock_unlock(&wdlt_route_lock);
 }
 
 /* -------------------------------------------------------------------------- */
-static DltLogLevelType wdlt_level_list_get(const char* message) {
-#if HAVE_REGEX_H
-  level_entry_t* me;
-  for (me = level_list_begin; me != NULL; me = me->_next) {
-    if (me->re == NULL) {
-      continue;
-    }
-    if (regexec(me->re, message, 0, NULL, 0) == 0) {
-      return me->dlt_level;
-    }
+/* Applies all rules to "message". The caller must hold the write lock of
+ * wdlt_route_lock. */
+static void wdlt_route_match(const char* message, DltContext* def,
+                             wdlt_route_t* route) {
+  *route = (wdlt_route_t){
+    .dlt_level = DLT_LOG_INFO,
+    .dlt_context = def,
+  };
+  if (wdlt_rules == NULL) {
+    return;
   }
-#endif
-  return DLT_LOG_INFO;
+
+  wdlt_route_current = route;
+  match_set_apply(wdlt_rules, message);
+  wdlt_route_current = NULL;
 }
 
 
 /* ************************************************************************** */
-/* context list */
+/* route cache */
 /* ************************************************************************** */
 
-typedef struct context_entry_s {
-#if HAVE_REGEX_H
-  regex_t *re;
-#endif
-  DltContext* dlt_context;
-  struct context_entry_s* _next;
-} context_entry_t;
+/* Routing decisions per series, keyed by the value list identifier the rules
+ * are applied to. */
+typedef struct wdlt_cache_entry_s {
+  wdlt_route_t route;
+  char identifier[];
+} wdlt_cache_entry_t;
 
-static context_entry_t* context_list_begin = NULL;
-static context_entry_t* context_list_end = NULL;
+static c_avl_tree_t* wdlt_cache = NULL;
 
 /* -------------------------------------------------------------------------- */
-static void wdlt_context_list_add(const char* regexp, const char* context) {
-    int status;
+/* The caller must hold the write lock of wdlt_route_lock. */
+static void wdlt_cache_flush(void) {
+  void* key;
+  void* value;
 
-    context_entry_t* context_entry = calloc(1, sizeof(context_entry_t));
-    if (context_entry == NULL) {
-      ERROR("%s: context_list_add: malloc failed.", wdlt_name);
-      return ;
-    }
+  if (wdlt_cache == NULL) {
+    return;
+  }
+  /* The key is part of the entry. */
+  while (c_avl_pick(wdlt_cache, &key, &value) == 0) {
+    free(value);
+  }
+}
 
-#if HAVE_REGEX_H
-  if (regexp != NULL) {
-    context_entry->re = calloc(1, sizeof(*context_entry->re));
-    if (context_entry->re == NULL) {
-      ERROR("%s: context_list_add: calloc failed.", wdlt_name);
-      sfree(context_entry);
-      return;
-    }
+/* -------------------------------------------------------------------------- */
+static void wdlt_cache_destroy(void) {
+  pthread_rwlock_wrlock(&wdlt_route_lock);
+  wdlt_cache_flush();
+  c_avl_destroy(wdlt_cache);
+  wdlt_cache = NULL;
+  pthread_rwlock_unlock(&wdlt_route_lock);
+}
 
-    status = regcomp(context_entry->re, regexp, REG_EXTENDED | REG_NOSUB);
-    if (status != 0) {
-      DEBUG("%s: compiling the regular expression \"%s\" failed.",
-            wdlt_name, regexp);
-      regfree(context_entry->re);
-      sfree(context_entry);
+/* -------------------------------------------------------------------------- */
+/* Caches "route" for "identifier". The caller must hold the write lock of
+ * wdlt_route_lock. */
+static void wdlt_cache_insert(const char* identifier,
+                              const wdlt_route_t* route) {
+  if (wdlt_cache == NULL) {
+    wdlt_cache = c_avl_create((int (*)(const void*, const void*))strcmp);
+    if (wdlt_cache == NULL) {
       return;
     }
   }
-#else
-  if (regexp != NULL) {
-    ERROR("%s: ps_list_register: "
-          "Regular expression \"%s\" found in config "
-          "file, but support for regular expressions "
-          "has been disabled at compile time.",
-          wdlt_name, regexp);
-    sfree(context_entry);
-    return;
+
+  /* Bound the memory used by short-lived series. */
+  if (c_avl_size(wdlt_cache) >= WL_ROUTE_CACHE_MAX) {
+    DEBUG("%s: route cache is full, flushing it", wdlt_name);
+    wdlt_cache_flush();
   }
-#endif
 
-    context_entry->dlt_context = wdlt_context_get(context, "dynamic");
-    DEBUG("%s: add DLT context match '%s' --> %s", 
-          wdlt_name, regexp, context);
-      
-    if (context_list_begin == NULL) {
-      context_list_begin = context_entry;
-      context_list_end = context_entry;
-    } else {
-      context_list_end->_next = context_entry;      
-      context_list_end = context_entry;      
-    }
+  size_t len = strlen(identifier);
+  wdlt_cache_entry_t* entry = malloc(sizeof(*entry) + len + 1);
+  if (entry == NULL) {
+    return;
+  }
+  entry->route = *route;
+  memcpy(entry->identifier, identifier, len + 1);
 
+  if (c_avl_insert(wdlt_cache, entry->identifier, entry) != 0) {
+    free(entry);
+  }
 }
 
 /* -------------------------------------------------------------------------- */
-static void wdlt_context_list_clear() {
-  DEBUG("%s: context_list_clear: begin", wdlt_name);
-  while (context_list_begin != NULL) {
-    context_entry_t* context_entry_to_delete = context_list_begin;
-    context_list_begin = context_entry_to_delete->_next;
-    regfree(context_entry_to_delete->re);
-    free(context_entry_to_delete);
+/* Looks up the route of the series "vl" belongs to. The rules are applied to
+ * the identifier of the series, e.g. "host/plugin-instance/type-instance", so
+ * the route does not depend on the values or the output format. */
+static void wdlt_route_get(const value_list_t* vl, DltContext* def,
+                           wdlt_route_t* route) {
+  char identifier[6 * DATA_MAX_NAME_LEN];
+  wdlt_cache_entry_t* entry;
+
+  if (FORMAT_VL(identifier, sizeof(identifier), vl) != 0) {
+    ERROR("%s: formatting the identifier failed.", wdlt_name);
+    *route = (wdlt_route_t){.dlt_level = DLT_LOG_INFO, .dlt_context = def};
+    return;
   }
-  context_list_end = NULL;
-}
 
-/* -------------------------------------------------------------------------- */
-static DltContext* wdlt_context_list_get(const char* message, DltContext* def) {
-#if HAVE_REGEX_H
-  context_entry_t* me;
-  for (me = context_list_begin; me != NULL; me = me->_next) {
-    if (me->re == NULL) {
-      continue;
-    }
-    if (regexec(me->re, message, 0, NULL, 0) == 0) {
-      return me->dlt_context;
-    }
+  pthread_rwlock_rdlock(&wdlt_route_lock);
+  if (wdlt_rules == NULL) {
+    *route = (wdlt_route_t){.dlt_level = DLT_LOG_INFO, .dlt_context = def};
+    pthread_rwlock_unlock(&wdlt_route_lock);
+    return;
+  }
+  if ((wdlt_cache != NULL) &&
+      (c_avl_get(wdlt_cache, identifier, (void*)&entry) == 0)) {
+    *route = entry->route;
+    pthread_rwlock_unlock(&wdlt_route_lock);
+    return;
   }
-#endif
-  return def;
+  pthread_rwlock_unlock(&wdlt_route_lock);
+
+  /* Another thread may have added the series in the meantime. */
+  pthread_rwlock_wrlock(&wdlt_route_lock);
+  if ((wdlt_cache != NULL) &&
+      (c_avl_get(wdlt_cache, identifier, (void*)&entry) == 0)) {
+    *route = entry->route;
+  } else {
+    wdlt_route_match(identifier, def, route);
+    wdlt_cache_insert(identifier, route);
+  }
+  pthread_rwlock_unlock(&wdlt_route_lock);
 }
 
 
@@ -333,10 +371,10 @@ static int wdlt_write_graphite(const data_set_t *ds, const value_list_t *vl) {
   if (status != 0) /* error message has been printed already. */
     return status;
 
-  DltLogLevelType dlt_level = wdlt_level_list_get(buffer);
-  DltContext* dlt_context = wdlt_context_list_get(buffer, graphiteContext);
-  if (dlt_context != NULL) {
-    DLT_LOG(*dlt_context, dlt_level, DLT_STRING(buffer));
+  wdlt_route_t route;
+  wdlt_route_get(vl, graphiteContext, &route);
+  if (route.dlt_context != NULL) {
+    DLT_LOG(*route.dlt_context, route.dlt_level, DLT_STRING(buffer));
   }
   return 0;
 }
@@ -344,23 +382,31 @@ static int wdlt_write_graphite(const data_set_t *ds, const value_list_t *vl) {
 
 /* -------------------------------------------------------------------------- */
 static int wdlt_write_json(const data_set_t *ds, const value_list_t *vl) {
-  char buffer[WL_BUF_SIZE] = {0};
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
+  json_buffer_t *buffer;
+  int status;
 
   if (0 != strcmp(ds->type, vl->type)) {
     ERROR("%s: DS type does not match value list type", wdlt_name);
     return -1;
   }
 
-  format_json_initialize(buffer, &bfill, &bfree);
-  format_json_value_list(buffer, &bfill, &bfree, ds, vl, 0);
-  format_json_finalize(buffer, &bfill, &bfree);
+  buffer = json_buffer_thread();
+  if (buffer == NULL) {
+    ERROR("%s: json_buffer_thread failed.", wdlt_name);
+    return ENOMEM;
+  }
+
+  status = json_buffer_value_list(buffer, ds, vl, 0);
+  if (status != 0) {
+    ERROR("%s: Formatting JSON failed with status %i.", wdlt_name, status);
+    return status;
+  }
+  json_buffer_finalize(buffer);
 
-  DltLogLevelType dlt_level = wdlt_level_list_get(buffer);
-  DltContext* dlt_context = wdlt_context_list_get(buffer, jsonContext);
-  if (dlt_context != NULL) {
-    DLT_LOG(*dlt_context, dlt_level, DLT_STRING(buffer));
+  wdlt_route_t route;
+  wdlt_route_get(vl, jsonContext, &route);
+  if (route.dlt_context != NULL) {
+    DLT_LOG(*route.dlt_context, route.dlt_level, DLT_STRING(buffer->data));
   }
 
   return 0;
@@ -488,8 +534,8 @@ static int wdlt_init()
 /* -------------------------------------------------------------------------- */
 static int wdlt_shutdown()
 {
-  wdlt_level_list_clear();
-  wdlt_context_list_clear();
+  wdlt_rule_clear();
+  wdlt_cache_destroy();
   wdlt_context_clear();
 
   INFO("write_dlt: unregister app with '%s'.", wdlt_appid);
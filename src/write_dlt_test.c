@@ -38,22 +38,165 @@ static int teardown(void) {
 
 /* -------------------------------------------------------------------------- */
 DEF_TEST(level_matching) {
-  DltLogLevelType level;
+  wdlt_route_t route;
   if (setup() == 0) {
-    level = wdlt_level_list_get("abc");
-    EXPECT_EQ_INT(DLT_LOG_INFO, level);
+    wdlt_route_match("abc", graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_INFO, route.dlt_level);
+    OK(route.dlt_context == graphiteContext);
+
+    wdlt_level_list_add("^abc", "WARN");
+    wdlt_level_list_add("b", "ERROR");
+    wdlt_route_match("abc", graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_WARN, route.dlt_level);
+    wdlt_route_match("xbc", graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_ERROR, route.dlt_level);
+    OK(route.dlt_context == graphiteContext);
+  }
+  teardown();
+
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+DEF_TEST(route_cache) {
+  value_list_t vl = {
+    .host = "example.com",
+    .plugin = "cpu",
+    .plugin_instance = "0",
+    .type = "cpu",
+    .type_instance = "idle",
+  };
+  wdlt_route_t route;
+
+  if (setup() == 0) {
+    wdlt_context_list_add("^example\\.com/cpu-", "CPU");
+    wdlt_level_list_add("/cpu-idle$", "DEBUG");
+    DltContext* cpu_context = wdlt_context_get("CPU", NULL);
+
+    /* The rules are applied to the identifier of the series. */
+    wdlt_route_get(&vl, graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_DEBUG, route.dlt_level);
+    OK(route.dlt_context == cpu_context);
+    EXPECT_EQ_INT(1, c_avl_size(wdlt_cache));
+
+    /* The cached route is the same as the computed one. */
+    wdlt_route_get(&vl, graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_DEBUG, route.dlt_level);
+    OK(route.dlt_context == cpu_context);
+    EXPECT_EQ_INT(1, c_avl_size(wdlt_cache));
+
+    sstrncpy(vl.type_instance, "user", sizeof(vl.type_instance));
+    wdlt_route_get(&vl, graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_INFO, route.dlt_level);
+    OK(route.dlt_context == cpu_context);
+    EXPECT_EQ_INT(2, c_avl_size(wdlt_cache));
+
+    /* Adding a rule invalidates the cached routes. */
+    wdlt_level_list_add("/cpu-user$", "WARN");
+    EXPECT_EQ_INT(0, c_avl_size(wdlt_cache));
+    wdlt_route_get(&vl, graphiteContext, &route);
+    EXPECT_EQ_INT(DLT_LOG_WARN, route.dlt_level);
+    OK(route.dlt_context == cpu_context);
   }
   teardown();
 
   return 0;
 }
 
+/* -------------------------------------------------------------------------- */
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec) / 1e9;
+}
+
+/* -------------------------------------------------------------------------- */
+/* 40 routing rules and 200 series, similar to the configuration of an ECU.
+ * Only runs when "--benchmark" is passed. */
+DEF_TEST(benchmark) {
+  data_source_t dsrc = {"value", DS_TYPE_GAUGE, 0.0, NAN};
+  data_set_t ds = {"gauge", 1, &dsrc};
+  value_t values[] = {{.gauge = 42.0}};
+  value_list_t vl = {
+    .values = values,
+    .values_len = 1,
+    .interval = TIME_T_TO_CDTIME_T(10),
+    .host = "ecu",
+    .type = "gauge",
+  };
+  size_t series = 200;
+  size_t rounds = 100;
+  int errors = 0;
+
+  if (setup() != 0) {
+    teardown();
+    return -1;
+  }
+
+  for (int i = 0; i < 20; i++) {
+    char regex[64];
+    char context[8];
+
+    snprintf(regex, sizeof(regex), "/plugin%02d-[0-9]+/", i);
+    snprintf(context, sizeof(context), "C%03d", i);
+    wdlt_context_list_add(regex, context);
+
+    snprintf(regex, sizeof(regex), "/gauge-instance%d$", i);
+    wdlt_level_list_add(regex, (i % 2) ? "WARN" : "DEBUG");
+  }
+
+  /* Formatting the identifier and applying the rules to every value. */
+  double start = now_seconds();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < series; i++) {
+      char identifier[6 * DATA_MAX_NAME_LEN];
+      wdlt_route_t route;
+
+      snprintf(vl.plugin, sizeof(vl.plugin), "plugin%02zu", i % 25);
+      snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%zu", i);
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "instance%zu",
+               i % 30);
+      if (FORMAT_VL(identifier, sizeof(identifier), &vl) != 0)
+        errors++;
+      wdlt_route_match(identifier, graphiteContext, &route);
+    }
+  }
+  double uncached_time = now_seconds() - start;
+
+  /* The write callback, which routes by series. */
+  start = now_seconds();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < series; i++) {
+      snprintf(vl.plugin, sizeof(vl.plugin), "plugin%02zu", i % 25);
+      snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "%zu", i);
+      snprintf(vl.type_instance, sizeof(vl.type_instance), "instance%zu",
+               i % 30);
+      if (wdlt_write(&ds, &vl, NULL) != 0)
+        errors++;
+    }
+  }
+  double cached_time = now_seconds() - start;
+
+  EXPECT_EQ_INT(0, errors);
+  EXPECT_EQ_INT(series, c_avl_size(wdlt_cache));
+  printf("%zu values x 40 rules: uncached %.0f values/s, "
+         "wdlt_write %.0f values/s\n",
+         rounds * series, (double)(rounds * series) / uncached_time,
+         (double)(rounds * series) / cached_time);
+
+  teardown();
+  return 0;
+}
+
 /* ========================================================================== */
 /* main */
 /* ========================================================================== */
 
-int main(void) {
+int main(int argc, char **argv) {
   RUN_TEST(level_matching);
+  RUN_TEST(route_cache);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(benchmark);
 
   END_TEST;
 }
@@ -580,6 +580,11 @@ static int wg_config(oconfig_item_t *ci) {
   return 0;
 }
 
+/* The nodes are flushed and freed with their write callbacks, so there is
+ * nothing else to reset. */
+static int wg_reset(void) { return 0; }
+
 void module_register(void) {
   plugin_register_complex_config("write_graphite", wg_config);
+  plugin_register_reset("write_graphite", wg_reset);
 }
@@ -601,7 +601,7 @@ static int wh_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
 static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
 {
   wh_callback_t *cb;
-  char alert[4096];
+  json_buffer_t *alert;
   int status;
 
   if ((ud == NULL) || (ud->data == NULL))
@@ -610,7 +610,11 @@ static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
   cb = ud->data;
   assert(cb->send_notifications);
 
-  status = format_json_notification(alert, sizeof(alert), n);
+  alert = json_buffer_thread();
+  if (alert == NULL)
+    return ENOMEM;
+
+  status = json_buffer_notification(alert, n);
   if (status != 0) {
     ERROR("write_http plugin: formatting notification failed");
     return status;
@@ -623,7 +627,7 @@ static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
     return -1;
   }
 
-  status = wh_post_nolock(cb, alert);
+  status = wh_post_nolock(cb, alert->data);
   pthread_mutex_unlock(&cb->send_lock);
 
   return status;
@@ -931,8 +935,18 @@ static int wh_init(void) /* {{{ */
   return 0;
 } /* }}} int wh_init */
 
+/* The nodes are freed with their write callbacks. */
+static int wh_reset(void) /* {{{ */
+{
+  strarray_free(http_attrs, http_attrs_num);
+  http_attrs = NULL;
+  http_attrs_num = 0;
+  return 0;
+} /* }}} int wh_reset */
+
 void module_register(void) /* {{{ */
 {
   plugin_register_complex_config("write_http", wh_config);
   plugin_register_init("write_http", wh_init);
+  plugin_register_reset("write_http", wh_reset);
 } /* }}} void module_register */
@@ -23,6 +23,9 @@
  *   Carlos Peon Costa <carlospeon at gmail.com>
  **/
 
+/* _GNU_SOURCE is needed in Linux to use sendmmsg */
+#define _GNU_SOURCE
+
 #include "collectd.h"
 
 #include "plugin.h"
@@ -65,22 +68,53 @@ typedef struct sockent {
 #define NET_DEFAULT_PACKET_SIZE 1452
 #define NET_DEFAULT_PORT "8089"
 
+/* Upper limit for "PacketsPerSend". */
+#define NET_MAX_PACKETS_PER_SEND 64
+
+/* Per-thread buffer in which to-be-sent network packets are constructed.
+ * Each write thread fills its own buffer, so formatting does not contend on a
+ * global lock; "lock" is only contended by the flush callback. Up to
+ * "wifxudp_config_packets_per_send" packets are collected before they are
+ * sent with a single sendmmsg(2) call per server. */
+typedef struct wifxudp_buffer_s {
+  pthread_mutex_t lock;
+
+  char *packets;      /* packets_per_send * packet_size bytes */
+  size_t *packet_len; /* fill of each packet */
+  size_t packets_num; /* number of completed packets */
+  cdtime_t last_update;
+
+  /* State used by "PackFields" to append fields to the last point of the
+   * current packet: the offset and length of its series key, the offset of its
+   * timestamp suffix, and its time. */
+  size_t last_key_offset;
+  size_t last_key_len;
+  size_t last_suffix_offset;
+  cdtime_t last_time;
+
+  char *scratch; /* packet_size bytes used to format one point */
+
+  struct wifxudp_buffer_s *next;
+} wifxudp_buffer_t;
+
 /*
  * Private variables
  */
 
 static int wifxudp_config_ttl;
 static size_t wifxudp_config_packet_size = NET_DEFAULT_PACKET_SIZE;
+static size_t wifxudp_config_packets_per_send = 1;
 static bool wifxudp_config_store_rates;
+static bool wifxudp_config_pack_fields;
 
-static sockent_t *sending_socket;
+static sockent_t **sending_sockets;
+static size_t sending_sockets_num;
+/* Serializes (re)connecting and sending on the sockets. */
+static pthread_mutex_t sending_sockets_lock = PTHREAD_MUTEX_INITIALIZER;
 
-/* Buffer in which to-be-sent network packets are constructed. */
-static char *send_buffer;
-static char *send_buffer_ptr;
-static int send_buffer_fill;
-static cdtime_t send_buffer_last_update;
-static pthread_mutex_t send_buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t send_buffer_key;
+static wifxudp_buffer_t *send_buffer_list;
+static pthread_mutex_t send_buffer_list_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int listen_loop;
 
@@ -290,43 +324,140 @@ static void sockent_destroy(sockent_t *se) {
   }
 } /* void sockent_destroy */
 
-static void write_influxdb_udp_init_buffer(void) {
-  memset(send_buffer, 0, wifxudp_config_packet_size);
-  send_buffer_ptr = send_buffer;
-  send_buffer_fill = 0;
-  send_buffer_last_update = 0;
-} /* write_influxdb_udp_init_buffer */
-
-static void write_influxdb_udp_send_buffer(const char *buffer,
-                                           size_t buffer_size) {
-  while (42) {
-    int status = sockent_client_connect(sending_socket);
+static void wifxudp_buffer_reset(wifxudp_buffer_t *buf) {
+  for (size_t i = 0; i < wifxudp_config_packets_per_send; i++)
+    buf->packet_len[i] = 0;
+  buf->packets_num = 0;
+  buf->last_update = 0;
+  buf->last_key_len = 0;
+} /* void wifxudp_buffer_reset */
+
+static void wifxudp_buffer_destroy(wifxudp_buffer_t *buf) {
+  if (buf == NULL)
+    return;
+
+  pthread_mutex_destroy(&buf->lock);
+  sfree(buf->packets);
+  sfree(buf->packet_len);
+  sfree(buf->scratch);
+  sfree(buf);
+} /* void wifxudp_buffer_destroy */
+
+/* Returns the calling thread's buffer, creating it on first use. */
+static wifxudp_buffer_t *wifxudp_buffer_get(void) {
+  wifxudp_buffer_t *buf = pthread_getspecific(send_buffer_key);
+  if (buf != NULL)
+    return buf;
+
+  buf = calloc(1, sizeof(*buf));
+  if (buf == NULL)
+    return NULL;
+
+  pthread_mutex_init(&buf->lock, /* attr = */ NULL);
+  buf->packets =
+      malloc(wifxudp_config_packets_per_send * wifxudp_config_packet_size);
+  buf->packet_len =
+      calloc(wifxudp_config_packets_per_send, sizeof(*buf->packet_len));
+  buf->scratch = malloc(wifxudp_config_packet_size);
+  if ((buf->packets == NULL) || (buf->packet_len == NULL) ||
+      (buf->scratch == NULL)) {
+    wifxudp_buffer_destroy(buf);
+    return NULL;
+  }
+  wifxudp_buffer_reset(buf);
+
+  if (pthread_setspecific(send_buffer_key, buf) != 0) {
+    wifxudp_buffer_destroy(buf);
+    return NULL;
+  }
+
+  /* Buffers are owned by the list and live until shutdown. */
+  pthread_mutex_lock(&send_buffer_list_lock);
+  buf->next = send_buffer_list;
+  send_buffer_list = buf;
+  pthread_mutex_unlock(&send_buffer_list_lock);
+
+  return buf;
+} /* wifxudp_buffer_t *wifxudp_buffer_get */
+
+static void write_influxdb_udp_send_packets(sockent_t *se, /* {{{ */
+                                            struct iovec *iov,
+                                            size_t packets_num) {
+  size_t sent = 0;
+
+  while (sent < packets_num) {
+    int status = sockent_client_connect(se);
     if (status != 0)
       return;
 
-    status =
-        sendto(sending_socket->client.fd, buffer, buffer_size,
-               /* flags = */ 0, (struct sockaddr *)sending_socket->client.addr,
-               sending_socket->client.addrlen);
+#if HAVE_SENDMMSG
+    struct mmsghdr msgs[NET_MAX_PACKETS_PER_SEND] = {{{0}}};
+    for (size_t i = sent; i < packets_num; i++) {
+      msgs[i - sent].msg_hdr.msg_name = se->client.addr;
+      msgs[i - sent].msg_hdr.msg_namelen = se->client.addrlen;
+      msgs[i - sent].msg_hdr.msg_iov = iov + i;
+      msgs[i - sent].msg_hdr.msg_iovlen = 1;
+    }
+
+    status = sendmmsg(se->client.fd, msgs, (unsigned int)(packets_num - sent),
+                      /* flags = */ 0);
+#else
+    status = (int)sendto(se->client.fd, iov[sent].iov_base, iov[sent].iov_len,
+                         /* flags = */ 0, (struct sockaddr *)se->client.addr,
+                         se->client.addrlen);
+    if (status >= 0)
+      status = 1;
+#endif
     if (status < 0) {
       if ((errno == EINTR) || (errno == EAGAIN))
         continue;
 
       ERROR("write_influxdb_udp plugin: "
-            "sendto failed: %s. Closing sending socket.",
+            "sending failed: %s. Closing sending socket.",
             STRERRNO);
-      sockent_client_disconnect(sending_socket);
+      sockent_client_disconnect(se);
       return;
     }
 
-    break;
-  } /* while (42) */
-} /* void write_influxdb_udp_send_buffer */
+    sent += (size_t)status;
+  } /* while (sent < packets_num) */
+} /* }}} void write_influxdb_udp_send_packets */
+
+/* Sends all completed packets of "buf" to all servers. Must hold buf->lock. */
+static void flush_buffer(wifxudp_buffer_t *buf) {
+  struct iovec iov[NET_MAX_PACKETS_PER_SEND];
+  size_t packets_num = 0;
+
+  for (size_t i = 0; i < buf->packets_num; i++) {
+    if (buf->packet_len[i] == 0)
+      continue;
+    iov[packets_num].iov_base =
+        buf->packets + (i * wifxudp_config_packet_size);
+    iov[packets_num].iov_len = buf->packet_len[i];
+    packets_num++;
+  }
+
+  if (packets_num > 0) {
+    pthread_mutex_lock(&sending_sockets_lock);
+    for (size_t i = 0; i < sending_sockets_num; i++)
+      write_influxdb_udp_send_packets(sending_sockets[i], iov, packets_num);
+    pthread_mutex_unlock(&sending_sockets_lock);
+  }
+
+  wifxudp_buffer_reset(buf);
+} /* void flush_buffer */
 
-static void flush_buffer(void) {
-  write_influxdb_udp_send_buffer(send_buffer, (size_t)send_buffer_fill);
-  write_influxdb_udp_init_buffer();
-}
+/* Completes the current packet and sends the buffer if all packets are in use.
+ * Must hold buf->lock. */
+static void wifxudp_buffer_next_packet(wifxudp_buffer_t *buf) {
+  if (buf->packet_len[buf->packets_num] == 0)
+    return;
+
+  buf->packets_num++;
+  buf->last_key_len = 0;
+  if (buf->packets_num >= wifxudp_config_packets_per_send)
+    flush_buffer(buf);
+} /* void wifxudp_buffer_next_packet */
 
 static int wifxudp_escape_string(char *buffer, size_t buffer_size,
                                  const char *string) {
@@ -366,8 +497,13 @@ static int wifxudp_escape_string(char *buffer, size_t buffer_size,
   return dst_pos;
 } /* int wifxudp_escape_string */
 
+/* Formats the series key ("measurement,tags"), a space and the fields of "vl"
+ * into "buffer", without the timestamp. Returns the number of bytes written,
+ * zero if there are no values to send, or less than zero on error. The length
+ * of the series key is returned in "ret_key_len". */
 static int write_influxdb_point(char *buffer, int buffer_len,
-                                const data_set_t *ds, const value_list_t *vl) {
+                                const data_set_t *ds, const value_list_t *vl,
+                                size_t *ret_key_len) {
   int status;
   int offset = 0;
   gauge_t *rates = NULL;
@@ -379,8 +515,10 @@ static int write_influxdb_point(char *buffer, int buffer_len,
   do {                                                                         \
     status = wifxudp_escape_string(buffer + offset, buffer_len - offset,       \
                                    __VA_ARGS__);                               \
-    if (status < 0)                                                            \
+    if (status < 0) {                                                          \
+      sfree(rates);                                                            \
       return -1;                                                               \
+    }                                                                          \
     offset += status;                                                          \
   } while (0)
 
@@ -394,6 +532,21 @@ static int write_influxdb_point(char *buffer, int buffer_len,
     offset += status;                                                          \
   } while (0)
 
+/* With "PackFields", the type instance becomes (part of) the field name, so
+ * that all type instances of a series end up in one point. */
+#define BUFFER_ADD_FIELD_NAME(i)                                               \
+  do {                                                                         \
+    if (have_values)                                                           \
+      BUFFER_ADD(",");                                                         \
+    if (wifxudp_config_pack_fields && (vl->type_instance[0] != 0)) {           \
+      BUFFER_ADD_ESCAPE(vl->type_instance);                                    \
+      if (ds->ds_num > 1)                                                      \
+        BUFFER_ADD("_%s", ds->ds[i].name);                                     \
+    } else                                                                     \
+      BUFFER_ADD("%s", ds->ds[i].name);                                        \
+    BUFFER_ADD("=");                                                           \
+  } while (0)
+
   BUFFER_ADD_ESCAPE(vl->plugin);
   BUFFER_ADD(",host=");
   BUFFER_ADD_ESCAPE(vl->host);
@@ -405,10 +558,11 @@ static int write_influxdb_point(char *buffer, int buffer_len,
     BUFFER_ADD(",type=");
     BUFFER_ADD_ESCAPE(vl->type);
   }
-  if (strcmp(vl->type_instance, "") != 0) {
+  if (!wifxudp_config_pack_fields && (strcmp(vl->type_instance, "") != 0)) {
     BUFFER_ADD(",type_instance=");
     BUFFER_ADD_ESCAPE(vl->type_instance);
   }
+  *ret_key_len = (size_t)offset;
 
   BUFFER_ADD(" ");
   for (size_t i = 0; i < ds->ds_num; i++) {
@@ -423,9 +577,8 @@ static int write_influxdb_point(char *buffer, int buffer_len,
     if (ds->ds[i].type == DS_TYPE_GAUGE) {
       if (isnan(vl->values[i].gauge))
         continue;
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%lf", ds->ds[i].name, vl->values[i].gauge);
+      BUFFER_ADD_FIELD_NAME(i);
+      BUFFER_ADD("%lf", vl->values[i].gauge);
       have_values = true;
     } else if (wifxudp_config_store_rates) {
       if (rates == NULL)
@@ -437,25 +590,20 @@ static int write_influxdb_point(char *buffer, int buffer_len,
       }
       if (isnan(rates[i]))
         continue;
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%lf", ds->ds[i].name, rates[i]);
+      BUFFER_ADD_FIELD_NAME(i);
+      BUFFER_ADD("%lf", rates[i]);
       have_values = true;
     } else if (ds->ds[i].type == DS_TYPE_COUNTER) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIu64 "i", ds->ds[i].name,
-                 (uint64_t)vl->values[i].counter);
+      BUFFER_ADD_FIELD_NAME(i);
+      BUFFER_ADD("%" PRIu64 "i", (uint64_t)vl->values[i].counter);
       have_values = true;
     } else if (ds->ds[i].type == DS_TYPE_DERIVE) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIi64 "i", ds->ds[i].name, vl->values[i].derive);
+      BUFFER_ADD_FIELD_NAME(i);
+      BUFFER_ADD("%" PRIi64 "i", vl->values[i].derive);
       have_values = true;
     } else if (ds->ds[i].type == DS_TYPE_ABSOLUTE) {
-      if (have_values)
-        BUFFER_ADD(",");
-      BUFFER_ADD("%s=%" PRIu64 "i", ds->ds[i].name, vl->values[i].absolute);
+      BUFFER_ADD_FIELD_NAME(i);
+      BUFFER_ADD("%" PRIu64 "i", vl->values[i].absolute);
       have_values = true;
     }
 
@@ -465,14 +613,75 @@ static int write_influxdb_point(char *buffer, int buffer_len,
   if (!have_values)
     return 0;
 
-  BUFFER_ADD(" %" PRIu64 "\n", CDTIME_T_TO_MS(vl->time));
-
+#undef BUFFER_ADD_FIELD_NAME
 #undef BUFFER_ADD_ESCAPE
 #undef BUFFER_ADD
 
   return offset;
 } /* int write_influxdb_point */
 
+/* Formats the " <timestamp>\n" suffix of a point. Timestamps are sent with
+ * millisecond precision. */
+static size_t write_influxdb_suffix(char *buffer, size_t buffer_size,
+                                    cdtime_t t) {
+  if (buffer_size < 2)
+    return buffer_size;
+
+  buffer[0] = ' ';
+  size_t len =
+      1 + (size_t)format_uint64(buffer + 1, buffer_size - 1, CDTIME_T_TO_MS(t));
+  if (len + 1 >= buffer_size)
+    return buffer_size;
+
+  buffer[len] = '\n';
+  buffer[len + 1] = 0;
+  return len + 1;
+} /* size_t write_influxdb_suffix */
+
+/* Appends the point in buf->scratch to the current packet. If "PackFields" is
+ * enabled and the previous point in the packet has the same series key and
+ * time, only the fields are appended to that point. Returns -1 if the point
+ * does not fit into the current packet. Must hold buf->lock. */
+static int wifxudp_buffer_append(wifxudp_buffer_t *buf, size_t point_len,
+                                 size_t key_len, cdtime_t t) {
+  char *packet = buf->packets + (buf->packets_num * wifxudp_config_packet_size);
+  size_t *fill = &buf->packet_len[buf->packets_num];
+  char suffix[32];
+  size_t suffix_len = write_influxdb_suffix(suffix, sizeof(suffix), t);
+
+  if (wifxudp_config_pack_fields && (buf->last_key_len == key_len) &&
+      (buf->last_time == t) &&
+      (memcmp(packet + buf->last_key_offset, buf->scratch, key_len) == 0)) {
+    /* Replace the previous point's suffix with ",<fields><suffix>". */
+    size_t fields_len = point_len - (key_len + 1);
+    size_t offset = buf->last_suffix_offset;
+
+    if ((offset + 1 + fields_len + suffix_len) >= wifxudp_config_packet_size)
+      return -1;
+
+    packet[offset] = ',';
+    memcpy(packet + offset + 1, buf->scratch + key_len + 1, fields_len);
+    offset += 1 + fields_len;
+    memcpy(packet + offset, suffix, suffix_len);
+    buf->last_suffix_offset = offset;
+    *fill = offset + suffix_len;
+    return 0;
+  }
+
+  if ((*fill + point_len + suffix_len) >= wifxudp_config_packet_size)
+    return -1;
+
+  memcpy(packet + *fill, buf->scratch, point_len);
+  memcpy(packet + *fill + point_len, suffix, suffix_len);
+
+  buf->last_key_offset = *fill;
+  buf->last_key_len = key_len;
+  buf->last_suffix_offset = *fill + point_len;
+  buf->last_time = t;
+  *fill += point_len + suffix_len;
+  return 0;
+} /* int wifxudp_buffer_append */
+
 static int
 write_influxdb_udp_write(const data_set_t *ds, const value_list_t *vl,
                          user_data_t __attribute__((unused)) * user_data) {
@@ -482,38 +691,44 @@ write_influxdb_udp_write(const data_set_t *ds, const value_list_t *vl,
    * down. */
   assert(listen_loop == 0);
 
-  pthread_mutex_lock(&send_buffer_lock);
+  wifxudp_buffer_t *buf = wifxudp_buffer_get();
+  if (buf == NULL) {
+    ERROR("write_influxdb_udp plugin: allocating send buffer failed.");
+    return -1;
+  }
 
-  int status = write_influxdb_point(
-      send_buffer_ptr, wifxudp_config_packet_size - send_buffer_fill, ds, vl);
+  pthread_mutex_lock(&buf->lock);
 
-  if (status < 0) {
-    flush_buffer();
-    status = write_influxdb_point(
-        send_buffer_ptr, wifxudp_config_packet_size - send_buffer_fill, ds, vl);
+  size_t key_len = 0;
+  int status = write_influxdb_point(buf->scratch, wifxudp_config_packet_size,
+                                    ds, vl, &key_len);
+  if (status > 0) {
+    if (wifxudp_buffer_append(buf, (size_t)status, key_len, vl->time) != 0) {
+      wifxudp_buffer_next_packet(buf);
+      if (wifxudp_buffer_append(buf, (size_t)status, key_len, vl->time) != 0)
+        status = -1;
+    }
   }
   if (status < 0) {
     ERROR("write_influxdb_udp plugin: write_influxdb_udp_write failed.");
-    pthread_mutex_unlock(&send_buffer_lock);
+    pthread_mutex_unlock(&buf->lock);
     return -1;
   }
   if (status == 0) {
     /* no real values to send (nan) */
-    pthread_mutex_unlock(&send_buffer_lock);
+    pthread_mutex_unlock(&buf->lock);
     return 0;
   }
 
-  send_buffer_fill += status;
-  send_buffer_ptr += status;
-  send_buffer_last_update = cdtime();
+  buf->last_update = cdtime();
 
-  if (wifxudp_config_packet_size - send_buffer_fill < 120)
+  if (wifxudp_config_packet_size - buf->packet_len[buf->packets_num] < 120)
     /* No room for a new point of average size in buffer,
        the probability of fail for the new point is bigger than
        the probability of success */
-    flush_buffer();
+    wifxudp_buffer_next_packet(buf);
 
-  pthread_mutex_unlock(&send_buffer_lock);
+  pthread_mutex_unlock(&buf->lock);
   return 0;
 } /* int write_influxdb_udp_write */
 
@@ -549,6 +764,23 @@ static int wifxudp_config_set_buffer_size(const oconfig_item_t *ci) {
   return 0;
 } /* int wifxudp_config_set_buffer_size */
 
+static int wifxudp_config_set_packets_per_send(const oconfig_item_t *ci) {
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+  else if ((tmp >= 1) && (tmp <= NET_MAX_PACKETS_PER_SEND))
+    wifxudp_config_packets_per_send = (size_t)tmp;
+  else {
+    WARNING("write_influxdb_udp plugin: "
+            "The `PacketsPerSend' must be between 1 and %d.",
+            NET_MAX_PACKETS_PER_SEND);
+    return -1;
+  }
+
+  return 0;
+} /* int wifxudp_config_set_packets_per_send */
+
 static int wifxudp_config_set_server(const oconfig_item_t *ci) {
   if ((ci->values_num < 1) || (ci->values_num > 2) ||
       (ci->values[0].type != OCONFIG_TYPE_STRING) ||
@@ -559,15 +791,26 @@ static int wifxudp_config_set_server(const oconfig_item_t *ci) {
     return -1;
   }
 
-  sending_socket = sockent_create();
-  if (sending_socket == NULL) {
+  sockent_t **tmp = realloc(sending_sockets, (sending_sockets_num + 1) *
+                                                 sizeof(*sending_sockets));
+  if (tmp == NULL) {
+    ERROR("write_influxdb_udp plugin: realloc failed.");
+    return -1;
+  }
+  sending_sockets = tmp;
+
+  sockent_t *se = sockent_create();
+  if (se == NULL) {
     ERROR("write_influxdb_udp plugin: sockent_create failed.");
     return -1;
   }
 
-  sending_socket->node = strdup(ci->values[0].value.string);
+  se->node = strdup(ci->values[0].value.string);
   if (ci->values_num >= 2)
-    sending_socket->service = strdup(ci->values[1].value.string);
+    se->service = strdup(ci->values[1].value.string);
+
+  sending_sockets[sending_sockets_num] = se;
+  sending_sockets_num++;
 
   return 0;
 } /* int wifxudp_config_set_server */
@@ -582,8 +825,12 @@ static int write_influxdb_udp_config(oconfig_item_t *ci) {
       wifxudp_config_set_ttl(child);
     } else if (strcasecmp("MaxPacketSize", child->key) == 0)
       wifxudp_config_set_buffer_size(child);
+    else if (strcasecmp("PacketsPerSend", child->key) == 0)
+      wifxudp_config_set_packets_per_send(child);
     else if (strcasecmp("StoreRates", child->key) == 0)
       cf_util_get_boolean(child, &wifxudp_config_store_rates);
+    else if (strcasecmp("PackFields", child->key) == 0)
+      cf_util_get_boolean(child, &wifxudp_config_pack_fields);
     else {
       WARNING("write_influxdb_udp plugin: "
               "Option `%s' is not allowed here.",
@@ -594,16 +841,44 @@ static int write_influxdb_udp_config(oconfig_item_t *ci) {
   return 0;
 } /* int write_influxdb_udp_config */
 
+/* Sends the buffers of all threads, subject to "timeout". */
+static void write_influxdb_udp_flush_all(cdtime_t timeout) {
+  cdtime_t now = cdtime();
+
+  pthread_mutex_lock(&send_buffer_list_lock);
+  for (wifxudp_buffer_t *buf = send_buffer_list; buf != NULL;
+       buf = buf->next) {
+    pthread_mutex_lock(&buf->lock);
+    if ((buf->packets_num > 0) || (buf->packet_len[buf->packets_num] > 0)) {
+      /* timeout == 0  => flush unconditionally */
+      if ((timeout == 0) || ((buf->last_update + timeout) <= now)) {
+        if (buf->packet_len[buf->packets_num] > 0)
+          buf->packets_num++;
+        flush_buffer(buf);
+      }
+    }
+    pthread_mutex_unlock(&buf->lock);
+  }
+  pthread_mutex_unlock(&send_buffer_list_lock);
+} /* void write_influxdb_udp_flush_all */
+
 static int write_influxdb_udp_shutdown(void) {
-  if (send_buffer_fill > 0)
-    flush_buffer();
+  write_influxdb_udp_flush_all(/* timeout = */ 0);
 
-  sfree(send_buffer);
+  pthread_mutex_lock(&send_buffer_list_lock);
+  while (send_buffer_list != NULL) {
+    wifxudp_buffer_t *next = send_buffer_list->next;
+    wifxudp_buffer_destroy(send_buffer_list);
+    send_buffer_list = next;
+  }
+  pthread_mutex_unlock(&send_buffer_list_lock);
 
-  if (sending_socket != NULL) {
-    sockent_client_disconnect(sending_socket);
-    sockent_destroy(sending_socket);
+  for (size_t i = 0; i < sending_sockets_num; i++) {
+    sockent_client_disconnect(sending_sockets[i]);
+    sockent_destroy(sending_sockets[i]);
   }
+  sfree(sending_sockets);
+  sending_sockets_num = 0;
 
   plugin_unregister_config("write_influxdb_udp");
   plugin_unregister_init("write_influxdb_udp");
@@ -624,15 +899,16 @@ static int write_influxdb_udp_init(void) {
 
   plugin_register_shutdown("write_influxdb_udp", write_influxdb_udp_shutdown);
 
-  send_buffer = malloc(wifxudp_config_packet_size);
-  if (send_buffer == NULL) {
-    ERROR("write_influxdb_udp plugin: malloc failed.");
+  /* Buffers are freed in the shutdown callback, not on thread exit. */
+  int status = pthread_key_create(&send_buffer_key, /* destructor = */ NULL);
+  if (status != 0) {
+    ERROR("write_influxdb_udp plugin: pthread_key_create failed: %s",
+          STRERROR(status));
     return -1;
   }
-  write_influxdb_udp_init_buffer();
 
   /* setup socket(s) and so on */
-  if (sending_socket != NULL) {
+  if (sending_sockets_num > 0) {
     plugin_register_write("write_influxdb_udp", write_influxdb_udp_write,
                           /* user_data = */ NULL);
   }
@@ -645,20 +921,7 @@ static int write_influxdb_udp_flush(cdtime_t timeout,
                                     const char *identifier,
                                     __attribute__((unused))
                                     user_data_t *user_data) {
-  pthread_mutex_lock(&send_buffer_lock);
-
-  if (send_buffer_fill > 0) {
-    if (timeout > 0) {
-      cdtime_t now = cdtime();
-      if ((send_buffer_last_update + timeout) > now) {
-        pthread_mutex_unlock(&send_buffer_lock);
-        return 0;
-      }
-    }
-    flush_buffer();
-  }
-  pthread_mutex_unlock(&send_buffer_lock);
-
+  write_influxdb_udp_flush_all(timeout);
   return 0;
 } /* int write_influxdb_udp_flush */
 
@@ -54,6 +54,23 @@ struct kafka_topic_context {
   char escape_char;
   char *topic_name;
   pthread_mutex_t lock;
+
+  /* If buffer_size is non-zero, multiple value lists are coalesced into one
+   * message. The buffer is handed over to librdkafka when sending, so it is
+   * reallocated after each message. Protected by "lock". */
+  size_t buffer_size;
+  char *buffer;
+  size_t buffer_fill;
+  size_t buffer_free;
+  size_t buffer_values;
+  cdtime_t buffer_init_time;
+
+  /* Value lists in accepted messages and the number of messages accepted and
+   * rejected by librdkafka. Protected by "lock". */
+  bool report_stats;
+  derive_t stats_values;
+  derive_t stats_accepted;
+  derive_t stats_rejected;
 };
 
 static int kafka_handle(struct kafka_topic_context *);
@@ -170,14 +187,244 @@ static int kafka_handle(struct kafka_topic_context *ctx) /* {{{ */
 
 } /* }}} int kafka_handle */
 
+/* Sends one message. With RD_KAFKA_MSG_F_FREE, librdkafka takes ownership of
+ * "buffer" on success only. */
+static int kafka_produce(struct kafka_topic_context *ctx, /* {{{ */
+                         char *buffer, size_t blen, int msgflags) {
+  void *key;
+  size_t keylen;
+  int status;
+
+  key =
+      (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
+  keylen = strlen(key);
+
+  status = rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, msgflags,
+                            buffer, blen, key, keylen, NULL);
+  if (status != 0) {
+    ERROR("write_kafka plugin: rd_kafka_produce failed: %s",
+          rd_kafka_err2str(kafka_error()));
+    return -1;
+  }
+
+  return 0;
+} /* }}} int kafka_produce */
+
+/* Accounts for one message holding "values" value lists which was produced
+ * with "status". Must hold ctx->lock when calling. */
+static void kafka_stats_add(struct kafka_topic_context *ctx, /* {{{ */
+                            size_t values, int status) {
+  if (status == 0) {
+    ctx->stats_values += (derive_t)values;
+    ctx->stats_accepted++;
+  } else {
+    ctx->stats_rejected++;
+  }
+} /* }}} void kafka_stats_add */
+
+/* must hold ctx->lock when calling */
+static int kafka_buffer_reset(struct kafka_topic_context *ctx) /* {{{ */
+{
+  if (ctx->buffer == NULL) {
+    ctx->buffer = malloc(ctx->buffer_size);
+    if (ctx->buffer == NULL) {
+      ERROR("write_kafka plugin: malloc failed.");
+      return ENOMEM;
+    }
+  }
+
+  ctx->buffer[0] = 0;
+  ctx->buffer_fill = 0;
+  ctx->buffer_free = ctx->buffer_size;
+  ctx->buffer_values = 0;
+  ctx->buffer_init_time = cdtime();
+
+  if (ctx->format == KAFKA_FORMAT_JSON)
+    format_json_initialize(ctx->buffer, &ctx->buffer_fill, &ctx->buffer_free);
+
+  return 0;
+} /* }}} int kafka_buffer_reset */
+
+/* must hold ctx->lock when calling */
+static int kafka_flush_nolock(cdtime_t timeout, /* {{{ */
+                              struct kafka_topic_context *ctx) {
+  int status;
+
+  if (ctx->buffer == NULL)
+    return 0;
+
+  /* timeout == 0  => flush unconditionally */
+  if ((timeout > 0) && ((ctx->buffer_init_time + timeout) > cdtime()))
+    return 0;
+
+  if (ctx->buffer_fill == 0) {
+    ctx->buffer_init_time = cdtime();
+    return 0;
+  }
+
+  if (ctx->format == KAFKA_FORMAT_JSON) {
+    status = format_json_finalize(ctx->buffer, &ctx->buffer_fill,
+                                  &ctx->buffer_free);
+    if (status != 0) {
+      ERROR("write_kafka plugin: format_json_finalize failed.");
+      kafka_buffer_reset(ctx);
+      return status;
+    }
+  }
+
+  /* Zero-copy: hand the buffer over to librdkafka and start a new one. */
+  status = kafka_produce(ctx, ctx->buffer, ctx->buffer_fill,
+                         RD_KAFKA_MSG_F_FREE);
+  if (status == 0)
+    ctx->buffer = NULL;
+  kafka_stats_add(ctx, ctx->buffer_values, status);
+
+  int reset_status = kafka_buffer_reset(ctx);
+  return (status != 0) ? status : reset_status;
+} /* }}} int kafka_flush_nolock */
+
+/* Appends "vl" to the coalescing buffer. Returns -ENOMEM if the buffer is too
+ * small to hold it. Must hold ctx->lock when calling. */
+static int kafka_buffer_append(struct kafka_topic_context *ctx, /* {{{ */
+                               const data_set_t *ds, const value_list_t *vl) {
+  char message[8192];
+  size_t len;
+  int status;
+
+  switch (ctx->format) {
+  case KAFKA_FORMAT_COMMAND:
+    status = cmd_create_putval(message, sizeof(message) - 1, ds, vl);
+    if (status != 0) {
+      ERROR("write_kafka plugin: cmd_create_putval failed with status %i.",
+            status);
+      return status;
+    }
+    /* One command per line. */
+    len = strlen(message);
+    message[len++] = '\n';
+    break;
+  case KAFKA_FORMAT_JSON:
+    /* Adds an element to the JSON array. */
+    return format_json_value_list(ctx->buffer, &ctx->buffer_fill,
+                                  &ctx->buffer_free, ds, vl, ctx->store_rates);
+  case KAFKA_FORMAT_GRAPHITE:
+    /* Graphite lines are already newline terminated. */
+    status =
+        format_graphite(message, sizeof(message), ds, vl, ctx->prefix,
+                        ctx->postfix, ctx->escape_char, ctx->graphite_flags);
+    if (status != 0) {
+      ERROR("write_kafka plugin: format_graphite failed with status %i.",
+            status);
+      return status;
+    }
+    len = strlen(message);
+    break;
+  default:
+    ERROR("write_kafka plugin: invalid format %i.", ctx->format);
+    return -1;
+  }
+
+  if (len >= ctx->buffer_free)
+    return -ENOMEM;
+
+  memcpy(ctx->buffer + ctx->buffer_fill, message, len);
+  ctx->buffer_fill += len;
+  ctx->buffer_free -= len;
+  ctx->buffer[ctx->buffer_fill] = 0;
+  return 0;
+} /* }}} int kafka_buffer_append */
+
+static int kafka_write_buffered(struct kafka_topic_context *ctx, /* {{{ */
+                                const data_set_t *ds, const value_list_t *vl) {
+  int status;
+
+  pthread_mutex_lock(&ctx->lock);
+
+  if (ctx->buffer == NULL) {
+    status = kafka_buffer_reset(ctx);
+    if (status != 0) {
+      pthread_mutex_unlock(&ctx->lock);
+      return status;
+    }
+  }
+
+  status = kafka_buffer_append(ctx, ds, vl);
+  if (status == -ENOMEM) {
+    status = kafka_flush_nolock(/* timeout = */ 0, ctx);
+    if (status == 0)
+      status = kafka_buffer_append(ctx, ds, vl);
+    if (status == -ENOMEM)
+      ERROR("write_kafka plugin: value list does not fit into a buffer of "
+            "%" PRIsz " bytes. Please increase \"BufferSize\".",
+            ctx->buffer_size);
+  }
+  if (status == 0)
+    ctx->buffer_values++;
+
+  pthread_mutex_unlock(&ctx->lock);
+  return status;
+} /* }}} int kafka_write_buffered */
+
+static int kafka_flush(cdtime_t timeout, /* {{{ */
+                       const char *identifier __attribute__((unused)),
+                       user_data_t *ud) {
+  struct kafka_topic_context *ctx = ud->data;
+  int status;
+
+  pthread_mutex_lock(&ctx->lock);
+  status = kafka_handle(ctx);
+  if (status == 0)
+    status = kafka_flush_nolock(timeout, ctx);
+  pthread_mutex_unlock(&ctx->lock);
+
+  return status;
+} /* }}} int kafka_flush */
+
+static int kafka_stats_read(user_data_t *ud) /* {{{ */
+{
+  struct kafka_topic_context *ctx = ud->data;
+  value_list_t vl = VALUE_LIST_INIT;
+  gauge_t queue_length = NAN;
+  derive_t values, accepted, rejected;
+
+  pthread_mutex_lock(&ctx->lock);
+  if (ctx->kafka != NULL)
+    queue_length = (gauge_t)rd_kafka_outq_len(ctx->kafka);
+  values = ctx->stats_values;
+  accepted = ctx->stats_accepted;
+  rejected = ctx->stats_rejected;
+  pthread_mutex_unlock(&ctx->lock);
+
+  vl.values = &(value_t){.gauge = queue_length};
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "write_kafka", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, ctx->topic_name, sizeof(vl.plugin_instance));
+  sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+  plugin_dispatch_values(&vl);
+
+  vl.values = &(value_t){.derive = values};
+  sstrncpy(vl.type, "total_values", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "sent", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  vl.values = &(value_t){.derive = accepted};
+  sstrncpy(vl.type, "total_requests", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "produce-accepted", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  vl.values = &(value_t){.derive = rejected};
+  sstrncpy(vl.type_instance, "produce-rejected", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  return 0;
+} /* }}} int kafka_stats_read */
+
 static int kafka_write(const data_set_t *ds, /* {{{ */
                        const value_list_t *vl, user_data_t *ud) {
   int status = 0;
-  void *key;
-  size_t keylen = 0;
   char buffer[8192];
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
+  char *payload = buffer;
+  json_buffer_t *json;
   size_t blen = 0;
   struct kafka_topic_context *ctx = ud->data;
 
@@ -190,6 +437,9 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
   if (status != 0)
     return status;
 
+  if (ctx->buffer_size > 0)
+    return kafka_write_buffered(ctx, ds, vl);
+
   bzero(buffer, sizeof(buffer));
 
   switch (ctx->format) {
@@ -203,10 +453,18 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
     blen = strlen(buffer);
     break;
   case KAFKA_FORMAT_JSON:
-    format_json_initialize(buffer, &bfill, &bfree);
-    format_json_value_list(buffer, &bfill, &bfree, ds, vl, ctx->store_rates);
-    format_json_finalize(buffer, &bfill, &bfree);
-    blen = strlen(buffer);
+    json = json_buffer_thread();
+    if (json == NULL)
+      return ENOMEM;
+    status = json_buffer_value_list(json, ds, vl, ctx->store_rates);
+    if (status != 0) {
+      ERROR("write_kafka plugin: Formatting JSON failed with status %i.",
+            status);
+      return status;
+    }
+    json_buffer_finalize(json);
+    payload = json->data;
+    blen = json->fill;
     break;
   case KAFKA_FORMAT_GRAPHITE:
     status =
@@ -224,12 +482,13 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
     return -1;
   }
 
-  key =
-      (ctx->key != NULL) ? ctx->key : kafka_random_key(KAFKA_RANDOM_KEY_BUFFER);
-  keylen = strlen(key);
+  status = kafka_produce(ctx, payload, blen, RD_KAFKA_MSG_F_COPY);
 
-  rd_kafka_produce(ctx->topic, RD_KAFKA_PARTITION_UA, RD_KAFKA_MSG_F_COPY,
-                   buffer, blen, key, keylen, NULL);
+  if (ctx->report_stats) {
+    pthread_mutex_lock(&ctx->lock);
+    kafka_stats_add(ctx, 1, status);
+    pthread_mutex_unlock(&ctx->lock);
+  }
 
   return status;
 } /* }}} int kafka_write */
@@ -241,6 +500,11 @@ static void kafka_topic_context_free(void *p) /* {{{ */
   if (ctx == NULL)
     return;
 
+  /* Send what is left in the coalescing buffer. */
+  if ((ctx->buffer != NULL) && (ctx->topic != NULL))
+    kafka_flush_nolock(/* timeout = */ 0, ctx);
+  sfree(ctx->buffer);
+
   if (ctx->topic_name != NULL)
     sfree(ctx->topic_name);
   if (ctx->topic != NULL)
@@ -366,6 +630,17 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
 
       sfree(key);
 
+    } else if (strcasecmp("BufferSize", child->key) == 0) {
+      int buffer_size = 0;
+      status = cf_util_get_int(child, &buffer_size);
+      if ((status == 0) && (buffer_size < 0)) {
+        WARNING("write_kafka plugin: \"BufferSize\" must not be negative.");
+        status = -1;
+      }
+      if (status == 0)
+        tctx->buffer_size = (size_t)buffer_size;
+    } else if (strcasecmp("ReportStats", child->key) == 0) {
+      status = cf_util_get_boolean(child, &tctx->report_stats);
     } else if (strcasecmp("StoreRates", child->key) == 0) {
       status = cf_util_get_boolean(child, &tctx->store_rates);
       (void)cf_util_get_flag(child, &tctx->graphite_flags,
@@ -413,6 +688,8 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
   ssnprintf(callback_name, sizeof(callback_name), "write_kafka/%s",
             tctx->topic_name);
 
+  pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
+
   status = plugin_register_write(callback_name, kafka_write,
                                  &(user_data_t){
                                      .data = tctx,
@@ -422,10 +699,19 @@ static void kafka_config_topic(rd_kafka_conf_t *conf,
     WARNING("write_kafka plugin: plugin_register_write (\"%s\") "
             "failed with status %i.",
             callback_name, status);
+    pthread_mutex_destroy(&tctx->lock);
     goto errout;
   }
 
-  pthread_mutex_init(&tctx->lock, /* attr = */ NULL);
+  /* tctx is owned by the write callback from here on. */
+  if (tctx->buffer_size > 0)
+    plugin_register_flush(callback_name, kafka_flush,
+                          &(user_data_t){.data = tctx});
+
+  if (tctx->report_stats)
+    plugin_register_complex_read(/* group = */ NULL, callback_name,
+                                 kafka_stats_read, /* interval = */ 0,
+                                 &(user_data_t){.data = tctx});
 
   return;
 errout:
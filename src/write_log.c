@@ -62,21 +62,28 @@ static int wl_write_graphite(const data_set_t *ds, const value_list_t *vl) {
 } /* int wl_write_graphite */
 
 static int wl_write_json(const data_set_t *ds, const value_list_t *vl) {
-  char buffer[WL_BUF_SIZE] = {0};
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
+  json_buffer_t *buffer;
+  int status;
 
   if (0 != strcmp(ds->type, vl->type)) {
     ERROR("write_log plugin: DS type does not match value list type");
     return -1;
   }
 
-  format_json_initialize(buffer, &bfill, &bfree);
-  format_json_value_list(buffer, &bfill, &bfree, ds, vl,
-                         /* store rates = */ 0);
-  format_json_finalize(buffer, &bfill, &bfree);
+  buffer = json_buffer_thread();
+  if (buffer == NULL) {
+    ERROR("write_log plugin: json_buffer_thread failed.");
+    return ENOMEM;
+  }
 
-  INFO("write_log values:\n%s", buffer);
+  status = json_buffer_value_list(buffer, ds, vl, /* store rates = */ 0);
+  if (status != 0) {
+    ERROR("write_log plugin: Formatting JSON failed with status %i.", status);
+    return status;
+  }
+  json_buffer_finalize(buffer);
+
+  INFO("write_log values:\n%s", buffer->data);
 
   return 0;
 } /* int wl_write_json */
@@ -0,0 +1,412 @@
+/**
+ * collectd - src/write_shm.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+/*
+ * Publishes the latest value of every series in a memory-mapped file for
+ * local readers. See src/libcollectdclient/collectd/shm.h for the layout and
+ * the reader.
+ */
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/avltree/avltree.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+#include "utils_complain.h"
+
+#include "collectd/shm.h"
+
+#include <sched.h>
+#include <sys/mman.h>
+
+#define WSHM_DEFAULT_FILE "/dev/shm/collectd"
+#define WSHM_DEFAULT_MAX_SERIES 65536
+#define WSHM_DEFAULT_PERMS (S_IRUSR | S_IWUSR | S_IRGRP)
+/* Space reserved in the dictionary per series. Identifiers are usually much
+ * shorter than the maximum; pages of the file are only allocated once used. */
+#define WSHM_DICT_BYTES_PER_SERIES 128
+
+/*
+ * Private variables
+ */
+static char *wshm_file;
+static uint64_t max_series = WSHM_DEFAULT_MAX_SERIES;
+static int wshm_perms = WSHM_DEFAULT_PERMS;
+static bool store_rates;
+
+/* Updating existing series only needs a read lock: the slot itself is
+ * protected by its sequence lock. Adding a series and (re)creating the file
+ * need the write lock. */
+static pthread_rwlock_t wshm_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* Maps identifiers to slot indexes. */
+static c_avl_tree_t *wshm_tree;
+
+static void *wshm_map;
+static size_t wshm_map_size;
+static lcc_shm_header_t *wshm_header;
+static char *wshm_slots;
+static char *wshm_dict;
+
+static c_complain_t wshm_full_complaint = C_COMPLAIN_INIT_STATIC;
+static c_complain_t wshm_values_complaint = C_COMPLAIN_INIT_STATIC;
+
+static lcc_shm_slot_t *wshm_slot(uint64_t index) {
+  return (lcc_shm_slot_t *)(wshm_slots + index * wshm_header->slot_size);
+}
+
+/* Stores a field readers check, after all preceding stores. */
+static void wshm_store(uint64_t *ptr, uint64_t value) {
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  *(uint64_t volatile *)ptr = value;
+}
+
+/* Creates a new file and renames it over "file", so that readers which still
+ * have the old file mapped are not affected. */
+static int wshm_create(const char *file, uint64_t slots_max) /* {{{ */
+{
+  char tmp_file[PATH_MAX];
+  int status;
+
+  uint64_t slots_offset = sizeof(lcc_shm_header_t);
+  slots_offset += (8 - slots_offset % 8) % 8;
+  uint64_t dict_offset = slots_offset + slots_max * sizeof(lcc_shm_slot_t);
+  uint64_t dict_size = slots_max * WSHM_DICT_BYTES_PER_SERIES;
+  size_t size = (size_t)(dict_offset + dict_size);
+
+  status = snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", file);
+  if ((status < 0) || ((size_t)status >= sizeof(tmp_file)))
+    return ENAMETOOLONG;
+
+  int fd = open(tmp_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    status = errno;
+    ERROR("write_shm plugin: Opening \"%s\" failed: %s", tmp_file, STRERRNO);
+    return status;
+  }
+
+  /* Not subject to the umask, like the unixsock plugin's SocketPerms. */
+  if (fchmod(fd, (mode_t)wshm_perms) != 0) {
+    status = errno;
+    ERROR("write_shm plugin: chmod of \"%s\" failed: %s", tmp_file, STRERRNO);
+    close(fd);
+    unlink(tmp_file);
+    return status;
+  }
+
+  if (ftruncate(fd, (off_t)size) != 0) {
+    status = errno;
+    ERROR("write_shm plugin: Resizing \"%s\" to %" PRIsz " bytes failed: %s",
+          tmp_file, size, STRERRNO);
+    close(fd);
+    unlink(tmp_file);
+    return status;
+  }
+
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  status = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    ERROR("write_shm plugin: mmap of \"%s\" failed: %s", tmp_file,
+          STRERROR(status));
+    unlink(tmp_file);
+    return status;
+  }
+
+  lcc_shm_header_t *h = map;
+  *h = (lcc_shm_header_t){
+      .version = LCC_SHM_VERSION,
+      .slot_size = (uint32_t)sizeof(lcc_shm_slot_t),
+      .slots_offset = slots_offset,
+      .slots_max = slots_max,
+      .dict_offset = dict_offset,
+      .dict_size = dict_size,
+      .created = (uint64_t)cdtime(),
+  };
+  memcpy(h->magic, LCC_SHM_MAGIC, sizeof(h->magic));
+
+  if (rename(tmp_file, file) != 0) {
+    status = errno;
+    ERROR("write_shm plugin: Renaming \"%s\" to \"%s\" failed: %s", tmp_file,
+          file, STRERRNO);
+    munmap(map, size);
+    unlink(tmp_file);
+    return status;
+  }
+
+  wshm_map = map;
+  wshm_map_size = size;
+  wshm_header = h;
+  wshm_slots = (char *)map + slots_offset;
+  wshm_dict = (char *)map + dict_offset;
+  return 0;
+} /* }}} int wshm_create */
+
+static void wshm_destroy(void) /* {{{ */
+{
+  if (wshm_tree != NULL) {
+    char *key = NULL;
+    void *value = NULL;
+    while (c_avl_pick(wshm_tree, (void *)&key, &value) == 0)
+      sfree(key);
+    c_avl_destroy(wshm_tree);
+    wshm_tree = NULL;
+  }
+
+  if (wshm_map != NULL) {
+    wshm_header->closed = 1;
+    munmap(wshm_map, wshm_map_size);
+  }
+  wshm_map = NULL;
+  wshm_map_size = 0;
+  wshm_header = NULL;
+  wshm_slots = NULL;
+  wshm_dict = NULL;
+} /* }}} void wshm_destroy */
+
+/* Looks up the slot of "identifier". Must hold at least the read lock. */
+static int wshm_slot_find(const char *identifier, uint64_t *ret_index) {
+  void *value = NULL;
+  if (c_avl_get(wshm_tree, identifier, &value) != 0)
+    return ENOENT;
+
+  *ret_index = (uint64_t)(uintptr_t)value;
+  return 0;
+} /* int wshm_slot_find */
+
+/* Looks up the slot of "identifier" or assigns a new one. New slots are not
+ * published until the caller increases "slots_num". Must hold the write
+ * lock. */
+static int wshm_slot_get_nolock(const char *identifier, /* {{{ */
+                                uint64_t *ret_index) {
+  if (wshm_slot_find(identifier, ret_index) == 0)
+    return 0;
+
+  uint64_t index = wshm_header->slots_num;
+  size_t len = strlen(identifier) + 1;
+  if ((index >= wshm_header->slots_max) ||
+      (len > wshm_header->dict_size - wshm_header->dict_used)) {
+    c_complain(LOG_WARNING, &wshm_full_complaint,
+               "write_shm plugin: \"%s\" is full, new series are not "
+               "exported. Consider increasing MaxSeries.",
+               wshm_file);
+    return ENOSPC;
+  }
+
+  char *key = strdup(identifier);
+  if (key == NULL)
+    return ENOMEM;
+  if (c_avl_insert(wshm_tree, key, (void *)(uintptr_t)index) != 0) {
+    sfree(key);
+    return -1;
+  }
+
+  memcpy(wshm_dict + wshm_header->dict_used, identifier, len);
+  wshm_slot(index)->identifier = wshm_header->dict_used;
+  wshm_header->dict_used += len;
+
+  *ret_index = index;
+  return 0;
+} /* }}} int wshm_slot_get_nolock */
+
+/* Writes the values of "vl" to "slot". Several threads may update the same
+ * slot while holding the read lock, so the writer side of the sequence lock
+ * is taken by making "seq" odd with a compare-and-swap. */
+static void wshm_slot_update(lcc_shm_slot_t *slot, /* {{{ */
+                             const data_set_t *ds, const value_list_t *vl,
+                             const gauge_t *rates) {
+  uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+  while (true) {
+    if (seq & 1) {
+      sched_yield();
+      seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+      continue;
+    }
+    /* Readers retry while "seq" is odd or has changed. */
+    if (__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      break;
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  slot->time = (uint64_t)vl->time;
+  slot->interval = (uint64_t)vl->interval;
+  slot->values_len = (uint32_t)ds->ds_num;
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    if (store_rates && (ds->ds[i].type != DS_TYPE_GAUGE)) {
+      slot->values_types[i] = DS_TYPE_GAUGE;
+      slot->values[i].gauge = rates[i];
+      continue;
+    }
+
+    slot->values_types[i] = (uint8_t)ds->ds[i].type;
+    memcpy(slot->values + i, vl->values + i, sizeof(slot->values[i]));
+  }
+
+  wshm_store(&slot->seq, seq + 2);
+} /* }}} void wshm_slot_update */
+
+static int wshm_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
+                      user_data_t __attribute__((unused)) * user_data) {
+  char identifier[6 * DATA_MAX_NAME_LEN];
+  gauge_t rates[LCC_SHM_VALUES_MAX];
+
+  if (0 != strcmp(ds->type, vl->type)) {
+    ERROR("write_shm plugin: DS type does not match value list type");
+    return -1;
+  }
+
+  if (ds->ds_num > LCC_SHM_VALUES_MAX) {
+    c_complain(LOG_WARNING, &wshm_values_complaint,
+               "write_shm plugin: Type \"%s\" has %" PRIsz " data sources, "
+               "only up to %d can be exported.",
+               ds->type, ds->ds_num, LCC_SHM_VALUES_MAX);
+    return EINVAL;
+  }
+
+  if (store_rates && (uc_get_rate_r(ds, vl, rates) != 0)) {
+    ERROR("write_shm plugin: uc_get_rate_r failed.");
+    return -1;
+  }
+
+  int status = FORMAT_VL(identifier, sizeof(identifier), vl);
+  if (status != 0)
+    return status;
+
+  /* Fast path: the series has been seen before. */
+  uint64_t index = 0;
+  pthread_rwlock_rdlock(&wshm_lock);
+  if (wshm_map == NULL) {
+    pthread_rwlock_unlock(&wshm_lock);
+    return -1;
+  }
+  if (wshm_slot_find(identifier, &index) == 0) {
+    wshm_slot_update(wshm_slot(index), ds, vl, rates);
+    pthread_rwlock_unlock(&wshm_lock);
+    return 0;
+  }
+  pthread_rwlock_unlock(&wshm_lock);
+
+  pthread_rwlock_wrlock(&wshm_lock);
+  if (wshm_map == NULL) {
+    pthread_rwlock_unlock(&wshm_lock);
+    return -1;
+  }
+  status = wshm_slot_get_nolock(identifier, &index);
+  if (status != 0) {
+    pthread_rwlock_unlock(&wshm_lock);
+    return status;
+  }
+  wshm_slot_update(wshm_slot(index), ds, vl, rates);
+
+  /* Slots are assigned in order, so this is a new one unless another thread
+   * added it in the meantime. Publish it now that its identifier and first
+   * value are in place. */
+  if (index == wshm_header->slots_num)
+    wshm_store(&wshm_header->slots_num, index + 1);
+
+  pthread_rwlock_unlock(&wshm_lock);
+  return 0;
+} /* }}} int wshm_write */
+
+static int wshm_init(void) /* {{{ */
+{
+  pthread_rwlock_wrlock(&wshm_lock);
+
+  if (wshm_map != NULL) {
+    pthread_rwlock_unlock(&wshm_lock);
+    return 0;
+  }
+
+  if (wshm_file == NULL) {
+    wshm_file = strdup(WSHM_DEFAULT_FILE);
+    if (wshm_file == NULL) {
+      pthread_rwlock_unlock(&wshm_lock);
+      return ENOMEM;
+    }
+  }
+
+  wshm_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
+  if (wshm_tree == NULL) {
+    pthread_rwlock_unlock(&wshm_lock);
+    return ENOMEM;
+  }
+
+  int status = wshm_create(wshm_file, max_series);
+  if (status != 0)
+    wshm_destroy();
+
+  pthread_rwlock_unlock(&wshm_lock);
+  return status;
+} /* }}} int wshm_init */
+
+static int wshm_shutdown(void) /* {{{ */
+{
+  pthread_rwlock_wrlock(&wshm_lock);
+  wshm_destroy();
+  sfree(wshm_file);
+  pthread_rwlock_unlock(&wshm_lock);
+  return 0;
+} /* }}} int wshm_shutdown */
+
+static int wshm_config(oconfig_item_t *ci) /* {{{ */
+{
+  for (int i = 0; i < ci->children_num; i++) {
+    oconfig_item_t *child = ci->children + i;
+    int status = 0;
+
+    if (strcasecmp("File", child->key) == 0) {
+      status = cf_util_get_string(child, &wshm_file);
+    } else if (strcasecmp("MaxSeries", child->key) == 0) {
+      int tmp = 0;
+      status = cf_util_get_int(child, &tmp);
+      if ((status == 0) && (tmp < 1)) {
+        ERROR("write_shm plugin: MaxSeries must be positive.");
+        status = -1;
+      }
+      if (status == 0)
+        max_series = (uint64_t)tmp;
+    } else if (strcasecmp("FilePerms", child->key) == 0) {
+      char *perms = NULL;
+      status = cf_util_get_string(child, &perms);
+      if (status == 0) {
+        wshm_perms = (int)strtol(perms, NULL, 8);
+        sfree(perms);
+      }
+    } else if (strcasecmp("StoreRates", child->key) == 0) {
+      status = cf_util_get_boolean(child, &store_rates);
+    } else {
+      ERROR("write_shm plugin: Invalid configuration option: `%s'.",
+            child->key);
+      status = -1;
+    }
+
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int wshm_config */
+
+void module_register(void) {
+  plugin_register_complex_config("write_shm", wshm_config);
+  plugin_register_init("write_shm", wshm_init);
+  plugin_register_write("write_shm", wshm_write, /* user_data = */ NULL);
+  plugin_register_shutdown("write_shm", wshm_shutdown);
+} /* void module_register */
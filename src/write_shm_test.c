@@ -0,0 +1,284 @@
+/**
+ * collectd - src/write_shm_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; only version 2 of the License is applicable.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ **/
+
+#include "write_shm.c" /* sic */
+
+#include "testing.h"
+
+#define BENCH_SERIES_NUM (1024 * 1024)
+
+static char tmp_dir[] = "/tmp/write_shm_test.XXXXXX";
+static char file[PATH_MAX];
+
+static data_source_t dsrc_gauge2[] = {
+    {"a", DS_TYPE_GAUGE, 0.0, NAN},
+    {"b", DS_TYPE_GAUGE, 0.0, NAN},
+};
+static data_set_t ds_gauge2 = {"gauge2", 2, dsrc_gauge2};
+
+static data_source_t dsrc_derive[] = {{"value", DS_TYPE_DERIVE, 0.0, NAN}};
+static data_set_t ds_derive = {"derive", 1, dsrc_derive};
+
+static data_source_t dsrc_wide[LCC_SHM_VALUES_MAX + 1];
+static data_set_t ds_wide = {"wide", LCC_SHM_VALUES_MAX + 1, dsrc_wide};
+
+/* cdtime() is mocked in the test build. */
+static double now(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int start(uint64_t series) {
+  sfree(wshm_file);
+  wshm_file = strdup(file);
+  max_series = series;
+  return wshm_init();
+}
+
+static int write_gauge2(const char *plugin_instance, gauge_t value) {
+  value_t values[] = {{.gauge = value}, {.gauge = value}};
+  value_list_t vl = {
+      .values = values,
+      .values_len = STATIC_ARRAY_SIZE(values),
+      .time = TIME_T_TO_CDTIME_T(1500000000),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "gauge2",
+  };
+  sstrncpy(vl.plugin_instance, plugin_instance, sizeof(vl.plugin_instance));
+
+  return wshm_write(&ds_gauge2, &vl, NULL);
+}
+
+DEF_TEST(write_read) {
+  lcc_shm_t *shm = NULL;
+  lcc_shm_series_t series;
+
+  CHECK_ZERO(start(2));
+  CHECK_ZERO(lcc_shm_open(file, &shm));
+  EXPECT_EQ_INT(0, lcc_shm_series_num(shm));
+  EXPECT_EQ_INT(ENOENT, lcc_shm_read(shm, 0, &series));
+
+  struct stat statbuf;
+  CHECK_ZERO(stat(file, &statbuf));
+  EXPECT_EQ_INT(0640, statbuf.st_mode & 0777);
+
+  value_t derive = {.derive = -42};
+  value_list_t vl = {
+      .values = &derive,
+      .values_len = 1,
+      .time = TIME_T_TO_CDTIME_T(1500000000),
+      .interval = TIME_T_TO_CDTIME_T(10),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "derive",
+      .type_instance = "ti",
+  };
+  CHECK_ZERO(wshm_write(&ds_derive, &vl, NULL));
+  CHECK_ZERO(write_gauge2("a", 1.5));
+
+  EXPECT_EQ_INT(2, lcc_shm_series_num(shm));
+  CHECK_ZERO(lcc_shm_read(shm, 0, &series));
+  EXPECT_EQ_STR("example.com/test/derive-ti", series.identifier);
+  EXPECT_EQ_DOUBLE(1500000000.0, series.time);
+  EXPECT_EQ_DOUBLE(10.0, series.interval);
+  EXPECT_EQ_INT(1, series.values_len);
+  EXPECT_EQ_INT(DS_TYPE_DERIVE, series.values_types[0]);
+  EXPECT_EQ_INT(-42, series.values[0].derive);
+
+  CHECK_ZERO(write_gauge2("a", 2.5));
+  EXPECT_EQ_INT(2, lcc_shm_series_num(shm));
+  CHECK_ZERO(lcc_shm_read(shm, 1, &series));
+  EXPECT_EQ_STR("example.com/test-a/gauge2", series.identifier);
+  EXPECT_EQ_INT(2, series.values_len);
+  EXPECT_EQ_INT(DS_TYPE_GAUGE, series.values_types[1]);
+  EXPECT_EQ_DOUBLE(2.5, series.values[1].gauge);
+
+  /* The file is full; existing series are still updated. */
+  EXPECT_EQ_INT(ENOSPC, write_gauge2("b", 1.0));
+  EXPECT_EQ_INT(2, lcc_shm_series_num(shm));
+  CHECK_ZERO(write_gauge2("a", 3.5));
+
+  /* Data sets with too many data sources are not exported. */
+  sstrncpy(vl.type, "wide", sizeof(vl.type));
+  EXPECT_EQ_INT(EINVAL, wshm_write(&ds_wide, &vl, NULL));
+
+  OK(!lcc_shm_closed(shm));
+
+  /* A restart replaces the file. */
+  CHECK_ZERO(wshm_shutdown());
+  OK(lcc_shm_closed(shm));
+  CHECK_ZERO(start(2));
+  OK(lcc_shm_closed(shm));
+  lcc_shm_close(shm);
+
+  CHECK_ZERO(lcc_shm_open(file, &shm));
+  OK(!lcc_shm_closed(shm));
+  EXPECT_EQ_INT(0, lcc_shm_series_num(shm));
+  lcc_shm_close(shm);
+
+  CHECK_ZERO(wshm_shutdown());
+  return 0;
+}
+
+DEF_TEST(open_invalid) {
+  lcc_shm_t *shm = NULL;
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/invalid", tmp_dir);
+  FILE *fh = fopen(path, "w");
+  CHECK_NOT_NULL(fh);
+  for (size_t i = 0; i < sizeof(lcc_shm_header_t); i++)
+    fputc('x', fh);
+  CHECK_ZERO(fclose(fh));
+
+  EXPECT_EQ_INT(EPROTO, lcc_shm_open(path, &shm));
+  EXPECT_EQ_INT(ENOENT, lcc_shm_open("/nonexistent/collectd", &shm));
+
+  unlink(path);
+  return 0;
+}
+
+#define WRITERS_NUM 2
+#define WRITES_NUM 100000
+
+static int writers_done;
+
+/* Each writer writes its own range of values. */
+static void *writer_thread(void *arg) {
+  int first = *(int *)arg * WRITES_NUM;
+
+  for (int i = first; i < first + WRITES_NUM; i++)
+    write_gauge2("a", (gauge_t)i);
+  __atomic_add_fetch(&writers_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/* Both values of the series are always written together, so a reader must
+ * never see them differ, not even with several writers updating the series
+ * at the same time. */
+DEF_TEST(concurrent) {
+  lcc_shm_t *shm = NULL;
+  pthread_t threads[WRITERS_NUM];
+  int ids[WRITERS_NUM];
+  lcc_shm_series_t series;
+
+  CHECK_ZERO(start(1));
+  CHECK_ZERO(write_gauge2("a", -1.0));
+  CHECK_ZERO(lcc_shm_open(file, &shm));
+
+  writers_done = 0;
+  for (int i = 0; i < WRITERS_NUM; i++) {
+    ids[i] = i;
+    CHECK_ZERO(pthread_create(threads + i, NULL, writer_thread, ids + i));
+  }
+
+  size_t reads_num = 0;
+  size_t torn_num = 0;
+  while (__atomic_load_n(&writers_done, __ATOMIC_ACQUIRE) < WRITERS_NUM) {
+    if (lcc_shm_read(shm, 0, &series) != 0)
+      continue;
+    reads_num++;
+    if (series.values[0].gauge != series.values[1].gauge)
+      torn_num++;
+  }
+  for (int i = 0; i < WRITERS_NUM; i++)
+    pthread_join(threads[i], NULL);
+
+  printf("# %" PRIsz " consistent reads while writing\n", reads_num);
+  EXPECT_EQ_INT(0, torn_num);
+
+  /* The last value written by one of the writers. */
+  CHECK_ZERO(lcc_shm_read(shm, 0, &series));
+  OK((series.values[0].gauge == (gauge_t)(WRITES_NUM - 1)) ||
+     (series.values[0].gauge == (gauge_t)(2 * WRITES_NUM - 1)));
+  EXPECT_EQ_INT(1, lcc_shm_series_num(shm));
+
+  lcc_shm_close(shm);
+  CHECK_ZERO(wshm_shutdown());
+  return 0;
+}
+
+static int count_series(lcc_shm_series_t const *series, void *user_data) {
+  size_t *count = user_data;
+  if (series->values_len == 2)
+    (*count)++;
+  return 0;
+}
+
+/* Only runs when "--benchmark" is passed: the file is about 240 MB. */
+DEF_TEST(bench) {
+  lcc_shm_t *shm = NULL;
+  char plugin_instance[DATA_MAX_NAME_LEN];
+
+  CHECK_ZERO(start(BENCH_SERIES_NUM));
+
+  double t0 = now();
+  size_t failed_num = 0;
+  for (size_t i = 0; i < BENCH_SERIES_NUM; i++) {
+    snprintf(plugin_instance, sizeof(plugin_instance), "%zu", i);
+    if (write_gauge2(plugin_instance, (gauge_t)i) != 0)
+      failed_num++;
+  }
+  double write_time = now() - t0;
+  EXPECT_EQ_INT(0, failed_num);
+
+  CHECK_ZERO(lcc_shm_open(file, &shm));
+  EXPECT_EQ_INT(BENCH_SERIES_NUM, lcc_shm_series_num(shm));
+
+  /* The first scan faults the pages in. */
+  size_t count = 0;
+  CHECK_ZERO(lcc_shm_scan(shm, count_series, &count));
+  EXPECT_EQ_INT(BENCH_SERIES_NUM, count);
+
+  count = 0;
+  t0 = now();
+  CHECK_ZERO(lcc_shm_scan(shm, count_series, &count));
+  double read_time = now() - t0;
+  EXPECT_EQ_INT(BENCH_SERIES_NUM, count);
+
+  printf("# writing %d series took %.3f s, reading all of them %.3f s "
+         "(%.1f ns per series)\n",
+         BENCH_SERIES_NUM, write_time, read_time,
+         1e9 * read_time / BENCH_SERIES_NUM);
+
+  lcc_shm_close(shm);
+  CHECK_ZERO(wshm_shutdown());
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (mkdtemp(tmp_dir) == NULL) {
+    fprintf(stderr, "mkdtemp failed: %s\n", STRERRNO);
+    return 1;
+  }
+  snprintf(file, sizeof(file), "%s/collectd", tmp_dir);
+
+  RUN_TEST(write_read);
+  RUN_TEST(open_invalid);
+  RUN_TEST(concurrent);
+  if ((argc > 1) && (strcmp("--benchmark", argv[1]) == 0))
+    RUN_TEST(bench);
+
+  unlink(file);
+  rmdir(tmp_dir);
+
+  END_TEST;
+}